@@ -58,6 +58,12 @@
 /* Whether to compile Smoldyn with vtk support */
 /* #undef OPTION_VTK */
 
+/* Whether OpenMP multithreading is available */
+/* #undef HAVE_OPENMP */
+
+/* Whether to store diffusion displacements in single precision */
+/* #undef OPTION_SINGLE_PRECISION */
+
 /* Define to the version of this package. */
 #define VERSION "2.37"
 
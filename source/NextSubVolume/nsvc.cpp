@@ -294,6 +294,7 @@ void nsv_integrate(NextSubvolumeMethod* nsv,double dt, portstruct *port, lattice
 	int *species = new int[n];
 	double **positions = new double*[n];
 	double **positionsx = new double*[n];
+	double *posxbuf = new double[sim->mols->nl[port->llport]*DIMMAX];
 
 	//const double lattice_lengthscale = 0.0001*std::min(lattice->dx[0],std::min(lattice->dx[1],lattice->dx[2]));
 
@@ -308,6 +309,7 @@ void nsv_integrate(NextSubvolumeMethod* nsv,double dt, portstruct *port, lattice
 	n = sim->mols->nl[port->llport];
 	for (int i = 0; i < n; ++i) {
 		moleculeptr m = sim->mols->live[port->llport][i];
+		double *posx = molreal2dbl(m->posx,posxbuf+i*DIMMAX,sim->dim);
 
 //		//process other surface interactions
 //		int er = checksurfaces1mol(sim,m);
@@ -360,7 +362,7 @@ void nsv_integrate(NextSubvolumeMethod* nsv,double dt, portstruct *port, lattice
 			}
 			for (int j = 0; j < PSMAX; ++j) {
 				for (int k = 0; k < lattice->surfacelist[i]->npanel[j]; ++k) {
-					if (lineXpanel(m->posx,cc.data(),lattice->surfacelist[i]->panels[j][k],port->portss->sim->dim,crsspt,&face1,&face2,NULL,NULL,NULL)==1) {
+					if (lineXpanel(posx,cc.data(),lattice->surfacelist[i]->panels[j][k],port->portss->sim->dim,crsspt,&face1,&face2,NULL,NULL,NULL)==1) {
 						//if particle crossed surface when adding to lattice, throw back through port
 						if ((face1!=face2) && (lattice->surfacelist[i]->action[m->ident][0][face1]==SAreflect)) throw_back = true;
 
@@ -373,8 +375,8 @@ void nsv_integrate(NextSubvolumeMethod* nsv,double dt, portstruct *port, lattice
 		if (throw_back) {
 			//std::cout << "throwing back particle at posx = ("<<m->posx[0]<<','<<m->posx[1]<<','<<m->posx[2]<<") and pos = ("<<m->pos[0]<<','<<m->pos[1]<<','<<m->pos[2]<<")"<<std::endl;
 			species[nout] = m->ident;
-			positions[nout] = m->posx;
-			positionsx[nout] = m->posx;
+			positions[nout] = posx;
+			positionsx[nout] = posx;
 			nout++;
 		} else {
 			nsv->get_species(m->ident)->copy_numbers[ci]++;
@@ -444,6 +446,7 @@ void nsv_integrate(NextSubvolumeMethod* nsv,double dt, portstruct *port, lattice
 
 	delete species;
 	delete positions;
+	delete [] posxbuf;
 }
 
 vtkUnstructuredGrid* nsv_get_grid(NextSubvolumeMethod* nsv) {
@@ -13,6 +13,7 @@
 #include "random2.h"
 #include "smoldyn.h"
 #include "smoldynfuncs.h"
+#include "smoldynconfigure.h"
 #include "Zn.h"
 
 /******************************************************************************/
@@ -43,6 +44,7 @@ int boxesupdateparams(simptr sim);
 int boxesupdatelists(simptr sim);
 
 // core simulation functions
+double boxtunecost(simptr sim,double width,double step,double pnlmol,double width0,int maxbox);
 
 
 /******************************************************************************/
@@ -160,7 +162,7 @@ int boxaddmol(moleculeptr mptr,int ll) {
 	
 	if(bptr->nmol[ll]==bptr->maxmol[ll]){
 		if(expandbox(bptr,bptr->maxmol[ll]+1,ll)){ 
-			printf("bptr->nmol[ll]=%d, bptr->maxmol[ll]=%d, mptr->ident=%d\n", bptr->nmol[ll],bptr->maxmol[ll],mptr->ident);
+			SMOLTRACE(NULL,TCdiffuse,TLerror,"bptr->nmol[ll]=%d, bptr->maxmol[ll]=%d, mptr->ident=%d\n", bptr->nmol[ll],bptr->maxmol[ll],mptr->ident);
 			return 1;
 	}}
 	
@@ -193,6 +195,7 @@ boxptr boxalloc(int dim,int nlist) {
 	bptr=NULL;
 	CHECKMEM(bptr=(boxptr) malloc(sizeof(struct boxstruct)));
 	bptr->indx=NULL;
+	bptr->adrs=0;
 	bptr->nneigh=0;
 	bptr->midneigh=0;
 	bptr->neigh=NULL;
@@ -281,8 +284,6 @@ void boxfree(boxptr bptr,int nlist) {
 	free(bptr->maxmol);
 	free(bptr->panel);
 	free(bptr->wlist);
-	free(bptr->wpneigh);
-	free(bptr->neigh);
 	free(bptr->indx);
 	free(bptr);
 	return; }
@@ -334,6 +335,18 @@ boxssptr boxssalloc(int dim) {
 	boxs->min=NULL;
 	boxs->size=NULL;
 	boxs->blist=NULL;
+	boxs->stride=NULL;
+	boxs->nstencil=0;
+	boxs->midstencil=0;
+	boxs->stencil=NULL;
+	boxs->neighpool=NULL;
+	boxs->wppool=NULL;
+	boxs->newbox=NULL;
+	boxs->maxnewbox=0;
+	boxs->tuneinterval=0;
+	boxs->tunect=0;
+	boxs->tunecount=NULL;
+	boxs->maxtunecount=0;
 
 	CHECKMEM(boxs->side=(int*) calloc(dim,sizeof(int)));
 	for(d=0;d<dim;d++) boxs->side[d]=0;
@@ -341,6 +354,9 @@ boxssptr boxssalloc(int dim) {
 	for(d=0;d<dim;d++) boxs->min[d]=0;
 	CHECKMEM(boxs->size=(double*) calloc(dim,sizeof(double)));
 	for(d=0;d<dim;d++) boxs->size[d]=0;
+	CHECKMEM(boxs->stride=(int*) calloc(dim,sizeof(int)));
+	for(d=0;d<dim;d++) boxs->stride[d]=0;
+	CHECKMEM(boxs->stencil=(int*) calloc(intpower(3,dim)-1,sizeof(int)));
 	return boxs;
 
  failure:
@@ -353,6 +369,12 @@ boxssptr boxssalloc(int dim) {
 void boxssfree(boxssptr boxs) {
 	if(!boxs) return;
 	boxesfree(boxs->blist,boxs->nbox,boxs->nlist);
+	free(boxs->neighpool);
+	free(boxs->wppool);
+	free(boxs->stencil);
+	free(boxs->stride);
+	free(boxs->newbox);
+	free(boxs->tunecount);
 	free(boxs->size);
 	free(boxs->min);
 	free(boxs->side);
@@ -435,6 +457,7 @@ void boxssoutput(simptr sim) {
 	simLog(sim,2,"\n");
 	if(boxs->boxsize) simLog(sim,2," Requested box width: %g\n",boxs->boxsize);
 	if(boxs->mpbox) simLog(sim,2," Requested molecules per box: %g\n",boxs->mpbox);
+	if(boxs->tuneinterval) simLog(sim,2," Box size tuned every %i time steps\n",boxs->tuneinterval);
 	simLog(sim,2," Box dimensions: ");
 	for(d=0;d<dim;d++) simLog(sim,2," %g",boxs->size[d]);
 	simLog(sim,2,"\n");
@@ -539,6 +562,25 @@ int boxsetsize(simptr sim,const char *info,double val) {
 	return 0; }
 
 
+/* boxsettune.  Sets the number of time steps between automatic box size
+tuning, or 0 to keep the box size fixed.  Returns 0 for success, 1 for out of
+memory, 2 for a negative interval, or 3 if the dimensionality is undefined. */
+int boxsettune(simptr sim,int interval) {
+	boxssptr boxs;
+
+	if(interval<0) return 2;
+	if(!sim->boxs) {
+		if(!sim->dim) return 3;
+		boxs=boxssalloc(sim->dim);
+		if(!boxs) return 1;
+		boxs->sim=sim;
+		sim->boxs=boxs;
+		boxsetcondition(boxs,SCinit,0); }
+	sim->boxs->tuneinterval=interval;
+	sim->boxs->tunect=0;
+	return 0; }
+
+
 /* boxesupdateparams */
 int boxesupdateparams(simptr sim) {
 	int m,mlo,mhi,nbox,b,ll,ll1,mxml,er,npanel;
@@ -547,6 +589,7 @@ int boxesupdateparams(simptr sim) {
 	int nsrf,s,p;
 	surfaceptr srf;
 	moleculeptr mptr,*mlist;
+	double pbuf[DIMMAX];
 	enum PanelShape ps;
 	panelptr pnl;
 
@@ -594,7 +637,7 @@ int boxesupdateparams(simptr sim) {
 				mlist=sim->mols->live[ll1]; }
 			for(m=mlo;m<mhi;m++) {
 				mptr=mlist[m];
-				bptr=pos2box(sim,mptr->pos);
+				bptr=pos2box(sim,molreal2dbl(mptr->pos,pbuf,sim->dim));
 				mptr->box=bptr;
 				ll=sim->mols->listlookup[mptr->ident][mptr->mstate];
 				bptr->nmol[ll]++; }}
@@ -621,8 +664,8 @@ int boxesupdateparams(simptr sim) {
 
 /* boxesupdatelists */
 int boxesupdatelists(simptr sim) {
-	int dim,d,nbox,b,b2,w,er,nneigh,nwall;
-	int *side,*indx;
+	int dim,d,nbox,b,b2,w,er,nneigh,nwall,maxneigh,type,interior;
+	int *side,*indx,*stride,*stencil,ofst[DIMMAX],side3[DIMMAX],indx3[DIMMAX];
 	boxssptr boxs;
 	boxptr *blist,bptr;
 	double flt1,flt2,mpbox;
@@ -639,7 +682,12 @@ int boxesupdatelists(simptr sim) {
 	if(sim->mols && sim->mols->condition<SCparams) return 2;
 	if(boxs->blist) {																// box superstructure
 		boxesfree(boxs->blist,boxs->nbox,boxs->nlist);
+		boxs->blist=NULL;
 		boxs->nbox=0; }
+	free(boxs->neighpool);
+	free(boxs->wppool);
+	boxs->neighpool=NULL;
+	boxs->wppool=NULL;
 	side=boxs->side;
 	mpbox=boxs->mpbox;
 	if(mpbox<=0 && boxs->boxsize<=0) mpbox=5;
@@ -663,42 +711,60 @@ int boxesupdatelists(simptr sim) {
 	blist=boxs->blist=boxesalloc(nbox,dim,boxs->nlist);
 	if(!blist) return 1;
 
-	for(b=0;b<nbox;b++) add2indxZV(b,blist[b]->indx,side,dim);	// box->indx
+	stride=boxs->stride;														// box->indx, adrs
+	stride[dim-1]=1;
+	for(d=dim-2;d>=0;d--) stride[d]=stride[d+1]*side[d+1];
+	for(b=0;b<nbox;b++) {
+		add2indxZV(b,blist[b]->indx,side,dim);
+		blist[b]->adrs=b; }
 
 	if(sim->accur>=3) {
-		ntemp=allocZV(intpower(3,dim)-1);								// neigh
-		wptemp=allocZV(intpower(3,dim)-1);
-		if(!ntemp || !wptemp) return 1;
+		maxneigh=intpower(3,dim)-1;
+		type=(sim->accur<6)?0:((sim->accur<9)?6:7);
+		ntemp=allocZV(maxneigh);												// neigh
+		wptemp=allocZV(maxneigh);
+		boxs->neighpool=(boxptr*) calloc(nbox*maxneigh,sizeof(boxptr));
+		boxs->wppool=(int*) calloc(nbox*maxneigh,sizeof(int));
+		if(!ntemp || !wptemp || !boxs->neighpool || !boxs->wppool) return 1;
+
+		stencil=boxs->stencil;													// stencil from a 3^dim grid
+		for(d=0;d<dim;d++) {
+			side3[d]=3;
+			indx3[d]=1; }
+		for(w=0;w<2*dim;w++) wptemp[w]=0;
+		boxs->nstencil=neighborZV(indx3,ntemp,side3,dim,type,wptemp,&boxs->midstencil);
+		if(boxs->nstencil==-1) return 1;
+		for(b2=0;b2<boxs->nstencil;b2++) {
+			add2indx3ZV(ntemp[b2],ofst,dim);
+			stencil[b2]=0;
+			for(d=0;d<dim;d++) stencil[b2]+=(ofst[d]-1)*stride[d]; }
+
 		for(b=0;b<nbox;b++) {
 			bptr=blist[b];
 			indx=bptr->indx;
-			if(sim->accur<6)
-				nneigh=neighborZV(indx,ntemp,side,dim,0,NULL,&bptr->midneigh);
-			else if(sim->accur<9) {
+			bptr->neigh=boxs->neighpool+b*maxneigh;
+			bptr->wpneigh=NULL;
+			interior=1;
+			for(d=0;d<dim && interior;d++)
+				if(indx[d]<1 || indx[d]>side[d]-2) interior=0;
+			if(interior) {																// interior box, no wrapping
+				bptr->nneigh=boxs->nstencil;
+				bptr->midneigh=boxs->midstencil;
+				for(b2=0;b2<boxs->nstencil;b2++) bptr->neigh[b2]=blist[b+stencil[b2]];
+				continue; }
+
+			if(type!=0)
 				for(w=0;w<2*dim;w++) wptemp[w]=(sim->wlist[w]->type=='p' && sim->srfss==NULL);
-				nneigh=neighborZV(indx,ntemp,side,dim,6,wptemp,&bptr->midneigh); }
-			else {
-				for(w=0;w<2*dim;w++) wptemp[w]=(sim->wlist[w]->type=='p' && sim->srfss==NULL);
-				nneigh=neighborZV(indx,ntemp,side,dim,7,wptemp,&bptr->midneigh); }
+			nneigh=neighborZV(indx,ntemp,side,dim,type,wptemp,&bptr->midneigh);
 			if(nneigh==-1) return 1;
 			w=0;
-			if(sim->accur>=6) for(b2=0;b2<nneigh;b2++) w+=wptemp[b2];
-
-			if(nneigh && nneigh!=bptr->nneigh) {
-				free(bptr->neigh);
-				free(bptr->wpneigh);
-				bptr->wpneigh=NULL;
-				bptr->neigh=(boxptr*) calloc(nneigh,sizeof(boxptr));
-				if(!bptr->neigh) return 1;
-				if(w) {
-					bptr->wpneigh=allocZV(nneigh);
-					if(!bptr->wpneigh) return 1; }
-				bptr->nneigh=nneigh; }
-			if(nneigh)
-				for(b2=0;b2<nneigh;b2++) bptr->neigh[b2]=blist[ntemp[b2]];
+			if(type!=0) for(b2=0;b2<nneigh;b2++) w+=wptemp[b2];
+			bptr->nneigh=nneigh;
+			for(b2=0;b2<nneigh;b2++) bptr->neigh[b2]=blist[ntemp[b2]];
 			if(w) {
+				bptr->wpneigh=boxs->wppool+b*maxneigh;
 				for(b2=0;b2<nneigh;b2++) bptr->wpneigh[b2]=wptemp[b2]; }}
-		
+
 		neighborZV(NULL,NULL,NULL,0,-1,NULL,NULL);
 		freeZV(ntemp);
 		freeZV(wptemp); }
@@ -749,20 +815,20 @@ int boxesupdate(simptr sim) {
 
 /* line2nextbox */
 boxptr line2nextbox(simptr sim,double *pt1,double *pt2,boxptr bptr) {
-	int dim,d,d2,boxside,boxside2,adrs,z1[DIMMAX],*side,sum,flag;
+	int dim,d,d2,boxside,boxside2,adrs,*side,*stride,sum,flag;
 	double *size,*min,crsmin,edge,crs;
 
 	if(pos2box(sim,pt2)==bptr) return NULL;
 	dim=sim->dim;
 	size=sim->boxs->size;
 	side=sim->boxs->side;
+	stride=sim->boxs->stride;
 	min=sim->boxs->min;
 	crsmin=1.01;
 	boxside2=0;
 	d2=0;
 	flag=0;
 	for(d=0;d<dim;d++) {
-		z1[d]=bptr->indx[d];
 		if(pt2[d]!=pt1[d]) {
 			boxside=(pt2[d]>pt1[d])?1:0;		// 1 for high side, 0 for low side
 			sum=bptr->indx[d]+boxside;
@@ -779,6 +845,7 @@ boxptr line2nextbox(simptr sim,double *pt1,double *pt2,boxptr bptr) {
 					else flag=1; }}}}
 
 	if(flag) {
+		adrs=bptr->adrs;
 		for(d=0;d<dim;d++) {
 			if(pt2[d]!=pt1[d]) {
 				boxside=(pt2[d]>pt1[d])?1:0;
@@ -787,35 +854,52 @@ boxptr line2nextbox(simptr sim,double *pt1,double *pt2,boxptr bptr) {
 					edge=min[d]+(double)sum*size[d];
 					crs=(edge-pt1[d])/(pt2[d]-pt1[d]);
 					if(crs==crsmin && (boxside==1 || flag==2))
-						z1[d]+=boxside?1:-1; }}}
-		adrs=indx2addZV(z1,sim->boxs->side,dim);
+						adrs+=boxside?stride[d]:-stride[d]; }}}
 		return sim->boxs->blist[adrs]; }
 
 	if(crsmin==1.01) return NULL;
-	z1[d2]+=boxside2?1:-1;
-	adrs=indx2addZV(z1,sim->boxs->side,dim);
+	adrs=bptr->adrs+(boxside2?stride[d2]:-stride[d2]);
 	return sim->boxs->blist[adrs]; }
 
 
-/* reassignmolecs */
+/* reassignmolecs.  With more than one thread, the box lookups are done in
+parallel into boxs->newbox and the box arrays are then updated serially, in
+list order, so the result does not depend on the number of threads. */
 int reassignmolecs(simptr sim,int diffusing,int reborn) {
-	int m,nmol,m2,ll;
-	boxptr bptr1;
+	int m,m0,nmol,m2,ll;
+	boxptr bptr1,*newbox;
+	boxssptr boxs;
 	moleculeptr mptr,*mlist,*mlist2;
+	double pbuf[DIMMAX];
 
 	if(!sim->mols) return 0;
-	if(sim->boxs->nbox==1) return 0;
+	boxs=sim->boxs;
+	if(boxs->nbox==1) return 0;
 	// for(ll=0;ll<sim->mols->nlist;ll++)			// don't think need to reassign immobile molecules
 	for(ll=0;ll<1;ll++)
 		if(sim->mols->listtype[ll]==MLTsystem)
 			if(diffusing==0 || sim->mols->diffuselist[ll]==1){
 				nmol=sim->mols->nl[ll];
 				mlist=sim->mols->live[ll];
-				if(!reborn) m=0;
-				else m=sim->mols->topl[ll];				// or sim->mols->nl[ll]==sim->mols->topl[ll]
-				for(;m<nmol;m++) {
+				if(!reborn) m0=0;
+				else m0=sim->mols->topl[ll];				// or sim->mols->nl[ll]==sim->mols->topl[ll]
+				newbox=NULL;
+				if(sim->nthreads>1 && nmol>m0) {
+					if(boxs->maxnewbox<nmol) {
+						free(boxs->newbox);
+						boxs->newbox=(boxptr*) calloc(nmol,sizeof(boxptr));
+						boxs->maxnewbox=boxs->newbox?nmol:0;
+						if(!boxs->newbox) return 1; }
+					newbox=boxs->newbox;
+#ifdef HAVE_OPENMP
+					#pragma omp parallel for schedule(static) num_threads(sim->nthreads)
+#endif
+					for(m=m0;m<nmol;m++) {
+						double mbuf[DIMMAX];
+						newbox[m]=pos2box(sim,molreal2dbl(mlist[m]->pos,mbuf,sim->dim)); }}
+				for(m=m0;m<nmol;m++) {
 					mptr=mlist[m];
-					bptr1=pos2box(sim,mptr->pos);
+					bptr1=newbox?newbox[m]:pos2box(sim,molreal2dbl(mptr->pos,pbuf,sim->dim));
 					if(!bptr1) return 1;
 					
 					if(mptr->box!=bptr1){
@@ -828,4 +912,121 @@ int reassignmolecs(simptr sim,int diffusing,int reborn) {
 	return 0; }
 
 
+/* boxtunecost.  Estimates the per time step cost of a uniform box grid of
+the given width, in units of single distance or panel tests.  Molecules are
+binned into the trial grid, in boxs->tunecount, to count pair tests within the
+3^dim box neighborhoods.  Box crossings are estimated from the mean step
+length step, and panel tests from the mean number of panels per molecule's
+box pnlmol, measured at the current width width0.  Returns -1 if the grid
+would have more than maxbox boxes, or -2 for out of memory. */
+double boxtunecost(simptr sim,double width,double step,double pnlmol,double width0,int maxbox) {
+	boxssptr boxs;
+	molssptr mols;
+	int d,dim,ll,m,b,i,nbox,nmol,side[DIMMAX],*count;
+	double sumsq,cost;
+	molreal *pos;
+
+	boxs=sim->boxs;
+	mols=sim->mols;
+	dim=sim->dim;
+	nbox=1;
+	for(d=0;d<dim;d++) {
+		side[d]=(int)ceil((sim->wlist[2*d+1]->pos-sim->wlist[2*d]->pos)/width);
+		if(side[d]<1) side[d]=1;
+		if(nbox>maxbox/side[d]) return -1;
+		nbox*=side[d]; }
+	if(nbox>boxs->maxtunecount) {
+		free(boxs->tunecount);
+		boxs->tunecount=(int*) calloc(nbox,sizeof(int));
+		boxs->maxtunecount=boxs->tunecount?nbox:0;
+		if(!boxs->tunecount) return -2; }
+	count=boxs->tunecount;
+	for(b=0;b<nbox;b++) count[b]=0;
+
+	nmol=0;
+	for(ll=0;ll<mols->nlist;ll++) {
+		if(mols->listtype[ll]!=MLTsystem) continue;
+		for(m=0;m<mols->nl[ll];m++) {
+			pos=mols->live[ll][m]->pos;
+			b=0;
+			for(d=0;d<dim;d++) {
+				i=(int)((pos[d]-boxs->min[d])/width);
+				if(i<0) i=0;
+				else if(i>=side[d]) i=side[d]-1;
+				b=b*side[d]+i; }
+			count[b]++;
+			nmol++; }}
+
+	sumsq=0;
+	for(b=0;b<nbox;b++) sumsq+=(double)count[b]*count[b];
+	cost=0.5*intpower(3,dim)*sumsq;							// pair tests
+	cost+=nmol*dim*step/width;									// box crossings
+	cost+=nmol*pnlmol*pow(width/width0,dim-1);	// panel tests
+	cost+=0.1*nbox;														// per box overhead
+	return cost; }
+
+
+/* boxestune.  Called once per time step.  Every tuneinterval time steps, this
+compares the estimated cost of the current box width with widths that differ
+by powers of sqrt(2), from 16 times smaller to 2 times larger, and rebuilds the
+box grid at the cheapest width if it saves more than 10%.  The grid is rebuilt by simupdate at
+the start of the next time step, which also reassigns molecules and surface
+panels to boxes and recomputes compartment box lists.  Protective domains are
+burst first, because they were sized for the old boxes.  Returns 0 for success
+or 1 for out of memory. */
+int boxestune(simptr sim) {
+	boxssptr boxs;
+	molssptr mols;
+	moleculeptr mptr;
+	int d,dim,ll,m,k,nmol,kbest,maxbox;
+	double width0,width,step,pnlmol,cost,cost0,costbest;
+
+	boxs=sim->boxs;
+	mols=sim->mols;
+	if(!boxs || !boxs->tuneinterval || !mols || boxs->condition!=SCok) return 0;
+	if(++boxs->tunect<boxs->tuneinterval) return 0;
+	boxs->tunect=0;
+	dim=sim->dim;
+
+	nmol=0;
+	step=pnlmol=0;
+	for(ll=0;ll<mols->nlist;ll++) {
+		if(mols->listtype[ll]!=MLTsystem) continue;
+		for(m=0;m<mols->nl[ll];m++) {
+			mptr=mols->live[ll][m];
+			step+=sqrt(2.0*dim*mols->difc[mptr->ident][mptr->mstate]*sim->dt);
+			pnlmol+=mptr->box->npanel;
+			nmol++; }}
+	if(!nmol) return 0;
+	step/=nmol;
+	pnlmol/=nmol;
+
+	width0=1;
+	for(d=0;d<dim;d++) width0*=boxs->size[d];
+	width0=pow(width0,1.0/dim);
+	maxbox=8*nmol+64;
+	if(maxbox<boxs->nbox) maxbox=boxs->nbox;
+
+	cost0=costbest=boxtunecost(sim,width0,step,pnlmol,width0,maxbox);
+	if(cost0==-2) return 1;
+	kbest=0;
+	for(k=-8;k<=2;k++) {
+		if(k==0) continue;
+		width=width0*pow(2.0,0.5*k);
+		cost=boxtunecost(sim,width,step,pnlmol,width0,maxbox);
+		if(cost==-2) return 1;
+		if(cost>=0 && cost<costbest) {
+			costbest=cost;
+			kbest=k; }}
+	if(kbest==0 || costbest>0.9*cost0) return 0;
+
+	width=width0*pow(2.0,0.5*kbest);
+	simLog(sim,2," time %g: box width changed from %g to %g\n",sim->time,width0,width);
+	if(gfrdburstall(sim)) return 1;
+	boxs->mpbox=0;
+	boxs->boxsize=width;
+	boxsetcondition(boxs,SClists,0);
+	compartsetcondition(sim->cmptss,SCparams,0);
+	mols->nbrvalid=0;
+	return 0; }
 
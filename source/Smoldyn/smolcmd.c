@@ -13,6 +13,7 @@
 #include "random2.h"
 #include "Rn.h"
 #include "RnSort.h"
+#include "SimTraj.h"
 #include "smoldyn.h"
 #include "smoldynfuncs.h"
 #include "string2.h"
@@ -29,6 +30,8 @@
 #include <vcellcmd.h>
 #endif
 
+typedef enum CMDcode (*cmdfnptr)(simptr sim,cmdptr cmd,char *line2);
+
 // simulation control
 enum CMDcode cmdstop(simptr sim,cmdptr cmd,char *line2);
 enum CMDcode cmdpause(simptr sim,cmdptr cmd,char *line2);
@@ -65,6 +68,7 @@ enum CMDcode cmdmolcountincmpts(simptr sim,cmdptr cmd,char *line2);
 enum CMDcode cmdmolcountincmpt2(simptr sim,cmdptr cmd,char *line2);
 enum CMDcode cmdmolcountonsurf(simptr sim,cmdptr cmd,char *line2);
 enum CMDcode cmdmolcountspace(simptr sim,cmdptr cmd,char *line2);
+enum CMDcode cmdmolcountspacegrid(simptr sim,cmdptr cmd,char *line2);
 enum CMDcode cmdmolcountspecies(simptr sim,cmdptr cmd,char *line2);
 enum CMDcode cmdmollistsize(simptr sim,cmdptr cmd,char *line2);
 enum CMDcode cmdlistmols(simptr sim,cmdptr cmd,char *line2);
@@ -76,6 +80,7 @@ enum CMDcode cmdmolpos(simptr sim,cmdptr cmd,char *line2);
 enum CMDcode cmdtrackmol(simptr sim,cmdptr cmd,char *line2);
 enum CMDcode cmdmolmoments(simptr sim,cmdptr cmd,char *line2);
 enum CMDcode cmdsavesim(simptr sim,cmdptr cmd,char *line2);
+enum CMDcode cmdwritetraj(simptr sim,cmdptr cmd,char *line2);
 enum CMDcode cmdmeansqrdisp(simptr sim,cmdptr cmd,char *line2);
 enum CMDcode cmdmeansqrdisp2(simptr sim,cmdptr cmd,char *line2);
 enum CMDcode cmdmeansqrdisp3(simptr sim,cmdptr cmd,char *line2);
@@ -116,128 +121,241 @@ enum CMDcode cmdexcludesphere(simptr sim,cmdptr cmd,char *line2);
 enum CMDcode cmdincludeecoli(simptr sim,cmdptr cmd,char *line2);
 enum CMDcode cmdsetreactionratemolcount(simptr sim,cmdptr cmd,char *line2);
 
+/* cmdtrackstruct.  Molecules tracked by the mean square displacement and
+residence time commands; see cmdtrackalloc. */
+typedef struct cmdtrackstruct {
+	int dim;							// dimensionality of positions, 0 for none
+	int n;								// number of tracked molecules
+	int max;							// allocated number of slots
+	long int *serno;			// serial numbers [j]
+	int *state;						// tracking states [j]
+	double *t0;						// times when tracking started [j]
+	double *x0;						// starting positions [d*max+j]
+	double *x1;						// latest positions [d*max+j]
+	double *r2;						// squared displacements [j]
+	int nhash;						// size of hash table, a power of 2
+	int *hash;						// slot+1 for each hash entry, 0 if empty [h]
+	int maxsort;					// allocated size of sort arrays
+	long int *sortkey;		// serial numbers for sorted output [k]
+	void **sortval;				// start times for sorted output [k]
+	} *cmdtrackptr;
+
 // internal functions
 void cmdv1free(cmdptr cmd);
 void cmdv1v2free(cmdptr cmd);
+int cmdmolname(simptr sim,cmdptr cmd,int k,char *line2,enum MolecState *msptr);
+int cmdfindname(cmdptr cmd,int k,char *line2,char **names,int n);
+enum MolecState cmdmolstate(cmdptr cmd,int k,char *line2);
 enum CMDcode conditionalcmdtype(simptr sim,cmdptr cmd,int nparam);
-int insideecoli(double *pos,double *ofst,double rad,double length);
-void putinecoli(double *pos,double *ofst,double rad,double length);
+int insideecoli(molreal *pos,double *ofst,double rad,double length);
+void putinecoli(molreal *pos,double *ofst,double rad,double length);
 int molinpanels(simptr sim,int ll,int m,int s,char pshape);
-void cmdmeansqrdispfree(cmdptr cmd);
+void cmdtrackfree(cmdptr cmd);
+int cmdtrackhash(cmdtrackptr track,long int serno);
+void cmdtrackrehash(cmdtrackptr track);
+int cmdtrackexpand(cmdtrackptr track,int maxslot);
+cmdtrackptr cmdtrackalloc(int dim,int maxslot);
+int cmdtrackfind(cmdtrackptr track,long int serno);
+int cmdtrackadd(simptr sim,cmdtrackptr track,moleculeptr mptr,int state);
+int cmdtrackupdate(simptr sim,cmdtrackptr track,moleculeptr *mlist,int nmol,int i,enum MolecState ms,int add);
+void cmdtracksqrdisp(cmdtrackptr track,int msddim);
+void cmdtrackexpire(cmdtrackptr track);
+void cmdwritetrajfree(cmdptr cmd);
+enum CMDcode cmdtrajframe(simptr sim,cmdptr cmd,FILE *fptr,char *line2,int i,enum MolecState ms,compartptr cmpt,int unwrap);
+int cmdtrajword(char *line2);
+void cmdcensusdue(void *arg,cmdptr cmd);
 
 
 /**********************************************************/
 /********************* command processor ******************/
 /**********************************************************/
 
-enum CMDcode docommand(void *cmdfnarg,cmdptr cmd,char *line) {
-	simptr sim;
-	char word[STRCHAR],*line2;
-	int itct;
-
-	if(!cmdfnarg) return CMDok;
-	sim=(simptr) cmdfnarg;
-	if(!line) return CMDok;
-	itct=sscanf(line,"%s",word);
-	if(itct<=0) return CMDok;
-	line2=strnword(line,2);
+/* cmdtable.  Maps command words to the functions that run them.  census is 1
+for observers that get their results from the molecule census, which register
+their needs with it before the commands of a step run; see cmdcensusplan. */
+struct cmdtablestruct {
+	const char *word;
+	cmdfnptr fn;
+	int census; };
 
+static struct cmdtablestruct cmdtable[]={
 	// simulation control
-	if(!strcmp(word,"stop")) return cmdstop(sim,cmd,line2);
-	else if(!strcmp(word,"pause")) return cmdpause(sim,cmd,line2);
-	else if(!strcmp(word,"beep")) return cmdbeep(sim,cmd,line2);
-	else if(!strcmp(word,"keypress")) return cmdkeypress(sim,cmd,line2);
-	else if(!strcmp(word,"setflag")) return cmdsetflag(sim,cmd,line2);
-	else if(!strcmp(word,"setrandseed")) return cmdsetrandseed(sim,cmd,line2);
-	else if(!strcmp(word,"setgraphics")) return cmdsetgraphics(sim,cmd,line2);
-	else if(!strcmp(word,"setgraphic_iter")) return cmdsetgraphic_iter(sim,cmd,line2);
+	{"stop",cmdstop},
+	{"pause",cmdpause},
+	{"beep",cmdbeep},
+	{"keypress",cmdkeypress},
+	{"setflag",cmdsetflag},
+	{"setrandseed",cmdsetrandseed},
+	{"setgraphics",cmdsetgraphics},
+	{"setgraphic_iter",cmdsetgraphic_iter},
 
 	// file manipulation
-	else if(!strcmp(word,"overwrite")) return cmdoverwrite(sim,cmd,line2);
-	else if(!strcmp(word,"incrementfile")) return cmdincrementfile(sim,cmd,line2);
+	{"overwrite",cmdoverwrite},
+	{"incrementfile",cmdincrementfile},
 
 	// conditional
-	else if(!strcmp(word,"ifflag")) return cmdifflag(sim,cmd,line2);
-	else if(!strcmp(word,"ifprob")) return cmdifprob(sim,cmd,line2);
-	else if(!strcmp(word,"ifno")) return cmdifno(sim,cmd,line2);
-	else if(!strcmp(word,"ifless")) return cmdifless(sim,cmd,line2);
-	else if(!strcmp(word,"ifmore")) return cmdifmore(sim,cmd,line2);
-	else if(!strcmp(word,"ifincmpt")) return cmdifincmpt(sim,cmd,line2);
-	else if(!strcmp(word,"ifchange")) return cmdifchange(sim,cmd,line2);
+	{"ifflag",cmdifflag},
+	{"ifprob",cmdifprob},
+	{"ifno",cmdifno},
+	{"ifless",cmdifless},
+	{"ifmore",cmdifmore},
+	{"ifincmpt",cmdifincmpt},
+	{"ifchange",cmdifchange},
 
 	// system observation
-	else if(!strcmp(word,"echo")) return cmdecho(sim,cmd,line2);
-	else if(!strcmp(word,"warnescapee")) return cmdwarnescapee(sim,cmd,line2);
-	else if(!strcmp(word,"molcountheader")) return cmdmolcountheader(sim,cmd,line2);
-	else if(!strcmp(word,"molcount")) return cmdmolcount(sim,cmd,line2);
-	else if(!strcmp(word,"molcountinbox")) return cmdmolcountinbox(sim,cmd,line2);
-	else if(!strcmp(word,"molcountincmpt")) return cmdmolcountincmpt(sim,cmd,line2);
-	else if(!strcmp(word,"molstatecountincmpt")) return cmdmolstatecountincmpt(sim,cmd,line2);
-	else if(!strcmp(word,"complexconnection")) return cmdcomplexconnection(sim,cmd,line2);				// cplx
-	else if(!strcmp(word,"molcountincmpts")) return cmdmolcountincmpts(sim,cmd,line2);
-	else if(!strcmp(word,"molcountincmpt2")) return cmdmolcountincmpt2(sim,cmd,line2);
-	else if(!strcmp(word,"molcountonsurf")) return cmdmolcountonsurf(sim,cmd,line2);
-	else if(!strcmp(word,"molcountspace")) return cmdmolcountspace(sim,cmd,line2);
-	else if(!strcmp(word,"molcountspecies")) return cmdmolcountspecies(sim,cmd,line2);
-	else if(!strcmp(word,"mollistsize")) return cmdmollistsize(sim,cmd,line2);
-	else if(!strcmp(word,"listmols")) return cmdlistmols(sim,cmd,line2);
-	else if(!strcmp(word,"listmols2")) return cmdlistmols2(sim,cmd,line2);
-	else if(!strcmp(word,"listmols3")) return cmdlistmols3(sim,cmd,line2);
-	else if(!strcmp(word,"listmols4")) return cmdlistmols4(sim,cmd,line2);
-	else if(!strcmp(word,"listmolscmpt")) return cmdlistmolscmpt(sim,cmd,line2);
-	else if(!strcmp(word,"molpos")) return cmdmolpos(sim,cmd,line2);
-	else if(!strcmp(word,"trackmol")) return cmdtrackmol(sim,cmd,line2);
-	else if(!strcmp(word,"molmoments")) return cmdmolmoments(sim,cmd,line2);
-	else if(!strcmp(word,"savesim")) return cmdsavesim(sim,cmd,line2);
-	else if(!strcmp(word,"meansqrdisp")) return cmdmeansqrdisp(sim,cmd,line2);
-	else if(!strcmp(word,"meansqrdisp2")) return cmdmeansqrdisp2(sim,cmd,line2);
-	else if(!strcmp(word,"meansqrdisp3")) return cmdmeansqrdisp3(sim,cmd,line2);
-	else if(!strcmp(word,"residencetime")) return cmdresidencetime(sim,cmd,line2);
-	else if(!strcmp(word,"diagnostics")) return cmddiagnostics(sim,cmd,line2);
-	else if(!strcmp(word,"executiontime")) return cmdexecutiontime(sim,cmd,line2);
-	else if(!strcmp(word,"writeVTK")) return cmdwriteVTK(sim,cmd,line2);
-	else if(!strcmp(word,"printLattice")) return cmdprintLattice(sim,cmd,line2);
+	{"echo",cmdecho},
+	{"warnescapee",cmdwarnescapee},
+	{"molcountheader",cmdmolcountheader},
+	{"molcount",cmdmolcount},
+	{"molcountinbox",cmdmolcountinbox},
+	{"molcountincmpt",cmdmolcountincmpt,1},
+	{"molstatecountincmpt",cmdmolstatecountincmpt},
+	{"complexconnection",cmdcomplexconnection},				// cplx
+	{"molcountincmpts",cmdmolcountincmpts,1},
+	{"molcountincmpt2",cmdmolcountincmpt2,1},
+	{"molcountonsurf",cmdmolcountonsurf},
+	{"molcountspace",cmdmolcountspace,1},
+	{"molcountspacegrid",cmdmolcountspacegrid,1},
+	{"molcountspecies",cmdmolcountspecies},
+	{"mollistsize",cmdmollistsize},
+	{"listmols",cmdlistmols},
+	{"listmols2",cmdlistmols2},
+	{"listmols3",cmdlistmols3},
+	{"listmols4",cmdlistmols4},
+	{"listmolscmpt",cmdlistmolscmpt},
+	{"molpos",cmdmolpos},
+	{"trackmol",cmdtrackmol},
+	{"molmoments",cmdmolmoments,1},
+	{"savesim",cmdsavesim},
+	{"writetraj",cmdwritetraj},
+	{"meansqrdisp",cmdmeansqrdisp},
+	{"meansqrdisp2",cmdmeansqrdisp2},
+	{"meansqrdisp3",cmdmeansqrdisp3},
+	{"residencetime",cmdresidencetime},
+	{"diagnostics",cmddiagnostics},
+	{"executiontime",cmdexecutiontime},
+	{"writeVTK",cmdwriteVTK},
+	{"printLattice",cmdprintLattice},
 
 
 	// system manipulation
-	else if(!strcmp(word,"set")) return cmdset(sim,cmd,line2);
-	else if(!strcmp(word,"pointsource")) return cmdpointsource(sim,cmd,line2);
-	else if(!strcmp(word,"volumesource")) return cmdvolumesource(sim,cmd,line2);
-	else if(!strcmp(word,"movesurfacemol")) return cmdmovesurfacemol(sim,cmd,line2);
-	else if(!strcmp(word,"killmol")) return cmdkillmol(sim,cmd,line2);
-	else if(!strcmp(word,"killmolprob")) return cmdkillmolprob(sim,cmd,line2);
-	else if(!strcmp(word,"killmolinsphere")) return cmdkillmolinsphere(sim,cmd,line2);
-	else if(!strcmp(word,"killmolincmpt")) return cmdkillmolincmpt(sim,cmd,line2);
-	else if(!strcmp(word,"killmoloutsidesystem")) return cmdkillmoloutsidesystem(sim,cmd,line2);
-	else if(!strcmp(word,"fixmolcount")) return cmdfixmolcount(sim,cmd,line2);
-	else if(!strcmp(word,"fixmolcountonsurf")) return cmdfixmolcountonsurf(sim,cmd,line2);
-	else if(!strcmp(word,"fixmolcountincmpt")) return cmdfixmolcountincmpt(sim,cmd,line2);
-	else if(!strcmp(word,"equilmol")) return cmdequilmol(sim,cmd,line2);
-	else if(!strcmp(word,"replacexyzmol")) return cmdreplacexyzmol(sim,cmd,line2);
-	else if(!strcmp(word,"replacevolmol")) return cmdreplacevolmol(sim,cmd,line2);
-	else if(!strcmp(word,"replacecmptmol")) return cmdreplacecmptmol(sim,cmd,line2);
-	else if(!strcmp(word,"modulatemol")) return cmdmodulatemol(sim,cmd,line2);
-	else if(!strcmp(word,"react1")) return cmdreact1(sim,cmd,line2);
-	else if(!strcmp(word,"setrateint")) return cmdsetrateint(sim,cmd,line2);
-	else if(!strcmp(word,"shufflemollist")) return cmdshufflemollist(sim,cmd,line2);
-//	else if(!strcmp(word,"shufflereactions")) return cmdshufflereactions(sim,cmd,line2);
-//	else if(!strcmp(word,"setsurfcoeff")) return cmdsetsurfcoeff(sim,cmd,line2);
-	else if(!strcmp(word,"settimestep")) return cmdsettimestep(sim,cmd,line2);
-	else if(!strcmp(word,"porttransport")) return cmdporttransport(sim,cmd,line2);
-	else if(!strcmp(word,"excludebox")) return cmdexcludebox(sim,cmd,line2);
-	else if(!strcmp(word,"excludesphere")) return cmdexcludesphere(sim,cmd,line2);
-	else if(!strcmp(word,"includeecoli")) return cmdincludeecoli(sim,cmd,line2);
-	else if(!strcmp(word,"setreactionratemolcount")) return cmdsetreactionratemolcount(sim,cmd,line2);
+	{"set",cmdset},
+	{"pointsource",cmdpointsource},
+	{"volumesource",cmdvolumesource},
+	{"movesurfacemol",cmdmovesurfacemol},
+	{"killmol",cmdkillmol},
+	{"killmolprob",cmdkillmolprob},
+	{"killmolinsphere",cmdkillmolinsphere},
+	{"killmolincmpt",cmdkillmolincmpt},
+	{"killmoloutsidesystem",cmdkillmoloutsidesystem},
+	{"fixmolcount",cmdfixmolcount},
+	{"fixmolcountonsurf",cmdfixmolcountonsurf},
+	{"fixmolcountincmpt",cmdfixmolcountincmpt},
+	{"equilmol",cmdequilmol},
+	{"replacexyzmol",cmdreplacexyzmol},
+	{"replacevolmol",cmdreplacevolmol},
+	{"replacecmptmol",cmdreplacecmptmol},
+	{"modulatemol",cmdmodulatemol},
+	{"react1",cmdreact1},
+	{"setrateint",cmdsetrateint},
+	{"shufflemollist",cmdshufflemollist},
+//	{"shufflereactions",cmdshufflereactions},
+//	{"setsurfcoeff",cmdsetsurfcoeff},
+	{"settimestep",cmdsettimestep},
+	{"porttransport",cmdporttransport},
+	{"excludebox",cmdexcludebox},
+	{"excludesphere",cmdexcludesphere},
+	{"includeecoli",cmdincludeecoli},
+	{"setreactionratemolcount",cmdsetreactionratemolcount},
 
 #ifdef VCELL
 	// vcell commands
-	else if(!strcmp(word,"vcellPrintProgress")) return cmdVCellPrintProgress(sim,cmd,line2);
-	else if(!strcmp(word,"vcellWriteOutput")) return cmdVCellWriteOutput(sim,cmd,line2);
-	else if(!strcmp(word,"vcellDataProcess")) return cmdVCellDataProcess(sim,cmd,line2);
+	{"vcellPrintProgress",cmdVCellPrintProgress},
+	{"vcellWriteOutput",cmdVCellWriteOutput},
+	{"vcellDataProcess",cmdVCellDataProcess},
 #endif
+	{NULL,NULL}};
 
-	SCMDCHECK(0,"command not recognized");
-	return CMDwarn; }
+
+/* cmdlookup.  Returns the function that runs command word, or NULL if the
+word is not a command. */
+cmdfnptr cmdlookup(const char *word) {
+	int k;
+
+	for(k=0;cmdtable[k].word;k++)
+		if(!strcmp(word,cmdtable[k].word)) return cmdtable[k].fn;
+	return NULL; }
+
+
+/* cmdcensusdue.  Callback for scmddue that lets command cmd register the
+compartments and census items it needs, if it is a census observer that has run
+before.  The handler does this instead of its usual work while censusplan is set.
+Commands that have not run yet register themselves when they first run. */
+void cmdcensusdue(void *arg,cmdptr cmd) {
+	simptr sim;
+	int k;
+
+	sim=(simptr) arg;
+	if(!cmd->handler) return;
+	for(k=0;cmdtable[k].word && cmdtable[k].fn!=cmd->handler;k++);
+	if(cmdtable[k].word && cmdtable[k].census)
+		(*cmd->handler)(sim,cmd,cmd->argstr);
+	return; }
+
+
+/* cmdcensusplan.  Plans the molecule census for the commands that the next call
+to scmdexecute will run, with the same donow value, so that the census sweep only
+counts what these commands need.  Census items that are not needed on this step
+are left out of the sweep but kept for later. */
+void cmdcensusplan(simptr sim,int donow) {
+	if(!sim->mols) return;
+	molcensusreset(sim->mols);
+	if(!sim->cmds) return;
+	sim->mols->censusplan=1;
+	scmddue((cmdssptr) sim->cmds,sim->time,donow,&cmdcensusdue,(void*)sim);
+	sim->mols->censusplan=0;
+	return; }
+
+
+/* docommand.  Runs the command in line.  When line is the command's own
+string, the handler, its command type, and the argument pointer are saved in
+cmd on the first run, so later runs go straight to the handler without reading
+the command word again.  Handlers may also keep resolved arguments in cmd, which
+is only allowed when they run on the command's own string.  Any command that is
+not known to be an observer invalidates the molecule census. */
+enum CMDcode docommand(void *cmdfnarg,cmdptr cmd,char *line) {
+	simptr sim;
+	char word[STRCHAR],*line2;
+	int itct,argset;
+	cmdfnptr fn;
+	enum CMDcode code;
+
+	if(!cmdfnarg) return CMDok;
+	sim=(simptr) cmdfnarg;
+	if(!line) return CMDok;
+	if(cmd && cmd->handler && line==cmd->str) {
+		if(cmd->htype!=CMDobserve && sim->mols) sim->mols->censusok=0;
+		return (*cmd->handler)(sim,cmd,cmd->argstr); }
+	itct=sscanf(line,"%s",word);
+	if(itct<=0) return CMDok;
+	line2=strnword(line,2);
+
+	fn=cmdlookup(word);
+	SCMDCHECK(fn,"command not recognized");
+	if(line2 && !strcmp(line2,"cmdtype")) return (*fn)(sim,cmd,line2);
+	if(cmd && line==cmd->str) {
+		cmd->handler=fn;
+		cmd->htype=(*fn)(sim,cmd,(char*)"cmdtype");
+		cmd->argstr=line2;
+		if(sim->mols && cmd->htype!=CMDobserve) sim->mols->censusok=0;
+		return (*fn)(sim,cmd,line2); }
+	if(sim->mols) sim->mols->censusok=0;
+	if(!cmd) return (*fn)(sim,cmd,line2);
+	argset=cmd->argset;											// nested command, so don't keep arguments
+	cmd->argset=-1;
+	code=(*fn)(sim,cmd,line2);
+	cmd->argset=argset;
+	return code; }
 
 
 /**********************************************************/
@@ -454,6 +572,7 @@ enum CMDcode cmdifmore(simptr sim,cmdptr cmd,char *line2) {
 
 enum CMDcode cmdifincmpt(simptr sim,cmdptr cmd,char *line2) {
 	int itct,i,count,min,c,ll,m;
+	double pbuf[DIMMAX];
 	enum MolecState ms;
 	char cname[STRCHAR];
 	compartssptr cmptss;
@@ -484,7 +603,7 @@ enum CMDcode cmdifincmpt(simptr sim,cmdptr cmd,char *line2) {
 		ll=sim->mols->listlookup[i][ms];
 		for(m=0;m<sim->mols->nl[ll];m++) {
 			mptr=sim->mols->live[ll][m];
-			if(mptr->ident==i && mptr->mstate==ms && posincompart(sim,mptr->pos,cmpt))
+			if(mptr->ident==i && mptr->mstate==ms && posincompart(sim,molreal2dbl(mptr->pos,pbuf,sim->dim),cmpt))
 				count++; }}
 	else {
 		for(ll=0;ll<sim->mols->nlist;ll++)
@@ -493,7 +612,7 @@ enum CMDcode cmdifincmpt(simptr sim,cmdptr cmd,char *line2) {
 					mptr=sim->mols->live[ll][m];
 					if(i==-5 || mptr->ident==i)
 						if(ms==MSall || mptr->mstate==ms)
-							if(posincompart(sim,mptr->pos,cmpt))
+							if(posincompart(sim,molreal2dbl(mptr->pos,pbuf,sim->dim),cmpt))
 								count++; }}
 
 	if((ch=='<' && count<min) || (ch=='=' && count==min) || (ch=='>' && count>min))
@@ -543,15 +662,16 @@ enum CMDcode cmdwarnescapee(simptr sim,cmdptr cmd,char *line2) {
 	enum MolecState ms;
 	FILE *fptr;
 	moleculeptr *mlist,mptr;
-	double *pos,*posx,*via;
+	double *via,pbuf[DIMMAX];
+	molreal *pos,*posx;
 	wallptr *wlist;
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	i=readmolname(sim,line2,&ms,0);
+	i=cmdmolname(sim,cmd,1,line2,&ms);
 	SCMDCHECK(!(i<0 && i>-5),"cannot read molecule and/or state name");
 	SCMDCHECK(i!=-6,"wildcard characters not permitted in species name");
 	line2=strnword(line2,2);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 
 	dim=sim->dim;
@@ -563,16 +683,16 @@ enum CMDcode cmdwarnescapee(simptr sim,cmdptr cmd,char *line2) {
 			mptr=mlist[m];
 			if((mptr->ident>0 && i<0 && (ms==MSall || mptr->mstate==ms)) || (mptr->ident==i && (ms==MSall || mptr->mstate==ms))) {
 				pos=mptr->pos;
-				escape=!posinsystem(sim,pos);
+				escape=!posinsystem(sim,molreal2dbl(pos,pbuf,dim));
 				if(escape) {
 					posx=mptr->posx;
-					escape=!posinsystem(sim,posx);
+					escape=!posinsystem(sim,molreal2dbl(posx,pbuf,dim));
 					if(!escape) {
 						via=mptr->via;
 						if(dim==1) scmdfprintf(cmd->cmds,fptr,"New escapee: %g #%li %g to %g via %g\n",sim->time,mptr->serno,posx[0],pos[0],via[0]);
 						else if(dim==2) scmdfprintf(cmd->cmds,fptr,"New escapee: %g #%li (%g,%g) to (%g,%g) via (%g,%g)\n",sim->time,mptr->serno,posx[0],posx[1],pos[0],pos[1],via[0],via[1]);
 						else scmdfprintf(cmd->cmds,fptr,"New escapee: %g #%li (%g,%g,%g) to (%g,%g,%g) via (%g,%g,%g)\n",sim->time,mptr->serno,posx[0],posx[1],posx[2],pos[0],pos[1],pos[2],via[0],via[1],via[2]); }}}}}
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
@@ -581,7 +701,7 @@ enum CMDcode cmdecho(simptr sim,cmdptr cmd,char *line2) {
 	char *termqt,str[STRCHAR];
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 	line2=strnword(line2,2);
 	SCMDCHECK(line2=strchr(line2,'"'),"no starting quote on string");
@@ -591,7 +711,7 @@ enum CMDcode cmdecho(simptr sim,cmdptr cmd,char *line2) {
 	*termqt='\0';
 	strbslash2escseq(str);
 	scmdfprintf(cmd->cmds,fptr,"%s",str);
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
@@ -600,24 +720,24 @@ enum CMDcode cmdmolcountheader(simptr sim,cmdptr cmd,char *line2) {
 	int i;
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 	SCMDCHECK(sim->mols,"molecules are undefined");
 	scmdfprintf(cmd->cmds,fptr,"time");
 	for(i=1;i<sim->mols->nspecies;i++) scmdfprintf(cmd->cmds,fptr," %s",sim->mols->spname[i]);
 	scmdfprintf(cmd->cmds,fptr,"\n");
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
 enum CMDcode cmdmolcount(simptr sim,cmdptr cmd,char *line2) {
 	FILE *fptr;
-	int ll,m,*ct,i,nspecies,*ctlat,ilat;
+	int *ct,i,nspecies,*ctlat,ilat,*cen,k;
 	latticeptr lat;
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
 	SCMDCHECK(cmd->i1!=-1,"error on setup");					// failed before, don't try again
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 	SCMDCHECK(sim->mols,"molecules are undefined");
 
@@ -629,12 +749,11 @@ enum CMDcode cmdmolcount(simptr sim,cmdptr cmd,char *line2) {
 		cmd->v1=calloc(nspecies,sizeof(int));
 		if(!cmd->v1) {cmd->i1=-1;return CMDwarn;} }
 
+	cen=sim->mols->spcount;
 	ct=(int*)cmd->v1;
 	for(i=0;i<nspecies;i++) ct[i]=0;
-	for(ll=0;ll<sim->mols->nlist;ll++)
-		for(m=0;m<sim->mols->nl[ll];m++) {
-			i=sim->mols->live[ll][m]->ident;
-			if(i>0) ct[i]++; }
+	for(i=1;i<nspecies;i++)
+		for(k=0;k<MSMAX;k++) ct[i]+=cen[i*MSMAX+k];
 
 	if(sim->latticess) {
     if(cmd->i2!=nspecies) {
@@ -658,15 +777,15 @@ enum CMDcode cmdmolcount(simptr sim,cmdptr cmd,char *line2) {
 	scmdfprintf(cmd->cmds,fptr,"%g",sim->time);
 	for(i=1;i<nspecies;i++) scmdfprintf(cmd->cmds,fptr," %i",ct[i]);
 	scmdfprintf(cmd->cmds,fptr,"\n");
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
 enum CMDcode cmdmolcountinbox(simptr sim,cmdptr cmd,char *line2) {
 	FILE *fptr;
-	int ll,m,*ct,d,dim,itct,i,nspecies;
+	int ll,m,*ct,d,dim,itct,i,nspecies,nthreads,t,nmol,*work,*count;
 	double low[3],high[3];
-	moleculeptr mptr;
+	moleculeptr mptr,*mlist;
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
 	SCMDCHECK(cmd->i1!=-1,"error on setup");					// failed before, don't try again
@@ -677,7 +796,7 @@ enum CMDcode cmdmolcountinbox(simptr sim,cmdptr cmd,char *line2) {
 		itct=sscanf(line2,"%lg %lg",&low[d],&high[d]);
 		SCMDCHECK(itct==2,"read failure");
 		line2=strnword(line2,3); }
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 
 	nspecies=sim->mols->nspecies;
@@ -690,25 +809,33 @@ enum CMDcode cmdmolcountinbox(simptr sim,cmdptr cmd,char *line2) {
 	
 	ct=(int*)cmd->v1;
 	for(i=0;i<nspecies;i++) ct[i]=0;
-	for(ll=0;ll<sim->mols->nlist;ll++)
-		for(m=0;m<sim->mols->nl[ll];m++) {
-			mptr=sim->mols->live[ll][m];
-			for(d=0;d<dim;d++)
-				if(mptr->pos[d]<low[d] || mptr->pos[d]>high[d]) d=dim+1;
-			if(d==dim && mptr->ident>0) ct[mptr->ident]++; }
+	nthreads=molreducethreads(sim);
+	work=(nthreads>1)?molreduceint(sim,nspecies):NULL;
+	SCMDCHECK(nthreads==1 || work,"out of memory");
+	for(ll=0;ll<sim->mols->nlist;ll++) {
+		mlist=sim->mols->live[ll];
+		nmol=sim->mols->nl[ll];
+#ifdef HAVE_OPENMP
+		#pragma omp parallel for schedule(static) private(m,mptr,d,count) num_threads(nthreads) if(nthreads>1)
+#endif
+		for(t=0;t<nthreads;t++) {
+			count=work?work+t*nspecies:ct;
+			for(m=(int)((long long)t*nmol/nthreads);m<(int)((long long)(t+1)*nmol/nthreads);m++) {
+				mptr=mlist[m];
+				for(d=0;d<dim;d++)
+					if(mptr->pos[d]<low[d] || mptr->pos[d]>high[d]) d=dim+1;
+				if(d==dim && mptr->ident>0) count[mptr->ident]++; }}}
+	if(work) molreducemerge(sim,nspecies,ct);
 	scmdfprintf(cmd->cmds,fptr,"%g",sim->time);
 	for(i=1;i<nspecies;i++) scmdfprintf(cmd->cmds,fptr," %i",ct[i]);
 	scmdfprintf(cmd->cmds,fptr,"\n");
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 enum CMDcode cmdmolcountincmpt(simptr sim,cmdptr cmd,char *line2) {
 	FILE *fptr;
-	char nm[STRCHAR];
-	compartptr cmpt;
 	compartssptr cmptss;
-	int ll,m,*ct,itct,c,i,nspecies;
-	moleculeptr mptr;
+	int *ct,c,i,nspecies,*cen;
 	
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
 	SCMDCHECK(cmd->i1!=-1,"error on setup");									// failed before, don't try again
@@ -716,13 +843,11 @@ enum CMDcode cmdmolcountincmpt(simptr sim,cmdptr cmd,char *line2) {
 	SCMDCHECK(cmptss,"no compartments defined");
 	SCMDCHECK(sim->mols,"molecules are undefined");
 	SCMDCHECK(line2,"missing argument");
-	itct=sscanf(line2,"%s",nm);
-	SCMDCHECK(itct==1,"cannot read argument");
-	c=stringfind(cmptss->cnames,cmptss->ncmpt,nm);
+	c=cmdfindname(cmd,2,line2,cmptss->cnames,cmptss->ncmpt);
+	SCMDCHECK(c!=-1,"cannot read argument");
 	SCMDCHECK(c>=0,"compartment name not recognized");
-	cmpt=cmptss->cmptlist[c];
 	line2=strnword(line2,2);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 	
 	nspecies=sim->mols->nspecies;
@@ -733,27 +858,24 @@ enum CMDcode cmdmolcountincmpt(simptr sim,cmdptr cmd,char *line2) {
 		cmd->v1=calloc(nspecies,sizeof(int));
 		if(!cmd->v1) {cmd->i1=-1;return CMDwarn;} }
 	
+	if(sim->mols->censusplan) return molcensuscmpt(sim,c)?CMDwarn:CMDok;
+	cen=molcensus(sim,c);
+	SCMDCHECK(cen,"out of memory");
 	ct=(int*)cmd->v1;
-	for(i=0;i<nspecies;i++) ct[i]=0;
-	for(ll=0;ll<sim->mols->nlist;ll++)
-		for(m=0;m<sim->mols->nl[ll];m++) {
-			mptr=sim->mols->live[ll][m];
-			if(mptr->ident>0 && posincompart(sim,mptr->pos,cmpt) && mptr->mstate==MSsoln) 
-				ct[mptr->ident]++; 
-			}
+	for(i=0;i<nspecies;i++) ct[i]=cen[i*MSMAX+MSsoln];
 	scmdfprintf(cmd->cmds,fptr,"%g",sim->time);
 	for(i=1;i<nspecies;i++) scmdfprintf(cmd->cmds,fptr," %i",ct[i]);
 	scmdfprintf(cmd->cmds,fptr,"\n");
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 enum CMDcode cmdmolstatecountincmpt(simptr sim,cmdptr cmd,char *line2) {
 	FILE *fptr;
-	char nm[STRCHAR],name[STRCHAR];
+	double pbuf[DIMMAX];
 	compartptr cmpt;
 	compartssptr cmptss;
-	int ll,m,*ct,itct,c,i,nspecies,nstates,nsites,s;
-	moleculeptr mptr;
+	int ll,m,*ct,c,i,nspecies,nstates,nsites,s,nthreads,t,nmol,*work,*count;
+	moleculeptr mptr,*mlist;
 	
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
 	SCMDCHECK(cmd->i1!=-1,"error on setup");									// failed before, don't try again
@@ -761,17 +883,17 @@ enum CMDcode cmdmolstatecountincmpt(simptr sim,cmdptr cmd,char *line2) {
 	SCMDCHECK(cmptss,"no compartments defined");
 	SCMDCHECK(sim->mols,"molecules are undefined");
 	SCMDCHECK(line2,"missing argument");
-	itct=sscanf(line2,"%s",nm);
-	SCMDCHECK(itct==1,"cannot read argument");
-	c=stringfind(cmptss->cnames,cmptss->ncmpt,nm);
+	c=cmdfindname(cmd,2,line2,cmptss->cnames,cmptss->ncmpt);
+	SCMDCHECK(c!=-1,"cannot read argument");
 	SCMDCHECK(c>=0,"compartment name not recognized");
 	cmpt=cmptss->cmptlist[c];
 	line2=strnword(line2,2);
-	itct=sscanf(line2, "%s", name);
-	s=stringfind(sim->mols->spname,sim->mols->nspecies,strtrim(name));
-	ll=stringfind(sim->mols->listname,sim->mols->nlist,strtrim(name));
+	SCMDCHECK(line2,"missing argument");
+	s=cmdfindname(cmd,1,line2,sim->mols->spname,sim->mols->nspecies);
+	SCMDCHECK(s!=-1,"cannot read species name");
+	SCMDCHECK(s>=0,"species name not recognized");
 	line2=strnword(line2,2);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 	
 	nspecies=sim->mols->nspecies;
@@ -790,64 +912,97 @@ enum CMDcode cmdmolstatecountincmpt(simptr sim,cmdptr cmd,char *line2) {
 	
 	ct=(int*)cmd->v1;
 	for(i=0;i<nstates;i++) ct[i]=0;
+	nthreads=molreducethreads(sim);
+	work=(nthreads>1)?molreduceint(sim,nstates):NULL;
+	SCMDCHECK(nthreads==1 || work,"out of memory");
 	
 	for(ll=0;ll<sim->mols->nlist;ll++){
-		for(m=0;m<sim->mols->nl[ll];m++) {
-			mptr=sim->mols->live[ll][m];
-			if(mptr->ident==s && mptr->sites_val>=0 && posincompart(sim,mptr->pos,cmpt)){ 
-				ct[mptr->sites_val]++;
-				//printf("nstates=%d, mptr->sitse_val=%d\n",nstates,mptr->sites_val);
+		mlist=sim->mols->live[ll];
+		nmol=sim->mols->nl[ll];
+#ifdef HAVE_OPENMP
+		#pragma omp parallel for schedule(static) private(m,mptr,count,pbuf) num_threads(nthreads) if(nthreads>1)
+#endif
+		for(t=0;t<nthreads;t++) {
+			count=work?work+t*nstates:ct;
+			for(m=(int)((long long)t*nmol/nthreads);m<(int)((long long)(t+1)*nmol/nthreads);m++) {
+				mptr=mlist[m];
+				if(mptr->ident==s && mptr->sites_val>=0 && posincompart(sim,molreal2dbl(mptr->pos,pbuf,sim->dim),cmpt)){ 
+					count[mptr->sites_val]++;
+					//printf("nstates=%d, mptr->sitse_val=%d\n",nstates,mptr->sites_val);
+				}
 			}
 		}
 	}
+	if(work) molreducemerge(sim,nstates,ct);
 	scmdfprintf(cmd->cmds,fptr,"%g",sim->time);
 
 	for(i=0;i<nstates;i++) scmdfprintf(cmd->cmds,fptr," %i",ct[i]);
 	scmdfprintf(cmd->cmds,fptr,"\n");
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
-/* output the binding array of each complex in the mols->complexlist 
-	cmd e cmdcomplexconnection filename 				*/
+/* cmdcomplexconnection.  Finds the clusters of molecules that are connected by
+being in one complex or by bound sites, using molclusters.  Writes one line per
+cluster size, with the time, the size in molecules, the number of clusters of
+that size, and the number of molecules of each species in them.  If a second file
+is given, a binary record of the clusters of two or more molecules is appended to
+it: the time as a double, the number of clusters as an int, and then for each
+cluster its size as an int and the serial numbers of its molecules as long longs.
+	cmd e complexconnection filename [member_filename]				*/
 enum CMDcode cmdcomplexconnection(simptr sim,cmdptr cmd,char *line2){
-	FILE *fptr;
-	char nm[STRCHAR];
-	// int k, i;
-	// complexptr complex_tmp;
-	// int tot_sunit;
-	// dict1key complex_connect=sim->mols->complex_connect;
-	// struct elt1k *e_tmp;
+	FILE *fptr,*mfptr;
+	int r,i,k,node,nspecies,ncluster,size;
+	clusterptr clus;
+	long long serno;
 
+	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
+	SCMDCHECK(sim->mols,"molecules are undefined");
 	SCMDCHECK(line2,"missing filename");
-	sscanf(line2,"%s",nm);
-	fptr=scmdgetfptr((cmdssptr)sim->cmds,line2);	
-	SCMDCHECK(fptr,"file name not recognized");
-	
-	/*
-	for(k=0;k<sim->mols->ncomplex;k++){
-		complex_tmp=sim->mols->complexlist[k];
-		if(DictSearch1key(complex_connect, complex_tmp->serno)){
-			e_tmp=complex_connect->table[hash1key(complex_tmp->serno)%complex_connect->size];
-			for(;e_tmp=!0;e_tmp=e_tmp->next){
-				scmdfprintf(cmd->cmds,fptr,"%g, %i, %i\n", sim->time, complex_tmp->serno, e_tmp->value);	
-			}
-		}
+	mfptr=NULL;
+	if(wordcount(line2)==2) {
+		fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
+		SCMDCHECK(fptr,"file name not recognized");
+		line2=strnword(line2,2);
+		mfptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,3,line2);
+		SCMDCHECK(mfptr,"member file name not recognized");
+		SCMDCHECK(mfptr!=stdout && mfptr!=stderr,"member file cannot be stdout or stderr"); }
+	else {
+		fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
+		SCMDCHECK(fptr,"file name not recognized"); }
+
+	clus=molclusters(sim,mfptr?1:0);
+	SCMDCHECK(clus,"out of memory in complexconnection");
+	nspecies=sim->mols->nspecies;
+	for(r=0;r<clus->nrow;r++) {
+		scmdfprintf(cmd->cmds,fptr,"%g %i %i",sim->time,clus->bysize[r*(nspecies+2)],clus->bysize[r*(nspecies+2)+1]);
+		for(i=1;i<nspecies;i++) scmdfprintf(cmd->cmds,fptr," %i",clus->bysize[r*(nspecies+2)+2+i]);
+		scmdfprintf(cmd->cmds,fptr,"\n"); }
+	scmdflush((cmdssptr) sim->cmds,fptr);
+
+	if(mfptr) {
+		scmdwait((cmdssptr) sim->cmds);							// records are written directly
+		ncluster=0;
+		for(node=0;node<clus->nnode;node++)
+			if(clus->parent[node]==node && clus->size[node]>1) ncluster++;
+		fwrite(&sim->time,sizeof(double),1,mfptr);
+		fwrite(&ncluster,sizeof(int),1,mfptr);
+		for(node=0,k=0;node<clus->nnode;node++)
+			if(clus->parent[node]==node && clus->size[node]>1) {
+				size=clus->size[node];
+				fwrite(&size,sizeof(int),1,mfptr);
+				for(i=0;i<size;i++) {
+					serno=clus->member[k++]->serno;
+					fwrite(&serno,sizeof(long long),1,mfptr); }}
+		fflush(mfptr); }
+	return CMDok; }
 
-	}
-	*/
-	// scmdfprintf(cmd->cmds, fptr, "\n");
-	scmdflush(fptr);
-	return CMDok;	
-}
 
 enum CMDcode cmdmolcountincmpts(simptr sim,cmdptr cmd,char *line2) {
 	FILE *fptr;
-	char nm[STRCHAR];
-	compartptr cmptlist[16];
+	int cmptlist[16];
 	compartssptr cmptss;
-	int ll,m,*ct,itct,c,i,ic,ncmpt,nspecies;
-	moleculeptr mptr;
+	int *ct,c,i,ic,ncmpt,nspecies,*cen;
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
 	SCMDCHECK(cmd->i1!=-1,"error on setup");					// failed before, don't try again
@@ -858,14 +1013,13 @@ enum CMDcode cmdmolcountincmpts(simptr sim,cmdptr cmd,char *line2) {
 	ncmpt=wordcount(line2)-1;
 	SCMDCHECK(ncmpt>=1,"no compartment or no output file listed");
 	for(ic=0;ic<ncmpt;ic++) {
-		itct=sscanf(line2,"%s",nm);
-		SCMDCHECK(itct==1,"cannot read compartment name");
-		c=stringfind(cmptss->cnames,cmptss->ncmpt,nm);
+		c=cmdfindname(cmd,ic+1,line2,cmptss->cnames,cmptss->ncmpt);
+		SCMDCHECK(c!=-1,"cannot read compartment name");
 		SCMDCHECK(c>=0,"compartment name not recognized");
-		cmptlist[ic]=cmptss->cmptlist[c];
+		cmptlist[ic]=c;
 		line2=strnword(line2,2);
 		SCMDCHECK(line2,"missing argument"); }
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 
 	nspecies=sim->mols->nspecies;
@@ -877,29 +1031,26 @@ enum CMDcode cmdmolcountincmpts(simptr sim,cmdptr cmd,char *line2) {
 		if(!cmd->v1) {cmd->i1=-1;return CMDwarn;} }
 
 	ct=(int*)cmd->v1;
-	for(i=0;i<nspecies*ncmpt;i++) ct[i]=0;
-	for(ll=0;ll<sim->mols->nlist;ll++)
-		for(m=0;m<sim->mols->nl[ll];m++) {
-			mptr=sim->mols->live[ll][m];
-			if(mptr->ident>0 && mptr->mstate==MSsoln)
-				for(ic=0;ic<ncmpt;ic++)
-					if(posincompart(sim,mptr->pos,cmptlist[ic])) ct[ic*nspecies+mptr->ident]++; }
+	for(ic=0;ic<ncmpt;ic++)
+		SCMDCHECK(!molcensuscmpt(sim,cmptlist[ic]),"out of memory");
+	if(sim->mols->censusplan) return CMDok;
+	for(ic=0;ic<ncmpt;ic++) {
+		cen=molcensus(sim,cmptlist[ic]);
+		SCMDCHECK(cen,"out of memory");
+		for(i=0;i<nspecies;i++) ct[ic*nspecies+i]=cen[i*MSMAX+MSsoln]; }
 
 	scmdfprintf(cmd->cmds,fptr,"%g",sim->time);
 	for(i=1;i<nspecies*ncmpt;i++) 
 		if(i%nspecies!=0) scmdfprintf(cmd->cmds,fptr," %i",ct[i]);
 	scmdfprintf(cmd->cmds,fptr,"\n");
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
 enum CMDcode cmdmolcountincmpt2(simptr sim,cmdptr cmd,char *line2) {
 	FILE *fptr;
-	char nm[STRCHAR],state[STRCHAR];
-	compartptr cmpt;
 	compartssptr cmptss;
-	int ll,m,*ct,itct,c,i,nspecies;
-	moleculeptr mptr;
+	int *ct,c,i,nspecies,*cen,k;
 	enum MolecState ms;
 	
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
@@ -908,16 +1059,16 @@ enum CMDcode cmdmolcountincmpt2(simptr sim,cmdptr cmd,char *line2) {
 	SCMDCHECK(cmptss,"no compartments defined");
 	SCMDCHECK(sim->mols,"molecules are undefined");
 	SCMDCHECK(line2,"missing argument");
-	itct=sscanf(line2,"%s %s",nm,state);
-	SCMDCHECK(itct==2,"cannot read arguments");
-	c=stringfind(cmptss->cnames,cmptss->ncmpt,nm);
+	c=cmdfindname(cmd,2,line2,cmptss->cnames,cmptss->ncmpt);
+	SCMDCHECK(c!=-1,"cannot read arguments");
 	SCMDCHECK(c>=0,"compartment name not recognized");
-	ms=molstring2ms(state);
+	line2=strnword(line2,2);
+	SCMDCHECK(line2,"cannot read arguments");
+	ms=cmdmolstate(cmd,3,line2);
 	SCMDCHECK(ms!=MSnone,"molecule state not recognized");
 	SCMDCHECK(ms!=MSbsoln,"bsoln molecule state not permitted");
-	cmpt=cmptss->cmptlist[c];
-	line2=strnword(line2,3);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	line2=strnword(line2,2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 
 	nspecies=sim->mols->nspecies;
@@ -928,17 +1079,17 @@ enum CMDcode cmdmolcountincmpt2(simptr sim,cmdptr cmd,char *line2) {
 		cmd->v1=calloc(nspecies,sizeof(int));
 		if(!cmd->v1) {cmd->i1=-1;return CMDwarn;} }
 
+	if(sim->mols->censusplan) return molcensuscmpt(sim,c)?CMDwarn:CMDok;
+	cen=molcensus(sim,c);
+	SCMDCHECK(cen,"out of memory");
 	ct=(int*)cmd->v1;
-	for(i=0;i<nspecies;i++) ct[i]=0;
-	for(ll=0;ll<sim->mols->nlist;ll++)
-		for(m=0;m<sim->mols->nl[ll];m++) {
-			mptr=sim->mols->live[ll][m];
-			if(mptr->ident>0 && posincompart(sim,mptr->pos,cmpt))
-				if(ms==MSall || mptr->mstate==ms) ct[mptr->ident]++; }
+	for(i=0;i<nspecies;i++) {
+		if(ms!=MSall) ct[i]=cen[i*MSMAX+ms];
+		else for(ct[i]=0,k=0;k<MSMAX;k++) ct[i]+=cen[i*MSMAX+k]; }
 	scmdfprintf(cmd->cmds,fptr,"%g",sim->time);
 	for(i=1;i<nspecies;i++) scmdfprintf(cmd->cmds,fptr," %i",ct[i]);
 	scmdfprintf(cmd->cmds,fptr,"\n");
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
@@ -947,7 +1098,7 @@ enum CMDcode cmdmolcountonsurf(simptr sim,cmdptr cmd,char *line2) {
 	char nm[STRCHAR];
 	surfaceptr srf;
 	surfacessptr srfss;
-	int ll,m,*ct,itct,s,i,nspecies;
+	int ll,m,*ct,s,i,nspecies;
 	moleculeptr mptr;
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
@@ -956,13 +1107,12 @@ enum CMDcode cmdmolcountonsurf(simptr sim,cmdptr cmd,char *line2) {
 	SCMDCHECK(srfss,"no surfaces defined");
 	SCMDCHECK(sim->mols,"molecules are undefined");
 	SCMDCHECK(line2,"missing argument");
-	itct=sscanf(line2,"%s",nm);
-	SCMDCHECK(itct==1,"cannot read argument");
-	s=stringfind(srfss->snames,srfss->nsrf,nm);
-	SCMDCHECK(s>=0,"surface name '%s' not recognized",nm);
+	s=cmdfindname(cmd,2,line2,srfss->snames,srfss->nsrf);
+	SCMDCHECK(s!=-1,"cannot read argument");
+	SCMDCHECK(s>=0 || sscanf(line2,"%s",nm)!=1,"surface name '%s' not recognized",nm);
 	srf=srfss->srflist[s];
 	line2=strnword(line2,2);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 
 	nspecies=sim->mols->nspecies;
@@ -982,16 +1132,15 @@ enum CMDcode cmdmolcountonsurf(simptr sim,cmdptr cmd,char *line2) {
 	scmdfprintf(cmd->cmds,fptr,"%g",sim->time);
 	for(i=1;i<nspecies;i++) scmdfprintf(cmd->cmds,fptr," %i",ct[i]);
 	scmdfprintf(cmd->cmds,fptr,"\n");
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
 enum CMDcode cmdmolcountspace(simptr sim,cmdptr cmd,char *line2) {
 	FILE *fptr;
-	int dim,i,itct,axis,nbin,ax2,d,*ct,bin,ll,lllo,llhi,nmol,m,average,*ctlat,ilat;
+	int dim,i,itct,axis,nbin,ax2,d,*ct,bin,average,*ctlat,ilat,nbins[DIMMAX];
 	enum MolecState ms;
-	double low[DIMMAX],high[DIMMAX],scale;
-	moleculeptr *mlist,mptr;
+	double low[DIMMAX],high[DIMMAX];
 	latticeptr lat;
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
@@ -999,7 +1148,7 @@ enum CMDcode cmdmolcountspace(simptr sim,cmdptr cmd,char *line2) {
 
 	dim=sim->dim;
 	SCMDCHECK(line2,"missing arguments");
-	i=readmolname(sim,line2,&ms,0);
+	i=cmdmolname(sim,cmd,1,line2,&ms);
 	SCMDCHECK(!(i<0 && i>-5),"cannot read molecule and/or state name");
 	SCMDCHECK(i!=-6,"wildcard characters not permitted in species name");
 	line2=strnword(line2,2);
@@ -1028,7 +1177,7 @@ enum CMDcode cmdmolcountspace(simptr sim,cmdptr cmd,char *line2) {
 	SCMDCHECK(itct==1,"cannot read average number");
 	SCMDCHECK(average>=0,"illegal average value");
 	line2=strnword(line2,2);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 
 	if(cmd->i1!=nbin) {														// allocate counter if required
@@ -1039,24 +1188,11 @@ enum CMDcode cmdmolcountspace(simptr sim,cmdptr cmd,char *line2) {
 		if(!cmd->v1) {cmd->i1=-1;return CMDwarn;} }
 
 	ct=(int*)cmd->v1;
+	for(d=0;d<dim;d++) nbins[d]=(d==axis)?nbin:1;
+	if(sim->mols && sim->mols->censusplan) return molcensusitem(sim,i,ms,low,high,nbins)<0?CMDwarn:CMDok;
 	if(average<=1 || cmd->invoke%average==1)
 		for(bin=0;bin<nbin;bin++) ct[bin]=0;
-	scale=(double)nbin/(high[axis]-low[axis]);
-
-	if(i<0 || ms==MSall) {lllo=0;llhi=sim->mols->nlist;}
-	else llhi=1+(lllo=sim->mols->listlookup[i][ms]);
-	for(ll=lllo;ll<llhi;ll++) {
-		mlist=sim->mols->live[ll];
-		nmol=sim->mols->nl[ll];
-		for(m=0;m<nmol;m++) {
-			mptr=mlist[m];
-			if((mptr->ident>0 && i<0 && (ms==MSall || mptr->mstate==ms)) || (mptr->ident==i && (ms==MSall || mptr->mstate==ms))) {
-				for(d=0;d<dim;d++)
-					if(mptr->pos[d]<=low[d] || mptr->pos[d]>=high[d]) d=dim+1;
-				if(d==dim) {
-					bin=(int)floor(scale*(mptr->pos[axis]-low[axis]));
-					if(bin==nbin) bin--;
-					ct[bin]++; }}}}
+	SCMDCHECK(!molcensushist(sim,i,ms,low,high,nbins,ct),"out of memory");
 
 	if(sim->latticess) {
     if(cmd->i2!=nbin) {
@@ -1084,7 +1220,73 @@ enum CMDcode cmdmolcountspace(simptr sim,cmdptr cmd,char *line2) {
 		scmdfprintf(cmd->cmds,fptr,"%g",sim->time);
 		for(bin=0;bin<nbin;bin++) scmdfprintf(cmd->cmds,fptr," %g",(double)(ct[bin])/(double)average);
 		scmdfprintf(cmd->cmds,fptr,"\n"); }
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
+	return CMDok; }
+
+
+/* cmdmolcountspacegrid.  Counts molecules on a grid that divides every
+dimension into bins, using molcensushist, to give 2D or 3D maps.  A dimension with
+1 bin only bounds the region.  Each line has the time and then the counts, with
+the last dimension varying fastest.  If average is more than 1, counts are summed
+over that many invocations and their means are written.  Lattice molecules are
+not counted.
+	cmd N molcountspacegrid species(state) low_0 high_0 bins_0 ... average filename */
+enum CMDcode cmdmolcountspacegrid(simptr sim,cmdptr cmd,char *line2) {
+	FILE *fptr;
+	int dim,i,itct,d,*ct,bin,ntot,average,nbin[DIMMAX];
+	enum MolecState ms;
+	double low[DIMMAX],high[DIMMAX];
+
+	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
+	SCMDCHECK(cmd->i1!=-1,"error on setup");					// failed before, don't try again
+	SCMDCHECK(sim->mols,"molecules are undefined");
+
+	dim=sim->dim;
+	SCMDCHECK(line2,"missing arguments");
+	i=cmdmolname(sim,cmd,1,line2,&ms);
+	SCMDCHECK(!(i<0 && i>-5),"cannot read molecule and/or state name");
+	SCMDCHECK(i!=-6,"wildcard characters not permitted in species name");
+	line2=strnword(line2,2);
+	ntot=1;
+	for(d=0;d<dim;d++) {
+		SCMDCHECK(line2,"missing grid arguments");
+		itct=sscanf(line2,"%lf %lf %i",&low[d],&high[d],&nbin[d]);
+		SCMDCHECK(itct==3,"cannot read grid arguments: low high bins");
+		SCMDCHECK(low[d]<high[d],"low value needs to be less than high value");
+		SCMDCHECK(nbin[d]>0,"bins value needs to be > 0");
+		SCMDCHECK(ntot<=100000000/nbin[d],"too many grid bins");
+		ntot*=nbin[d];
+		line2=strnword(line2,4); }
+	SCMDCHECK(line2,"missing arguments");
+	itct=sscanf(line2,"%i",&average);
+	SCMDCHECK(itct==1,"cannot read average number");
+	SCMDCHECK(average>=0,"illegal average value");
+	line2=strnword(line2,2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
+	SCMDCHECK(fptr,"file name not recognized");
+
+	if(cmd->i1!=ntot) {														// allocate counter if required
+		cmdv1free(cmd);
+		cmd->i1=ntot;
+		cmd->freefn=&cmdv1free;
+		cmd->v1=calloc(ntot,sizeof(int));
+		if(!cmd->v1) {cmd->i1=-1;return CMDwarn;} }
+
+	ct=(int*)cmd->v1;
+	if(sim->mols->censusplan) return molcensusitem(sim,i,ms,low,high,nbin)<0?CMDwarn:CMDok;
+	if(average<=1 || cmd->invoke%average==1)
+		for(bin=0;bin<ntot;bin++) ct[bin]=0;
+	SCMDCHECK(!molcensushist(sim,i,ms,low,high,nbin,ct),"out of memory");
+
+	if(average<=1) {
+		scmdfprintf(cmd->cmds,fptr,"%g",sim->time);
+		for(bin=0;bin<ntot;bin++) scmdfprintf(cmd->cmds,fptr," %i",ct[bin]);
+		scmdfprintf(cmd->cmds,fptr,"\n"); }
+	else if(cmd->invoke%average==0) {
+		scmdfprintf(cmd->cmds,fptr,"%g",sim->time);
+		for(bin=0;bin<ntot;bin++) scmdfprintf(cmd->cmds,fptr," %g",(double)(ct[bin])/(double)average);
+		scmdfprintf(cmd->cmds,fptr,"\n"); }
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
@@ -1101,31 +1303,29 @@ enum CMDcode cmdmolcountspecies(simptr sim,cmdptr cmd,char *line2) {
 	SCMDCHECK(er!=-4,"molecule name not recognized");
 	SCMDCHECK(er!=-7,"error allocating memory");
 	line2=strnword(line2,2);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 	
 	count=molcount(sim,er,index,ms,NULL,-1);
 	scmdfprintf(cmd->cmds,fptr,"%g %i\n",sim->time,count);
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
 enum CMDcode cmdmollistsize(simptr sim,cmdptr cmd,char *line2) {
 	FILE *fptr;
-	int ll,itct;
-	char listname[STRCHAR];
+	int ll;
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	itct=sscanf(line2,"%s",listname);
-	SCMDCHECK(itct==1,"cannot read molecule list name");
 	SCMDCHECK(sim->mols && sim->mols->nlist>0,"no molecule lists defined");
-	ll=stringfind(sim->mols->listname,sim->mols->nlist,listname);
+	ll=cmdfindname(cmd,2,line2,sim->mols->listname,sim->mols->nlist);
+	SCMDCHECK(ll!=-1,"cannot read molecule list name");
 	SCMDCHECK(ll>=0,"molecule list name not recognized");
 	line2=strnword(line2,2);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 	scmdfprintf(cmd->cmds,fptr,"%g %i\n",sim->time,sim->mols->nl[ll]);
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
@@ -1137,8 +1337,9 @@ enum CMDcode cmdlistmols(simptr sim,cmdptr cmd,char *line2) {
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
 	SCMDCHECK(sim->mols,"molecules are undefined");
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
+	if(cmdtrajword(strnword(line2,2))) return cmdtrajframe(sim,cmd,fptr,strnword(line2,3),-5,MSall,NULL,0);
 	for(ll=0;ll<sim->mols->nlist;ll++)
 		for(m=0;m<sim->mols->nl[ll];m++) {
 			mptr=sim->mols->live[ll][m];
@@ -1146,7 +1347,7 @@ enum CMDcode cmdlistmols(simptr sim,cmdptr cmd,char *line2) {
 				scmdfprintf(cmd->cmds,fptr,"%s(%s) ",sim->mols->spname[mptr->ident],molms2string(mptr->mstate,string));
 				for(d=0;d<sim->dim;d++)
 					scmdfprintf(cmd->cmds,fptr,"%g%s",mptr->pos[d],d<sim->dim-1?" ":"\n"); }}
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
@@ -1156,8 +1357,9 @@ enum CMDcode cmdlistmols2(simptr sim,cmdptr cmd,char *line2) {
 	FILE *fptr;
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
+	if(cmdtrajword(strnword(line2,2))) return cmdtrajframe(sim,cmd,fptr,strnword(line2,3),-5,MSall,NULL,0);
 	invk=cmd?cmd->invoke:0;
 	for(ll=0;ll<sim->mols->nlist;ll++)
 		for(m=0;m<sim->mols->nl[ll];m++) {
@@ -1166,7 +1368,7 @@ enum CMDcode cmdlistmols2(simptr sim,cmdptr cmd,char *line2) {
 				scmdfprintf(cmd->cmds,fptr,"%i %i %i ",invk,mptr->ident,mptr->mstate);
 				for(d=0;d<sim->dim;d++)
 					scmdfprintf(cmd->cmds,fptr,"%g%s",mptr->pos[d],d<sim->dim-1?" ":"\n"); }}
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
@@ -1177,12 +1379,13 @@ enum CMDcode cmdlistmols3(simptr sim,cmdptr cmd,char *line2) {
 	enum MolecState ms;
 	
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	i=readmolname(sim,line2,&ms,0);
+	i=cmdmolname(sim,cmd,1,line2,&ms);
 	SCMDCHECK(!(i<0 && i>-5),"cannot read molecule and/or state name");
 	SCMDCHECK(i!=-6,"wildcard characters not permitted in species name");
 	line2=strnword(line2,2);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
+	if(cmdtrajword(strnword(line2,2))) return cmdtrajframe(sim,cmd,fptr,strnword(line2,3),i,ms,NULL,0);
 	invk=cmd?cmd->invoke:0;
 	dim=sim->dim;
 	
@@ -1197,7 +1400,7 @@ enum CMDcode cmdlistmols3(simptr sim,cmdptr cmd,char *line2) {
 				scmdfprintf(cmd->cmds,fptr,"%i %i %i ",invk,mptr->ident,mptr->mstate);
 				for(d=0;d<sim->dim;d++)
 					scmdfprintf(cmd->cmds,fptr,"%g%s",mptr->pos[d],d<sim->dim-1?" ":"\n"); }}}
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
@@ -1208,12 +1411,13 @@ enum CMDcode cmdlistmols4(simptr sim,cmdptr cmd,char *line2) {
 	enum MolecState ms;
 	
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	i=readmolname(sim,line2,&ms,0);
+	i=cmdmolname(sim,cmd,1,line2,&ms);
 	SCMDCHECK(!(i<0 && i>-5),"cannot read molecule and/or state name");
 	SCMDCHECK(i!=-6,"wildcard characters not permitted in species name");
 	line2=strnword(line2,2);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
+	if(cmdtrajword(strnword(line2,2))) return cmdtrajframe(sim,cmd,fptr,strnword(line2,3),i,ms,NULL,1);
 	invk=cmd?cmd->invoke:0;
 	dim=sim->dim;
 	
@@ -1228,35 +1432,35 @@ enum CMDcode cmdlistmols4(simptr sim,cmdptr cmd,char *line2) {
 				scmdfprintf(cmd->cmds,fptr,"%i %i %i ",invk,mptr->ident,mptr->mstate);
 				for(d=0;d<sim->dim;d++)
 					scmdfprintf(cmd->cmds,fptr,"%g%s",mptr->pos[d]+mptr->posoffset[d],d<sim->dim-1?" ":"\n"); }}}
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
 enum CMDcode cmdlistmolscmpt(simptr sim,cmdptr cmd,char *line2) {
-	int i,c,m,ll,dim,invk,lllo,llhi,nmol,itct,d;
+	int i,c,m,ll,dim,invk,lllo,llhi,nmol,d;
+	double pbuf[DIMMAX];
 	moleculeptr *mlist,mptr;
 	FILE *fptr;
 	enum MolecState ms;
-	char cname[STRCHAR];
 	compartssptr cmptss;
 	compartptr cmpt;
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	i=readmolname(sim,line2,&ms,0);
+	i=cmdmolname(sim,cmd,1,line2,&ms);
 	SCMDCHECK(!(i<0 && i>-5),"cannot read molecule and/or state name");
 	SCMDCHECK(i!=-6,"wildcard characters not permitted in species name");
 	line2=strnword(line2,2);
 	SCMDCHECK(line2,"missing compartment name");
-	itct=sscanf(line2,"%s",cname);
-	SCMDCHECK(itct==1,"cannot read compartment name");
 	cmptss=sim->cmptss;
 	SCMDCHECK(cmptss,"no compartments defined");
-	c=stringfind(cmptss->cnames,cmptss->ncmpt,cname);
+	c=cmdfindname(cmd,2,line2,cmptss->cnames,cmptss->ncmpt);
+	SCMDCHECK(c!=-1,"cannot read compartment name");
 	SCMDCHECK(c>=0,"compartment name not recognized");
 	cmpt=cmptss->cmptlist[c];
 	line2=strnword(line2,2);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
+	if(cmdtrajword(strnword(line2,2))) return cmdtrajframe(sim,cmd,fptr,strnword(line2,3),i,ms,cmpt,0);
 	invk=cmd?cmd->invoke:0;
 	dim=sim->dim;
 
@@ -1268,11 +1472,11 @@ enum CMDcode cmdlistmolscmpt(simptr sim,cmdptr cmd,char *line2) {
 		for(m=0;m<nmol;m++) {
 			mptr=mlist[m];
 			if((mptr->ident>0 && i<0 && (ms==MSall || mptr->mstate==ms)) || (mptr->ident==i && (ms==MSall || mptr->mstate==ms))) {
-				if(posincompart(sim,mptr->pos,cmpt)) {
+				if(posincompart(sim,molreal2dbl(mptr->pos,pbuf,sim->dim),cmpt)) {
 					scmdfprintf(cmd->cmds,fptr,"%i %i %i ",invk,mptr->ident,mptr->mstate);
 					for(d=0;d<sim->dim;d++)
 						scmdfprintf(cmd->cmds,fptr,"%g%s",mptr->pos[d],d<sim->dim-1?" ":"\n"); }}}}
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
@@ -1283,12 +1487,13 @@ enum CMDcode cmdmolpos(simptr sim,cmdptr cmd,char *line2) {
 	enum MolecState ms;
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	i=readmolname(sim,line2,&ms,0);
+	i=cmdmolname(sim,cmd,1,line2,&ms);
 	SCMDCHECK(!(i<0 && i>-5),"cannot read molecule and/or state name");
 	SCMDCHECK(i!=-6,"wildcard characters not permitted in species name");
 	line2=strnword(line2,2);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
+	if(cmdtrajword(strnword(line2,2))) return cmdtrajframe(sim,cmd,fptr,strnword(line2,3),i,ms,NULL,0);
 	dim=sim->dim;
 
 	scmdfprintf(cmd->cmds,fptr,"%g ",sim->time);
@@ -1303,12 +1508,13 @@ enum CMDcode cmdmolpos(simptr sim,cmdptr cmd,char *line2) {
 				for(d=0;d<dim;d++)
 					scmdfprintf(cmd->cmds,fptr,"%g ",mptr->pos[d]); }}}
 		scmdfprintf(cmd->cmds,fptr,"\n");
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
 enum CMDcode cmdtrackmol(simptr sim,cmdptr cmd,char *line2) {
-	int itct,ll,m,d,c;
+	int itct,d,c;
+	double pbuf[DIMMAX];
 	long int serno;
 	FILE *fptr;
 	molssptr mols;
@@ -1319,72 +1525,52 @@ enum CMDcode cmdtrackmol(simptr sim,cmdptr cmd,char *line2) {
 	itct=sscanf(line2,"%li",&serno);
 	SCMDCHECK(itct==1,"cannot read molecule serial number");
 	line2=strnword(line2,2);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 
 	if(sim->mols) {
 		mols=sim->mols;
-		for(ll=0;ll<mols->nlist;ll++)
-			for(m=0;m<mols->nl[ll];m++)
-				if(mols->live[ll][m]->serno==serno) {
-					mptr=mols->live[ll][m];
-					scmdfprintf(cmd->cmds,fptr,"%g %s %s",sim->time,mols->spname[mptr->ident],molms2string(mptr->mstate,string));
-					for(d=0;d<sim->dim;d++)
-						scmdfprintf(cmd->cmds,fptr," %g",mptr->pos[d]);
-					if(sim->cmptss)
-						for(c=0;c<sim->cmptss->ncmpt;c++) {
-							if(posincompart(sim,mptr->pos,sim->cmptss->cmptlist[c]))
-								scmdfprintf(cmd->cmds,fptr," in");
-							else
-								scmdfprintf(cmd->cmds,fptr," out"); }
-					scmdfprintf(cmd->cmds,fptr,"\n");
-					m=mols->nl[ll];
-					ll=mols->nlist; }}
-	scmdflush(fptr);
+		mptr=molfindserno(mols,serno);
+		if(mptr && mptr->list>=0) {
+			scmdfprintf(cmd->cmds,fptr,"%g %s %s",sim->time,mols->spname[mptr->ident],molms2string(mptr->mstate,string));
+			for(d=0;d<sim->dim;d++)
+				scmdfprintf(cmd->cmds,fptr," %g",mptr->pos[d]);
+			if(sim->cmptss)
+				for(c=0;c<sim->cmptss->ncmpt;c++) {
+					if(posincompart(sim,molreal2dbl(mptr->pos,pbuf,sim->dim),sim->cmptss->cmptlist[c]))
+						scmdfprintf(cmd->cmds,fptr," in");
+					else
+						scmdfprintf(cmd->cmds,fptr," out"); }
+			scmdfprintf(cmd->cmds,fptr,"\n"); }}
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
 enum CMDcode cmdmolmoments(simptr sim,cmdptr cmd,char *line2) {
-	int i,ll,m,ctr,dim,d,d2,nmol;
+	int i,ctr,dim,d,d2;
 	double v1[DIMMAX],m1[DIMMAX*DIMMAX];
 	FILE *fptr;
-	moleculeptr *mlist,mptr;
 	enum MolecState ms;
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	i=readmolname(sim,line2,&ms,0);
+	i=cmdmolname(sim,cmd,1,line2,&ms);
 	SCMDCHECK(i>=0,"cannot read molecule and/or state name; 'all' is not permitted");
 	if(ms==MSall) ms=MSsoln;
 	line2=strnword(line2,2);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 	dim=sim->dim;
 
-	ll=sim->mols->listlookup[i][ms];
-	mlist=sim->mols->live[ll];
-	nmol=sim->mols->nl[ll];
-	ctr=0;
-	for(d=0;d<dim;d++) v1[d]=0;
-	for(d=0;d<dim*dim;d++) m1[d]=0;
-	for(m=0;m<nmol;m++) {
-		mptr=mlist[m];
-		if(mptr->ident==i && mptr->mstate==ms) {
-			ctr++;
-			for(d=0;d<dim;d++) v1[d]+=mlist[m]->pos[d]; }}
-	for(d=0;d<dim;d++) v1[d]/=1.0*ctr;
-	for(m=0;m<nmol;m++) {
-		mptr=mlist[m];
-		if(mptr->ident==i && mptr->mstate==ms) {
-			for(d=0;d<dim;d++)
-				for(d2=0;d2<dim;d2++)
-					m1[d*dim+d2]+=(mlist[m]->pos[d]-v1[d])*(mlist[m]->pos[d2]-v1[d2]); }}
+	if(sim->mols->censusplan) return molcensusitem(sim,i,ms,NULL,NULL,NULL)<0?CMDwarn:CMDok;
+	ctr=molmoments(sim,i,ms,v1,m1);
+	SCMDCHECK(ctr>=0,"out of memory");
 	scmdfprintf(cmd->cmds,fptr,"%g %i",sim->time,ctr);
 	for(d=0;d<dim;d++) scmdfprintf(cmd->cmds,fptr," %g",v1[d]);
 	for(d=0;d<dim;d++)
 		for(d2=0;d2<dim;d2++)
 			scmdfprintf(cmd->cmds,fptr," %g",m1[d*dim+d2]/ctr);
 	scmdfprintf(cmd->cmds,fptr,"\n");
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
@@ -1392,12 +1578,13 @@ enum CMDcode cmdsavesim(simptr sim,cmdptr cmd,char *line2) {
 	FILE *fptr;
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 	if(line2) {
 		strcutwhite(line2,2); }
 
 	scmdfprintf(cmd->cmds,fptr,"# Configuration file automatically created by Smoldyn\n\n");
+	scmdwait((cmdssptr) sim->cmds);							// the rest is written directly
 	writesim(sim,fptr);
 	writegraphss(sim,fptr);
 	writemols(sim,fptr);
@@ -1409,18 +1596,315 @@ enum CMDcode cmdsavesim(simptr sim,cmdptr cmd,char *line2) {
 	scmdwritecommands((cmdssptr) sim->cmds,fptr,line2);
 	writemolecules(sim,fptr);
 	scmdfprintf(cmd->cmds,fptr,"\nend_file\n");
-	scmdflush(fptr);
-	return CMDok; }
+	scmdflush((cmdssptr) sim->cmds,fptr);
+	return CMDok; }
+
+
+void cmdwritetrajfree(cmdptr cmd) {
+	trajfileptr traj;
+	cmdssptr cmds;
+	int fid,open;
+
+	traj=(trajfileptr) cmd->v1;
+	if(traj) {
+		cmds=cmd->cmds;
+		scmdwait(cmds);
+		open=0;
+		if(cmds)
+			for(fid=0;fid<cmds->nfile;fid++)
+				if(cmds->fptr[fid]==traj->fptr) open=1;
+		if(open && ftell(traj->fptr)==(long)cmd->f1)		// file still ends with this trajectory
+			trajwriteindex(traj);
+		trajfree(traj); }
+	trajframefree((trajframeptr) cmd->v2);
+	cmd->v1=NULL;
+	cmd->v2=NULL;
+	return; }
+
+
+/* cmdtrajframe.  Appends a trajectory frame with the molecules of species i and
+state ms that are in compartment cmpt, which may be NULL, to the binary trajectory
+in fptr, for writetraj and the traj option of the molecule listing commands.
+line2 is the compression name, which may be NULL, and unwrap is passed on to
+moltrajframe.  The trajectory and frame are kept in cmd. */
+enum CMDcode cmdtrajframe(simptr sim,cmdptr cmd,FILE *fptr,char *line2,int i,enum MolecState ms,compartptr cmpt,int unwrap) {
+	int er;
+	char codecstr[STRCHAR];
+	enum TrajCodec codec;
+	trajfileptr traj;
+	trajframeptr frame;
+
+	SCMDCHECK(sim->mols,"molecules are undefined");
+	SCMDCHECK(fptr!=stdout && fptr!=stderr,"binary trajectories need an output file");
+	codec=TCnone;
+	if(line2) {
+		sscanf(line2,"%s",codecstr);
+		if(!strcmp(codecstr,"zlib")) codec=TCzlib;
+		else SCMDCHECK(!strcmp(codecstr,"none"),"unknown compression; use none or zlib");
+		SCMDCHECK(trajcodecavailable(codec),"zlib compression is not available in this build"); }
+	scmdwait((cmdssptr) sim->cmds);							// frames are written directly
+
+	traj=(trajfileptr) cmd->v1;
+	if(traj && (traj->fptr!=fptr || ftell(fptr)!=(long)cmd->f1)) {		// file was replaced, so start over
+		trajfree(traj);
+		cmd->v1=traj=NULL; }
+	if(!traj) {
+		cmd->freefn=&cmdwritetrajfree;
+		traj=trajwriteopen(fptr,sim->dim,sim->mols->nspecies,sim->mols->spname,codec);
+		SCMDCHECK(traj,"unable to start trajectory file");
+		cmd->v1=traj; }
+
+	frame=(trajframeptr) cmd->v2;
+	if(!frame) {
+		frame=trajframealloc(sim->dim,1);
+		SCMDCHECK(frame,"out of memory");
+		cmd->v2=frame; }
+	SCMDCHECK(!moltrajframe(sim,frame,i,ms,cmpt,unwrap),"out of memory");
+
+	er=trajwriteframe(traj,frame);
+	SCMDCHECK(er!=1,"out of memory");
+	SCMDCHECK(er!=2,"error writing trajectory frame");
+	fflush(fptr);
+	cmd->f1=(double)ftell(fptr);
+	return CMDok; }
+
+
+/* cmdtrajword.  Returns 1 if the first word of line2 is traj, which asks the
+molecule listing commands for a binary trajectory frame instead of text, and 0
+otherwise. */
+int cmdtrajword(char *line2) {
+	char word[STRCHAR];
+
+	return line2 && sscanf(line2,"%s",word)==1 && !strcmp(word,"traj"); }
+
+
+enum CMDcode cmdwritetraj(simptr sim,cmdptr cmd,char *line2) {
+	FILE *fptr;
+
+	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
+	SCMDCHECK(sim->mols,"molecules are undefined");
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
+	SCMDCHECK(fptr,"file name not recognized");
+	return cmdtrajframe(sim,cmd,fptr,strnword(line2,2),-5,MSall,NULL,0); }
+
+
+/* Molecule tracking for the mean square displacement and residence time
+commands.  Each tracked molecule has a slot, and each kind of slot data is kept
+in its own array, with positions stored by dimension, so that displacements are
+accumulated with simple loops over contiguous memory.  Slots are found from
+molecule serial numbers with an open addressing hash table, which has linear
+probing and is kept at most half full.  Arrays grow as needed. */
+
+
+/* cmdtrackfree */
+void cmdtrackfree(cmdptr cmd) {
+	cmdtrackptr track;
+
+	track=(cmdtrackptr)cmd->v1;
+	if(!track) return;
+	free(track->serno);
+	free(track->state);
+	free(track->t0);
+	free(track->x0);
+	free(track->x1);
+	free(track->r2);
+	free(track->hash);
+	free(track->sortkey);
+	free(track->sortval);
+	free(track);
+	cmd->v1=NULL;
+	return; }
+
+
+/* cmdtrackhash */
+int cmdtrackhash(cmdtrackptr track,long int serno) {
+	return (int)((((unsigned long long)serno)*11400714819323198485ULL)>>32)&(track->nhash-1); }
+
+
+/* cmdtrackrehash.  Rebuilds the hash table from the slots. */
+void cmdtrackrehash(cmdtrackptr track) {
+	int j,h;
+
+	for(h=0;h<track->nhash;h++) track->hash[h]=0;
+	for(j=0;j<track->n;j++) {
+		for(h=cmdtrackhash(track,track->serno[j]);track->hash[h];h=(h+1)&(track->nhash-1));
+		track->hash[h]=j+1; }
+	return; }
+
+
+/* cmdtrackexpand.  Expands the slot arrays to hold maxslot slots.  Returns 0 for
+success or 1 for out of memory, in which case the tracker is unchanged. */
+int cmdtrackexpand(cmdtrackptr track,int maxslot) {
+	int dim,j,d,nhash,*newstate,*newhash;
+	long int *newserno;
+	double *newt0,*newx0,*newx1,*newr2;
+
+	dim=track->dim;
+	for(nhash=16;nhash<2*maxslot;nhash*=2);
+	newserno=(long int*) calloc(maxslot,sizeof(long int));
+	newstate=(int*) calloc(maxslot,sizeof(int));
+	newt0=(double*) calloc(maxslot,sizeof(double));
+	newx0=(double*) calloc(dim*maxslot+1,sizeof(double));
+	newx1=(double*) calloc(dim*maxslot+1,sizeof(double));
+	newr2=(double*) calloc(maxslot,sizeof(double));
+	newhash=(int*) calloc(nhash,sizeof(int));
+	if(!newserno || !newstate || !newt0 || !newx0 || !newx1 || !newr2 || !newhash) {
+		free(newserno);
+		free(newstate);
+		free(newt0);
+		free(newx0);
+		free(newx1);
+		free(newr2);
+		free(newhash);
+		return 1; }
+
+	for(j=0;j<track->n;j++) {
+		newserno[j]=track->serno[j];
+		newstate[j]=track->state[j];
+		newt0[j]=track->t0[j]; }
+	for(d=0;d<dim;d++)
+		for(j=0;j<track->n;j++) {
+			newx0[d*maxslot+j]=track->x0[d*track->max+j];
+			newx1[d*maxslot+j]=track->x1[d*track->max+j]; }
+
+	free(track->serno);
+	free(track->state);
+	free(track->t0);
+	free(track->x0);
+	free(track->x1);
+	free(track->r2);
+	free(track->hash);
+	track->serno=newserno;
+	track->state=newstate;
+	track->t0=newt0;
+	track->x0=newx0;
+	track->x1=newx1;
+	track->r2=newr2;
+	track->hash=newhash;
+	track->nhash=nhash;
+	track->max=maxslot;
+	cmdtrackrehash(track);
+	return 0; }
+
+
+/* cmdtrackalloc.  Allocates a tracker for dim dimensional positions, with room
+for maxslot molecules initially.  Use dim of 0 if positions are not needed.
+Returns the tracker or NULL if memory ran out. */
+cmdtrackptr cmdtrackalloc(int dim,int maxslot) {
+	cmdtrackptr track;
+
+	track=(cmdtrackptr) malloc(sizeof(struct cmdtrackstruct));
+	if(!track) return NULL;
+	track->dim=dim;
+	track->n=0;
+	track->max=0;
+	track->serno=NULL;
+	track->state=NULL;
+	track->t0=NULL;
+	track->x0=NULL;
+	track->x1=NULL;
+	track->r2=NULL;
+	track->nhash=0;
+	track->hash=NULL;
+	track->maxsort=0;
+	track->sortkey=NULL;
+	track->sortval=NULL;
+	if(cmdtrackexpand(track,maxslot>0?maxslot:1)) {
+		free(track);
+		return NULL; }
+	return track; }
+
+
+/* cmdtrackfind.  Returns the slot of the molecule with serial number serno, or
+-1 if it is not tracked. */
+int cmdtrackfind(cmdtrackptr track,long int serno) {
+	int h,j;
+
+	for(h=cmdtrackhash(track,serno);(j=track->hash[h]);h=(h+1)&(track->nhash-1))
+		if(track->serno[j-1]==serno) return j-1;
+	return -1; }
+
+
+/* cmdtrackadd.  Starts tracking molecule mptr, at the current time, with tracking
+state state.  Its starting and latest positions are set to its current position.
+Returns the new slot, or -1 if memory ran out. */
+int cmdtrackadd(simptr sim,cmdtrackptr track,moleculeptr mptr,int state) {
+	int j,d,h;
+
+	if(track->n==track->max && cmdtrackexpand(track,2*track->max)) return -1;
+	j=track->n++;
+	track->serno[j]=mptr->serno;
+	track->state[j]=state;
+	track->t0[j]=sim->time;
+	for(d=0;d<track->dim;d++)
+		track->x0[d*track->max+j]=track->x1[d*track->max+j]=mptr->posoffset[d]+mptr->pos[d];
+	for(h=cmdtrackhash(track,mptr->serno);track->hash[h];h=(h+1)&(track->nhash-1));
+	track->hash[h]=j+1;
+	return j; }
+
+
+/* cmdtrackupdate.  Updates the tracking states for the live molecules in mlist
+that have identity i and state ms, or any state if ms is MSall.  For each one,
+the state of a tracked molecule is incremented and, if the result is 3, its
+latest position is recorded; untracked molecules start being tracked with state
+3 if add is set.  Returns 0 for success or 1 for out of memory. */
+int cmdtrackupdate(simptr sim,cmdtrackptr track,moleculeptr *mlist,int nmol,int i,enum MolecState ms,int add) {
+	int m,j,d;
+	moleculeptr mptr;
+
+	for(m=0;m<nmol;m++) {
+		mptr=mlist[m];
+		if(mptr->ident==i && (ms==MSall || mptr->mstate==ms)) {
+			j=cmdtrackfind(track,mptr->serno);
+			if(j>=0) {
+				if(++track->state[j]==3)
+					for(d=0;d<track->dim;d++)
+						track->x1[d*track->max+j]=mptr->posoffset[d]+mptr->pos[d]; }
+			else if(add && cmdtrackadd(sim,track,mptr,3)<0) return 1; }}
+	return 0; }
 
 
-void cmdmeansqrdispfree(cmdptr cmd) {
-	int j;
+/* cmdtracksqrdisp.  Computes the squared displacement between the starting and
+latest positions of each slot into track->r2, either for all dimensions if
+msddim is negative or else for dimension msddim. */
+void cmdtracksqrdisp(cmdtrackptr track,int msddim) {
+	int j,d,n,max;
+	double *x0,*x1,*r2,diff;
+
+	n=track->n;
+	max=track->max;
+	r2=track->r2;
+	for(j=0;j<n;j++) r2[j]=0;
+	for(d=(msddim<0?0:msddim);d<(msddim<0?track->dim:msddim+1);d++) {
+		x0=track->x0+d*max;
+		x1=track->x1+d*max;
+		for(j=0;j<n;j++) {
+			diff=x1[j]-x0[j];
+			r2[j]+=diff*diff; }}
+	return; }
+
 
-	if(cmd->v2 && cmd->i1)
-		for(j=0;j<cmd->i1;j++)
-			free(((double**)(cmd->v2))[j]);
-	if(cmd->v2) free(cmd->v2);
-	if(cmd->v1) free(cmd->v1);
+/* cmdtrackexpire.  Stops tracking molecules whose state is 0 or 2, and
+decrements the states of the others. */
+void cmdtrackexpire(cmdtrackptr track) {
+	int j,k,d,max,moved;
+
+	max=track->max;
+	moved=0;
+	for(j=0;j<track->n;j++) {
+		if(track->state[j]==0 || track->state[j]==2) {
+			k=--track->n;
+			track->serno[j]=track->serno[k];
+			track->state[j]=track->state[k];
+			track->t0[j]=track->t0[k];
+			for(d=0;d<track->dim;d++) {
+				track->x0[d*max+j]=track->x0[d*max+k];
+				track->x1[d*max+j]=track->x1[d*max+k]; }
+			moved=1;
+			j--; }
+		else
+			track->state[j]--; }
+	if(moved) cmdtrackrehash(track);
 	return; }
 
 
@@ -1429,12 +1913,12 @@ enum CMDcode cmdmeansqrdisp(simptr sim,cmdptr cmd,char *line2) {
 	int i,j,d,itct,ll,dim,ctr,m,msddim,nmol;
 	FILE *fptr;
 	moleculeptr *mlist;
-	double r2,sum,sum4,diff,*pos,**v2;
-	long int *v1;
+	double sum,sum4,*r2;
+	cmdtrackptr track;
 	enum MolecState ms;
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	i=readmolname(sim,line2,&ms,0);
+	i=cmdmolname(sim,cmd,1,line2,&ms);
 	SCMDCHECK(i>=0,"cannot read molecule and/or state name; 'all' is not permitted");
 	if(ms==MSall) ms=MSsoln;
 	line2=strnword(line2,2);
@@ -1447,7 +1931,7 @@ enum CMDcode cmdmeansqrdisp(simptr sim,cmdptr cmd,char *line2) {
 		SCMDCHECK(itct==1,"cannot read dimension");
 		SCMDCHECK(msddim>=0 && msddim<sim->dim,"dimension out of range"); }
 	line2=strnword(line2,2);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 
 	SCMDCHECK(cmd->i2!=2,"error on setup");					// failed before, don't try again
@@ -1462,69 +1946,52 @@ enum CMDcode cmdmeansqrdisp(simptr sim,cmdptr cmd,char *line2) {
 		ctr=0;
 		for(m=0;m<nmol;m++)
 			if(mlist[m]->ident==i && mlist[m]->mstate==ms) ctr++;
-		cmd->i1=ctr;										// size of arrays
-		SCMDCHECK(ctr>0,"no molecules to track");
-		cmd->freefn=&cmdmeansqrdispfree;
-		cmd->v1=calloc(ctr,sizeof(long int));	// v1 is serial numbers
-		if(!cmd->v1) {cmd->i2=2;return CMDwarn;}
-		for(j=0;j<ctr;j++) ((long int*)cmd->v1)[j]=0;
-		cmd->v2=calloc(ctr,sizeof(double**));	// v2 is positions
-		if(!cmd->v2) {cmd->i2=2;return CMDwarn;}
-		for(j=0;j<ctr;j++) ((double**)cmd->v2)[j]=NULL;
-		for(j=0;j<ctr;j++) {
-			((double**)cmd->v2)[j]=(double*)calloc(dim,sizeof(double));
-			if(!((double**)cmd->v2)[j]) {cmd->i2=2;return CMDwarn;}
-			for(d=0;d<dim;d++) ((double**)cmd->v2)[j][d]=0; }
-		ctr=0;
-		for(m=0;m<nmol;m++) {
-			if(mlist[m]->ident==i && mlist[m]->mstate==ms) {
-				((long int*)cmd->v1)[ctr]=mlist[m]->serno;
-				for(d=0;d<dim;d++)
-					((double**)cmd->v2)[ctr][d]=mlist[m]->posoffset[d]+mlist[m]->pos[d];
-				ctr++; }}
-		sortVliv((long int*)cmd->v1,(void**)cmd->v2,cmd->i1); }
+		track=cmdtrackalloc(dim,ctr);
+		if(!track) {cmd->i2=2;return CMDwarn;}
+		cmd->v1=track;										// v1 is the tracker
+		cmd->freefn=&cmdtrackfree;
+		for(m=0;m<nmol;m++)
+			if(mlist[m]->ident==i && mlist[m]->mstate==ms)
+				cmdtrackadd(sim,track,mlist[m],3);
+		SCMDCHECK(ctr>0,"no molecules to track"); }
 
-	ctr=0;														// start of code that is run every invocation
-	sum=0;
-	sum4=0;
-	v1=(long int*)cmd->v1;
-	v2=(double**)cmd->v2;
+	track=(cmdtrackptr)cmd->v1;				// start of code that is run every invocation
+	for(d=0;d<dim;d++)								// molecules that are not found have no displacement
+		memcpy(track->x1+d*track->max,track->x0+d*track->max,track->n*sizeof(double));
+	ctr=0;
 	for(m=0;m<nmol;m++)
 		if(mlist[m]->ident==i && mlist[m]->mstate==ms) {
-			j=locateVli(v1,mlist[m]->serno,cmd->i1);
+			j=cmdtrackfind(track,mlist[m]->serno);
 			if(j>=0) {
-				pos=mlist[m]->pos;
 				ctr++;
-				if(msddim<0) {
-					r2=0;
-					for(d=0;d<dim;d++) {
-						diff=mlist[m]->posoffset[d]+pos[d]-v2[j][d];
-						r2+=diff*diff; }
-					sum+=r2;
-					sum4+=r2*r2; }
-				else {
-					diff=mlist[m]->posoffset[msddim]+pos[msddim]-v2[j][msddim];
-					sum+=diff*diff;
-					sum4+=diff*diff*diff*diff; }}}
+				for(d=0;d<dim;d++)
+					track->x1[d*track->max+j]=mlist[m]->posoffset[d]+mlist[m]->pos[d]; }}
+	cmdtracksqrdisp(track,msddim);
+	r2=track->r2;
+	sum=0;
+	sum4=0;
+	for(j=0;j<track->n;j++) {
+		sum+=r2[j];
+		sum4+=r2[j]*r2[j]; }
 	scmdfprintf(cmd->cmds,fptr,"%g %g %g\n",sim->time,sum/ctr,sum4/ctr);
 
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
 enum CMDcode cmdmeansqrdisp2(simptr sim,cmdptr cmd,char *line2) {
 	static char dimstr[STRCHAR];
-	int i,j,d,itct,ll,dim,ctr,m,msddim,nmol,maxmoment,maxmol,mom;
+	int i,j,itct,ll,dim,m,msddim,nmol,maxmoment,maxmol,mom,report;
 	FILE *fptr;
 	moleculeptr *mlist;
 	static double sum[17];
-	double r2,diff,**v2,*dblptr;
-	long int *v1;
+	double r,power,*x0,*x1;
+	cmdtrackptr track;
 	enum MolecState ms;
 	char startchar,reportchar;
   
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	i=readmolname(sim,line2,&ms,0);
+	i=cmdmolname(sim,cmd,1,line2,&ms);
 	SCMDCHECK(i>=0,"cannot read molecule and/or state name; 'all' is not permitted");
 	if(ms==MSall) ms=MSsoln;
 	line2=strnword(line2,2);
@@ -1544,7 +2011,7 @@ enum CMDcode cmdmeansqrdisp2(simptr sim,cmdptr cmd,char *line2) {
 	SCMDCHECK(maxmoment>0,"maxmoment has to be at least 1");
 	SCMDCHECK(maxmoment<=16,"max_moment cannot exceed 16");
 	line2=strnword(line2,5);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
   
 	SCMDCHECK(cmd->i2!=2,"error on setup");					// failed before, don't try again
@@ -1556,71 +2023,33 @@ enum CMDcode cmdmeansqrdisp2(simptr sim,cmdptr cmd,char *line2) {
   
 	if(!cmd->i2) {										// test for first run
 		cmd->i2=1;											// if first run, set up data structures
-		cmd->i1=maxmol;
-		cmd->i3=0;
-		cmd->freefn=&cmdmeansqrdispfree;
-		cmd->v1=calloc(maxmol,sizeof(long int));	// v1 is serial numbers
-		if(!cmd->v1) {cmd->i2=2;return CMDwarn;}
-		v1=(long int*)cmd->v1;
-		for(j=0;j<maxmol;j++) v1[j]=0;
-		cmd->v2=calloc(maxmol,sizeof(double**));	// v2 is positions
-		if(!cmd->v2) {cmd->i2=2;return CMDwarn;}
-		v2=(double**)cmd->v2;
-		for(j=0;j<maxmol;j++) v2[j]=NULL;
-		for(j=0;j<maxmol;j++) {
-			v2[j]=(double*)calloc(2*dim+1,sizeof(double));
-			if(!v2[j]) {cmd->i2=2;return CMDwarn;}
-			for(d=0;d<2*dim+1;d++) v2[j][d]=0; }
-		ctr=0;
-		for(m=0;m<nmol;m++) {
-			if(mlist[m]->ident==i && mlist[m]->mstate==ms) {
-				SCMDCHECK(ctr<maxmol,"insufficient allocated space");
-				v1[ctr]=mlist[m]->serno;
-				if(startchar=='c') v2[ctr][0]=0;
-				else v2[ctr][0]=2.0;
-				for(d=0;d<dim;d++)
-					v2[ctr][1+d]=v2[ctr][dim+1+d]=mlist[m]->posoffset[d]+mlist[m]->pos[d];
-				ctr++; }}
-		cmd->i3=ctr;
-		if(cmd->i3>0) sortVliv(v1,(void**)cmd->v2,cmd->i3); }
-  
-	v1=(long int*)cmd->v1;						// start of code that is run every invocation
-	v2=(double**)cmd->v2;
+		track=cmdtrackalloc(dim,maxmol);		// max_mol is the initial size
+		if(!track) {cmd->i2=2;return CMDwarn;}
+		cmd->v1=track;										// v1 is the tracker
+		cmd->freefn=&cmdtrackfree;
+		for(m=0;m<nmol;m++)
+			if(mlist[m]->ident==i && mlist[m]->mstate==ms)
+				if(cmdtrackadd(sim,track,mlist[m],startchar=='c'?0:2)<0) {cmd->i2=2;SCMDCHECK(0,"out of memory");} }
   
-	for(m=0;m<nmol;m++) {							// update tracking information for all tracked molecules
-		if(mlist[m]->ident==i && mlist[m]->mstate==ms) {
-			j=locateVli(v1,mlist[m]->serno,cmd->i3);
-			if(j>=0) {										// molecule was found
-				v2[j][0]+=1.0;
-				if(v2[j][0]==3.0) {					// molecule is being tracked and exists, so record current positions
-					for(d=0;d<dim;d++)
-						v2[j][dim+1+d]=mlist[m]->posoffset[d]+mlist[m]->pos[d]; }}
-			else if(startchar!='i') {			// molecule was not found but should be tracked
-				if(cmd->i3==cmd->i1) {SCMDCHECK(0,"not enough allocated space");}
-				j=cmd->i3++;					// find empty spot
-				v1[j]=mlist[m]->serno;
-				v2[j][0]=3.0;
-				for(d=0;d<dim;d++)
-					v2[j][1+d]=v2[j][dim+1+d]=mlist[m]->posoffset[d]+mlist[m]->pos[d]; }}}
-	if(startchar!='i')								// resort lists if appropriate
-		if(cmd->i3>0) sortVliv(v1,(void**)cmd->v2,cmd->i3);
+	track=(cmdtrackptr)cmd->v1;				// start of code that is run every invocation
+	SCMDCHECK(!cmdtrackupdate(sim,track,mlist,nmol,i,ms,startchar!='i'),"out of memory");
   
 	for(mom=0;mom<=maxmoment;mom++)
 		sum[mom]=0;
-	for(j=0;j<cmd->i3;j++) {					// find moments of all reported results
-		if((reportchar=='e' && v2[j][0]==3.0) || (reportchar=='r' && v2[j][0]==2.0)) { // molecule should be recorded
-			if(msddim<0) {
-				r2=0;
-				for(d=0;d<dim;d++) {
-					diff=v2[j][dim+1+d]-v2[j][1+d];
-					r2+=diff*diff; }
-				r2=sqrt(r2);
-				for(mom=0;mom<=maxmoment;mom++)
-					sum[mom]+=pow(r2,mom); }
-			else {
-				diff=v2[j][dim+1+msddim]-v2[j][1+msddim];
-				for(mom=0;mom<=maxmoment;mom++)
-					sum[mom]+=pow(diff,mom); }}}
+	if(msddim<0) {
+		cmdtracksqrdisp(track,-1);
+		x0=x1=NULL; }
+	else {
+		x0=track->x0+msddim*track->max;
+		x1=track->x1+msddim*track->max; }
+	for(j=0;j<track->n;j++) {					// find moments of all reported results
+		report=(reportchar=='e' && track->state[j]==3) || (reportchar=='r' && track->state[j]==2);
+		if(report) {											// molecule should be recorded
+			r=(msddim<0)?sqrt(track->r2[j]):x1[j]-x0[j];
+			power=1;
+			for(mom=0;mom<=maxmoment;mom++) {
+				sum[mom]+=power;
+				power*=r; }}}
   
 	if(sum[0]>0) {
 		scmdfprintf(cmd->cmds,fptr,"%g %g",sim->time,sum[0]);					// display results
@@ -1628,37 +2057,25 @@ enum CMDcode cmdmeansqrdisp2(simptr sim,cmdptr cmd,char *line2) {
 			scmdfprintf(cmd->cmds,fptr," %g",sum[mom]/sum[0]); }
 		scmdfprintf(cmd->cmds,fptr,"\n"); }
   
-	for(j=0;j<cmd->i3;j++) {							// stop tracking expired molecules
-		if(v2[j][0]==0 || v2[j][0]==2.0) {
-			v1[j]=v1[cmd->i3-1];
-			v1[cmd->i3-1]=0;
-			dblptr=v2[j];
-			v2[j]=v2[cmd->i3-1];
-			v2[cmd->i3-1]=dblptr;
-			v2[cmd->i3-1][0]=0;
-			j--;
-			cmd->i3--; }
-		else
-			v2[j][0]-=1.0; }
-	if(cmd->i3>0) sortVliv(v1,(void**)cmd->v2,cmd->i3);
+	cmdtrackexpire(track);							// stop tracking expired molecules
   
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
 enum CMDcode cmdmeansqrdisp3(simptr sim,cmdptr cmd,char *line2) {
 	static char dimstr[STRCHAR];
-	int i,j,d,itct,ll,dim,ctr,m,msddim,nmol,maxmol;
+	int i,j,itct,ll,dim,ctr,m,msddim,nmol,maxmol;
 	FILE *fptr;
 	moleculeptr *mlist;
 	double sum,wgt;
-	double r2,diff,**v2,*dblptr,change;
-	long int *v1;
+	double change;
+	cmdtrackptr track;
 	enum MolecState ms;
 	char startchar,reportchar;
   
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	i=readmolname(sim,line2,&ms,0);
+	i=cmdmolname(sim,cmd,1,line2,&ms);
 	SCMDCHECK(i>=0,"cannot read molecule and/or state name; 'all' is not permitted for species");
 	line2=strnword(line2,2);
 	SCMDCHECK(line2,"missing dimension information");
@@ -1675,7 +2092,7 @@ enum CMDcode cmdmeansqrdisp3(simptr sim,cmdptr cmd,char *line2) {
 	SCMDCHECK(itct==4,"cannot read start, report, max_mol, or change information");
 	SCMDCHECK(maxmol>0,"max_mol has to be at least 1");
 	line2=strnword(line2,5);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
   line2=strnword(line2,2);
   SCMDCHECK(change<=0 || line2,"missing task to be accomplished if change is small");
@@ -1692,114 +2109,52 @@ enum CMDcode cmdmeansqrdisp3(simptr sim,cmdptr cmd,char *line2) {
   
 	if(!cmd->i2) {										// test for first run
 		cmd->i2=1;											// if first run, set up data structures
-		cmd->i1=maxmol;
-		cmd->i3=0;
     cmd->f1=-1;
-		cmd->freefn=&cmdmeansqrdispfree;
-		cmd->v1=calloc(maxmol,sizeof(long int));	// v1 is serial numbers
-		if(!cmd->v1) {cmd->i2=2;return CMDwarn;}
-		v1=(long int*)cmd->v1;
-		for(j=0;j<maxmol;j++) v1[j]=0;
-		cmd->v2=calloc(maxmol,sizeof(double**));	// v2 is positions
-		if(!cmd->v2) {cmd->i2=2;return CMDwarn;}
-		v2=(double**)cmd->v2;
-		for(j=0;j<maxmol;j++) v2[j]=NULL;
-		for(j=0;j<maxmol;j++) {
-			v2[j]=(double*)calloc(2*dim+2,sizeof(double));
-			if(!v2[j]) {cmd->i2=2;return CMDwarn;}
-			for(d=0;d<2*dim+2;d++) v2[j][d]=0; }
-		ctr=0;
-		for(m=0;m<nmol;m++) {                    // record initial data
-			if(mlist[m]->ident==i && (ms==MSall || mlist[m]->mstate==ms)) {
-				SCMDCHECK(ctr<maxmol,"insufficient allocated space");
-				v1[ctr]=mlist[m]->serno;
-				if(startchar=='c') v2[ctr][0]=0;
-				else v2[ctr][0]=2.0;
-				for(d=0;d<dim;d++)
-					v2[ctr][1+d]=v2[ctr][dim+1+d]=mlist[m]->posoffset[d]+mlist[m]->pos[d];
-        v2[ctr][2*dim+1]=sim->time;
-				ctr++; }}
-		cmd->i3=ctr;
-		if(cmd->i3>0) sortVliv(v1,(void**)cmd->v2,cmd->i3); }
+		track=cmdtrackalloc(dim,maxmol);		// max_mol is the initial size
+		if(!track) {cmd->i2=2;return CMDwarn;}
+		cmd->v1=track;										// v1 is the tracker
+		cmd->freefn=&cmdtrackfree;
+		for(m=0;m<nmol;m++)                    // record initial data
+			if(mlist[m]->ident==i && (ms==MSall || mlist[m]->mstate==ms))
+				if(cmdtrackadd(sim,track,mlist[m],startchar=='c'?0:2)<0) {cmd->i2=2;SCMDCHECK(0,"out of memory");} }
   
-	v1=(long int*)cmd->v1;						// start of code that is run every invocation
-	v2=(double**)cmd->v2;
-  
-	for(m=0;m<nmol;m++) {							// update tracking information for all tracked molecules
-		if(mlist[m]->ident==i && (ms==MSall || mlist[m]->mstate==ms)) {
-			j=locateVli(v1,mlist[m]->serno,cmd->i3);
-			if(j>=0) {										// molecule was found
-				v2[j][0]+=1.0;
-				if(v2[j][0]==3.0) {					// molecule is being tracked and exists, so record current positions
-					for(d=0;d<dim;d++)
-						v2[j][dim+1+d]=mlist[m]->posoffset[d]+mlist[m]->pos[d]; }}
-			else if(startchar!='i') {			// molecule was not found but should be tracked
-				if(cmd->i3==cmd->i1) {SCMDCHECK(0,"not enough allocated space");}
-				j=cmd->i3++;					// find empty spot
-				v1[j]=mlist[m]->serno;
-				v2[j][0]=3.0;
-				for(d=0;d<dim;d++)
-					v2[j][1+d]=v2[j][dim+1+d]=mlist[m]->posoffset[d]+mlist[m]->pos[d];
-        v2[j][2*dim+1]=sim->time; }}}
-	if(startchar!='i')								// resort lists if appropriate
-		if(cmd->i3>0) sortVliv(v1,(void**)cmd->v2,cmd->i3);
+	track=(cmdtrackptr)cmd->v1;				// start of code that is run every invocation
+	SCMDCHECK(!cmdtrackupdate(sim,track,mlist,nmol,i,ms,startchar!='i'),"out of memory");
   
+	cmdtracksqrdisp(track,msddim);
   sum=0;
   ctr=0;
   wgt=0;
-	for(j=0;j<cmd->i3;j++) {					// find effective diffusion coefficients of all reported results
-		if((reportchar=='e' && v2[j][0]==3.0) || (reportchar=='r' && v2[j][0]==2.0)) { // molecule should be recorded
+	for(j=0;j<track->n;j++) {					// find effective diffusion coefficients of all reported results
+		if((reportchar=='e' && track->state[j]==3) || (reportchar=='r' && track->state[j]==2)) { // molecule should be recorded
       ctr++;
-			if(msddim<0) {
-				r2=0;
-				for(d=0;d<dim;d++) {
-					diff=v2[j][dim+1+d]-v2[j][1+d];
-					r2+=diff*diff; }
-        sum+=r2;
-        wgt+=sim->time-v2[j][2*dim+1]; }
-			else {
-				diff=v2[j][dim+1+msddim]-v2[j][1+msddim];
-        r2=diff*diff;
-        sum+=r2;
-        wgt+=sim->time-v2[j][2*dim+1]; }}}
+      sum+=track->r2[j];
+      wgt+=sim->time-track->t0[j]; }}
   if(msddim<0) sum/=(2.0*dim);
   else sum/=2.0;
 
   scmdfprintf(cmd->cmds,fptr,"%g %i %g\n",sim->time,ctr,sum/wgt);					// display results
   
-	for(j=0;j<cmd->i3;j++) {							// stop tracking expired molecules
-		if(v2[j][0]==0 || v2[j][0]==2.0) {
-			v1[j]=v1[cmd->i3-1];
-			v1[cmd->i3-1]=0;
-			dblptr=v2[j];
-			v2[j]=v2[cmd->i3-1];
-			v2[cmd->i3-1]=dblptr;
-			v2[cmd->i3-1][0]=0;
-			j--;
-			cmd->i3--; }
-		else
-			v2[j][0]-=1.0; }
-	if(cmd->i3>0) sortVliv(v1,(void**)cmd->v2,cmd->i3);
+	cmdtrackexpire(track);							// stop tracking expired molecules
   
   if(change>0 && ctr>0 && cmd->f1>0 && fabs((sum/ctr-cmd->f1)/cmd->f1)<change)
     return docommand(sim,cmd,line2);
   cmd->f1=sum/ctr;
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
 enum CMDcode cmdresidencetime(simptr sim,cmdptr cmd,char *line2) {
-	int i,j,d,itct,ll,ctr,m,nmol,maxmol,summaryout,listout;
+	int i,j,k,nlist,itct,ll,ctr,m,nmol,maxmol,summaryout,listout;
 	FILE *fptr;
 	moleculeptr *mlist;
 	double sum;
-	double **v2,*dblptr;
-	long int *v1;
+	cmdtrackptr track;
 	enum MolecState ms;
 	char startchar,reportchar;
   
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	i=readmolname(sim,line2,&ms,0);
+	i=cmdmolname(sim,cmd,1,line2,&ms);
 	SCMDCHECK(i>=0,"cannot read molecule and/or state name; 'all' is not permitted");
 	if(ms==MSall) ms=MSsoln;
 	line2=strnword(line2,2);
@@ -1808,7 +2163,7 @@ enum CMDcode cmdresidencetime(simptr sim,cmdptr cmd,char *line2) {
 	SCMDCHECK(itct==5,"cannot read start, report, summary_out, list_out, or max_mol information");
 	SCMDCHECK(maxmol>0,"max_mol has to be at least 1");
 	line2=strnword(line2,6);
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
   
 	SCMDCHECK(cmd->i2!=2,"error on setup");					// failed before, don't try again
@@ -1819,77 +2174,48 @@ enum CMDcode cmdresidencetime(simptr sim,cmdptr cmd,char *line2) {
   
 	if(!cmd->i2) {										// test for first run
 		cmd->i2=1;											// if first run, set up data structures
-		cmd->i1=maxmol;
-		cmd->i3=0;
-		cmd->freefn=&cmdmeansqrdispfree;
-		cmd->v1=calloc(maxmol,sizeof(long int));	// v1 is serial numbers
-		if(!cmd->v1) {cmd->i2=2;return CMDwarn;}
-		v1=(long int*)cmd->v1;
-		for(j=0;j<maxmol;j++) v1[j]=0;
-		cmd->v2=calloc(maxmol,sizeof(double**));	// v2 is creation times
-		if(!cmd->v2) {cmd->i2=2;return CMDwarn;}
-		v2=(double**)cmd->v2;
-		for(j=0;j<maxmol;j++) v2[j]=NULL;
-		for(j=0;j<maxmol;j++) {
-			v2[j]=(double*)calloc(2,sizeof(double));
-			if(!v2[j]) {cmd->i2=2;return CMDwarn;}
-			for(d=0;d<2;d++) v2[j][d]=0; }
-		ctr=0;
-		for(m=0;m<nmol;m++) {                    // record initial data
-			if(mlist[m]->ident==i && mlist[m]->mstate==ms) {
-				SCMDCHECK(ctr<maxmol,"insufficient allocated space");
-				v1[ctr]=mlist[m]->serno;
-				if(startchar=='c') v2[ctr][0]=0;
-				else v2[ctr][0]=2.0;
-        v2[ctr][1]=sim->time;
-				ctr++; }}
-		cmd->i3=ctr;
-		if(cmd->i3>0) sortVliv(v1,(void**)cmd->v2,cmd->i3); }
-  
-	v1=(long int*)cmd->v1;						// start of code that is run every invocation
-	v2=(double**)cmd->v2;
+		track=cmdtrackalloc(0,maxmol);			// max_mol is the initial size; no positions
+		if(!track) {cmd->i2=2;return CMDwarn;}
+		cmd->v1=track;										// v1 is the tracker
+		cmd->freefn=&cmdtrackfree;
+		for(m=0;m<nmol;m++)                    // record initial data
+			if(mlist[m]->ident==i && mlist[m]->mstate==ms)
+				if(cmdtrackadd(sim,track,mlist[m],startchar=='c'?0:2)<0) {cmd->i2=2;SCMDCHECK(0,"out of memory");} }
   
-	for(m=0;m<nmol;m++) {							// update tracking information for all tracked molecules
-		if(mlist[m]->ident==i && mlist[m]->mstate==ms) {
-			j=locateVli(v1,mlist[m]->serno,cmd->i3);
-			if(j>=0) {										// molecule was found
-				v2[j][0]+=1.0; }
-			else if(startchar!='i') {			// molecule was not found but should be tracked
-				if(cmd->i3==cmd->i1) {SCMDCHECK(0,"not enough allocated space");}
-				j=cmd->i3++;                // find empty spot
-				v1[j]=mlist[m]->serno;
-				v2[j][0]=3.0;
-        v2[j][1]=sim->time; }}}
-	if(startchar!='i')								// resort lists if appropriate
-		if(cmd->i3>0) sortVliv(v1,(void**)cmd->v2,cmd->i3);
+	track=(cmdtrackptr)cmd->v1;				// start of code that is run every invocation
+	SCMDCHECK(!cmdtrackupdate(sim,track,mlist,nmol,i,ms,startchar!='i'),"out of memory");
   
+	if(listout>0 && cmd->invoke>0 && cmd->invoke%listout==0 && track->maxsort<track->n) {
+		free(track->sortkey);								// list output is sorted by serial number
+		free(track->sortval);
+		track->maxsort=track->max;
+		track->sortkey=(long int*) calloc(track->maxsort,sizeof(long int));
+		track->sortval=(void**) calloc(track->maxsort,sizeof(void*));
+		if(!track->sortkey || !track->sortval) {
+			track->maxsort=0;
+			SCMDCHECK(0,"out of memory"); }}
+
   sum=0;
   ctr=0;
-	for(j=0;j<cmd->i3;j++) {					// find effective diffusion coefficients of all reported results
-		if((reportchar=='e' && v2[j][0]==3.0) || (reportchar=='r' && v2[j][0]==2.0)) { // molecule should be recorded
+  nlist=0;
+	for(j=0;j<track->n;j++) {					// find residence times of all reported results
+		if((reportchar=='e' && track->state[j]==3) || (reportchar=='r' && track->state[j]==2)) { // molecule should be recorded
       ctr++;
-      sum+=sim->time-v2[j][1];
-      if(listout>0 && cmd->invoke>0 && cmd->invoke%listout==0)
-        scmdfprintf(cmd->cmds,fptr,"%li %g\n",v1[j],sim->time-v2[j][1]); }}
+      sum+=sim->time-track->t0[j];
+      if(listout>0 && cmd->invoke>0 && cmd->invoke%listout==0) {
+				track->sortkey[nlist]=track->serno[j];
+				track->sortval[nlist++]=(void*)&track->t0[j]; }}}
+	if(nlist>0) {
+		sortVliv(track->sortkey,track->sortval,nlist);
+		for(k=0;k<nlist;k++)
+			scmdfprintf(cmd->cmds,fptr,"%li %g\n",track->sortkey[k],sim->time-*(double*)track->sortval[k]); }
   
   if(summaryout>0 && cmd->invoke>0 && cmd->invoke%summaryout==0)
     scmdfprintf(cmd->cmds,fptr,"%g %i %g\n",sim->time,ctr,sum/ctr);					// display results
   
-	for(j=0;j<cmd->i3;j++) {							// stop tracking expired molecules
-		if(v2[j][0]==0 || v2[j][0]==2.0) {
-			v1[j]=v1[cmd->i3-1];
-			v1[cmd->i3-1]=0;
-			dblptr=v2[j];
-			v2[j]=v2[cmd->i3-1];
-			v2[cmd->i3-1]=dblptr;
-			v2[cmd->i3-1][0]=0;
-			j--;
-			cmd->i3--; }
-		else
-			v2[j][0]-=1.0; }
-	if(cmd->i3>0) sortVliv(v1,(void**)cmd->v2,cmd->i3);
+	cmdtrackexpire(track);							// stop tracking expired molecules
   
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
@@ -1925,12 +2251,12 @@ enum CMDcode cmdexecutiontime(simptr sim,cmdptr cmd,char *line2) {
 	FILE *fptr;
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 
 	scmdfprintf(cmd->cmds,fptr,"%g %g\n",sim->time,sim->elapsedtime+difftime(time(NULL),sim->clockstt));
 
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
@@ -1941,7 +2267,7 @@ enum CMDcode cmdprintLattice(simptr sim,cmdptr cmd,char *line2) {
 	int n,i;
 
 	if(line2 && !strcmp(line2,"cmdtype")) return CMDobserve;
-	fptr=scmdgetfptr((cmdssptr) sim->cmds,line2);
+	fptr=scmdgetfptrarg((cmdssptr) sim->cmds,cmd,0,line2);
 	SCMDCHECK(fptr,"file name not recognized");
 
 	n=sim->latticess->nlattice;
@@ -1950,7 +2276,7 @@ enum CMDcode cmdprintLattice(simptr sim,cmdptr cmd,char *line2) {
 		scmdfprintf(cmd->cmds,fptr,"Lattice %d: %s:\n",i,lattice->latticename);
 		NSV_CALL(nsv_print(lattice->nsv,buffer));
 		scmdfprintf(cmd->cmds,fptr,"%s",buffer); }
-	scmdflush(fptr);
+	scmdflush((cmdssptr) sim->cmds,fptr);
 	return CMDok; }
 
 
@@ -2229,6 +2555,7 @@ enum CMDcode cmdkillmolinsphere(simptr sim,cmdptr cmd,char *line2) {
 
 enum CMDcode cmdkillmolincmpt(simptr sim,cmdptr cmd,char *line2) {
 	int itct,i,ll,m,c;
+	double pbuf[DIMMAX];
 	static char cname[STRCHAR];
 	moleculeptr mptr;
 	enum MolecState ms;
@@ -2255,7 +2582,7 @@ enum CMDcode cmdkillmolincmpt(simptr sim,cmdptr cmd,char *line2) {
 		ll=sim->mols->listlookup[i][ms];
 		for(m=0;m<sim->mols->nl[ll];m++) {
 			mptr=sim->mols->live[ll][m];
-			if(mptr->ident==i && mptr->mstate==ms && posincompart(sim,mptr->pos,cmpt))
+			if(mptr->ident==i && mptr->mstate==ms && posincompart(sim,molreal2dbl(mptr->pos,pbuf,sim->dim),cmpt))
 				molkill(sim,mptr,ll,m); }}
 	else {
 		for(ll=0;ll<sim->mols->nlist;ll++)
@@ -2264,7 +2591,7 @@ enum CMDcode cmdkillmolincmpt(simptr sim,cmdptr cmd,char *line2) {
 					mptr=sim->mols->live[ll][m];
 					if(i==-5 || mptr->ident==i)
 						if(ms==MSall || mptr->mstate==ms)
-							if(posincompart(sim,mptr->pos,cmpt))
+							if(posincompart(sim,molreal2dbl(mptr->pos,pbuf,sim->dim),cmpt))
 								molkill(sim,mptr,ll,m); }}
 
 	return CMDok; }
@@ -2272,6 +2599,7 @@ enum CMDcode cmdkillmolincmpt(simptr sim,cmdptr cmd,char *line2) {
 
 enum CMDcode cmdkillmoloutsidesystem(simptr sim,cmdptr cmd,char *line2) {
 	int i,ll,m,lllo,llhi,nmol;
+	double pbuf[DIMMAX];
 	moleculeptr *mlist,mptr;
 	enum MolecState ms;
 
@@ -2288,7 +2616,7 @@ enum CMDcode cmdkillmoloutsidesystem(simptr sim,cmdptr cmd,char *line2) {
 		for(m=0;m<nmol;m++) {
 			mptr=mlist[m];
 			if((i<0 && ms==MSall) || (i<0 && mptr->mstate==ms) || (mptr->ident==i && ms==MSall) || (mptr->ident==i && mptr->mstate==ms))
-				if(!posinsystem(sim,mptr->pos)) molkill(sim,mptr,ll,m); }}
+				if(!posinsystem(sim,molreal2dbl(mptr->pos,pbuf,sim->dim))) molkill(sim,mptr,ll,m); }}
 	return CMDok; }
 
 
@@ -2373,6 +2701,7 @@ enum CMDcode cmdfixmolcountonsurf(simptr sim,cmdptr cmd,char *line2) {
 
 enum CMDcode cmdfixmolcountincmpt(simptr sim,cmdptr cmd,char *line2) {
 	int itct,num,i,ll,m,ct,numl,c;
+	double pbuf[DIMMAX];
 	static char nm[STRCHAR];
 	moleculeptr mptr;
 	compartptr cmpt;
@@ -2398,7 +2727,7 @@ enum CMDcode cmdfixmolcountincmpt(simptr sim,cmdptr cmd,char *line2) {
 	ct=0;
 	for(m=0;m<numl;m++) {
 		mptr=sim->mols->live[ll][m];
-		if(mptr->ident==i && mptr->mstate==MSsoln && posincompart(sim,mptr->pos,cmpt)) ct++; }
+		if(mptr->ident==i && mptr->mstate==MSsoln && posincompart(sim,molreal2dbl(mptr->pos,pbuf,sim->dim),cmpt)) ct++; }
 
 	if(ct==num);
 	else if(ct<num) {
@@ -2408,7 +2737,7 @@ enum CMDcode cmdfixmolcountincmpt(simptr sim,cmdptr cmd,char *line2) {
 		for(;num>0;num--) {
 			m=intrand(numl);
 			mptr=sim->mols->live[ll][m];
-			while(!(mptr->ident==i && mptr->mstate==MSsoln && posincompart(sim,mptr->pos,cmpt))) {
+			while(!(mptr->ident==i && mptr->mstate==MSsoln && posincompart(sim,molreal2dbl(mptr->pos,pbuf,sim->dim),cmpt))) {
 				m=(m==numl-1)?0:m+1;
 				mptr=sim->mols->live[ll][m]; }
 			molkill(sim,mptr,ll,m); }}
@@ -2481,7 +2810,8 @@ enum CMDcode cmdreplacexyzmol(simptr sim,cmdptr cmd,char *line2) {
 
 enum CMDcode cmdreplacevolmol(simptr sim,cmdptr cmd,char *line2) {
 	int m,itct,dim,d,b,b1,b2,i1,i2,ll;
-	double *pos,poslo[DIMMAX],poshi[DIMMAX],frac;
+	double poslo[DIMMAX],poshi[DIMMAX],frac;
+	molreal *pos;
 	boxptr bptr1,bptr2,bptr;
 	boxssptr boxs;
 	moleculeptr *mlist;
@@ -2529,6 +2859,7 @@ enum CMDcode cmdreplacevolmol(simptr sim,cmdptr cmd,char *line2) {
 
 enum CMDcode cmdreplacecmptmol(simptr sim,cmdptr cmd,char *line2) {
 	int m,itct,i1,i2,ll,c,numl;
+	double pbuf[DIMMAX];
 	char nm[STRCHAR];
 	double frac;
 	enum MolecState ms1,ms2;
@@ -2561,7 +2892,7 @@ enum CMDcode cmdreplacecmptmol(simptr sim,cmdptr cmd,char *line2) {
 	numl=sim->mols->nl[ll];
 	for(m=0;m<numl;m++) {
 		mptr=sim->mols->live[ll][m];
-		if(mptr->ident==i1 && mptr->mstate==ms1 && posincompart(sim,mptr->pos,cmpt) && coinrandD(frac)) 
+		if(mptr->ident==i1 && mptr->mstate==ms1 && posincompart(sim,molreal2dbl(mptr->pos,pbuf,sim->dim),cmpt) && coinrandD(frac)) 
 			molchangeident(sim,mptr,ll,m,i2,ms2,mptr->pnl); }
 	return CMDok; }
 
@@ -2787,7 +3118,8 @@ enum CMDcode cmdporttransport(simptr sim,cmdptr cmd,char *line2) {
 
 enum CMDcode cmdexcludebox(simptr sim,cmdptr cmd,char *line2) {
 	int m,itct,dim,d,b,b1,b2;
-	double *pos,poslo[DIMMAX],poshi[DIMMAX];
+	double poslo[DIMMAX],poshi[DIMMAX];
+	molreal *pos;
 	boxptr bptr1,bptr2,bptr;
 	boxssptr boxs;
 	moleculeptr *mlist;
@@ -2814,13 +3146,14 @@ enum CMDcode cmdexcludebox(simptr sim,cmdptr cmd,char *line2) {
 			if(d==dim) {
 				pos=mlist[m]->posx;
 				for(d=0;d<dim;d++) if(pos[d]<poslo[d] || pos[d]>poshi[d]) d=dim+1;
-				if(d>dim) copyVD(mlist[m]->posx,mlist[m]->pos,dim); }}}
+				if(d>dim) for(d=0;d<dim;d++) mlist[m]->pos[d]=mlist[m]->posx[d]; }}}
 	return CMDok; }
 
 
 enum CMDcode cmdexcludesphere(simptr sim,cmdptr cmd,char *line2) {
 	int m,itct,dim,d,b,b1,b2;
-	double *pos,poslo[DIMMAX],poshi[DIMMAX],poscent[DIMMAX],rad,dist;
+	double poslo[DIMMAX],poshi[DIMMAX],poscent[DIMMAX],rad,dist;
+	molreal *pos;
 	boxptr bptr1,bptr2,bptr;
 	boxssptr boxs;
 	moleculeptr *mlist;
@@ -2855,12 +3188,12 @@ enum CMDcode cmdexcludesphere(simptr sim,cmdptr cmd,char *line2) {
 			if(d==dim) {
 				pos=mlist[m]->posx;
 				for(dist=0,d=0;d<dim;d++) if((dist+=(pos[d]-poscent[d])*(pos[d]-poscent[d]))>rad) d=dim+1;
-				if(d>dim) copyVD(mlist[m]->posx,mlist[m]->pos,dim); }}}
+				if(d>dim) for(d=0;d<dim;d++) mlist[m]->pos[d]=mlist[m]->posx[d]; }}}
 	return CMDok; }
 
 
 enum CMDcode cmdincludeecoli(simptr sim,cmdptr cmd,char *line2) {
-	int m,ll,nmol;
+	int m,ll,nmol,d;
 	moleculeptr *mlist;
 	double rad,length,pos[DIMMAX];
 	wallptr *wlist;
@@ -2878,7 +3211,7 @@ enum CMDcode cmdincludeecoli(simptr sim,cmdptr cmd,char *line2) {
 		nmol=sim->mols->nl[ll];
 		for(m=0;m<nmol;m++)
 			if(!insideecoli(mlist[m]->pos,pos,rad,length)) {
-				if(insideecoli(mlist[m]->posx,pos,rad,length)) copyVD(mlist[m]->posx,mlist[m]->pos,3);
+				if(insideecoli(mlist[m]->posx,pos,rad,length)) for(d=0;d<3;d++) mlist[m]->pos[d]=mlist[m]->posx[d];
 				else putinecoli(mlist[m]->pos,pos,rad,length); }}
 	return CMDok; }
 
@@ -2933,6 +3266,52 @@ void cmdv1v2free(cmdptr cmd) {
 	return; }
 
 
+/* cmdmolname.  Reads the species and state at the start of line2, which is
+argument k of cmd, and returns the same values as readmolname.  Species and "all"
+are only looked up on the command's first run and are then kept in cmd. */
+int cmdmolname(simptr sim,cmdptr cmd,int k,char *line2,enum MolecState *msptr) {
+	int i,j;
+	enum MolecState ms;
+
+	if(scmdargget(cmd,k,&i,&j)) {
+		if(msptr) *msptr=(enum MolecState) j;
+		return i; }
+	i=readmolname(sim,line2,&ms,0);
+	if(i>=0 || i==-5) scmdargset(cmd,k,i,(int)ms);
+	if(msptr) *msptr=ms;
+	return i; }
+
+
+/* cmdfindname.  Finds the name at the start of line2, which is argument k of cmd,
+in the n strings of names.  Returns its index, -1 if no name could be read, or -2
+if the name is not in the list.  A found index is kept in cmd for later runs. */
+int cmdfindname(cmdptr cmd,int k,char *line2,char **names,int n) {
+	char nm[STRCHAR];
+	int i;
+
+	if(scmdargget(cmd,k,&i,NULL)) return i;
+	if(!line2 || sscanf(line2,"%s",nm)!=1) return -1;
+	i=stringfind(names,n,nm);
+	if(i<0) return -2;
+	scmdargset(cmd,k,i,0);
+	return i; }
+
+
+/* cmdmolstate.  Reads the molecule state at the start of line2, which is argument
+k of cmd.  Returns MSnone if it cannot be read.  A valid state is kept in cmd for
+later runs. */
+enum MolecState cmdmolstate(cmdptr cmd,int k,char *line2) {
+	char nm[STRCHAR];
+	int i;
+	enum MolecState ms;
+
+	if(scmdargget(cmd,k,&i,NULL)) return (enum MolecState) i;
+	if(!line2 || sscanf(line2,"%s",nm)!=1) return MSnone;
+	ms=molstring2ms(nm);
+	if(ms!=MSnone) scmdargset(cmd,k,(int)ms,0);
+	return ms; }
+
+
 enum CMDcode conditionalcmdtype(simptr sim,cmdptr cmd,int nparam) {
 	char string[STRCHAR],*strptr;
 	enum CMDcode ans;
@@ -2948,7 +3327,7 @@ enum CMDcode conditionalcmdtype(simptr sim,cmdptr cmd,int nparam) {
 	return ans; }
 
 
-int insideecoli(double *pos,double *ofst,double rad,double length) {
+int insideecoli(molreal *pos,double *ofst,double rad,double length) {
 	double dist;
 
 	dist=(pos[1]-ofst[1])*(pos[1]-ofst[1])+(pos[2]-ofst[2])*(pos[2]-ofst[2]);
@@ -2957,7 +3336,7 @@ int insideecoli(double *pos,double *ofst,double rad,double length) {
 	return dist<rad*rad; }
 
 
-void putinecoli(double *pos,double *ofst,double rad,double length) {
+void putinecoli(molreal *pos,double *ofst,double rad,double length) {
 	double dist;
 
 	dist=(pos[1]-ofst[1])*(pos[1]-ofst[1])+(pos[2]-ofst[2])*(pos[2]-ofst[2]);
@@ -2978,7 +3357,7 @@ void putinecoli(double *pos,double *ofst,double rad,double length) {
 
 int molinpanels(simptr sim,int ll,int m,int s,char pshape) {
 	int p,ps,dim,npnl;
-	double *pos;
+	double *pos,pbuf[DIMMAX];
 	panelptr *pnls,pnl;
 
 	if(s<0) {
@@ -2991,7 +3370,7 @@ int molinpanels(simptr sim,int ll,int m,int s,char pshape) {
 	else return 0;
 	pnls=sim->srfss->srflist[s]->panels[ps];
 	npnl=sim->srfss->srflist[s]->npanel[ps];
-	pos=sim->mols->live[ll][m]->pos;
+	pos=molreal2dbl(sim->mols->live[ll][m]->pos,pbuf,dim);
 	if(pshape=='s') {
 		for(p=0;p<npnl;p++) {
 			pnl=pnls[p];
@@ -778,7 +778,7 @@ int compartupdatebox(simptr sim,compartptr cmpt,boxptr bptr,double volfrac) {
 
 	/* added for varying diffusion coef*/
 	if(cmpt->difadj){
-		printf("%s  %d%d%d\n", cmpt->cname, bptr->indx[0], bptr->indx[1], bptr->indx[2]);
+		SMOLTRACE(sim,TCsurf,TLdebug,"%s  %d%d%d\n", cmpt->cname, bptr->indx[0], bptr->indx[1], bptr->indx[2]);
 		if(!bptr->difadj){
 			bptr->difadj=(double*) calloc(sim->mols->nspecies,sizeof(double));
 			for(i=0;i<sim->mols->nspecies;i++) 
@@ -11,6 +11,8 @@
 #include <time.h>
 #include <stdio.h>
 #include "List.h"
+#include "SimEvent.h"
+#include "SimTraj.h"
 #include "smoldynconfigure.h"			// generated by CMake from smoldynconfigure.h.in
 #include <glib.h>
 #include <map>
@@ -37,8 +39,23 @@
 #define DIMMAX 3					// maximum system dimensionality
 #define VERYCLOSE 1.0e-12			// distance that's safe from round-off error
 
+#ifdef OPTION_SINGLE_PRECISION		// storage type for molecule positions; float
+	typedef float molreal;			// gives a relative error below 6e-8 per step
+	#define MOLREAL_EPSILON FLT_EPSILON
+#else
+	typedef double molreal;
+	#define MOLREAL_EPSILON DBL_EPSILON
+#endif
+
 enum StructCond {SCinit,SClists,SCparams,SCok};
 
+enum TraceCat {TCreact,TCsurf,TCcplx,TCdiffuse,TCall};
+enum TraceLevel {TLnone,TLerror,TLwarning,TLinfo,TLdebug};
+
+#ifndef TRACE_LEVEL						// highest trace level compiled in; see SMOLTRACE
+	#define TRACE_LEVEL 2
+#endif
+
 /********************************* Molecules ********************************/
 
 // #define MSMAX 5
@@ -48,6 +65,9 @@ enum StructCond {SCinit,SClists,SCparams,SCok};
 enum MolecState {MSsoln,MSfront,MSback,MSup,MSdown,MSbsoln,MSall,MSnone,MSsome,MSimmobl};
 enum MolListType {MLTsystem,MLTport,MLTnone};
 #define PDMAX 7
+#define SERNOPAGEBITS 12						// serial number index page size is 2^SERNOPAGEBITS
+#define MOLBINBLOCK 256							// molecules binned together by molhistogramslice
+#define MOLREDUCEBLOCK 1024					// molecules per partial sum in floating point reductions
 enum PatternData {PDalloc,PDnresults,PDnspecies,PDmatch,PDsubst,PDdegen,PDrule};
 
 typedef struct sitestruct{
@@ -77,40 +97,56 @@ typedef struct vchnlstruct{
 
 } *vchnlptr;
 
+typedef struct molcoldstruct {
+	double theta_init;						// initial ring orientation of complex
+	double phi_init;
+	double arrival_time;
+	struct vchnlstruct *vchannel;			// voltage data for voltage dependent species
+	double domain_t;						// exit time from protective domain
+	double domain_t0;						// time protective domain was made
+	double domain_r;						// radius of protective domain
+	struct moleculestruct **nbr;			// Verlet neighbor list [k]
+	int nnbr;								// number in nbr, -1 if no list
+	int maxnbr;								// allocated size of nbr
+	double nbrpos[DIMMAX];					// position when nbr was built [d]
+	struct boxstruct *nbrbox;				// box when nbr was built
+	} *molcoldptr;
+
+/* The fields up to sites are read for every molecule on every time step by the
+diffusion, box assignment and bimolecular reaction loops, and are kept together in
+the first 64 bytes.  Seldom used data is in the separately allocated cold part. */
 typedef struct moleculestruct {
-	// long int serno;							// serial number
-	int serno;
-	int list;									// destination list number (ll)
-	int m;
-	double *pos;								// dim dimensional vector for position [d]
-	double *posx;								// dim dimensional vector for old position [d]
-	double *via;								// location of last surface interaction [d]
-	double *posoffset;							// position offset arising from jumps [d]
 	int ident;									// species of molecule; 0 is empty (i)
 	enum MolecState mstate;			// physical state of molecule (ms)
+	int list;									// destination list number (ll)
+	int m;
+	molreal *pos;								// dim dimensional vector for position [d]
 	struct boxstruct *box;			// pointer to box which molecule is in
-	struct panelstruct *pnl;		// panel that molecule is bound to if any
+	int sites_val;
+	int complex_id;					// >0 if belongs to a complex; -1 otherwise
 	int s_index;					// subunit index
-	struct moleculestruct *from; 	// pointer in
-	struct moleculestruct *to;	  	// pointer out
 	int tot_sunit;
-	double *pos_tmp;
-	double theta_init;
-	double phi_init;
-	double sdist_init;				// distance between current subunit and its 'to' neighbor
-	double sdist_tmp;
-	double* prev_pos;				// record positions before the latest updated pos, usd for calculating pos_offset
-	int complex_id;					// >0 if belongs to a complex; -1 otherwise
+	struct moleculestruct *to;	  	// pointer out
 	siteptr *sites;
-	int sites_val;
-	int sites_valx;
+	long int serno;							// serial number
+	int bind_id;
+	molreal *posx;								// dim dimensional vector for old position [d]
+	struct moleculestruct *from; 	// pointer in
 	struct moleculestruct *dif_molec;
+	molreal *pos_tmp;							// owned position storage; pos may point to a binding partner's
+	double sim_time;
+	int sites_valx;
 	int dif_site;
+	int domain_i;							// index in domain heap, -1 if not in a domain, -2 if due for one
+	int tally;								// slot counted in spcount, -1 if none
+	double sdist_init;				// distance between current subunit and its 'to' neighbor
+	double sdist_tmp;
+	struct panelstruct *pnl;		// panel that molecule is bound to if any
+	double *via;								// location of last surface interaction [d]
+	double *posoffset;							// position offset arising from jumps [d]
+	molreal *prev_pos;				// record positions before the latest updated pos, usd for calculating pos_offset
 	// double adj_prob;				// accumulated probability of an upcoming rxn in a time step accounted for preccedingly occurred reactions on a molecule
-	double sim_time;
-	struct vchnlstruct *vchannel;	
-	double arrival_time;
-	int bind_id;
+	molcoldptr cold;				// rarely used data
 } *moleculeptr;
 
 typedef struct complexstruct{
@@ -121,8 +157,44 @@ typedef struct complexstruct{
 	int dif_bind_site;
 	int diffuse_updated;
 	int layer;
+	int nlive;								// number of living subunits
+	int livei;								// index in complexlive, -1 if released
+	int *connect;							// ids of complexes bound to this one [k]
+	int nconnect;							// number of ids in connect
+	int maxconnect;							// allocated size of connect
 } *complexptr;
 
+typedef struct clusterstruct {
+	int maxnode;							// allocated size of node arrays
+	int nnode;								// number of nodes; complex ids come first
+	int *parent;							// union-find parent, self for roots [node]
+	int *size;								// number of molecules in each root's cluster [node]
+	GHashTable *single;						// node of each bound molecule outside complexes
+	int nmol;								// number of molecules analyzed
+	int ncluster;							// number of clusters, including lone molecules
+	int maxsize;							// number of molecules in largest cluster
+	int *sizerow;							// row of bysize for each cluster size [s]
+	int maxsizerow;							// allocated size of sizerow
+	int nrow;								// number of distinct cluster sizes
+	int *bysize;							// size, count, then species totals [r*(nspecies+2)+j]
+	int maxbysize;							// allocated size of bysize
+	moleculeptr *member;					// members of clusters of 2 or more, by root [k]
+	int maxmember;							// allocated size of member
+	} *clusterptr;
+
+typedef struct censusitemstruct {
+	int i;									// species, or -1 for all
+	enum MolecState ms;						// state, or MSall for all
+	int nbin[DIMMAX];						// histogram bins on each axis, 0 for moments
+	double low[DIMMAX];						// histogram low edges, or moment origin
+	double high[DIMMAX];					// histogram high edges
+	double scale[DIMMAX];					// histogram bins per unit length
+	int ntot;								// number of bins or moment sums
+	int offset;								// start in census or censusmom
+	int need;								// 1 if an observer needs it in this sweep
+	int bybin;								// 1 if threads list bins instead of private copies
+	} *censusitemptr;
+
 /*
 typedef struct difadjstruct{
 	int molec_ident;
@@ -166,15 +238,65 @@ typedef struct molsuperstruct {
 	int *nl;								// number of molecules in live lists [ll]
 	int *topl;								// live list index; above are reborn [ll]
 	int *sortl;								// live list index; above need sorting [ll]
+	int **chglog;							// live list slots changed since last sort [ll][k]
+	int *nchglog;							// entries in chglog, -1 if overflowed [ll]
+	int *maxchglog;							// allocated size of chglog [ll]
 	int *diffuselist;						// 1 if any listed molecs diffuse [ll]
+	int *substep;							// list diffuses every substep-th step [ll]
+	int *stepdue;							// 1 if list diffuses on current step [ll]
+	long int substepct;						// time steps diffused, for substep
+	int resortinterval;						// steps between spatial resorts, 0 for never
+	int resortct;							// steps since last spatial resort
 	long int serno;							// serial number for next resurrected molec.
+	moleculeptr **sernopage;				// live molecules by serial number [pg][serno]
+	int *sernopagect;						// number of molecules in each page [pg]
+	long int maxsernopage;					// allocated size of sernopage
 	int ngausstbl;							// number of elements in gausstbl
-	double *gausstbl;						// random numbers for diffusion
+	molreal *gausstbl;						// random numbers for diffusion
 	int *expand;							// whether species expand with libmzr [i]
-
-	complexptr *complexlist;				
-	int ncomplex;
-	int max_complex;
+	int *spcount;							// running counts of molecules [i*MSMAX+ms]
+	double *gfrdrmax;						// max protective domain radius, 0 for none [i]
+	double *gfrdbind;						// largest binding radius with any partner [i]
+	moleculeptr *gfrdheap;					// molecules in domains, heap on exit time [k]
+	int ngfrd;								// number of molecules in domains
+	int maxgfrd;							// allocated size of gfrdheap
+	moleculeptr *gfrddue;					// molecules waiting for a domain [k]
+	int ngfrddue;							// number of molecules waiting for a domain
+	int maxgfrddue;							// allocated size of gfrddue
+	double *nbrcut;							// neighbor list cutoff, 0 for none [i]
+	double *nbrskin;						// neighbor list skin distance [i]
+	int *nbronly;							// 1 if all binding partners have lists [i]
+	int nbrvalid;							// 1 if neighbor lists are current
+	moleculeptr *nbrbuf;					// scratch space for list filtering
+	int maxnbrbuf;							// allocated size of nbrbuf
+	int censusok;							// 1 if census matches current molecules
+	int censusplan;							// 1 while due observers register census needs
+	int *census;							// counts by census slot, species, state [slot][i][ms]
+	int ncensus;							// allocated size of census
+	int *censuscmpt;						// census slot of compartment [c], 0 if not swept
+	int maxcensuscmpt;						// allocated size of censuscmpt
+	censusitemptr censusitem;				// histograms and moments in census [q]
+	int ncensusitem;						// number of census items
+	int maxcensusitem;						// allocated size of censusitem
+	double *censusmom;						// moments as count, mean, covariance [offset+k]
+	int ncensusmom;							// allocated size of censusmom
+	int *censusbin;							// census indices listed by threads [k]
+	int maxcensusbin;						// allocated size of censusbin
+	int *censusbinn;						// start and number in censusbin [2*t+j]
+	int maxcensusbinn;						// allocated size of censusbinn
+	int *redint;							// per-thread private counts for reductions
+	int maxredint;							// allocated size of redint
+	double *reddbl;						// per-block partial sums for reductions
+	int maxreddbl;							// allocated size of reddbl
+
+	complexptr *complexlist;				// complexes, indexed by complex_id [id]
+	int ncomplex;							// number of complex ids ever handed out
+	int max_complex;						// allocated size of complex arrays
+	int *freecomplex;						// stack of released complex ids
+	int nfreecomplex;						// number of ids on freecomplex
+	int *complexlive;						// dense list of registered ids [k]
+	int nlivecomplex;						// number of registered complexes
+	int complexserno;						// serial number for next complex
 	char ***spsites_name;					// all sites regardless which species	
 	int *spsites_num;						// max sites for each species
 	int **spsites_binding;					// whether a pariticular site allows bindings or not
@@ -182,6 +304,7 @@ typedef struct molsuperstruct {
 	// int max_sites;
 	GHashTable* spdifsites;			
 	GHashTable* complex_connect;		
+	clusterptr clusters;					// complex connectivity scratch, or NULL
 	int **Mlist;							// indices for shuffling molecular list
 
 } *molssptr;
@@ -255,6 +378,8 @@ typedef struct rxnstruct {
 	double unbindrad;						// unbinding radius, if appropriate
 	double **prdpos;							// product position vectors [prd][d]
 	int disable;								// 1 if reaction is disabled
+	int logevents;							// 1 if reaction goes to binary event log
+	double intrarate;							// rate between neighboring complex subunits, 0 if spatial
 	struct compartstruct *cmpt;					// compartment reaction occurs in, or NULL
 	struct surfacestruct *srf;					// surface reaction on, or NULL
 } *rxnptr;
@@ -277,9 +402,16 @@ typedef struct rxnsuperstruct {
 	//GHashTable *rmaps;				// rxn->rmap now moves to rxnss
 	//GHashTable *rmaps_adj;
 	GHashTable *radius;
+	int rxnstep;					// time steps that radius and bindrad_eff are for
+	int nstepcache;					// number of time step caches
+	int *stepcachek;				// time steps of cache [c]
+	GHashTable **stepradius;		// radius cache for cache [c]
+	GHashTable **stepbindrad;		// bindrad_eff cache for cache [c]
 	GHashTable *rxnr_ptr;
 	GHashTable *rxn_ord1st;
 	int **binding;					// for 2 moleculed reactions only
+	int **intra;					// 1 if species pair reacts inside complexes [i][j]
+	int maxintra;					// allocated size of intra
 	
 	int maxrxn;						// allocated number of reactions
 	int totrxn;						// total number of reactions listed
@@ -387,10 +519,11 @@ typedef struct interface_struct{
 
 typedef struct boxstruct {
 	int *indx;									// dim dimensional index of the box [d]
+	int adrs;										// flat address of the box in blist
 	int nneigh;									// number of neighbors in list
 	int midneigh;								// logical middle of neighbor list
-	struct boxstruct **neigh;					// all box neighbors, using sim. accuracy
-	int *wpneigh;								// wrapping code of neighbors in list
+	struct boxstruct **neigh;					// all box neighbors, using sim. accuracy (in neighpool)
+	int *wpneigh;								// wrapping code of neighbors in list (in wppool)
 	int nwall;									// number of walls in box
 	wallptr *wlist;							// list of walls that cross the box
 	int maxpanel;								// allocated number of panels in box
@@ -415,6 +548,18 @@ typedef struct boxsuperstruct {
 	double *min;								// position vector for low corner of space
 	double *size;								// length of each side of a box
 	boxptr *blist; 							// actual array of boxes
+	int *stride;								// flat address stride along each axis [d]
+	int nstencil;								// number of offsets in neighbor stencil
+	int midstencil;							// stencil offsets before this are the half shell
+	int *stencil;								// flat address offsets of interior box neighbors [k]
+	boxptr *neighpool;					// shared storage for box neighbor lists
+	int *wppool;								// shared storage for neighbor wrapping codes
+	boxptr *newbox;							// scratch space for box reassignment
+	int maxnewbox;							// allocated size of newbox
+	int tuneinterval;						// time steps between box size tuning, 0 for none
+	int tunect;									// time steps since last tuning
+	int *tunecount;							// scratch occupancy counts for tuning
+	int maxtunecount;						// allocated size of tunecount
 	} *boxssptr;
 
 /******************************* Compartments *******************************/
@@ -642,9 +787,9 @@ typedef struct graphicssuperstruct {
 
 /******************************** Simulation *******************************/
 
-#define ETMAX 10
+#define ETMAX 11
 enum SmolStruct {SSmolec,SSwall,SSrxn,SSsurf,SSbox,SScmpt,SSport,SSfilament,SScmd,SSsim,SScheck,SSall,SSnone};
-enum EventType {ETwall,ETsurf,ETdesorb,ETrxn0,ETrxn1,ETrxn2intra,ETrxn2inter,ETrxn2wrap,ETimport,ETexport};
+enum EventType {ETwall,ETsurf,ETdesorb,ETrxn0,ETrxn1,ETrxn2intra,ETrxn2inter,ETrxn2wrap,ETrxn2cplx,ETimport,ETexport};
 
 typedef int (*diffusefnptr)(struct simstruct *);
 typedef int (*surfaceboundfnptr)(struct simstruct *,int);	
@@ -661,6 +806,10 @@ typedef struct simstruct {
 	enum StructCond condition;	// structure condition
 	char *vfile;
 	FILE *events;							// record reaction events	
+	eventlogptr eventlog;				// binary event log, or NULL
+	int logrxnevents;						// logevents value for new reactions
+	FILE *endtraj;							// file for final trajectory frame, or NULL
+	enum TrajCodec endtrajcodec;	// compression for final trajectory frame
 	FILE *logfile;							// file to send output
 	char *filepath;							// configuration file path
 	char *filename;							// configuration file name
@@ -676,6 +825,11 @@ typedef struct simstruct {
 	double tmax;								// simulation end time
 	double tbreak;							// simulation break time
 	double dt;									// simulation time step
+	double dtmin;								// adaptive time step lower bound, 0 if off
+	double dtmax;								// adaptive time step upper bound
+	double dtevents;						// target events per molecule per step
+	int dtevent0;								// event total at previous step
+	int nthreads;								// threads for per-molecule loops, 0 for serial
 	rxnssptr rxnss[MAXORDER+MAXORDER-1];		// reaction superstructures, used to be rxnss[MAXORDER]
 	molssptr mols;							// molecule superstructure
 	wallptr *wlist;							// list of walls
@@ -36,6 +36,40 @@ extern char SimFlags[];
 
 extern int VCellDefined;
 
+extern int TraceThreshold[];
+
+/* SMOLTRACE(sim,cat,level,...) sends a diagnostic message in category cat, which
+is an enum TraceCat, at level, which is an enum TraceLevel.  Messages above
+TRACE_LEVEL are removed by the compiler, including evaluation of their arguments,
+and the rest are filtered at run time by the trace statement.  SMOLTRACEON is the
+same test, for guarding diagnostic code that is more than a message.  SMOLPRINTF
+marks printf-style functions, so that GCC and Clang check their arguments. */
+#if TRACE_LEVEL>0
+	#define SMOLTRACEON(cat,level)				((level)<=TRACE_LEVEL && (level)<=TraceThreshold[cat])
+#else
+	#define SMOLTRACEON(cat,level)				0
+#endif
+#define SMOLTRACE(sim,cat,level,...)	do {if(SMOLTRACEON(cat,level)) simTrace(sim,cat,level,__VA_ARGS__);} while(0)
+
+#if defined(__GNUC__)
+	#define SMOLPRINTF(fmt,args)				__attribute__((format(printf,fmt,args)))
+#else
+	#define SMOLPRINTF(fmt,args)
+#endif
+
+/* molreal2dbl returns the molecule coordinate vector x, which is stored as
+molreal, as a double vector for functions that take double*.  With double
+precision storage this is x itself; otherwise x is copied into buf, which needs
+dim elements.  dbl2molreal copies a vector from molreal2dbl back into x, after
+a function changed it. */
+#ifdef OPTION_SINGLE_PRECISION
+	double *molreal2dbl(const molreal *x,double *buf,int dim);
+	void dbl2molreal(const double *buf,molreal *x,int dim);
+#else
+	#define molreal2dbl(x,buf,dim)				((void)(buf),(void)(dim),(x))
+	#define dbl2molreal(buf,x,dim)				(void)0
+#endif
+
 
 /********************************* Molecules *******************************/
 
@@ -64,13 +98,25 @@ void molsetcolor(simptr sim,int ident,int *index,enum MolecState ms,double *colo
 void molsetlistlookup(simptr sim,int ident,int *index,enum MolecState ms,int ll);
 void molsetexist(simptr sim,int ident,enum MolecState ms,int exist);
 int molcount(simptr sim,int i,int *index,enum MolecState ms,boxptr bptr,int max);
+void molcensusreset(molssptr mols);
+int molcensuscmpt(simptr sim,int c);
+int molcensusitem(simptr sim,int i,enum MolecState ms,const double *low,const double *high,const int *nbin);
+int *molcensus(simptr sim,int c);
+int molreducethreads(simptr sim);
+int *molreduceint(simptr sim,int n);
+void molreducemerge(simptr sim,int n,int *ct);
+double *molreducedbl(simptr sim,int n);
+int molcensushist(simptr sim,int i,enum MolecState ms,const double *low,const double *high,const int *nbin,int *ct);
+int molmoments(simptr sim,int i,enum MolecState ms,double *mean,double *cov);
+int moltrajframe(simptr sim,trajframeptr frame,int i,enum MolecState ms,compartptr cmpt,int unwrap);
+clusterptr molclusters(simptr sim,int members);
 int molcount_cplx(simptr sim,int i,int *index,enum MolecState ms,boxptr bptr,int max);
 // double MolCalcDifcSum(simptr sim,int i1,enum MolecState ms1,int i2,enum MolecState ms2);
 double MolCalcDifcSum(simptr sim,moleculeptr mptr1,moleculeptr mptr2,double *dc1, double *dc2);
 void molfree(simptr sim, moleculeptr mptr);
 int molexpandlist(molssptr mols, int dim, int ll, int nspace, int nmolecs);
-int boundarytest(simptr sim, double *pos);
-double molec_distance(simptr sim, double *pos1, double *pos2);
+int boundarytest(simptr sim, molreal *pos);
+double molec_distance(simptr sim, molreal *pos1, molreal *pos2);
 void rotation_compensate(double rotation_mtrx1[3][3], double rotation_mtrx2[3][3], double *vec, double *r_vec);
 void rotation_update(double rotation_mtrx[3][3], int rotation_dim, double angle);
 void inv3by3(double result[3][3], double m[3][3]);
@@ -80,6 +126,7 @@ int moladdsites(simptr sim, char *species, char *site_name, int sitecode);
 int moldifsites(simptr sim, char *species, char *site_name);
 int syncpos(molssptr mols, moleculeptr mptr, int site, double *offset);
 int molecsites_state(molssptr mols, moleculeptr mptr);
+void molsitesupdate(molssptr mols,moleculeptr mptr);
 
 // memory management
 void molssfree(molssptr mols,int maxsrf);
@@ -96,18 +143,31 @@ int molenablemols(simptr sim,int maxspecies);
 void molsetcondition(molssptr mols,enum StructCond cond,int upgrade);
 int addmollist(simptr sim,const char *nm,enum MolListType mlt);
 int molsetmaxmol(simptr sim,int max);
+int molsetresort(simptr sim,int interval);
+int molsetlistsubstep(simptr sim,int ll,int substep);
+int molsetnbrlist(simptr sim,int i,double cutoff,double skin);
+void molnbrstale(molssptr mols,int i1,int i2);
 int moladdspecies(simptr sim,const char *nm);
 int molsetexpansionflag(simptr sim,int i,int flag);
 int molsupdate(simptr sim);
 
 // adding and removing molecules
+int molsernoinsert(molssptr mols,moleculeptr mptr);
+void molsernoremove(molssptr mols,moleculeptr mptr);
+moleculeptr molfindserno(molssptr mols,long int serno);
+int complexregister(molssptr mols,int sunit);
+void complexrelease(molssptr mols,int id);
+int complexconnect(molssptr mols,int id1,int id2,int value1,int value2);
+void complexdisconnect(molssptr mols,int id1,int id2);
+void moltally(molssptr mols,moleculeptr mptr);
+void mollistlog(molssptr mols,moleculeptr mptr,int ll,int m);
 void molkill(simptr sim,moleculeptr mptr,int ll,int m);
 moleculeptr getnextmol(molssptr mols);
 moleculeptr getnextmol_cplx(molssptr mols, int sunit, int ident);
 int addmol_cplx(simptr sim,int nmol,int sunit,int bind_num,int *ident,int *sites,double *poslo,double *poshi,int sort,int ident_free, int sites_free);
 int addsurfmol_cplx(simptr sim,int nmol,int sunit,int bind_num,int *ident,int *sites,enum MolecState ms,double *pos,panelptr pnl,int surface,enum PanelShape ps,char *pname);
 int addcompartmol_cplx(simptr sim,int nmol,int sunit,int bind_num,int *ident,int *sites,compartptr cmpt);
-int updatecompartmol_cplx(simptr sim,int serno,int bind_num,int *ident,int *sites,compartptr cmpt);
+int updatecompartmol_cplx(simptr sim,long int serno,int bind_num,int *ident,int *sites,compartptr cmpt);
 
 moleculeptr getnextmol(molssptr mols);
 int addmol(simptr sim,int nmol,int ident,double *poslo,double *poshi,int sort);
@@ -117,6 +177,8 @@ int addcompartmol(simptr sim,int nmol,int ident,compartptr cmpt);
 // core simulation functions
 void moldosurfdrift2D(simptr sim,moleculeptr mptr,double dt);
 int molsort(simptr sim,int onlydead2live);
+long int molmortonkey(simptr sim,molreal *pos);
+int molspatialsort(simptr sim,int force);
 int diffuse(simptr sim);
 
 //complex subunits cplx
@@ -178,6 +240,7 @@ int rxnsetrate(simptr sim,int order,int r,char* estr);
 // structure set up
 void rxnsetcondition(simptr sim,int order,enum StructCond cond,int upgrade);
 int RxnSetValue(simptr sim,const char *option,rxnptr rxn,double value);
+int RxnSetIntraComplex(simptr sim,rxnptr rxn,double rate);
 int RxnSetRevparam(simptr sim,rxnptr rxn,enum RevParam rparamt,double rparam,int prd,double *pos,int dim);
 // void RxnSetPermit(simptr sim,rxnptr rxn,int order,enum MolecState *rctstate,int value);
 void RxnSetPermit(simptr sim, rxnptr rxn, int value);
@@ -203,6 +266,7 @@ int doreact(rxnssptr rxnss,gpointer rptr,moleculeptr mptr1,moleculeptr mptr2,int
 int zeroreact(simptr sim);
 int unireact(simptr sim);
 int bireact(simptr sim,int neigh);
+int intracplxreact(simptr sim);
 
 /********************************* Surfaces *********************************/
 
@@ -263,6 +327,7 @@ int ptinpanel(double *pt,panelptr pnl,int dim);
 enum SrfAction surfaction(surfaceptr srf,enum PanelFace face,int ident,enum MolecState ms,int *i2ptr,enum MolecState *ms2ptr);
 int rxnXsurface(simptr sim,moleculeptr mptr1,moleculeptr mptr2,int rxn_site_indx1,int rxn_site_indx2);
 void fixpt2panel(double *pt,panelptr pnl,int dim,enum PanelFace face,double epsilon);
+void fixmolpt2panel(molreal *pt,panelptr pnl,int dim,enum PanelFace face,double epsilon);
 double closestsurfacept(surfaceptr srf,int dim,double *testpt,double *pnlpt,panelptr *pnlptr);
 void movemol2closepanel(simptr sim,moleculeptr mptr,int dim,double epsilon,double neighdist,double margin);
 // int checksurfaces1mol(simptr sim,moleculeptr mptr);
@@ -289,11 +354,13 @@ int checkboxparams(simptr sim,int *warnptr);
 // structure set up
 void boxsetcondition(boxssptr boxs,enum StructCond cond,int upgrade);
 int boxsetsize(simptr sim,const char *info,double val);
+int boxsettune(simptr sim,int interval);
 int boxesupdate(simptr sim);
 
 // core simulation functions
 boxptr line2nextbox(simptr sim,double *pt1,double *pt2,boxptr bptr);
 int reassignmolecs(simptr sim,int diffusing,int reborn);
+int boxestune(simptr sim);
 
 /******************************* Compartments *******************************/
 
@@ -343,7 +410,7 @@ int portsupdate(simptr sim);
 
 // core simulation functions
 int portgetmols(simptr sim,portptr port,int ident,enum MolecState ms,int remove);
-int portgetmols2(simptr sim,portptr port,int ident,enum MolecState ms,int remove,double **positions);
+int portgetmols2(simptr sim,portptr port,int ident,enum MolecState ms,int remove,molreal **positions);
 int portputmols(simptr sim,portptr port,int nmol,int ident,int *species,double **positions);
 int portputmols2(simptr sim,portptr port,int nmol,int ident,int *species,double **positions,double **positionsx);
 int porttransport(simptr sim1,portptr port1,simptr sim2,portptr port2);
@@ -396,6 +463,18 @@ int filsupdate(simptr sim);
 // core simulation functions
 int filDynamics(simptr sim);
 
+/************************* Green's function domains *************************/
+
+// structure setup
+int molsetgfrd(simptr sim,int i,double rmax);
+
+// core simulation functions
+void gfrdremove(molssptr mols,moleculeptr mptr);
+int gfrdmarkdue(molssptr mols,moleculeptr mptr);
+int gfrdreset(molssptr mols,moleculeptr mptr);
+int gfrdburstall(simptr sim);
+int gfrdupdate(simptr sim);
+
 /********************************* BioNetGen ********************************/
 
 // data structure output
@@ -447,6 +526,7 @@ void smolsimulategl(simptr sim);
 
 /********************************* Commands *********************************/
 
+void cmdcensusplan(simptr sim,int donow);
 enum CMDcode docommand(void *cmdfnarg,cmdptr cmd,char *line);
 
 /******************************** Simulation ********************************/
@@ -455,9 +535,13 @@ enum CMDcode docommand(void *cmdfnarg,cmdptr cmd,char *line);
 void simSetLogging(FILE *logfile,void (*logFunction)(simptr,int,const char*, ...));
 void simSetThrowing(int corethreshold);
 void simLog(simptr sim,int importance,const char* format, ...);
+void simTrace(simptr sim,enum TraceCat cat,enum TraceLevel level,const char* format, ...) SMOLPRINTF(4,5);
+int simsettrace(enum TraceCat cat,enum TraceLevel level);
 void simParseError(simptr sim,ParseFilePtr pfp);
 
 // enumerated types
+enum TraceCat simstring2tc(const char *string);
+enum TraceLevel simstring2tl(const char *string);
 enum SmolStruct simstring2ss(char *string);char *simsc2string(enum StructCond sc,char *string);
 
 // low level utilities
@@ -489,8 +573,15 @@ int simupdate(simptr sim);
 #endif
 int simUpdateAndDisplay(simptr sim);
 
+// binary event log
+int simeventopen(simptr sim,const char *fname,int maxbuf);
+void simeventlog(simptr sim,enum EventRecType type,rxnptr rxn,int r,moleculeptr mptr1,moleculeptr mptr2,int site1,int site2,double value);
+void simeventclose(simptr sim);
+int simendtraj(simptr sim);
+
 // core simulation functions
 int simdocommands(simptr sim);
+int simadapttimestep(simptr sim);
 int simulatetimestep(simptr sim);
 void endsimulate(simptr sim,int er);
 int smolsimulate(simptr sim);
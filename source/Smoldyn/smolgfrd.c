@@ -0,0 +1,463 @@
+/* Steven Andrews, started 10/22/2001.
+ This is a library of functions for the Smoldyn program.
+ See documentation called Smoldyn_doc1.pdf and Smoldyn_doc2.pdf, and the Smoldyn
+ website, which is at www.smoldyn.org.
+ Copyright 2003-2013 by Steven Andrews.  This work is distributed under the terms
+ of the Gnu Lesser General Public License (LGPL). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "math2.h"
+#include "random2.h"
+#include "Rn.h"
+#include "smoldyn.h"
+#include "smoldynfuncs.h"
+
+/******************************************************************************/
+/************************* Green's function domains ***************************/
+/******************************************************************************/
+
+/* An isolated molecule of a species with gfrdrmax>0 is given a spherical
+protective domain that contains no other molecule, wall or surface panel.  It is
+then frozen at the domain center, skipped by diffuse(), and an exact first-exit
+time is drawn from the Green's function for free diffusion in a sphere.  At that
+time it is placed on the sphere surface and resumes ordinary Brownian dynamics.
+If another molecule enters the domain first, the domain is burst and the
+molecule is placed at a position sampled for the elapsed time.  Domains are
+kept in a heap ordered by exit time.  Only freely diffusing molecules can enter
+a domain, so bursts are found by checking them against nearby domains.  Molecules
+of domain species that are not in a domain are kept in a due list, and only those
+are considered for new domains.  Only 3D is supported. */
+
+#define GFRDMINSTEPS 4				// minimum domain radius in rms diffusion steps
+
+/******************************************************************************/
+/****************************** Local declarations ****************************/
+/******************************************************************************/
+
+double gfrdsurvival(double tau);
+double gfrdexittime(void);
+double gfrdradialcdf(double x,double tau);
+double gfrdburstradius(double tau);
+void gfrdheapup(molssptr mols,int k);
+void gfrdheapdown(molssptr mols,int k);
+int gfrdpush(molssptr mols,moleculeptr mptr);
+double gfrdclearance(simptr sim,moleculeptr mptr,double rmax,int creating);
+int gfrdintruder(simptr sim,moleculeptr mptr);
+void gfrdplace(simptr sim,moleculeptr mptr,double *v);
+void gfrdburst(simptr sim,moleculeptr mptr,double t);
+
+
+/******************************************************************************/
+/****************************** low level utilities ***************************/
+/******************************************************************************/
+
+/* gfrdsurvival.  Returns the probability that a molecule that started at the
+center of a sphere of unit radius has not left it by dimensionless time tau=Dt/R^2. */
+double gfrdsurvival(double tau) {
+	double sum,term;
+	int n;
+
+	if(tau<1e-3) return 1.0;
+	sum=0;
+	for(n=1;n<200;n++) {
+		term=exp(-n*n*PI*PI*tau);
+		sum+=(n%2)?term:-term;
+		if(term<1e-14) break; }
+	return 2.0*sum; }
+
+
+/* gfrdexittime.  Samples a dimensionless first-exit time tau from the unit sphere
+by inverting the survival function with bisection. */
+double gfrdexittime(void) {
+	double u,lo,hi,mid;
+	int it;
+
+	u=unirandOOD(0,1);
+	lo=1e-3;
+	hi=1.0;
+	while(gfrdsurvival(hi)>u) hi*=2;
+	for(it=0;it<50;it++) {
+		mid=0.5*(lo+hi);
+		if(gfrdsurvival(mid)>u) lo=mid;
+		else hi=mid; }
+	return 0.5*(lo+hi); }
+
+
+/* gfrdradialcdf.  Returns the probability that a molecule that started at the
+center of a sphere of unit radius is within radius x at dimensionless time tau,
+and has not left the sphere before then.  Dividing by gfrdsurvival(tau) gives the
+radial distribution conditioned on survival. */
+double gfrdradialcdf(double x,double tau) {
+	double sum,term,a;
+	int n;
+
+	sum=0;
+	for(n=1;n<200;n++) {
+		term=exp(-n*n*PI*PI*tau);
+		a=n*PI*x;
+		sum+=term*(sin(a)-a*cos(a))/n;
+		if(term<1e-14) break; }
+	return 2.0*sum/PI; }
+
+
+/* gfrdburstradius.  Samples the dimensionless distance from the center of a unit
+sphere for a molecule that started at the center and is known to still be inside
+it at dimensionless time tau.  Returns -1 if tau is so small that the sphere edge
+is irrelevant, in which case the caller should use free diffusion. */
+double gfrdburstradius(double tau) {
+	double u,lo,hi,mid;
+	int it;
+
+	if(tau<1e-3) return -1;
+	u=unirandOOD(0,1)*gfrdsurvival(tau);
+	lo=0;
+	hi=1;
+	for(it=0;it<50;it++) {
+		mid=0.5*(lo+hi);
+		if(gfrdradialcdf(mid,tau)<u) lo=mid;
+		else hi=mid; }
+	return 0.5*(lo+hi); }
+
+
+/* gfrdheapup */
+void gfrdheapup(molssptr mols,int k) {
+	moleculeptr *heap,mptr;
+	int parent;
+
+	heap=mols->gfrdheap;
+	mptr=heap[k];
+	while(k>0) {
+		parent=(k-1)/2;
+		if(heap[parent]->cold->domain_t<=mptr->cold->domain_t) break;
+		heap[k]=heap[parent];
+		heap[k]->domain_i=k;
+		k=parent; }
+	heap[k]=mptr;
+	mptr->domain_i=k;
+	return; }
+
+
+/* gfrdheapdown */
+void gfrdheapdown(molssptr mols,int k) {
+	moleculeptr *heap,mptr;
+	int child,n;
+
+	heap=mols->gfrdheap;
+	n=mols->ngfrd;
+	mptr=heap[k];
+	while((child=2*k+1)<n) {
+		if(child+1<n && heap[child+1]->cold->domain_t<heap[child]->cold->domain_t) child++;
+		if(mptr->cold->domain_t<=heap[child]->cold->domain_t) break;
+		heap[k]=heap[child];
+		heap[k]->domain_i=k;
+		k=child; }
+	heap[k]=mptr;
+	mptr->domain_i=k;
+	return; }
+
+
+/* gfrdpush */
+int gfrdpush(molssptr mols,moleculeptr mptr) {
+	moleculeptr *newheap;
+	int k,newmax;
+
+	if(mols->ngfrd==mols->maxgfrd) {
+		newmax=2*mols->maxgfrd+16;
+		newheap=(moleculeptr*) calloc(newmax,sizeof(moleculeptr));
+		if(!newheap) return 1;
+		for(k=0;k<mols->ngfrd;k++) newheap[k]=mols->gfrdheap[k];
+		free(mols->gfrdheap);
+		mols->gfrdheap=newheap;
+		mols->maxgfrd=newmax; }
+	mols->gfrdheap[mols->ngfrd]=mptr;
+	gfrdheapup(mols,mols->ngfrd++);
+	return 0; }
+
+
+/* gfrdremove.  Takes mptr out of the domain heap, or off the due list, leaving its
+position as is.  Does nothing if mptr is in neither. */
+void gfrdremove(molssptr mols,moleculeptr mptr) {
+	moleculeptr mptr2;
+	int k;
+
+	k=mptr->domain_i;
+	if(k<0) {
+		mptr->domain_i=-1;												// stale due list entries are dropped later
+		return; }
+	mptr->domain_i=-1;
+	if(k==--mols->ngfrd) return;
+	mptr2=mols->gfrdheap[mols->ngfrd];
+	mols->gfrdheap[k]=mptr2;
+	gfrdheapup(mols,k);
+	gfrdheapdown(mols,mptr2->domain_i);
+	return; }
+
+
+/* gfrdmarkdue.  Adds mptr to the list of molecules that are waiting for a domain,
+unless it is already in a domain or on the list.  Returns 0 for success or 1 for
+out of memory. */
+int gfrdmarkdue(molssptr mols,moleculeptr mptr) {
+	moleculeptr *newdue;
+	int k,newmax;
+
+	if(mptr->domain_i!=-1) return 0;
+	if(mols->ngfrddue==mols->maxgfrddue) {
+		newmax=2*mols->maxgfrddue+16;
+		newdue=(moleculeptr*) calloc(newmax,sizeof(moleculeptr));
+		if(!newdue) return 1;
+		for(k=0;k<mols->ngfrddue;k++) newdue[k]=mols->gfrddue[k];
+		free(mols->gfrddue);
+		mols->gfrddue=newdue;
+		mols->maxgfrddue=newmax; }
+	mols->gfrddue[mols->ngfrddue++]=mptr;
+	mptr->domain_i=-2;
+	return 0; }
+
+
+/* gfrdreset.  Called when mptr has changed species or state, or has bound to
+another molecule, which its domain, if it had one, was not built for.  Takes it
+out of the domain, leaving it at the domain center, and puts it on the due list
+if it may get a new domain.  Returns 0 for success or 1 for out of memory. */
+int gfrdreset(molssptr mols,moleculeptr mptr) {
+	if(mptr->domain_i>=0) gfrdremove(mols,mptr);
+	if(mptr->ident>0 && mols->gfrdrmax[mptr->ident]>0 && mptr->mstate==MSsoln)
+		return gfrdmarkdue(mols,mptr);
+	return 0; }
+
+
+/* gfrdclearance.  Returns the radius of the largest protective domain around mptr,
+up to rmax, that keeps clear of walls, of other domains, and of every other
+molecule in its box and the neighboring boxes.  Molecules and other domains also
+have to stay a binding radius, gfrdbind, beyond the domain edge, since they react
+with the frozen molecule at the domain center.  When creating a domain, only half
+the distance to freely diffusing molecules is used, so they do not burst it at
+once.  Returns 0 if mptr is near a panel. */
+double gfrdclearance(simptr sim,moleculeptr mptr,double rmax,int creating) {
+	boxptr bptr,bptr2;
+	moleculeptr mptr2;
+	int b,d,ll,m,nlist;
+	double r,dist,bind,*pos,pbuf[DIMMAX],pbuf2[DIMMAX];
+
+	bptr=mptr->box;
+	if(!bptr || bptr->npanel) return 0;
+	pos=molreal2dbl(mptr->pos,pbuf,sim->dim);
+	bind=sim->mols->gfrdbind[mptr->ident];
+	r=rmax;
+	for(d=0;d<sim->dim;d++) {
+		if(sim->boxs->size[d]-bind<r) r=sim->boxs->size[d]-bind;
+		if(pos[d]-sim->wlist[2*d]->pos<r) r=pos[d]-sim->wlist[2*d]->pos;
+		if(sim->wlist[2*d+1]->pos-pos[d]<r) r=sim->wlist[2*d+1]->pos-pos[d]; }
+
+	nlist=sim->mols->nlist;
+	for(b=-1;b<bptr->nneigh;b++) {
+		bptr2=(b<0)?bptr:bptr->neigh[b];
+		if(bptr2->npanel) return 0;
+		for(ll=0;ll<nlist;ll++)
+			for(m=0;m<bptr2->nmol[ll];m++) {
+				mptr2=bptr2->mol[ll][m];
+				if(mptr2==mptr) continue;
+				dist=distanceVVD(pos,molreal2dbl(mptr2->pos,pbuf2,sim->dim),sim->dim)-bind;
+				if(mptr2->domain_i>=0) dist-=mptr2->cold->domain_r;
+				else if(creating) dist*=0.5;
+				if(dist<r) r=dist; }}
+	return r; }
+
+
+/* gfrdintruder.  Checks whether freely diffusing molecule mptr is inside any
+domain in its box or the neighboring boxes, or within the domain molecule's
+binding radius of the domain edge.  Each domain that it reached is taken out of
+the heap, flagged with domain_t=-1, and put on the due list, where it waits to be
+placed.  Domains plus binding radii are never larger than a box, so no others can
+be reached.  Returns 0 for success or 1 for out of memory. */
+int gfrdintruder(simptr sim,moleculeptr mptr) {
+	boxptr bptr,bptr2;
+	moleculeptr mptr2;
+	int b,ll,m,nlist;
+	double r,*pos,pbuf[DIMMAX],pbuf2[DIMMAX];
+
+	bptr=mptr->box;
+	if(!bptr) return 0;
+	pos=molreal2dbl(mptr->pos,pbuf,sim->dim);
+	nlist=sim->mols->nlist;
+	for(b=-1;b<bptr->nneigh;b++) {
+		bptr2=(b<0)?bptr:bptr->neigh[b];
+		for(ll=0;ll<nlist;ll++)
+			for(m=0;m<bptr2->nmol[ll];m++) {
+				mptr2=bptr2->mol[ll][m];
+				if(mptr2->domain_i<0) continue;
+				r=mptr2->cold->domain_r+sim->mols->gfrdbind[mptr2->ident];
+				if(distanceVVD(pos,molreal2dbl(mptr2->pos,pbuf2,sim->dim),sim->dim)>=r) continue;
+				gfrdremove(sim->mols,mptr2);
+				mptr2->cold->domain_t=-1;
+				if(gfrdmarkdue(sim->mols,mptr2)) return 1; }}
+	return 0; }
+
+
+/* gfrdplace.  Moves a molecule that is leaving its domain by displacement v from
+the domain center and updates its box. */
+void gfrdplace(simptr sim,moleculeptr mptr,double *v) {
+	boxptr bptr;
+	int d,ll;
+	double pbuf[DIMMAX];
+
+	for(d=0;d<sim->dim;d++) {
+		mptr->pos[d]+=v[d];
+		mptr->posx[d]=mptr->pos[d]; }
+	ll=mptr->list;
+	bptr=pos2box(sim,molreal2dbl(mptr->pos,pbuf,sim->dim));
+	if(ll>=0 && mptr->box && bptr!=mptr->box) {
+		boxremovemol(mptr,ll);
+		mptr->box=bptr;
+		boxaddmol(mptr,ll); }
+	return; }
+
+
+/* gfrdburst.  Moves a molecule whose domain has been burst to a position sampled
+for the time it spent in the domain, up to time t, given that it did not leave. */
+void gfrdburst(simptr sim,moleculeptr mptr,double t) {
+	int d;
+	double r,difc,tau,rad,sigma,len,v[DIMMAX];
+
+	difc=sim->mols->difc[mptr->ident][MSsoln];
+	r=mptr->cold->domain_r;
+	tau=difc*(t-mptr->cold->domain_t0)/(r*r);
+	rad=gfrdburstradius(tau);
+	if(rad>=0) {															// conditioned on not having left
+		do {
+			len=0;
+			for(d=0;d<sim->dim;d++) {
+				v[d]=gaussrandD();
+				len+=v[d]*v[d]; }
+		} while(len==0);
+		len=r*rad/sqrt(len);
+		for(d=0;d<sim->dim;d++) v[d]*=len; }
+	else {																		// edge is too far away to matter
+		sigma=sqrt(2.0*difc*(t-mptr->cold->domain_t0));
+		do {
+			len=0;
+			for(d=0;d<sim->dim;d++) {
+				v[d]=sigma*gaussrandD();
+				len+=v[d]*v[d]; }
+		} while(len>=r*r); }
+	gfrdplace(sim,mptr,v);
+	return; }
+
+
+/******************************************************************************/
+/********************************* data structures ****************************/
+/******************************************************************************/
+
+/* molsetgfrd.  Sets the maximum protective domain radius for species i; 0 turns
+domains off for the species.  Returns 0 for success, 1 for out of memory, 2 for a
+bad species, 3 if the system is not 3D, 4 for a negative radius. */
+int molsetgfrd(simptr sim,int i,double rmax) {
+	molssptr mols;
+	int ll,m;
+
+	mols=sim->mols;
+	if(!mols || i<1 || i>=mols->nspecies) return 2;
+	if(sim->dim!=3) return 3;
+	if(rmax<0) return 4;
+	mols->gfrdrmax[i]=rmax;
+	if(rmax>0)																// existing molecules become due
+		for(ll=0;ll<mols->nlist;ll++)
+			if(mols->listtype[ll]==MLTsystem)
+				for(m=0;m<mols->nl[ll];m++)
+					if(mols->live[ll][m]->ident==i)
+						if(gfrdmarkdue(mols,mols->live[ll][m])) return 1;
+	return 0; }
+
+
+/******************************************************************************/
+/******************************* core simulation ******************************/
+/******************************************************************************/
+
+/* gfrdburstall.  Bursts every domain, placing each molecule for the elapsed time,
+and puts the molecules on the due list.  Called when the box grid changes, since
+domains were sized for the old boxes and intruders are only looked for in
+neighboring boxes.  Returns 0 for success or 1 for out of memory. */
+int gfrdburstall(simptr sim) {
+	molssptr mols;
+	moleculeptr mptr;
+	double tnext;
+
+	mols=sim->mols;
+	if(!mols || !mols->ngfrd) return 0;
+	tnext=sim->time+sim->dt;
+	while(mols->ngfrd) {
+		mptr=mols->gfrdheap[mols->ngfrd-1];
+		gfrdremove(mols,mptr);
+		gfrdburst(sim,mptr,tnext);
+		if(gfrdmarkdue(mols,mptr)) return 1; }
+	return 0; }
+
+
+/* gfrdupdate.  Called once per time step, after diffusion and box assignment.
+Releases molecules whose domains have expired or been entered, then builds new
+domains for molecules on the due list.  Molecules that are too crowded for a
+domain stay on the list and are tried again next time step; those that can never
+have one are dropped from it.  Returns 0 for success or 1 for out of memory. */
+int gfrdupdate(simptr sim) {
+	molssptr mols;
+	moleculeptr mptr,*mlist;
+	int k,n,ll,m,i,d,er;
+	double tnext,r,difc,len,v[DIMMAX];
+
+	mols=sim->mols;
+	if(!mols || !mols->gfrdrmax || sim->dim!=3 || !sim->boxs) return 0;
+	tnext=sim->time+sim->dt;
+
+	while(mols->ngfrd && mols->gfrdheap[0]->cold->domain_t<=tnext) {	// domain exits
+		mptr=mols->gfrdheap[0];
+		gfrdremove(mols,mptr);
+		do {
+			len=0;
+			for(d=0;d<sim->dim;d++) {
+				v[d]=gaussrandD();
+				len+=v[d]*v[d]; }
+		} while(len==0);
+		len=mptr->cold->domain_r/sqrt(len);							// uniform on the domain surface
+		for(d=0;d<sim->dim;d++) v[d]*=len;
+		gfrdplace(sim,mptr,v);
+		if(gfrdmarkdue(mols,mptr)) return 1; }
+
+	n=mols->ngfrddue;														// domain bursts
+	if(mols->ngfrd)
+		for(ll=0;ll<mols->nlist;ll++) {
+			if(mols->listtype[ll]!=MLTsystem) continue;
+			mlist=mols->live[ll];
+			for(m=0;m<mols->nl[ll];m++)
+				if(mlist[m]->domain_i<0)
+					if(gfrdintruder(sim,mlist[m])) return 1; }
+	for(k=n;k<mols->ngfrddue;k++)
+		gfrdburst(sim,mols->gfrddue[k],tnext);
+
+	n=0;																		// new domains
+	for(k=0;k<mols->ngfrddue;k++) {
+		mptr=mols->gfrddue[k];
+		if(mptr->domain_i!=-2) continue;								// killed or already seen
+		mptr->domain_i=-1;
+		i=mptr->ident;
+		if(mptr->list<0 || mols->listtype[mptr->list]!=MLTsystem) continue;
+		if(mols->gfrdrmax[i]<=0 || mptr->mstate!=MSsoln || mptr->complex_id!=-1 || mptr->pos!=mptr->pos_tmp) continue;
+		if(mols->difm[i][MSsoln] || mols->drift[i][MSsoln]) continue;
+		difc=mols->difc[i][MSsoln];
+		if(difc<=0) continue;
+		r=gfrdclearance(sim,mptr,mols->gfrdrmax[i],1);
+		if(r<GFRDMINSTEPS*sqrt(6.0*difc*sim->dt)) {				// too crowded, stay with BD
+			mptr->domain_i=-3;
+			mols->gfrddue[n++]=mptr;
+			continue; }
+		mptr->cold->domain_r=r;
+		mptr->cold->domain_t0=tnext;
+		mptr->cold->domain_t=tnext+gfrdexittime()*r*r/difc;
+		er=gfrdpush(mols,mptr);
+		if(er) return 1; }
+	for(k=0;k<n;k++) mols->gfrddue[k]->domain_i=-2;
+	mols->ngfrddue=n;
+
+	return 0; }
+
+
@@ -1136,7 +1136,7 @@ void RenderMolecs(simptr sim) {
 						glBegin(GL_POINTS);
 						if(dim==1) glVertex3d((GLdouble)mptr->pos[0],(GLdouble)ymid,(GLdouble)zmid);
 						else if(dim==2) glVertex3d((GLdouble)(mptr->pos[0]),(GLdouble)(mptr->pos[1]),(GLdouble)zmid);
-						else glVertex3fv(gl2Double2GLfloat(mptr->pos,glf1,3));
+						else glVertex3d((GLdouble)(mptr->pos[0]),(GLdouble)(mptr->pos[1]),(GLdouble)(mptr->pos[2]));
 						glEnd(); }}}
 
 	else if(sim->graphss->graphics>=2) {
@@ -39,6 +39,11 @@ char *molmlt2string(enum MolListType mlt,char *string);
 
 // low level utilities
 char *molpos2string(simptr sim,moleculeptr mptr,char *string);
+int molclusternode(clusterptr clus,moleculeptr mptr,int add);
+int molclusterroot(clusterptr clus,int node);
+int molhistogramslice(moleculeptr *mlist,int m0,int m1,int dim,censusitemptr item,int *ct,int *binlist);
+void molcensusadd(molssptr mols,moleculeptr mptr,int dim,double *bsum);
+int molcensuscovers(molssptr mols,censusitemptr item,int ll);
 
 // memory management
 moleculeptr molalloc(simptr sim, int dim);
@@ -51,6 +56,9 @@ int molpatternindexalloc(int **indexptr,int n);
 int molpatternalloc(simptr sim,int maxpattern);
 complexptr complexalloc(simptr sim, moleculeptr mptr);
 void complexfree(complexptr cplxptr);
+int complexexpand(molssptr mols,int maxnew);
+int molsortslot(simptr sim,int ll,int m);
+void molclustersfree(clusterptr clus);
 
 // data structure output
 
@@ -67,6 +75,7 @@ int moldummyporter(simptr sim);
 
 // core simulation functions
 double power(double a, int b);
+int molkeyedspecies(simptr sim,moleculeptr mptr);
 
 /******************************************************************************/
 /********************************* enumerated types ***************************/
@@ -314,12 +323,12 @@ int readmolname_cplx(simptr sim,char *str, int **identptr, int **sitesptr){
 			ident_indx=stringfind(sim->mols->spname,sim->mols->nspecies,molec);			
 			if(ident_indx<0) return -1;
 			else identptr[0][i]=ident_indx;
-			printf("cptr=%s, molec=%s\n",cptr,molec);
+			SMOLTRACE(sim,TCcplx,TLdebug,"cptr=%s, molec=%s\n",cptr,molec);
 	
 			site_indx=stringfind(sim->mols->spsites_name[ident_indx],sim->mols->spsites_num[ident_indx],cptr);
 			if(site_indx<0) return -2;
 			else sitesptr[0][i]=site_indx;
-			printf("identptr[0][i]=%d, sitesptr[0][i]=%d\n", identptr[0][i], sitesptr[0][i]);
+			SMOLTRACE(sim,TCcplx,TLdebug,"identptr[0][i]=%d, sitesptr[0][i]=%d\n", identptr[0][i], sitesptr[0][i]);
 		}
 	}
 	return count;
@@ -538,7 +547,7 @@ int molstring2index1(simptr sim,char *str,enum MolecState *msptr,int **indexptr)
 char *molpos2string(simptr sim,moleculeptr mptr,char *string) {
 	int d,dim,done,p,tryagain,count;
 	char *line2;
-	double newpos[DIMMAX],crosspt[DIMMAX],dist;
+	double newpos[DIMMAX],crosspt[DIMMAX],dist,pbuf[DIMMAX],*pos;
 	boxptr bptr;
 	panelptr pnl;
 
@@ -553,6 +562,7 @@ char *molpos2string(simptr sim,moleculeptr mptr,char *string) {
 		line2+=strlen(line2); }
 
 	if(!sim->srfss) done=1;
+	pos=molreal2dbl(mptr->pos,pbuf,dim);
 	while(!done) {
 		line2=string;											// read in written position
 		for(d=0;d<dim;d++) {
@@ -561,10 +571,10 @@ char *molpos2string(simptr sim,moleculeptr mptr,char *string) {
 
 		tryagain=0;
 		bptr=pos2box(sim,newpos);
-		if(bptr!=pos2box(sim,mptr->pos)) tryagain=1;		// check for same box
+		if(bptr!=pos2box(sim,pos)) tryagain=1;		// check for same box
 		for(p=0;p<bptr->npanel && tryagain==0;p++) {		// check for no panels crossed
 			pnl=bptr->panel[p];
-			if(mptr->pnl!=pnl && lineXpanel(mptr->pos,newpos,pnl,dim,crosspt,NULL,NULL,NULL,NULL,NULL)) tryagain=1; }
+			if(mptr->pnl!=pnl && lineXpanel(pos,newpos,pnl,dim,crosspt,NULL,NULL,NULL,NULL,NULL)) tryagain=1; }
 		if(!tryagain) done=1;
 
 		if(!done) {
@@ -596,6 +606,7 @@ void molchangeident(simptr sim,moleculeptr mptr,int ll,int m,int i,enum MolecSta
 	dim=sim->dim;
 	epsilon=sim->srfss?sim->srfss->epsilon:0;
 
+	molnbrstale(sim->mols,mptr->ident,i);
 	mptr->ident=i;
 	mptr->mstate=ms;
 	if(ms==MSsoln || ms==MSbsoln) mptr->pnl=NULL;
@@ -603,22 +614,24 @@ void molchangeident(simptr sim,moleculeptr mptr,int ll,int m,int i,enum MolecSta
 
 	if(ms==MSsoln && !pnl);												// soln -> soln
 	else if(ms==MSsoln) {													// surf -> front soln
-		fixpt2panel(mptr->posx,pnl,dim,PFfront,epsilon); }
+		fixmolpt2panel(mptr->posx,pnl,dim,PFfront,epsilon); }
 	else if(ms==MSbsoln) {												// surf -> back soln
 		mptr->mstate=MSsoln;
-		fixpt2panel(mptr->posx,pnl,dim,PFback,epsilon); }
+		fixmolpt2panel(mptr->posx,pnl,dim,PFback,epsilon); }
 	else if(ms==MSfront)													// any -> front surf
-		fixpt2panel(mptr->pos,pnl,dim,PFfront,epsilon);
+		fixmolpt2panel(mptr->pos,pnl,dim,PFfront,epsilon);
 	else if(ms==MSback)														// any -> back surf
-		fixpt2panel(mptr->pos,pnl,dim,PFback,epsilon);
+		fixmolpt2panel(mptr->pos,pnl,dim,PFback,epsilon);
 	else																					// any -> up or down
-		fixpt2panel(mptr->pos,pnl,dim,PFnone,epsilon);
+		fixmolpt2panel(mptr->pos,pnl,dim,PFnone,epsilon);
+	moltally(sim->mols,mptr);
+	if(gfrdreset(sim->mols,mptr))
+		simLog(sim,10,"out of memory in molchangeident\n");
 
 	ll2=sim->mols->listlookup[i][ms];
 	if(ll>=0 && ll2!=ll) {
 		mptr->list=ll2;
-		if(m<0) sim->mols->sortl[ll]=0;
-		else if(m<sim->mols->sortl[ll]) sim->mols->sortl[ll]=m; }
+		mollistlog(sim->mols,mptr,ll,m); }
 	return; }
 
 
@@ -626,7 +639,11 @@ void molchangeident(simptr sim,moleculeptr mptr,int ll,int m,int i,enum MolecSta
 int molssetgausstable(simptr sim,int size) {
 	int er;
 	molssptr mols;
-	double *newtable;
+	molreal *newtable;
+#ifdef OPTION_SINGLE_PRECISION
+	double *dbltable;
+	int j;
+#endif
 	if(er) return er;
 	mols=sim->mols;
 
@@ -634,10 +651,21 @@ int molssetgausstable(simptr sim,int size) {
 	if(size<1) size=4096;
 	else if(!is2ton(size)) return 3;
 
-	newtable=(double*) calloc(size,sizeof(double));
+	newtable=(molreal*) calloc(size,sizeof(molreal));
 	CHECKMEM(newtable);
+#ifdef OPTION_SINGLE_PRECISION
+	dbltable=(double*) calloc(size,sizeof(double));
+	if(!dbltable) {
+		free(newtable);
+		CHECKMEM(0); }
+	randtableD(dbltable,size,1);
+	randshuffletableD(dbltable,size);
+	for(j=0;j<size;j++) newtable[j]=(molreal) dbltable[j];
+	free(dbltable);
+#else
 	randtableD(newtable,size,1);
 	randshuffletableD(newtable,size);
+#endif
 
 	if(mols->gausstbl) free(mols->gausstbl);
 	mols->ngausstbl=size;
@@ -876,10 +904,13 @@ void molsetexist(simptr sim,int ident,enum MolecState ms,int exist) {
 	return; }
 
 
-/* molcount */
+/* molcount.  Whole-system counts are read from the running counts in spcount,
+plus any resurrected molecules that have not been sorted yet.  Counts in a box, or
+in a system with ports, whose port lists are excluded from counts, scan the
+lists. */
 int molcount(simptr sim,int i,int *index,enum MolecState ms,boxptr bptr,int max) {
-	int count,ll,nmol,top,m,j,nresults,uselist;
-	moleculeptr *mlist;
+	int count,ll,nmol,top,m,j,nresults,uselist,i2;
+	moleculeptr *mlist,mptr;
 	molssptr mols;
 	enum MolecState msval;
 
@@ -888,6 +919,21 @@ int molcount(simptr sim,int i,int *index,enum MolecState ms,boxptr bptr,int max)
 	if(max<0) max=INT_MAX;
 	count=0;
 
+	if(!bptr && mols->spcount && !(sim->portss && sim->portss->nport>0)) {
+		nresults=index?index[PDnresults]:0;
+		for(i2=1;i2<mols->nspecies;i2++)
+			if(i<0 || i2==i || (i==0 && index && locateVi(index+PDMAX,i2,nresults,0)>=0)) {
+				if(ms!=MSall) count+=mols->spcount[i2*MSMAX+ms];
+				else for(msval=(enum MolecState)0;msval<MSMAX;msval=(enum MolecState)(msval+1))
+					count+=mols->spcount[i2*MSMAX+msval]; }
+		for(m=mols->topd;m<mols->nd;m++) {									// resurrected, not yet counted
+			mptr=mols->dead[m];
+			i2=mptr->ident;
+			if(i2>0 && mptr->tally<0 && (ms==MSall || mptr->mstate==ms))
+				if(i<0 || i2==i || (i==0 && index && locateVi(index+PDMAX,i2,nresults,0)>=0))
+					count++; }
+		return count<max?count:max; }
+
 	if(i<0 && ms==MSall) {																	// all species, all states
 		for(ll=0;ll<mols->nlist;ll++)
 			if(mols->listtype[ll]==MLTsystem) {
@@ -1029,6 +1075,659 @@ int molcount(simptr sim,int i,int *index,enum MolecState ms,boxptr bptr,int max)
 	return count; }
 
 
+/* molhistogramslice.  Adds molecules m0 to m1-1 of mlist that match census
+item, which is a histogram, into ct, which starts at the item's first bin.  Only
+molecules strictly between low and high in every dimension are counted, and ct is
+indexed with the last dimension varying fastest.  If binlist is not NULL, ct is
+not used and the census indices of the bins, which include the item's offset,
+are listed in binlist instead.  Matching molecules are collected in blocks, and
+then tested and binned with loops over the block, one dimension at a time, which
+have no branches so that the compiler can vectorize them.  Returns the number of
+indices added to binlist, or 0 if it is NULL. */
+int molhistogramslice(moleculeptr *mlist,int m0,int m1,int dim,censusitemptr item,int *ct,int *binlist) {
+	moleculeptr mptr;
+	double x[DIMMAX][MOLBINBLOCK],b,lo,hi,scale;
+	int in[MOLBINBLOCK],bin[MOLBINBLOCK];
+	int m,k,n,d,i,nb,nlist;
+	enum MolecState ms;
+
+	i=item->i;
+	ms=item->ms;
+	nlist=0;
+	m=m0;
+	while(m<m1) {
+		for(n=0;m<m1 && n<MOLBINBLOCK;m++) {
+			mptr=mlist[m];
+			if((i<0?mptr->ident>0:mptr->ident==i) && (ms==MSall || mptr->mstate==ms)) {
+				for(d=0;d<dim;d++) x[d][n]=mptr->pos[d];
+				n++; }}
+		for(k=0;k<n;k++) {
+			in[k]=1;
+			bin[k]=0; }
+		for(d=0;d<dim;d++) {
+			lo=item->low[d];
+			hi=item->high[d];
+			scale=item->scale[d];
+			nb=item->nbin[d];
+			for(k=0;k<n;k++) {
+				in[k]&=(x[d][k]>lo)&(x[d][k]<hi);
+				b=(x[d][k]-lo)*scale;
+				b=(b<0)?0:((b>nb-1)?nb-1:b);
+				bin[k]=bin[k]*nb+(int)b; }}
+		if(binlist)
+			for(k=0;k<n;k++) {
+				binlist[nlist]=item->offset+bin[k];
+				nlist+=in[k]; }
+		else
+			for(k=0;k<n;k++)
+				if(in[k]) ct[bin[k]]++; }
+	return nlist; }
+
+
+/* molcensusadd.  Adds molecule mptr to the census moment sums in bsum, for
+molcensus.  Moment sums are the count and the first and second moments about the
+item's origin.  Histogram items are binned separately, by molhistogramslice. */
+void molcensusadd(molssptr mols,moleculeptr mptr,int dim,double *bsum) {
+	censusitemptr item;
+	int q,d,d2;
+	double x[DIMMAX],*sum;
+
+	for(q=0;q<mols->ncensusitem;q++) {
+		item=&mols->censusitem[q];
+		if(item->nbin[0]>0 || !item->need) continue;
+		if((item->i>=0 && mptr->ident!=item->i) || (item->ms!=MSall && mptr->mstate!=item->ms)) continue;
+		sum=bsum+item->offset;
+		for(d=0;d<dim;d++) x[d]=mptr->pos[d]-item->low[d];
+		sum[0]+=1;
+		for(d=0;d<dim;d++) {
+			sum[1+d]+=x[d];
+			for(d2=0;d2<dim;d2++) sum[1+dim+d*dim+d2]+=x[d]*x[d2]; }}
+	return; }
+
+
+/* molcensuscovers.  Returns 1 if list ll can hold molecules of census item,
+and 0 if not. */
+int molcensuscovers(molssptr mols,censusitemptr item,int ll) {
+	return item->i<0 || item->ms==MSall || mols->listlookup[item->i][item->ms]==ll; }
+
+
+/* molcensusreset.  Starts the plan for the next census sweep, in which the
+observers that are due register the compartments and items that they need with
+molcensuscmpt and molcensusitem.  Items are kept, so that they can be found again
+later, but are only swept while they are needed. */
+void molcensusreset(molssptr mols) {
+	int c,q;
+
+	if(!mols) return;
+	for(c=0;c<mols->maxcensuscmpt;c++) mols->censuscmpt[c]=0;
+	for(q=0;q<mols->ncensusitem;q++) mols->censusitem[q].need=0;
+	mols->censusok=0;
+	return; }
+
+
+/* molcensuscmpt.  Adds compartment c to the next census sweep, which
+invalidates the census if it was not in it already.  Returns 0 for success or 1
+if memory could not be allocated. */
+int molcensuscmpt(simptr sim,int c) {
+	molssptr mols;
+	int ncmpt,cc,*newcmpt;
+
+	mols=sim->mols;
+	ncmpt=sim->cmptss?sim->cmptss->ncmpt:0;
+	if(ncmpt>mols->maxcensuscmpt) {
+		newcmpt=(int*) calloc(ncmpt,sizeof(int));
+		if(!newcmpt) return 1;
+		for(cc=0;cc<mols->maxcensuscmpt;cc++) newcmpt[cc]=mols->censuscmpt[cc];
+		free(mols->censuscmpt);
+		mols->censuscmpt=newcmpt;
+		mols->maxcensuscmpt=ncmpt; }
+	if(c>=0 && c<ncmpt && !mols->censuscmpt[c]) {
+		mols->censuscmpt[c]=1;
+		mols->censusok=0; }
+	return 0; }
+
+
+/* molcensusitem.  Returns the index of the census item for the histogram of
+species i and state ms with nbin[d] bins between low[d] and high[d], or for the
+moments of species i and state ms if nbin is NULL, and adds it to the next census
+sweep.  The item is added if it is not there yet.  Either invalidates the census
+if the item was not in it already.  Moments start with the system center as
+their origin.  Returns -1 if memory could not be allocated. */
+int molcensusitem(simptr sim,int i,enum MolecState ms,const double *low,const double *high,const int *nbin) {
+	molssptr mols;
+	censusitemptr item,newitem;
+	int q,d,dim,newmax;
+	double poslo[DIMMAX],poshi[DIMMAX];
+
+	mols=sim->mols;
+	dim=sim->dim;
+	for(q=0;q<mols->ncensusitem;q++) {
+		item=&mols->censusitem[q];
+		if(item->i!=i || item->ms!=ms || (item->nbin[0]>0)!=(nbin!=NULL)) continue;
+		if(nbin) {
+			for(d=0;d<dim && item->nbin[d]==nbin[d] && item->low[d]==low[d] && item->high[d]==high[d];d++);
+			if(d<dim) continue; }
+		if(!item->need) {
+			item->need=1;
+			mols->censusok=0; }
+		return q; }
+
+	if(mols->ncensusitem==mols->maxcensusitem) {
+		newmax=2*mols->maxcensusitem+4;
+		newitem=(censusitemptr) calloc(newmax,sizeof(struct censusitemstruct));
+		if(!newitem) return -1;
+		for(q=0;q<mols->ncensusitem;q++) newitem[q]=mols->censusitem[q];
+		free(mols->censusitem);
+		mols->censusitem=newitem;
+		mols->maxcensusitem=newmax; }
+	q=mols->ncensusitem++;
+	item=&mols->censusitem[q];
+	item->i=i;
+	item->ms=ms;
+	if(nbin) {
+		item->ntot=1;
+		for(d=0;d<dim;d++) {
+			item->nbin[d]=nbin[d];
+			item->low[d]=low[d];
+			item->high[d]=high[d];
+			item->scale[d]=(high[d]>low[d])?(double)nbin[d]/(high[d]-low[d]):0;
+			item->ntot*=nbin[d]; }}
+	else {
+		systemcorners(sim,poslo,poshi);
+		for(d=0;d<dim;d++) {
+			item->nbin[d]=0;
+			item->low[d]=0.5*(poslo[d]+poshi[d]); }
+		item->ntot=1+dim+dim*dim; }
+	item->offset=0;
+	item->need=1;
+	item->bybin=0;
+	mols->censusok=0;
+	return q; }
+
+
+/* molcensus.  Returns the molecule counts in compartment c, or in the whole system
+if c is -1, as an array indexed by i*MSMAX+ms.  All counts come from one sweep over
+the live lists, which is shared by every observation command until censusok is
+cleared.  The sweep only includes the compartments and items that were registered
+since molcensusreset, which the simulation calls before each step's commands run,
+so several observers on the same step still cost a single pass and nothing is
+counted for observers that are not due.  Compartment c is added here if it was
+not registered, which costs another sweep.  The histograms and moments of census
+items are found in the same sweep, after the compartment counts in census and in
+censusmom, respectively.  Histograms are binned a block of molecules at a time
+with molhistogramslice, and only over the lists that can hold their molecules.
+With several threads, compartment counts and small histograms are made in private
+copies from molreduceint, while histograms with more bins per thread than
+molecules to put in them are instead listed as census indices in censusbin, one
+region per thread, and added up afterwards.  Moments are summed over fixed blocks
+of molecules so that they do not depend on the number of threads, and are then
+converted to the count, the mean, and the second moments about the mean, which
+are not divided by the count.  Returns NULL if memory could not be allocated. */
+int *molcensus(simptr sim,int c) {
+	molssptr mols;
+	moleculeptr mptr;
+	compartssptr cmptss;
+	censusitemptr item;
+	int ll,m,k,cc,q,d,d2,dim,ncmpt,stride,size,small,momsize,nhist,nbig,nthreads,t,nmol,*work,*count,slot;
+	int nblock,blk0,blk,mtop,m0,m1,*binlist,nlist,binsize;
+	double pbuf[DIMMAX],*sums,*bsum,*mom,*newmom,n;
+	moleculeptr *mlist;
+
+	mols=sim->mols;
+	if(!mols) return NULL;
+	dim=sim->dim;
+	cmptss=sim->cmptss;
+	ncmpt=cmptss?cmptss->ncmpt:0;
+	if(c>=ncmpt) return NULL;
+	stride=mols->nspecies*MSMAX;
+	if(molcensuscmpt(sim,c)) return NULL;
+
+	if(!mols->censusok) {
+		nthreads=molreducethreads(sim);
+		slot=1;																					// census layout
+		for(cc=0;cc<ncmpt;cc++)
+			if(mols->censuscmpt[cc]) mols->censuscmpt[cc]=slot++;
+		size=slot*stride;
+		momsize=0;
+		nhist=nbig=0;
+		for(q=0;q<mols->ncensusitem;q++) {
+			item=&mols->censusitem[q];
+			if(!item->need) continue;
+			if(item->nbin[0]>0) {
+				for(nmol=ll=0;ll<mols->nlist;ll++)
+					if(molcensuscovers(mols,item,ll)) nmol+=mols->nl[ll];
+				item->bybin=(nthreads>1 && item->ntot>nmol/nthreads);
+				nhist++;
+				if(item->bybin) nbig++;
+				else {
+					item->offset=size;
+					size+=item->ntot; }}
+			else {
+				item->offset=momsize;
+				momsize+=item->ntot; }}
+		small=size;
+		for(q=0;q<mols->ncensusitem && nbig;q++) {
+			item=&mols->censusitem[q];
+			if(item->need && item->nbin[0]>0 && item->bybin) {
+				item->offset=size;
+				size+=item->ntot; }}
+
+		if(size>mols->ncensus) {
+			free(mols->census);
+			mols->census=(int*) calloc(size,sizeof(int));
+			mols->ncensus=mols->census?size:0;
+			if(!mols->census) return NULL; }
+		if(momsize>mols->ncensusmom) {
+			newmom=(double*) calloc(momsize,sizeof(double));
+			if(!newmom) return NULL;
+			free(mols->censusmom);
+			mols->censusmom=newmom;
+			mols->ncensusmom=momsize; }
+
+		if(nbig) {																			// census index space for each thread
+			if(2*nthreads>mols->maxcensusbinn) {
+				free(mols->censusbinn);
+				mols->censusbinn=(int*) calloc(2*nthreads,sizeof(int));
+				mols->maxcensusbinn=mols->censusbinn?2*nthreads:0;
+				if(!mols->censusbinn) return NULL; }
+			binsize=0;
+			for(t=0;t<nthreads;t++) {
+				mols->censusbinn[2*t]=binsize;
+				mols->censusbinn[2*t+1]=0;
+				for(ll=0;ll<mols->nlist;ll++) {
+					for(k=q=0;q<mols->ncensusitem;q++) {
+						item=&mols->censusitem[q];
+						if(item->need && item->nbin[0]>0 && item->bybin && molcensuscovers(mols,item,ll)) k++; }
+					nblock=(mols->nl[ll]+MOLREDUCEBLOCK-1)/MOLREDUCEBLOCK;
+					m0=t*nblock/nthreads*MOLREDUCEBLOCK;
+					m1=(t+1)*nblock/nthreads*MOLREDUCEBLOCK;
+					if(m1>mols->nl[ll]) m1=mols->nl[ll];
+					if(m1>m0) binsize+=k*(m1-m0); }}
+			if(binsize>mols->maxcensusbin) {
+				free(mols->censusbin);
+				mols->censusbin=(int*) calloc(binsize,sizeof(int));
+				mols->maxcensusbin=mols->censusbin?binsize:0;
+				if(!mols->censusbin) return NULL; }}
+
+		for(k=0;k<size;k++) mols->census[k]=0;
+		work=(nthreads>1)?molreduceint(sim,small):NULL;
+		if(nthreads>1 && !work) return NULL;
+		nblock=0;
+		for(ll=0;ll<mols->nlist;ll++) nblock+=(mols->nl[ll]+MOLREDUCEBLOCK-1)/MOLREDUCEBLOCK;
+		sums=NULL;
+		if(momsize>0) {
+			sums=molreducedbl(sim,nblock*momsize);
+			if(!sums) return NULL; }
+		blk0=0;
+		for(ll=0;ll<mols->nlist;ll++) {
+			mlist=mols->live[ll];
+			nmol=mols->nl[ll];
+			nblock=(nmol+MOLREDUCEBLOCK-1)/MOLREDUCEBLOCK;
+#ifdef HAVE_OPENMP
+			#pragma omp parallel for schedule(static) private(blk,bsum,mtop,m,mptr,k,cc,q,item,count,pbuf,binlist,nlist) num_threads(nthreads) if(nthreads>1)
+#endif
+			for(t=0;t<nthreads;t++) {
+				count=work?work+t*small:mols->census;
+				binlist=nbig?mols->censusbin+mols->censusbinn[2*t]:NULL;
+				nlist=nbig?mols->censusbinn[2*t+1]:0;
+				for(blk=t*nblock/nthreads;blk<(t+1)*nblock/nthreads;blk++) {		// threads take whole blocks
+					bsum=sums?sums+(blk0+blk)*momsize:NULL;
+					mtop=(blk+1)*MOLREDUCEBLOCK<nmol?(blk+1)*MOLREDUCEBLOCK:nmol;
+					for(m=blk*MOLREDUCEBLOCK;m<mtop;m++) {
+						mptr=mlist[m];
+						if(mptr->ident<=0) continue;
+						k=mptr->ident*MSMAX+mptr->mstate;
+						count[k]++;
+						for(cc=0;cc<ncmpt;cc++)
+							if(mols->censuscmpt[cc] && posincompart(sim,molreal2dbl(mptr->pos,pbuf,dim),cmptss->cmptlist[cc]))
+								count[mols->censuscmpt[cc]*stride+k]++;
+						if(momsize) molcensusadd(mols,mptr,dim,bsum); }
+					for(q=0;q<mols->ncensusitem && nhist;q++) {						// histograms, a block at a time
+						item=&mols->censusitem[q];
+						if(item->need && item->nbin[0]>0 && molcensuscovers(mols,item,ll)) {
+							if(item->bybin) nlist+=molhistogramslice(mlist,blk*MOLREDUCEBLOCK,mtop,dim,item,NULL,binlist+nlist);
+							else molhistogramslice(mlist,blk*MOLREDUCEBLOCK,mtop,dim,item,count+item->offset,NULL); }}}
+				if(nbig) mols->censusbinn[2*t+1]=nlist; }
+			blk0+=nblock; }
+		if(work) molreducemerge(sim,small,mols->census);
+		for(t=0;t<nthreads && nbig;t++) {
+			binlist=mols->censusbin+mols->censusbinn[2*t];
+			for(k=0;k<mols->censusbinn[2*t+1];k++) mols->census[binlist[k]]++; }
+
+		if(momsize>0) {
+			for(k=0;k<momsize;k++) mols->censusmom[k]=0;
+			for(blk=0;blk<blk0;blk++)
+				for(k=0;k<momsize;k++) mols->censusmom[k]+=sums[blk*momsize+k];
+			for(q=0;q<mols->ncensusitem;q++) {
+				item=&mols->censusitem[q];
+				if(item->nbin[0]>0 || !item->need) continue;
+				mom=mols->censusmom+item->offset;
+				n=mom[0];
+				for(d=0;d<dim;d++)
+					for(d2=0;d2<dim;d2++)
+						mom[1+dim+d*dim+d2]=(n>0)?mom[1+dim+d*dim+d2]-mom[1+d]*mom[1+d2]/n:0;
+				for(d=0;d<dim;d++) {
+					mom[1+d]=item->low[d]+mom[1+d]/n;
+					if(n>0) item->low[d]=mom[1+d]; }}}
+		mols->censusok=1; }
+
+	return mols->census+(c>=0?mols->censuscmpt[c]:0)*stride; }
+
+
+/* molcensushist.  Adds the histogram of the molecules of species i and state ms
+into ct.  Use i<0 for all species and ms of MSall for all states.  Dimension d
+is divided into nbin[d] equal bins between low[d] and high[d], where 1 is used for
+dimensions that only bound the region; see molhistogramslice.  The histogram is
+made in the census sweep, so observers that run on the same step share one pass
+over the molecules.  Returns 0 for success or 1 if memory could not
+be allocated. */
+int molcensushist(simptr sim,int i,enum MolecState ms,const double *low,const double *high,const int *nbin,int *ct) {
+	censusitemptr item;
+	int q,k,*cen;
+
+	if(!sim->mols) return 1;
+	q=molcensusitem(sim,i,ms,low,high,nbin);
+	if(q<0) return 1;
+	cen=molcensus(sim,-1);
+	if(!cen) return 1;
+	item=&sim->mols->censusitem[q];
+	for(k=0;k<item->ntot;k++) ct[k]+=sim->mols->census[item->offset+k];
+	return 0; }
+
+
+/* molreducethreads.  Returns the number of threads that observation functions
+split their molecule loops over, which is at least 1. */
+int molreducethreads(simptr sim) {
+	return (sim->nthreads>1)?sim->nthreads:1; }
+
+
+/* molreduceint.  Returns space for one private array of n counts per thread, all
+set to zero, for a parallel count that is finished with molreducemerge.  Thread t
+uses elements t*n to t*n+n-1.  Returns NULL if memory could not be allocated. */
+int *molreduceint(simptr sim,int n) {
+	molssptr mols;
+	int size,k;
+
+	mols=sim->mols;
+	size=molreducethreads(sim)*n;
+	if(size>mols->maxredint) {
+		free(mols->redint);
+		mols->redint=(int*) calloc(size,sizeof(int));
+		mols->maxredint=mols->redint?size:0;
+		if(!mols->redint) return NULL; }
+	for(k=0;k<size;k++) mols->redint[k]=0;
+	return mols->redint; }
+
+
+/* molreducemerge.  Adds the private arrays from molreduceint, which have n
+elements each, into ct. */
+void molreducemerge(simptr sim,int n,int *ct) {
+	int nthreads,t,k,*count;
+
+	nthreads=molreducethreads(sim);
+	for(t=0;t<nthreads;t++) {
+		count=sim->mols->redint+t*n;
+		for(k=0;k<n;k++) ct[k]+=count[k]; }
+	return; }
+
+
+/* molreducedbl.  Returns space for n partial sums, all set to zero, or NULL if
+memory could not be allocated.  Floating point sums are made over fixed blocks of
+MOLREDUCEBLOCK molecules and then added in block order, so that they do not depend
+on the number of threads. */
+double *molreducedbl(simptr sim,int n) {
+	molssptr mols;
+	int k;
+
+	mols=sim->mols;
+	if(n<1) n=1;
+	if(n>mols->maxreddbl) {
+		free(mols->reddbl);
+		mols->reddbl=(double*) calloc(n,sizeof(double));
+		mols->maxreddbl=mols->reddbl?n:0;
+		if(!mols->reddbl) return NULL; }
+	for(k=0;k<n;k++) mols->reddbl[k]=0;
+	return mols->reddbl; }
+
+
+/* molmoments.  Finds the mean position of the molecules of species i and state ms
+into mean, and their second moments about the mean into cov, as a dim by dim matrix
+that is not divided by the number of molecules.  These come from the census sweep,
+so they are shared with other observers that run on the same step.  Returns the
+number of molecules, or -1 if memory could not be allocated. */
+int molmoments(simptr sim,int i,enum MolecState ms,double *mean,double *cov) {
+	int q,d,dim;
+	double *mom;
+
+	dim=sim->dim;
+	q=molcensusitem(sim,i,ms,NULL,NULL,NULL);
+	if(q<0) return -1;
+	if(!molcensus(sim,-1)) return -1;
+	mom=sim->mols->censusmom+sim->mols->censusitem[q].offset;
+	for(d=0;d<dim;d++) mean[d]=mom[1+d];
+	for(d=0;d<dim*dim;d++) cov[d]=mom[1+dim+d];
+	return (int)mom[0]; }
+
+
+/* moltrajframe.  Fills trajectory frame with the molecules of species i and state
+ms that are in compartment cmpt, or anywhere if cmpt is NULL.  Use i<0 for all
+species and ms of MSall for all states.  If unwrap is set, positions include the
+offsets from periodic boundaries.  Returns 0 for success or 1 if memory could not
+be allocated. */
+int moltrajframe(simptr sim,trajframeptr frame,int i,enum MolecState ms,compartptr cmpt,int unwrap) {
+	molssptr mols;
+	moleculeptr mptr,*mlist;
+	int ll,lllo,llhi,m,n,d,dim,nmol;
+	double pbuf[DIMMAX];
+
+	mols=sim->mols;
+	dim=sim->dim;
+	if(i<0 || ms==MSall) {lllo=0;llhi=mols->nlist;}
+	else llhi=1+(lllo=mols->listlookup[i][ms]);
+	nmol=0;
+	for(ll=lllo;ll<llhi;ll++) nmol+=mols->nl[ll];
+	if(trajframeexpand(frame,nmol)) return 1;
+
+	n=0;
+	for(ll=lllo;ll<llhi;ll++) {
+		mlist=mols->live[ll];
+		for(m=0;m<mols->nl[ll];m++) {
+			mptr=mlist[m];
+			if((i<0?mptr->ident>0:mptr->ident==i) && (ms==MSall || mptr->mstate==ms)) {
+				if(cmpt && !posincompart(sim,molreal2dbl(mptr->pos,pbuf,dim),cmpt)) continue;
+				frame->serno[n]=mptr->serno;
+				frame->species[n]=mptr->ident;
+				frame->state[n]=(int)mptr->mstate;
+				frame->sites[n]=mptr->sites_val;
+				frame->complexid[n]=mptr->complex_id;
+				for(d=0;d<dim;d++)
+					frame->pos[d*frame->maxmol+n]=unwrap?mptr->pos[d]+mptr->posoffset[d]:mptr->pos[d];
+				n++; }}}
+	frame->nmol=n;
+	frame->time=sim->time;
+	return 0; }
+
+
+/* molclusternode.  Returns the union-find node of molecule mptr for molclusters,
+which is its complex id if it is in a complex.  Otherwise, it is a node from the
+single table, which is added if add is set and it is not there yet.  Returns -1 if
+mptr has no node, or -2 if memory could not be allocated. */
+int molclusternode(clusterptr clus,moleculeptr mptr,int add) {
+	gpointer value;
+	int node,newmax,k,*newparent,*newsize;
+
+	if(mptr->complex_id>=0) return mptr->complex_id;
+	value=g_hash_table_lookup(clus->single,mptr);
+	if(value) return GPOINTER_TO_INT(value)-1;
+	if(!add) return -1;
+	if(clus->nnode==clus->maxnode) {
+		newmax=2*clus->maxnode+16;
+		newparent=(int*) calloc(newmax,sizeof(int));
+		newsize=(int*) calloc(newmax,sizeof(int));
+		if(!newparent || !newsize) {
+			free(newparent);
+			free(newsize);
+			return -2; }
+		for(k=0;k<clus->nnode;k++) {
+			newparent[k]=clus->parent[k];
+			newsize[k]=clus->size[k]; }
+		free(clus->parent);
+		free(clus->size);
+		clus->parent=newparent;
+		clus->size=newsize;
+		clus->maxnode=newmax; }
+	node=clus->nnode++;
+	clus->parent[node]=node;
+	clus->size[node]=0;
+	g_hash_table_insert(clus->single,mptr,GINT_TO_POINTER(node+1));
+	return node; }
+
+
+/* molclusterroot.  Returns the root of node, halving the path on the way. */
+int molclusterroot(clusterptr clus,int node) {
+	while(clus->parent[node]!=node) {
+		clus->parent[node]=clus->parent[clus->parent[node]];
+		node=clus->parent[node]; }
+	return node; }
+
+
+/* molclusters.  Finds the connected clusters of molecules, where molecules are
+connected if they are in the same complex or if a binding site of one is bound to
+the other.  Each complex starts as one union-find node, bound molecules outside
+complexes get nodes of their own, and unbound molecules outside complexes are
+clusters of one without a node.  Bonds are merged in one pass over the live lists
+and two more passes count cluster sizes and species composition.  If members is
+set, member lists the molecules of every cluster of two or more, grouped by root
+in increasing node order.  Returns the result, which is kept in mols->clusters
+until the next call, or NULL if memory could not be allocated. */
+clusterptr molclusters(simptr sim,int members) {
+	molssptr mols;
+	clusterptr clus;
+	moleculeptr mptr,bptr;
+	int ll,m,k,s,r,node,node2,root,root2,nsingle,stride,size,*newint,nmember;
+
+	mols=sim->mols;
+	if(!mols) return NULL;
+	if(!mols->clusters) {
+		mols->clusters=(clusterptr) calloc(1,sizeof(struct clusterstruct));
+		if(!mols->clusters) return NULL;
+		mols->clusters->single=g_hash_table_new(g_direct_hash,g_direct_equal); }
+	clus=mols->clusters;
+	g_hash_table_remove_all(clus->single);
+
+	if(mols->ncomplex>clus->maxnode) {									// complex nodes
+		free(clus->parent);
+		free(clus->size);
+		clus->maxnode=mols->ncomplex;
+		clus->parent=(int*) calloc(clus->maxnode,sizeof(int));
+		clus->size=(int*) calloc(clus->maxnode,sizeof(int));
+		if(!clus->parent || !clus->size) {
+			clus->maxnode=0;
+			return NULL; }}
+	clus->nnode=mols->ncomplex;
+	for(node=0;node<clus->nnode;node++) {
+		clus->parent[node]=node;
+		clus->size[node]=0; }
+
+	for(ll=0;ll<mols->nlist;ll++)																// merge bonds
+		for(m=0;m<mols->nl[ll];m++) {
+			mptr=mols->live[ll][m];
+			if(mptr->ident<=0 || !mptr->sites) continue;
+			node=-1;
+			for(k=0;k<mols->spsites_num[mptr->ident];k++) {
+				bptr=mptr->sites[k]->bind;
+				if(!bptr || bptr->ident<=0) continue;
+				if(node<0) node=molclusternode(clus,mptr,1);
+				node2=molclusternode(clus,bptr,1);
+				if(node<0 || node2<0) return NULL;
+				root=molclusterroot(clus,node);
+				root2=molclusterroot(clus,node2);
+				if(root<root2) clus->parent[root2]=root;
+				else if(root2<root) clus->parent[root]=root2; }}
+
+	clus->nmol=0;																								// cluster sizes
+	nsingle=0;
+	for(ll=0;ll<mols->nlist;ll++)
+		for(m=0;m<mols->nl[ll];m++) {
+			mptr=mols->live[ll][m];
+			if(mptr->ident<=0) continue;
+			clus->nmol++;
+			node=molclusternode(clus,mptr,0);
+			if(node<0) nsingle++;
+			else clus->size[molclusterroot(clus,node)]++; }
+
+	clus->maxsize=nsingle?1:0;
+	clus->ncluster=nsingle;
+	nmember=0;
+	for(node=0;node<clus->nnode;node++)
+		if(clus->parent[node]==node && clus->size[node]>0) {
+			clus->ncluster++;
+			if(clus->size[node]>clus->maxsize) clus->maxsize=clus->size[node];
+			if(clus->size[node]>1) nmember+=clus->size[node]; }
+
+	if(clus->maxsize+1>clus->maxsizerow) {											// size table
+		newint=(int*) calloc(clus->maxsize+1,sizeof(int));
+		if(!newint) return NULL;
+		free(clus->sizerow);
+		clus->sizerow=newint;
+		clus->maxsizerow=clus->maxsize+1; }
+	for(s=0;s<=clus->maxsize;s++) clus->sizerow[s]=0;
+	clus->sizerow[1]+=nsingle;
+	for(node=0;node<clus->nnode;node++)
+		if(clus->parent[node]==node && clus->size[node]>0)
+			clus->sizerow[clus->size[node]]++;
+	stride=mols->nspecies+2;
+	clus->nrow=0;
+	for(s=1;s<=clus->maxsize;s++)
+		if(clus->sizerow[s]) clus->nrow++;
+	size=clus->nrow*stride;
+	if(size>clus->maxbysize) {
+		newint=(int*) calloc(size,sizeof(int));
+		if(!newint) return NULL;
+		free(clus->bysize);
+		clus->bysize=newint;
+		clus->maxbysize=size; }
+	for(k=0;k<size;k++) clus->bysize[k]=0;
+	for(s=1,r=0;s<=clus->maxsize;s++)
+		if(clus->sizerow[s]) {
+			clus->bysize[r*stride]=s;
+			clus->bysize[r*stride+1]=clus->sizerow[s];
+			clus->sizerow[s]=r++; }
+		else clus->sizerow[s]=-1;
+
+	if(members) {																								// member offsets
+		if(nmember>clus->maxmember) {
+			free(clus->member);
+			clus->member=(moleculeptr*) calloc(nmember,sizeof(moleculeptr));
+			clus->maxmember=clus->member?nmember:0;
+			if(!clus->member) return NULL; }
+		for(node=0,k=0;node<clus->nnode;node++)
+			if(clus->parent[node]==node && clus->size[node]>1) {
+				clus->parent[node]=-1-k;										// temporarily holds member offset
+				k+=clus->size[node]; }}
+
+	for(ll=0;ll<mols->nlist;ll++)																// composition and members
+		for(m=0;m<mols->nl[ll];m++) {
+			mptr=mols->live[ll][m];
+			if(mptr->ident<=0) continue;
+			node=molclusternode(clus,mptr,0);
+			if(node<0) s=1;
+			else {
+				if(members)
+					for(root=node;clus->parent[root]>=0 && clus->parent[root]!=root;root=clus->parent[root]);
+				else
+					root=molclusterroot(clus,node);
+				s=clus->size[root];
+				if(members && s>1) clus->member[-1-clus->parent[root]--]=mptr; }
+			clus->bysize[clus->sizerow[s]*stride+2+mptr->ident]++; }
+
+	if(members)																									// restore roots
+		for(node=0;node<clus->nnode;node++)
+			if(clus->parent[node]<0) clus->parent[node]=node;
+
+	return clus; }
+
+
 /* molcount_cplx */
 int molcount_cplx(simptr sim,int i,int *index,enum MolecState ms,boxptr bptr,int max) {
 	int count,ll,nmol,top,m,j,nresults,uselist;
@@ -1234,7 +1933,8 @@ double MolCalcDifcSum(simptr sim, moleculeptr mptr1, moleculeptr mptr2, double *
 /* molalloc */
 moleculeptr molalloc(simptr sim, int dim) {
 	moleculeptr mptr;
-	int d, d1;
+	int d, d1, nreal;
+	double *block;
 
 	mptr=NULL;
 	CHECKMEM(mptr=(moleculeptr) malloc(sizeof(struct moleculestruct)));
@@ -1256,8 +1956,6 @@ moleculeptr molalloc(simptr sim, int dim) {
 	mptr->from=NULL;			// potentially double free
 	mptr->tot_sunit=0;	
 	mptr->pos_tmp=NULL;			// potentially double free
-	mptr->theta_init=0;
-	mptr->phi_init=0;
 	mptr->sdist_tmp=0;
 	mptr->sdist_init=0;
 	mptr->prev_pos=NULL;
@@ -1268,15 +1966,31 @@ moleculeptr molalloc(simptr sim, int dim) {
 	mptr->dif_molec=NULL;
 	mptr->dif_site=-1;
 	mptr->sim_time=-1;
-	mptr->vchannel=NULL;
-	mptr->arrival_time=-1;
 	mptr->bind_id=-1;
-
-	CHECKMEM(mptr->pos=(double*) calloc(dim,sizeof(double)));
-	CHECKMEM(mptr->posx=(double*) calloc(dim,sizeof(double)));
-	CHECKMEM(mptr->via=(double*) calloc(dim,sizeof(double)));
-	CHECKMEM(mptr->posoffset=(double*) calloc(dim,sizeof(double)));
-	CHECKMEM(mptr->prev_pos=(double*) calloc(dim,sizeof(double)));
+	mptr->domain_i=-1;
+	mptr->tally=-1;
+	mptr->cold=NULL;
+
+	CHECKMEM(mptr->cold=(molcoldptr) malloc(sizeof(struct molcoldstruct)));
+	mptr->cold->theta_init=0;
+	mptr->cold->phi_init=0;
+	mptr->cold->vchannel=NULL;
+	mptr->cold->arrival_time=-1;
+	mptr->cold->domain_t=0;
+	mptr->cold->domain_t0=0;
+	mptr->cold->domain_r=0;
+	mptr->cold->nbr=NULL;
+	mptr->cold->nnbr=-1;
+	mptr->cold->maxnbr=0;
+	mptr->cold->nbrbox=NULL;
+
+	nreal=(3*dim*sizeof(molreal)+sizeof(double)-1)/sizeof(double);	// molreal vectors, in units of doubles
+	CHECKMEM(block=(double*) calloc(nreal+2*dim,sizeof(double)));	// pos, posx, prev_pos, via, posoffset share one block
+	mptr->pos=(molreal*) block;
+	mptr->posx=mptr->pos+dim;
+	mptr->prev_pos=mptr->pos+2*dim;
+	mptr->via=block+nreal;
+	mptr->posoffset=block+nreal+dim;
 	
 	/*
 	for(d=0;d<3;d++){
@@ -1303,37 +2017,21 @@ void molfree(simptr sim, moleculeptr mptr) {
 	siteptr site_tmp;
 	if(!mptr) return;
 	
-	// printf("mptr->serno=%d\n", mptr->serno);
+	// printf("mptr->serno=%ld\n", mptr->serno);
 	if(mptr->to)	mptr->to=NULL;
 	if(mptr->from)	mptr->from=NULL;
 	if(mptr->dif_molec) mptr->dif_molec=NULL;
 
 	if(mptr->pos) {	
 		mptr->pos=mptr->pos_tmp;	
-		free(mptr->pos);			
+		free(mptr->pos);						// also frees posx, via, posoffset and prev_pos
 		mptr->pos=NULL;
 		mptr->pos_tmp=NULL;
  	}
-
-	if(mptr->via) {
-		free(mptr->via);				
-		mptr->via=NULL;		
-	}
-
-	if(mptr->posx) {
-		free(mptr->posx);			
-		mptr->posx=NULL;
-	}
-
-	if(mptr->posoffset) {
-		free(mptr->posoffset);	
-		mptr->posoffset=NULL; 
-	}
-	
-	if(mptr->prev_pos) {
-		free(mptr->prev_pos);
-		mptr->prev_pos=NULL;
-	}
+	mptr->via=NULL;		
+	mptr->posx=NULL;
+	mptr->posoffset=NULL; 
+	mptr->prev_pos=NULL;
 	
 	if(mptr->sites) {
 		for(k=0;k<sim->mols->spsites_num[mptr->ident];k++) {
@@ -1345,11 +2043,16 @@ void molfree(simptr sim, moleculeptr mptr) {
 		free(mptr->sites);
 	}			
 
-	if(mptr->vchannel) {
-		fclose(mptr->vchannel->voltage_file);
-		mptr->vchannel->voltage_file=NULL;
-		free(mptr->vchannel);
-		mptr->vchannel=NULL;
+	if(mptr->cold) {
+		if(mptr->cold->vchannel) {
+			fclose(mptr->cold->vchannel->voltage_file);
+			mptr->cold->vchannel->voltage_file=NULL;
+			free(mptr->cold->vchannel);
+			mptr->cold->vchannel=NULL;
+		}
+		free(mptr->cold->nbr);
+		free(mptr->cold);
+		mptr->cold=NULL;
 	}
 
 	if(mptr) free(mptr); mptr=NULL;
@@ -1368,12 +2071,32 @@ complexptr complexalloc(simptr sim, moleculeptr mptr){
 	cplxptr->dif_bind_site=-1;
 	cplxptr->serno=0;
 	cplxptr->diffuse_updated=0;
+	cplxptr->layer=1;
+	cplxptr->nlive=0;
+	cplxptr->livei=-1;
+	cplxptr->connect=NULL;
+	cplxptr->nconnect=0;
+	cplxptr->maxconnect=0;
 	return cplxptr;
 failure:
 	simLog(sim,10,"Unable to allocate memory in complexalloc()");
 	return NULL;
 } 
 
+
+/* molclustersfree */
+void molclustersfree(clusterptr clus) {
+	if(!clus) return;
+	free(clus->parent);
+	free(clus->size);
+	if(clus->single) g_hash_table_destroy(clus->single);
+	free(clus->sizerow);
+	free(clus->bysize);
+	free(clus->member);
+	free(clus);
+	return; }
+
+
 void complexfree(complexptr cplxptr){
 	if(!cplxptr) return;
 	if(cplxptr->zeroindx_molec)
@@ -1382,10 +2105,39 @@ void complexfree(complexptr cplxptr){
 		cplxptr->dif_molec=NULL;
 	if(cplxptr->dif_bind)
 		cplxptr->dif_bind=NULL;
+	free(cplxptr->connect);
 	free(cplxptr);
 	return;
 }
 
+/* complexexpand.  Grows the complex registry arrays to hold maxnew ids.  Existing
+entries keep their ids, so complex_id values stored in molecules stay valid.
+Returns 0 for success or 1 for out of memory. */
+int complexexpand(molssptr mols,int maxnew) {
+	complexptr *newlist;
+	int *newfree,*newlive,i;
+
+	if(maxnew<=mols->max_complex) return 0;
+	newlist=(complexptr*) calloc(maxnew,sizeof(complexptr));
+	newfree=(int*) calloc(maxnew,sizeof(int));
+	newlive=(int*) calloc(maxnew,sizeof(int));
+	if(!newlist || !newfree || !newlive) {
+		free(newlist);
+		free(newfree);
+		free(newlive);
+		return 1; }
+	for(i=0;i<mols->ncomplex;i++) newlist[i]=mols->complexlist[i];
+	for(i=0;i<mols->nfreecomplex;i++) newfree[i]=mols->freecomplex[i];
+	for(i=0;i<mols->nlivecomplex;i++) newlive[i]=mols->complexlive[i];
+	free(mols->complexlist);
+	free(mols->freecomplex);
+	free(mols->complexlive);
+	mols->complexlist=newlist;
+	mols->freecomplex=newfree;
+	mols->complexlive=newlive;
+	mols->max_complex=maxnew;
+	return 0; }
+
 /* molexpandsurfdrift */
 int molexpandsurfdrift(simptr sim,int oldmaxspec,int oldmaxsrf) {	//?? needs to be called whenever maxspecies or maxsrf increase
 	double *****oldsurfdrift;
@@ -1491,6 +2243,8 @@ molssptr molssalloc(molssptr mols,int maxspecies) {
 	int newmols,i,j,**newexist,**newlistlookup,*newexpand,oldmaxspecies, *newspsites_num, *newvolt_dependent;// *newspdifsites;
 	enum MolecState ms;
 	char **newspname;
+	double *newgfrdrmax,*newgfrdbind,*newnbrcut,*newnbrskin;
+	int *newnbronly,*newspcount;
 	double **newdifc,**newdifstep,***newdifm,***newdrift,**newdisplay,***newcolor;
 
 	if(maxspecies<1) return NULL;
@@ -1535,15 +2289,66 @@ molssptr molssalloc(molssptr mols,int maxspecies) {
 		mols->nl=NULL;
 		mols->topl=NULL;
 		mols->sortl=NULL;
+		mols->chglog=NULL;
+		mols->nchglog=NULL;
+		mols->maxchglog=NULL;
 		mols->diffuselist=NULL;
+		mols->substep=NULL;
+		mols->stepdue=NULL;
+		mols->substepct=0;
+		mols->resortinterval=0;
+		mols->resortct=0;
 		mols->serno=1;
+		mols->sernopage=NULL;
+		mols->sernopagect=NULL;
+		mols->maxsernopage=0;
 		mols->ngausstbl=0;
 		mols->gausstbl=NULL;
 		mols->expand=NULL; 
+		mols->spcount=NULL;
+		mols->gfrdrmax=NULL;
+		mols->gfrdbind=NULL;
+		mols->gfrdheap=NULL;
+		mols->ngfrd=0;
+		mols->maxgfrd=0;
+		mols->gfrddue=NULL;
+		mols->ngfrddue=0;
+		mols->maxgfrddue=0;
+		mols->nbrcut=NULL;
+		mols->nbrskin=NULL;
+		mols->nbronly=NULL;
+		mols->nbrvalid=0;
+		mols->nbrbuf=NULL;
+		mols->maxnbrbuf=0;
+		mols->censusok=0;
+		mols->censusplan=0;
+		mols->census=NULL;
+		mols->ncensus=0;
+		mols->censuscmpt=NULL;
+		mols->maxcensuscmpt=0;
+		mols->censusitem=NULL;
+		mols->ncensusitem=0;
+		mols->maxcensusitem=0;
+		mols->censusmom=NULL;
+		mols->ncensusmom=0;
+		mols->censusbin=NULL;
+		mols->maxcensusbin=0;
+		mols->censusbinn=NULL;
+		mols->maxcensusbinn=0;
+		mols->redint=NULL;
+		mols->maxredint=0;
+		mols->reddbl=NULL;
+		mols->maxreddbl=0;
+		mols->clusters=NULL;
 
 		mols->complexlist=NULL;
 		mols->ncomplex=0; 		//-1;
 		mols->max_complex=0;
+		mols->freecomplex=NULL;
+		mols->nfreecomplex=0;
+		mols->complexlive=NULL;
+		mols->nlivecomplex=0;
+		mols->complexserno=1;
 		mols->spsites_num=NULL;
 		mols->spsites_name=NULL;
 		mols->spsites_binding=NULL;
@@ -1638,6 +2443,29 @@ molssptr molssalloc(molssptr mols,int maxspecies) {
 		for(i=0;i<oldmaxspecies;i++) newvolt_dependent[i]=mols->volt_dependent[i];
 		for(;i<maxspecies;i++) newvolt_dependent[i]=0;
 
+		CHECKMEM(newgfrdrmax=(double*) calloc(maxspecies,sizeof(double)));
+		for(i=0;i<oldmaxspecies;i++) newgfrdrmax[i]=mols->gfrdrmax[i];
+		for(;i<maxspecies;i++) newgfrdrmax[i]=0;
+
+		CHECKMEM(newgfrdbind=(double*) calloc(maxspecies,sizeof(double)));
+		for(i=0;i<oldmaxspecies;i++) newgfrdbind[i]=mols->gfrdbind[i];
+		for(;i<maxspecies;i++) newgfrdbind[i]=0;
+
+		CHECKMEM(newnbrcut=(double*) calloc(maxspecies,sizeof(double)));
+		for(i=0;i<oldmaxspecies;i++) newnbrcut[i]=mols->nbrcut[i];
+		for(;i<maxspecies;i++) newnbrcut[i]=0;
+
+		CHECKMEM(newnbrskin=(double*) calloc(maxspecies,sizeof(double)));
+		for(i=0;i<oldmaxspecies;i++) newnbrskin[i]=mols->nbrskin[i];
+		for(;i<maxspecies;i++) newnbrskin[i]=0;
+
+		CHECKMEM(newnbronly=(int*) calloc(maxspecies,sizeof(int)));
+		for(i=0;i<oldmaxspecies;i++) newnbronly[i]=mols->nbronly[i];
+		for(;i<maxspecies;i++) newnbronly[i]=0;
+
+		CHECKMEM(newspcount=(int*) calloc(maxspecies*MSMAX,sizeof(int)));
+		for(i=0;i<oldmaxspecies*MSMAX;i++) newspcount[i]=mols->spcount[i];
+		for(;i<maxspecies*MSMAX;i++) newspcount[i]=0;
 
 		mols->maxspecies=maxspecies;
 		free(mols->spname);
@@ -1664,6 +2492,18 @@ molssptr molssalloc(molssptr mols,int maxspecies) {
 		mols->spsites_num=newspsites_num;
 		free(mols->volt_dependent);
 		mols->volt_dependent=newvolt_dependent;
+		free(mols->gfrdrmax);
+		mols->gfrdrmax=newgfrdrmax;
+		free(mols->gfrdbind);
+		mols->gfrdbind=newgfrdbind;
+		free(mols->nbrcut);
+		mols->nbrcut=newnbrcut;
+		free(mols->nbrskin);
+		mols->nbrskin=newnbrskin;
+		free(mols->nbronly);
+		mols->nbronly=newnbronly;
+		free(mols->spcount);
+		mols->spcount=newspcount;
 		//g_hash_table_destroy(mols->spdifsites);
 		if(mols->surfdrift && mols->sim->srfss) { CHECK(molexpandsurfdrift(mols->sim,oldmaxspecies,mols->sim->srfss->maxsrf)==0); }}
 
@@ -1676,7 +2516,7 @@ molssptr molssalloc(molssptr mols,int maxspecies) {
 
 /* mollistalloc */
 int mollistalloc(molssptr mols,int maxlist,enum MolListType mlt) {
-	int *maxl,*nl,*topl,*sortl,*diffuselist,ll,m;
+	int *maxl,*nl,*topl,*sortl,*diffuselist,*substep,*stepdue,**chglog,*nchglog,*maxchglog,ll,m;
 	moleculeptr **live,mptr;
 	char **listname;
 	enum MolListType *listtype;
@@ -1693,7 +2533,12 @@ int mollistalloc(molssptr mols,int maxlist,enum MolListType mlt) {
 	nl=NULL;
 	topl=NULL;
 	sortl=NULL;
+	chglog=NULL;
+	nchglog=NULL;
+	maxchglog=NULL;
 	diffuselist=NULL;
+	substep=NULL;
+	stepdue=NULL;
 
 	CHECKMEM(listname=(char**) calloc(maxlist,sizeof(char*)));
 	for(ll=0;ll<maxlist;ll++) listname[ll]=NULL;
@@ -1716,9 +2561,24 @@ int mollistalloc(molssptr mols,int maxlist,enum MolListType mlt) {
 	CHECKMEM(sortl=(int*) calloc(maxlist,sizeof(int)));
 	for(ll=0;ll<maxlist;ll++) sortl[ll]=0;
 
+	CHECKMEM(chglog=(int**) calloc(maxlist,sizeof(int*)));
+	for(ll=0;ll<maxlist;ll++) chglog[ll]=NULL;
+
+	CHECKMEM(nchglog=(int*) calloc(maxlist,sizeof(int)));
+	for(ll=0;ll<maxlist;ll++) nchglog[ll]=0;
+
+	CHECKMEM(maxchglog=(int*) calloc(maxlist,sizeof(int)));
+	for(ll=0;ll<maxlist;ll++) maxchglog[ll]=0;
+
 	CHECKMEM(diffuselist=(int*) calloc(maxlist,sizeof(int)));
 	for(ll=0;ll<maxlist;ll++) diffuselist[ll]=0;
 
+	CHECKMEM(substep=(int*) calloc(maxlist,sizeof(int)));
+	for(ll=0;ll<maxlist;ll++) substep[ll]=1;
+
+	CHECKMEM(stepdue=(int*) calloc(maxlist,sizeof(int)));
+	for(ll=0;ll<maxlist;ll++) stepdue[ll]=1;
+
 	for(ll=0;ll<mols->maxlist;ll++) {			// copy over existing portions
 		listname[ll]=mols->listname[ll];
 		listtype[ll]=mols->listtype[ll];
@@ -1727,7 +2587,12 @@ int mollistalloc(molssptr mols,int maxlist,enum MolListType mlt) {
 		nl[ll]=mols->nl[ll];
 		topl[ll]=mols->topl[ll];
 		sortl[ll]=mols->sortl[ll];
+		chglog[ll]=mols->chglog[ll];
+		nchglog[ll]=mols->nchglog[ll];
+		maxchglog[ll]=mols->maxchglog[ll];
 		diffuselist[ll]=mols->diffuselist[ll];
+		substep[ll]=mols->substep[ll];
+		stepdue[ll]=mols->stepdue[ll];
 	 }
 
 	for(ll=mols->maxlist;ll<maxlist;ll++) {					// listnames and listtypes
@@ -1755,7 +2620,12 @@ int mollistalloc(molssptr mols,int maxlist,enum MolListType mlt) {
 		free(mols->nl);
 		free(mols->topl);
 		free(mols->sortl);
-		free(mols->diffuselist); 
+		free(mols->chglog);
+		free(mols->nchglog);
+		free(mols->maxchglog);
+		free(mols->diffuselist);
+		free(mols->substep);
+		free(mols->stepdue);
 	}
 
 	ll=mols->maxlist;
@@ -1767,7 +2637,12 @@ int mollistalloc(molssptr mols,int maxlist,enum MolListType mlt) {
 	mols->nl=nl;
 	mols->topl=topl;
 	mols->sortl=sortl;
+	mols->chglog=chglog;
+	mols->nchglog=nchglog;
+	mols->maxchglog=maxchglog;
 	mols->diffuselist=diffuselist;
+	mols->substep=substep;
+	mols->stepdue=stepdue;
 	return ll;
 
  failure:
@@ -1782,7 +2657,12 @@ int mollistalloc(molssptr mols,int maxlist,enum MolListType mlt) {
 	free(nl);
 	free(topl);
 	free(sortl);
+	free(chglog);
+	free(nchglog);
+	free(maxchglog);
 	free(diffuselist);
+	free(substep);
+	free(stepdue);
 	simLog(NULL,10,"Unable to allocate memory in mollistalloc");
 	return -1; }
 
@@ -1840,6 +2720,24 @@ void molssfree(molssptr mols,int maxsrf) {
 	maxspecies=mols->maxspecies;
 
 	free(mols->expand);
+	free(mols->spcount);
+	free(mols->gfrdrmax);
+	free(mols->gfrdbind);
+	free(mols->gfrdheap);
+	free(mols->gfrddue);
+	free(mols->nbrcut);
+	free(mols->nbrskin);
+	free(mols->nbronly);
+	free(mols->nbrbuf);
+	free(mols->census);
+	free(mols->censuscmpt);
+	free(mols->censusitem);
+	free(mols->censusmom);
+	free(mols->censusbin);
+	free(mols->censusbinn);
+	free(mols->redint);
+	free(mols->reddbl);
+	molclustersfree(mols->clusters);
 	free(mols->gausstbl);
 
 	// free(mols->spdifsites);
@@ -1854,10 +2752,15 @@ void molssfree(molssptr mols,int maxsrf) {
 		if(mols->live && mols->live[ll]) {
 			for(m=0;m<mols->nl[ll];m++)
 				molfree(mols->sim,mols->live[ll][m]);
-			printf("m=%d, ll=%d \n", m, ll);
-			free(mols->live[ll]); 
-	}}
+			SMOLTRACE(mols->sim,TCdiffuse,TLdebug,"m=%d, ll=%d \n", m, ll);
+			free(mols->live[ll]); }
+		if(mols->chglog) free(mols->chglog[ll]); }
 	free(mols->diffuselist);
+	free(mols->substep);
+	free(mols->stepdue);
+	free(mols->chglog);
+	free(mols->nchglog);
+	free(mols->maxchglog);
 	free(mols->sortl);
 	free(mols->topl);
 	free(mols->nl);
@@ -1867,10 +2770,18 @@ void molssfree(molssptr mols,int maxsrf) {
 	free(mols->listname);
 	
 	if(mols->complexlist) {
-		for(i=0;i<mols->max_complex;i++) 
+		for(i=0;i<mols->ncomplex;i++) 
 			complexfree(mols->complexlist[i]);
 		free(mols->complexlist);
 	}	
+	free(mols->freecomplex);
+	free(mols->complexlive);
+
+	if(mols->sernopage) {
+		for(i=0;i<mols->maxsernopage;i++)
+			free(mols->sernopage[i]);
+		free(mols->sernopage); }
+	free(mols->sernopagect);
 
 	if(mols->listlookup) {
 		for(i=0;i<maxspecies;i++){
@@ -1988,6 +2899,12 @@ void molssoutput(simptr sim) {
 	if(mols->condition!=SCok)
 		simLog(sim,7," Molecule superstructure condition: %s\n",simsc2string(mols->condition,string));
 	simLog(sim,1," Next molecule serial number: %li\n",mols->serno);
+	if(mols->resortinterval) simLog(sim,2," Live lists resorted in Morton order every %i time steps\n",mols->resortinterval);
+	for(i=1;i<mols->nspecies;i++)
+		if(mols->gfrdrmax && mols->gfrdrmax[i]>0) simLog(sim,2," %s uses protective domains up to radius %g\n",mols->spname[i],mols->gfrdrmax[i]);
+	if(mols->ngfrd) simLog(sim,1," %i molecules are in protective domains\n",mols->ngfrd);
+	for(i=1;i<mols->nspecies;i++)
+		if(mols->nbrcut && mols->nbrcut[i]>0) simLog(sim,2," %s uses neighbor lists with cutoff %g and skin %g\n",mols->spname[i],mols->nbrcut[i],mols->nbrskin[i]);
 	if(mols->gausstbl) simLog(sim,1," Table for Gaussian distributed random numbers has %i values\n",mols->ngausstbl);
 	else simLog(sim,1," Table for Gaussian distributed random numbers has not been set up\n");
 
@@ -2076,6 +2993,7 @@ void molssoutput(simptr sim) {
 		simLog(sim,1,"  %s: type=%s, allocated size=%i, number of molecules=%i",mols->listname[ll],molmlt2string(mols->listtype[ll],string),mols->maxl[ll],mols->nl[ll]);
 		if(mols->topl[ll]!=mols->nl[ll] && mols->topl!=0) simLog(sim,1,", top value=%i",mols->topl[ll]);
 		if(mols->sortl[ll]!=mols->nl[ll]) simLog(sim,1,", sort value=%i",mols->sortl[ll]);
+		if(mols->substep[ll]>1) simLog(sim,1,", diffuses every %i steps",mols->substep[ll]);
 		simLog(sim,1,"\n");
 		simLog(sim,2,"%s%s%s",ll==0?"  ":" ",mols->listname[ll],ll==mols->nlist-1?"\n":","); }
 
@@ -2201,7 +3119,7 @@ int checkmolparams(simptr sim,int *warnptr) {
 	moleculeptr mptr;
 	wallptr *wlist;
 	char **spname,string[STRCHAR];
-	double m2[DIMMAX*DIMMAX],diag;
+	double m2[DIMMAX*DIMMAX],diag,pbuf[DIMMAX];
 	enum MolecState ms;
 
 	error=warn=0;
@@ -2246,7 +3164,7 @@ int checkmolparams(simptr sim,int *warnptr) {
 	for(ll=0;ll<mols->nlist;ll++)
 		for(m=0;m<mols->nl[ll];m++)	{									// check for molecules outside system
 			mptr=mols->live[ll][m];
-			if(!posinsystem(sim,mptr->pos)) {
+			if(!posinsystem(sim,molreal2dbl(mptr->pos,pbuf,dim))) {
 				simLog(sim,5," WARNING: molecule #%li, of type '%s', is outside system volume\n",mptr->serno,spname[mptr->ident]);
 				warn++; }}
 
@@ -2367,6 +3285,48 @@ int molsetmaxmol(simptr sim,int max) {
 	sim->mols->maxdlimit=max;
 	return 0; }
 
+/* molsetresort */
+int molsetresort(simptr sim,int interval) {
+	int er;
+
+	if(!sim->mols) {
+		er=molenablemols(sim,-1);
+		if(er) return er; }
+	if(interval<0) return 2;
+	sim->mols->resortinterval=interval;
+	sim->mols->resortct=0;
+	return 0; }
+
+/* molsetnbrlist */
+int molsetnbrlist(simptr sim,int i,double cutoff,double skin) {
+	molssptr mols;
+
+	mols=sim->mols;
+	if(!mols || i<1 || i>=mols->nspecies) return 2;
+	if(cutoff<0 || skin<0) return 3;
+	mols->nbrcut[i]=cutoff;
+	mols->nbrskin[i]=skin;
+	mols->nbrvalid=0;
+	return 0; }
+
+/* molnbrstale.  Marks the neighbor lists as stale when a molecule changes from
+species i1 to species i2 and either species is listed.  Species 0 stands for
+the dead list, so this covers kills and births too. */
+void molnbrstale(molssptr mols,int i1,int i2) {
+	if(mols->nbrcut && i1!=i2 && (mols->nbrcut[i1]>0 || mols->nbrcut[i2]>0))
+		mols->nbrvalid=0;
+	return; }
+
+/* molsetlistsubstep */
+int molsetlistsubstep(simptr sim,int ll,int substep) {
+	molssptr mols;
+
+	mols=sim->mols;
+	if(!mols || ll<0 || ll>=mols->nlist) return 2;
+	if(substep<1) return 3;
+	mols->substep[ll]=substep;
+	return 0; }
+
 /* moldifsites */
 int moldifsites(simptr sim, char *species, char *site_name){
 	int er, sp_indx, site_indx;
@@ -2376,10 +3336,10 @@ int moldifsites(simptr sim, char *species, char *site_name){
 	mols=sim->mols;
 	if(!mols->spdifsites) mols->spdifsites=g_hash_table_new(g_direct_hash,g_direct_equal);
 	sp_indx=stringfind(mols->spname,mols->nspecies,species);
-	printf("sp_indx=%d\n",sp_indx);
+	SMOLTRACE(sim,TCcplx,TLdebug,"sp_indx=%d\n",sp_indx);
 	if(sp_indx<0) return -1;
 	site_indx=stringfind(mols->spsites_name[sp_indx],mols->spsites_num[sp_indx],site_name);
-	printf("site_indx=%d\n",site_indx);
+	SMOLTRACE(sim,TCcplx,TLdebug,"site_indx=%d\n",site_indx);
 	if(site_indx<0) return -2;
 	g_hash_table_insert(mols->spdifsites,GINT_TO_POINTER(sp_indx),g_slist_append((GSList*)g_hash_table_lookup(mols->spdifsites,GINT_TO_POINTER(sp_indx)),GINT_TO_POINTER(site_indx)));
 
@@ -2597,18 +3557,235 @@ int molsupdate(simptr sim) {
 /*********************** adding and removing molecules ************************/
 /******************************************************************************/
 
+/* molsernoinsert.  Enters molecule mptr into the serial number index under
+mptr->serno.  The index is a paged direct map, so pages are only allocated for
+ranges of serial numbers that have live molecules, and are freed again by
+molsernoremove once they empty.  Returns 0 for success or 1 for out of memory. */
+int molsernoinsert(molssptr mols,moleculeptr mptr) {
+	long int pg,maxnew,i;
+	moleculeptr **newpage;
+	int *newct,k;
+
+	if(mptr->serno<=0) return 0;
+	pg=mptr->serno>>SERNOPAGEBITS;
+	k=(int)(mptr->serno&((1L<<SERNOPAGEBITS)-1));
+	if(pg>=mols->maxsernopage) {
+		maxnew=2*mols->maxsernopage+1;
+		if(maxnew<=pg) maxnew=pg+1;
+		newpage=(moleculeptr**) calloc(maxnew,sizeof(moleculeptr*));
+		newct=(int*) calloc(maxnew,sizeof(int));
+		if(!newpage || !newct) {
+			free(newpage);
+			free(newct);
+			return 1; }
+		for(i=0;i<mols->maxsernopage;i++) {
+			newpage[i]=mols->sernopage[i];
+			newct[i]=mols->sernopagect[i]; }
+		free(mols->sernopage);
+		free(mols->sernopagect);
+		mols->sernopage=newpage;
+		mols->sernopagect=newct;
+		mols->maxsernopage=maxnew; }
+	if(!mols->sernopage[pg]) {
+		mols->sernopage[pg]=(moleculeptr*) calloc(1L<<SERNOPAGEBITS,sizeof(moleculeptr));
+		if(!mols->sernopage[pg]) return 1; }
+	if(!mols->sernopage[pg][k]) mols->sernopagect[pg]++;
+	mols->sernopage[pg][k]=mptr;
+	return 0; }
+
+
+/* molsernoremove.  Removes molecule mptr from the serial number index, if it is
+the molecule that is listed under its serial number. */
+void molsernoremove(molssptr mols,moleculeptr mptr) {
+	long int pg;
+	int k;
+
+	if(mptr->serno<=0) return;
+	pg=mptr->serno>>SERNOPAGEBITS;
+	k=(int)(mptr->serno&((1L<<SERNOPAGEBITS)-1));
+	if(pg>=mols->maxsernopage || !mols->sernopage[pg] || mols->sernopage[pg][k]!=mptr) return;
+	mols->sernopage[pg][k]=NULL;
+	if(--mols->sernopagect[pg]==0) {
+		free(mols->sernopage[pg]);
+		mols->sernopage[pg]=NULL; }
+	return; }
+
+
+/* molfindserno.  Returns the live molecule with serial number serno, or NULL if
+there isn't one. */
+moleculeptr molfindserno(molssptr mols,long int serno) {
+	long int pg;
+
+	if(serno<=0) return NULL;
+	pg=serno>>SERNOPAGEBITS;
+	if(pg>=mols->maxsernopage || !mols->sernopage[pg]) return NULL;
+	return mols->sernopage[pg][serno&((1L<<SERNOPAGEBITS)-1)]; }
+
+
+/* complexregister.  Returns a complex_id for a new complex of sunit subunits, or
+-1 if memory could not be allocated.  Released ids are reused before new ones are
+handed out and the registry grows geometrically, so this is amortized O(1). */
+int complexregister(molssptr mols,int sunit) {
+	int id;
+	complexptr cplx;
+
+	if(mols->nfreecomplex>0)
+		id=mols->freecomplex[--mols->nfreecomplex];
+	else {
+		if(mols->ncomplex==mols->max_complex)
+			if(complexexpand(mols,2*mols->max_complex+16)) return -1;
+		id=mols->ncomplex++; }
+
+	cplx=mols->complexlist[id];
+	if(!cplx) {
+		cplx=complexalloc(mols->sim,NULL);
+		if(!cplx) {
+			mols->freecomplex[mols->nfreecomplex++]=id;
+			return -1; }
+		mols->complexlist[id]=cplx; }
+	cplx->zeroindx_molec=NULL;
+	cplx->dif_molec=NULL;
+	cplx->dif_bind=NULL;
+	cplx->dif_bind_site=-1;
+	cplx->diffuse_updated=0;
+	cplx->layer=1;
+	cplx->serno=mols->complexserno++;
+	cplx->nlive=sunit;
+	cplx->livei=mols->nlivecomplex;
+	mols->complexlive[mols->nlivecomplex++]=id;
+	return id; }
+
+
+/* complexrelease.  Removes complex id from the list of live complexes and puts it
+on the free stack for reuse.  The complex structure itself is kept for the next
+complex that gets this id, but its complex_connect entries are removed so that
+the next complex doesn't inherit its bonds. */
+void complexrelease(molssptr mols,int id) {
+	complexptr cplx;
+	int k,idlast;
+
+	if(id<0 || id>=mols->ncomplex) return;
+	cplx=mols->complexlist[id];
+	if(!cplx || cplx->livei<0) return;
+	k=cplx->livei;
+	idlast=mols->complexlive[--mols->nlivecomplex];
+	mols->complexlive[k]=idlast;
+	mols->complexlist[idlast]->livei=k;
+	while(cplx->nconnect>0)
+		complexdisconnect(mols,id,cplx->connect[cplx->nconnect-1]);
+	cplx->livei=-1;
+	cplx->nlive=0;
+	cplx->zeroindx_molec=NULL;
+	cplx->dif_molec=NULL;
+	cplx->dif_bind=NULL;
+	mols->freecomplex[mols->nfreecomplex++]=id;
+	return; }
+
+
+/* complexconnect.  Records in complex_connect that complexes id1 and id2 are bound
+to each other, with value1 under the (id1,id2) key and value2 under (id2,id1).
+Each complex also lists the other, so that complexrelease can find the entries.
+Returns 0 for success or 1 for out of memory. */
+int complexconnect(molssptr mols,int id1,int id2,int value1,int value2) {
+	complexptr cplx;
+	int k,j,id,*newconnect;
+	gpointer key1,key2;
+
+	key1=GINT_TO_POINTER(g_pairing(id1,id2));
+	key2=GINT_TO_POINTER(g_pairing(id2,id1));
+	if(!g_hash_table_lookup(mols->complex_connect,key1) && !g_hash_table_lookup(mols->complex_connect,key2))
+		for(k=0;k<2;k++) {
+			id=k?id2:id1;
+			cplx=mols->complexlist[id];
+			if(cplx->nconnect==cplx->maxconnect) {
+				newconnect=(int*) calloc(2*cplx->maxconnect+4,sizeof(int));
+				if(!newconnect) return 1;
+				for(j=0;j<cplx->nconnect;j++) newconnect[j]=cplx->connect[j];
+				free(cplx->connect);
+				cplx->connect=newconnect;
+				cplx->maxconnect=2*cplx->maxconnect+4; }
+			cplx->connect[cplx->nconnect++]=k?id1:id2; }
+	g_hash_table_insert(mols->complex_connect,key1,GINT_TO_POINTER(value1));
+	g_hash_table_insert(mols->complex_connect,key2,GINT_TO_POINTER(value2));
+	return 0; }
+
+
+/* complexdisconnect.  Removes the complex_connect entries between complexes id1
+and id2, if there are any. */
+void complexdisconnect(molssptr mols,int id1,int id2) {
+	complexptr cplx;
+	int k,j,id,other;
+
+	g_hash_table_remove(mols->complex_connect,GINT_TO_POINTER(g_pairing(id1,id2)));
+	g_hash_table_remove(mols->complex_connect,GINT_TO_POINTER(g_pairing(id2,id1)));
+	for(k=0;k<2;k++) {
+		id=k?id2:id1;
+		other=k?id1:id2;
+		if(id<0 || id>=mols->ncomplex || !(cplx=mols->complexlist[id])) continue;
+		for(j=0;j<cplx->nconnect && cplx->connect[j]!=other;j++);
+		if(j<cplx->nconnect) cplx->connect[j]=cplx->connect[--cplx->nconnect]; }
+	return; }
+
+
+/* moltally.  Brings the running counts in spcount up to date with the species
+and state of mptr.  Every place that gives a live molecule a new identity or state,
+or moves a new molecule into a live list, calls this, so spcount always matches
+what a full scan of the live lists would find. */
+void moltally(molssptr mols,moleculeptr mptr) {
+	int k;
+
+	k=mptr->ident>0?mptr->ident*MSMAX+mptr->mstate:-1;
+	if(k==mptr->tally) return;
+	if(mptr->tally>=0) mols->spcount[mptr->tally]--;
+	if(k>=0) mols->spcount[k]++;
+	mptr->tally=k;
+	return; }
+
+
+/* mollistlog */
+void mollistlog(molssptr mols,moleculeptr mptr,int ll,int m) {
+	int *newlog,k,newmax;
+
+	if(ll<0) return;
+	if(m<0 || m>=mols->nl[ll] || mols->live[ll][m]!=mptr) m=mptr->m;
+	if(m<0 || m>=mols->nl[ll] || mols->live[ll][m]!=mptr) {		// slot unknown, sweep whole list
+		mols->sortl[ll]=0;
+		mols->nchglog[ll]=-1;
+		return; }
+	if(m<mols->sortl[ll]) mols->sortl[ll]=m;
+	if(mols->nchglog[ll]<0) return;
+	if(mols->nchglog[ll]==mols->maxchglog[ll]) {
+		newmax=2*mols->maxchglog[ll]+16;
+		newlog=(int*) calloc(newmax,sizeof(int));
+		if(!newlog) {
+			mols->nchglog[ll]=-1;
+			return; }
+		for(k=0;k<mols->nchglog[ll];k++) newlog[k]=mols->chglog[ll][k];
+		free(mols->chglog[ll]);
+		mols->chglog[ll]=newlog;
+		mols->maxchglog[ll]=newmax; }
+	mols->chglog[ll][mols->nchglog[ll]++]=m;
+	return; }
+
+
 /* molkill */
 void molkill(simptr sim,moleculeptr mptr,int ll,int m) {
 	int s,dim,d,*sortl,s1;
 	moleculeptr mptr_bind;
+	complexptr cplx;
 
 	if(mptr->dif_molec) return;
 
 	dim=sim->dim;
 	sortl=sim->mols->sortl;	
+	molsernoremove(sim->mols,mptr);
+	gfrdremove(sim->mols,mptr);
+	molnbrstale(sim->mols,mptr->ident,0);
+	mptr->cold->nnbr=-1;
 
 	mptr->ident=0;
 	mptr->mstate=MSsoln;
+	moltally(sim->mols,mptr);
 	mptr->list=-1;
 	mptr->pos=mptr->pos_tmp;
 	for(d=0;d<sim->dim;d++) {
@@ -2624,6 +3801,9 @@ void molkill(simptr sim,moleculeptr mptr,int ll,int m) {
 	mptr->tot_sunit=0;
 
 	// mptr->react_permit=0;
+	if(mptr->complex_id>=0) {
+		cplx=sim->mols->complexlist[mptr->complex_id];
+		if(cplx && --cplx->nlive<=0) complexrelease(sim->mols,mptr->complex_id); }
 	mptr->complex_id=-1;
 		
 	for(s=0;s<sim->mols->spsites_num[mptr->ident];s++){
@@ -2641,13 +3821,12 @@ void molkill(simptr sim,moleculeptr mptr,int ll,int m) {
 					mptr_bind->sites[s]->value[0]=0;
 				}
 			}	
+			molsitesupdate(sim->mols,mptr_bind);
 			mptr->sites[s]->bind=NULL;
 		}
 	}
 
-  if(ll<0);
-	else if(m<0) sim->mols->sortl[ll]=0;
-	else if(m<sim->mols->sortl[ll]) sim->mols->sortl[ll]=m;
+	mollistlog(sim->mols,mptr,ll,m);
 	return; }
 
 
@@ -2669,13 +3848,21 @@ moleculeptr getnextmol(molssptr mols) {
 		if(er) return NULL; }
 
 	mptr_cplx=(moleculeptr*) calloc(sunit, sizeof(moleculeptr));
+	if(!mptr_cplx) return NULL;
 	for(s=0;s<sunit;s++){
-		mptr_cplx[s]=mols->dead[--mols->topd];
-		mptr_cplx[s]->serno=mols->serno++;	
+		mptr_cplx[s]=mols->dead[mols->topd-1];
+		mptr_cplx[s]->serno=mols->serno;
+		if(molsernoinsert(mols,mptr_cplx[s])) {		// still dead, so nothing to undo
+			free(mptr_cplx);
+			return NULL; }
+		mols->topd--;
+		mols->serno++;
 		mptr_cplx[s]->s_index=s;
+		mptr_cplx[s]->sites_val=0;
 	}
 	//printf("not cplx nmol: %d\n", nmol);
 	mptr=mptr_cplx[0];
+	free(mptr_cplx);
 	return mptr; }
 
 
@@ -2685,22 +3872,11 @@ moleculeptr getnextmol_cplx(molssptr mols, int sunit, int ident) {
 	int er,nmol;
 	int s, s_from, s_to;
 	double theta_init, phi_init;
-	int d,i,k,spsites_num,site_indx;
+	int d,k,spsites_num,site_indx;
 	char **spsites_name, *site_bind, sitename_tmp[STRCHAR];
-	complexptr *complexlist_old, *complexlist_new, complex_tmp=NULL;
-	
-	if(sunit>1){
-		complexlist_old=mols->complexlist;
-		complexlist_new=(complexptr*) calloc(mols->max_complex, sizeof(complexptr));
-		if(complexlist_new!=NULL){
-			if(complexlist_old){
-				for(i=0;i<mols->ncomplex;i++) complexlist_new[i]=complexlist_old[i];
-				free(complexlist_old);	}
-			mols->complexlist=complexlist_new;
-		}
-		mols->ncomplex++;
-	}
+	int complex_id;
 
+	complex_id=-1;
 	if(mols->topd<sunit) {
 		if(mols->maxdlimit>=0 && mols->maxd>=mols->maxdlimit) return NULL;
 		//nmol=mols->maxd+1;
@@ -2712,6 +3888,19 @@ moleculeptr getnextmol_cplx(molssptr mols, int sunit, int ident) {
 		if(er) return NULL; 
 	}
 
+	for(s=0;s<sunit;s++) {							// index serial numbers before taking any molecules
+		mptr_tmp=mols->dead[mols->topd-1-s];
+		mptr_tmp->serno=mols->serno+s;
+		if(molsernoinsert(mols,mptr_tmp)) {
+			while(--s>=0) molsernoremove(mols,mols->dead[mols->topd-1-s]);
+			return NULL; }}
+
+	if(sunit>1) {
+		complex_id=complexregister(mols,sunit);
+		if(complex_id<0) {
+			for(s=0;s<sunit;s++) molsernoremove(mols,mols->dead[mols->topd-1-s]);
+			return NULL; }}
+
 	// rand() between 0 and RAND_MAX
 
 	mptr_cplx=&(mols->dead[mols->topd-1]);
@@ -2721,12 +3910,13 @@ moleculeptr getnextmol_cplx(molssptr mols, int sunit, int ident) {
 	spsites_num=mols->spsites_num[ident];
 	for(s=0;s<sunit;s++){
 		mptr_tmp=mols->dead[--mols->topd];
-		mptr_tmp->serno=mols->serno++;	
+		mptr_tmp->serno=mols->serno++;			// already in the serial number index
 		mptr_tmp->ident=ident;
 		mptr_tmp->s_index=sunit-1-s;
 		mptr_tmp->tot_sunit=sunit;
-		mptr_tmp->theta_init=theta_init;
-		mptr_tmp->phi_init=phi_init;
+		mptr_tmp->sites_val=0;
+		mptr_tmp->cold->theta_init=theta_init;
+		mptr_tmp->cold->phi_init=phi_init;
 		mptr_tmp->ident=ident;
 		mptr_tmp->bind_id=ident;
 		if(spsites_num>0){
@@ -2739,24 +3929,19 @@ moleculeptr getnextmol_cplx(molssptr mols, int sunit, int ident) {
 				mptr_tmp->sites[k]->time=-1;
 		}}
 		if(sunit>1) {
-			if(mptr_tmp->s_index==0){
-				complex_tmp=complexalloc(mols->sim, mptr_tmp);
-				if(complex_tmp){
-					complex_tmp->serno=mols->ncomplex;
-					mols->complexlist[mols->ncomplex-1]=complex_tmp;			// the first element will start from 1 if offsetting it
-					complex_tmp->layer=1; // 2;
-			}}
-			mptr_tmp->complex_id=mols->ncomplex-1;
+			if(mptr_tmp->s_index==0)
+				mols->complexlist[complex_id]->zeroindx_molec=mptr_tmp;
+			mptr_tmp->complex_id=complex_id;
 		}	
 		if(mols->volt_dependent[ident]==1){
-			mptr_tmp->vchannel=(vchnlptr) calloc(1,sizeof(vchnlstruct));	
-			mptr_tmp->vchannel->voltage_file=fopen(mols->sim->vfile,"r");
-			mptr_tmp->vchannel->vtime=-1;
-			mptr_tmp->vchannel->vtime_n=-1;
-			mptr_tmp->vchannel->molec_gen=-1;
-			//mptr_tmp->vchannel->voltage_file=fopen("/home/neuro/Documents/from_axon/dat_files/soma_v_10Hz.txt","r");
-			//mptr_tmp->vchannel->voltage=0;
-			mptr_tmp->vchannel->mptr=mptr_tmp;
+			mptr_tmp->cold->vchannel=(vchnlptr) calloc(1,sizeof(vchnlstruct));	
+			mptr_tmp->cold->vchannel->voltage_file=fopen(mols->sim->vfile,"r");
+			mptr_tmp->cold->vchannel->vtime=-1;
+			mptr_tmp->cold->vchannel->vtime_n=-1;
+			mptr_tmp->cold->vchannel->molec_gen=-1;
+			//mptr_tmp->cold->vchannel->voltage_file=fopen("/home/neuro/Documents/from_axon/dat_files/soma_v_10Hz.txt","r");
+			//mptr_tmp->cold->vchannel->voltage=0;
+			mptr_tmp->cold->vchannel->mptr=mptr_tmp;
 		}
 	}
 
@@ -2764,7 +3949,7 @@ moleculeptr getnextmol_cplx(molssptr mols, int sunit, int ident) {
 		mptr_tmp=mptr_cplx[-s];
 		if(sunit>1){
 			// adjusted for index and s differences
-			s_from=(s+1)>sunit?(s+1)%sunit:(s+1);			
+			s_from=(s+1)>=sunit?(s+1)%sunit:(s+1);			
 			s_to=(s-1)<0?(s-1+sunit):(s-1);
 			mptr_tmp->from=mptr_cplx[-s_from];
 			mptr_tmp->to=mptr_cplx[-s_to];
@@ -2800,6 +3985,7 @@ moleculeptr newestmol(molssptr mols) {
 /* addmol */
 int addmol(simptr sim,int nmol,int ident,double *poslo,double *poshi,int sort) {
 	int m,d;
+	double pbuf[DIMMAX];
 	moleculeptr mptr;
 
 	for(m=0;m<nmol;m++) {
@@ -2816,7 +4002,7 @@ int addmol(simptr sim,int nmol,int ident,double *poslo,double *poshi,int sort) {
 			for(d=0;d<sim->dim;d++)
 				mptr->posx[d]=mptr->pos[d]=unirandOOD(poslo[d],poshi[d]);
 		if(sim->boxs && sim->boxs->nbox)
-			mptr->box=pos2box(sim,mptr->pos);
+			mptr->box=pos2box(sim,molreal2dbl(mptr->pos,pbuf,sim->dim));
 		else mptr->box=NULL; }
 	molsetexist(sim,ident,MSsoln,1);
 	if(sort)
@@ -2826,9 +4012,10 @@ int addmol(simptr sim,int nmol,int ident,double *poslo,double *poshi,int sort) {
 /* addmol_cplx */
 int addmol_cplx(simptr sim,int num_mol,int sunit,int bind_num,int *ident,int *sites,double *poslo,double *poshi,int sort, int ident_free, int sites_free) {
 	int m,d;
+	double pbuf[DIMMAX];
 	moleculeptr mptr, mptr_tmp, mptr_bound;
 
-	if(sunit>1) sim->mols->max_complex+=num_mol;
+	if(sunit>1 && complexexpand(sim->mols,sim->mols->ncomplex+num_mol)) return 3;
 	for(m=0;m<num_mol;m++) {
 		mptr=getnextmol_cplx(sim->mols,sunit,ident[0]);
 		if(!mptr) return 3;
@@ -2844,13 +4031,13 @@ int addmol_cplx(simptr sim,int num_mol,int sunit,int bind_num,int *ident,int *si
 				mptr->posx[d]=mptr->prev_pos[d]=mptr->pos[d]=unirandOOD(poslo[d],poshi[d]);
 			complex_pos_init(sim,mptr,NULL);	 }
 
-		if(sim->boxs && sim->boxs->nbox) mptr->box=pos2box(sim,mptr->pos);
+		if(sim->boxs && sim->boxs->nbox) mptr->box=pos2box(sim,molreal2dbl(mptr->pos,pbuf,sim->dim));
 		else mptr->box=NULL;
 		mptr_tmp=mptr;
 		while(mptr_tmp->to!=NULL && mptr_tmp->s_index < mptr_tmp->to->s_index) {
 			mptr_tmp->to->mstate=MSsoln;
 			mptr_tmp->to->list=sim->mols->listlookup[ident[0]][MSsoln];
-			if(sim->boxs && sim->boxs->nbox) mptr_tmp->box=pos2box(sim,mptr_tmp->pos);
+			if(sim->boxs && sim->boxs->nbox) mptr_tmp->box=pos2box(sim,molreal2dbl(mptr_tmp->pos,pbuf,sim->dim));
 			else mptr_tmp->box=NULL;
 			// complex_pos_init(sim,mptr_tmp,NULL);	
 			mptr_tmp=mptr_tmp->to;
@@ -2870,13 +4057,15 @@ int addmol_cplx(simptr sim,int num_mol,int sunit,int bind_num,int *ident,int *si
 			mptr->sites[0]->bind=mptr_bound;
 			mptr_bound->sites[1]->bind=mptr;
 			mptr_bound->dif_molec=mptr;
-			mptr_bound->sites_val=molecsites_state(sim->mols,mptr_bound);
+			molsitesupdate(sim->mols,mptr_bound);
 			if(sim->events){
-				fprintf(sim->events,"rxn_time=%f start bound_ident=%s bound_serno=%d bound_state=%d  pos[0]=%f pos[1]=%f pos[2]=%f complex_id=%d\n", sim->time,sim->mols->spname[mptr_bound->ident], mptr_bound->serno, mptr_bound->sites_val, mptr_bound->pos[0], mptr_bound->pos[1], mptr_bound->pos[2], mptr_bound->complex_id);}
+				fprintf(sim->events,"rxn_time=%f start bound_ident=%s bound_serno=%ld bound_state=%d  pos[0]=%f pos[1]=%f pos[2]=%f complex_id=%d\n", sim->time,sim->mols->spname[mptr_bound->ident], mptr_bound->serno, mptr_bound->sites_val, mptr_bound->pos[0], mptr_bound->pos[1], mptr_bound->pos[2], mptr_bound->complex_id);}
+			simeventlog(sim,ERstart,NULL,-1,mptr_bound,NULL,-1,-1,0);
 		}		
-		mptr->sites_val=molecsites_state(sim->mols,mptr);
+		molsitesupdate(sim->mols,mptr);
 		if(sim->events)	{
-			fprintf(sim->events,"rxn_time=%f start ident=%s serno=%d sites_val=%d pos[0]=%f pos[1]=%f pos[2]=%f complex_id=%d\n", sim->time,sim->mols->spname[mptr->ident],mptr->serno,mptr->sites_val,mptr->pos[0],mptr->pos[1],mptr->pos[2], mptr->complex_id);}
+			fprintf(sim->events,"rxn_time=%f start ident=%s serno=%ld sites_val=%d pos[0]=%f pos[1]=%f pos[2]=%f complex_id=%d\n", sim->time,sim->mols->spname[mptr->ident],mptr->serno,mptr->sites_val,mptr->pos[0],mptr->pos[1],mptr->pos[2], mptr->complex_id);}
+		simeventlog(sim,ERstart,NULL,-1,mptr,NULL,-1,-1,0);
 	
 	}	
 	molsetexist(sim,ident[0],MSsoln,1);
@@ -3000,7 +4189,9 @@ int addsurfmol_cplx(simptr sim,int nmol,int sunit,int bind_num,int *ident,int *s
 			if(!mptr) return 3;
 			mptr->mstate=ms;
 			mptr->list=sim->mols->listlookup[ident[0]][ms];
-			if(bind_num==1 && sites!=NULL) mptr->sites[0]->value[0]=1;
+			if(bind_num==1 && sites!=NULL) {
+				mptr->sites[0]->value[0]=1;
+				molsitesupdate(sim->mols,mptr); }
 			mptr->pnl=pnl;
 			if(pos)
 				for(d=0;d<dim;d++) mpos[d]=pos[d];
@@ -3060,8 +4251,9 @@ int addsurfmol_cplx(simptr sim,int nmol,int sunit,int bind_num,int *ident,int *s
 			if(sim->boxs && sim->boxs->nbox) mptr->box=pos2box(sim,mpos);
 			else mptr->box=NULL;
 			if(sim->events){
-				fprintf(sim->events,"rxn_time=%f start ident=%s serno=%d sites_val=%d pos[0]=%f pos[1]=%f pos[2]=%f complex_id=%d\n", sim->time,sim->mols->spname[mptr->ident],mptr->serno,mptr->sites_val,mptr->pos[0],mptr->pos[1],mptr->pos[2],mptr->complex_id);		
+				fprintf(sim->events,"rxn_time=%f start ident=%s serno=%ld sites_val=%d pos[0]=%f pos[1]=%f pos[2]=%f complex_id=%d\n", sim->time,sim->mols->spname[mptr->ident],mptr->serno,mptr->sites_val,mptr->pos[0],mptr->pos[1],mptr->pos[2],mptr->complex_id);		
 			}
+			simeventlog(sim,ERstart,NULL,-1,mptr,NULL,-1,-1,0);
 		 }
 
 		free(paneltable);
@@ -3079,6 +4271,7 @@ int addsurfmol_cplx(simptr sim,int nmol,int sunit,int bind_num,int *ident,int *s
 /* addcompartmol */
 int addcompartmol(simptr sim,int nmol,int ident,compartptr cmpt) {
 	int d,dim,m,er;
+	double pbuf[DIMMAX],*pos;
 	moleculeptr mptr;
 
 	if(cmpt->npts==0 && cmpt->ncmptl==0) return 2;
@@ -3089,10 +4282,12 @@ int addcompartmol(simptr sim,int nmol,int ident,compartptr cmpt) {
 		mptr->ident=ident;
 		mptr->mstate=MSsoln;
 		mptr->list=sim->mols->listlookup[ident][MSsoln];
-		er=compartrandpos(sim,mptr->pos,cmpt);
+		pos=molreal2dbl(mptr->pos,pbuf,dim);
+		er=compartrandpos(sim,pos,cmpt);
 		if(er) return 2;
+		dbl2molreal(pos,mptr->pos,dim);
 		for(d=0;d<dim;d++) mptr->posx[d]=mptr->prev_pos[d]=mptr->pos[d];
-		if(sim->boxs && sim->boxs->nbox) mptr->box=pos2box(sim,mptr->pos);
+		if(sim->boxs && sim->boxs->nbox) mptr->box=pos2box(sim,molreal2dbl(mptr->pos,pbuf,sim->dim));
 		else mptr->box=NULL; }
 	molsetexist(sim,ident,MSsoln,1);
 	return 0; }
@@ -3100,12 +4295,13 @@ int addcompartmol(simptr sim,int nmol,int ident,compartptr cmpt) {
 /* addcompartmol_cplx*/
 int addcompartmol_cplx(simptr sim,int num_mol,int sunit,int bind_num,int *ident,int *sites_val,compartptr cmpt){
 	int d,dim,m,k,er;
+	double pbuf[DIMMAX],*pos;
 	moleculeptr mptr, mptr_tmp, mptr_bound;
 	int sunit_i;
 
 	if(cmpt->npts==0 && cmpt->ncmptl==0) return 2;
 	dim=sim->dim;
-	if(sunit>1) sim->mols->max_complex+=num_mol;
+	if(sunit>1 && complexexpand(sim->mols,sim->mols->ncomplex+num_mol)) return 3;
 	for(m=0;m<num_mol;m++) {
 		mptr=getnextmol_cplx(sim->mols,sunit,ident[0]);
 		if(!mptr) return 3;
@@ -3134,14 +4330,17 @@ int addcompartmol_cplx(simptr sim,int num_mol,int sunit,int bind_num,int *ident,
 			if(bind_num==1 && sites_val!=NULL) {
 				if(sites_val[1]==-1){
 					mptr_tmp->to->sites[sites_val[0]]->value[0]=1; 
+					molsitesupdate(sim->mols,mptr_tmp->to);
 				}
 			}
 			mptr_tmp=mptr_tmp->to;
 		}
-		er=compartrandpos(sim,mptr->pos,cmpt);
+		pos=molreal2dbl(mptr->pos,pbuf,dim);
+		er=compartrandpos(sim,pos,cmpt);
 		if(er) return 2;
+		dbl2molreal(pos,mptr->pos,dim);
 		for(d=0;d<dim;d++) mptr->posx[d]=mptr->prev_pos[d]=mptr->pos[d];
-		if(sim->boxs && sim->boxs->nbox) mptr->box=pos2box(sim,mptr->pos);
+		if(sim->boxs && sim->boxs->nbox) mptr->box=pos2box(sim,molreal2dbl(mptr->pos,pbuf,sim->dim));
 		else mptr->box=NULL; 
 		
 		complex_pos_init(sim,mptr,cmpt);	
@@ -3149,7 +4348,7 @@ int addcompartmol_cplx(simptr sim,int num_mol,int sunit,int bind_num,int *ident,
 		sunit_i=1;
 		while(mptr_tmp->to!=NULL && mptr_tmp->s_index!=mptr_tmp->to->s_index && sunit_i<=mptr->tot_sunit) {		
 			for(d=0;d<dim;d++) mptr_tmp->to->posx[d]=mptr_tmp->to->prev_pos[d]=mptr_tmp->to->pos[d];
-			if(sim->boxs && sim->boxs->nbox) mptr_tmp->to->box=pos2box(sim,mptr_tmp->to->pos);
+			if(sim->boxs && sim->boxs->nbox) mptr_tmp->to->box=pos2box(sim,molreal2dbl(mptr_tmp->to->pos,pbuf,sim->dim));
 			else mptr_tmp->to->box=NULL;
 			mptr_tmp=mptr_tmp->to;
 			sunit_i++;
@@ -3171,15 +4370,17 @@ int addcompartmol_cplx(simptr sim,int num_mol,int sunit,int bind_num,int *ident,
 			mptr->sites[sites_val[0]]->bind=mptr_bound;
 			mptr_bound->sites[sites_val[1]]->bind=mptr;
 			mptr_bound->dif_molec=mptr;
-			mptr_bound->sites_val=molecsites_state(sim->mols,mptr_bound);	
+			molsitesupdate(sim->mols,mptr_bound);	
 			if(sim->events){
-				fprintf(sim->events,"rxn_time=%f start bound_ident=%s bound_serno=%d sites_val=%d pos[0]=%f pos[1]=%f pos[2]=%f complex_id=%d\n", sim->time,sim->mols->spname[mptr_bound->ident],mptr_bound->serno,mptr_bound->sites_val,mptr_bound->pos[0],mptr_bound->pos[1],mptr_bound->pos[2], mptr_bound->complex_id);
+				fprintf(sim->events,"rxn_time=%f start bound_ident=%s bound_serno=%ld sites_val=%d pos[0]=%f pos[1]=%f pos[2]=%f complex_id=%d\n", sim->time,sim->mols->spname[mptr_bound->ident],mptr_bound->serno,mptr_bound->sites_val,mptr_bound->pos[0],mptr_bound->pos[1],mptr_bound->pos[2], mptr_bound->complex_id);
 			}
+			simeventlog(sim,ERstart,NULL,-1,mptr_bound,NULL,-1,-1,0);
 		}
-		mptr->sites_val=molecsites_state(sim->mols,mptr);
+		molsitesupdate(sim->mols,mptr);
 		if(sim->events){
-			fprintf(sim->events,"rxn_time=%f start ident=%s serno=%d sites_val=%d pos[0]=%f pos[1]=%f pos[2]=%f complex_id=%d\n", sim->time,sim->mols->spname[mptr->ident],mptr->serno,mptr->sites_val,mptr->pos[0],mptr->pos[1],mptr->pos[2],mptr->complex_id);		
+			fprintf(sim->events,"rxn_time=%f start ident=%s serno=%ld sites_val=%d pos[0]=%f pos[1]=%f pos[2]=%f complex_id=%d\n", sim->time,sim->mols->spname[mptr->ident],mptr->serno,mptr->sites_val,mptr->pos[0],mptr->pos[1],mptr->pos[2],mptr->complex_id);		
 		}
+		simeventlog(sim,ERstart,NULL,-1,mptr,NULL,-1,-1,0);
 	}	
 	molsetexist(sim,ident[0],MSsoln,1);
 	if(bind_num>1)	molsetexist(sim,ident[1],MSsoln,1);
@@ -3188,16 +4389,15 @@ int addcompartmol_cplx(simptr sim,int num_mol,int sunit,int bind_num,int *ident,
 
 	return 0; }
 
-int updatecompartmol_cplx(simptr sim,int serno, int bind_num,int *ident,int *sites_val,compartptr cmpt){
-	int d,dim,m,k,er;
+int updatecompartmol_cplx(simptr sim,long int serno, int bind_num,int *ident,int *sites_val,compartptr cmpt){
+	int d,dim,k,er;
 	moleculeptr mptr, mptr_tmp, mptr_bound;
 	int sunit_i;
 
 	if(cmpt->npts==0 && cmpt->ncmptl==0) return 2;
 	dim=sim->dim;
-	m=sim->mols->maxd-serno;
-	mptr=sim->mols->dead[m];
-	if(!mptr) return 3;
+	mptr=molfindserno(sim->mols,serno);
+	if(!mptr) return 5;
 	if(bind_num==1 && sites_val!=NULL) {
 		mptr->sites[sites_val[0]]->value[0]=1;		// phosphorylation or actin binding set to 1	
 		if(sites_val[1]>0)
@@ -3230,15 +4430,17 @@ int updatecompartmol_cplx(simptr sim,int serno, int bind_num,int *ident,int *sit
 		mptr->sites[sites_val[0]]->bind=mptr_bound;
 		mptr_bound->sites[sites_val[1]]->bind=mptr;
 		mptr_bound->dif_molec=mptr;
-		mptr_bound->sites_val=molecsites_state(sim->mols,mptr_bound);	
+		molsitesupdate(sim->mols,mptr_bound);	
 		if(sim->events){
-			fprintf(sim->events,"rxn_time=%f start bound_ident=%s bound_serno=%d sites_val=%d pos[0]=%f pos[1]=%f pos[2]=%f complex_id=%d\n", sim->time,sim->mols->spname[mptr_bound->ident],mptr_bound->serno,mptr_bound->sites_val,mptr_bound->pos[0],mptr_bound->pos[1],mptr_bound->pos[2], mptr_bound->complex_id);
+			fprintf(sim->events,"rxn_time=%f start bound_ident=%s bound_serno=%ld sites_val=%d pos[0]=%f pos[1]=%f pos[2]=%f complex_id=%d\n", sim->time,sim->mols->spname[mptr_bound->ident],mptr_bound->serno,mptr_bound->sites_val,mptr_bound->pos[0],mptr_bound->pos[1],mptr_bound->pos[2], mptr_bound->complex_id);
 		}
+		simeventlog(sim,ERstart,NULL,-1,mptr_bound,NULL,-1,-1,0);
 	}
-	mptr->sites_val=molecsites_state(sim->mols,mptr);
+	molsitesupdate(sim->mols,mptr);
 	if(sim->events){
-		fprintf(sim->events,"rxn_time=%f start ident=%s serno=%d sites_val=%d pos[0]=%f pos[1]=%f pos[2]=%f complex_id=%d\n", sim->time,sim->mols->spname[mptr->ident],mptr->serno,mptr->sites_val,mptr->pos[0],mptr->pos[1],mptr->pos[2],mptr->complex_id);		
+		fprintf(sim->events,"rxn_time=%f start ident=%s serno=%ld sites_val=%d pos[0]=%f pos[1]=%f pos[2]=%f complex_id=%d\n", sim->time,sim->mols->spname[mptr->ident],mptr->serno,mptr->sites_val,mptr->pos[0],mptr->pos[1],mptr->pos[2],mptr->complex_id);		
 	}
+	simeventlog(sim,ERstart,NULL,-1,mptr,NULL,-1,-1,0);
 		
 	molsetexist(sim,ident[0],MSsoln,1);
 	if(bind_num>1)	molsetexist(sim,ident[1],MSsoln,1);
@@ -3252,15 +4454,53 @@ int updatecompartmol_cplx(simptr sim,int serno, int bind_num,int *ident,int *sit
 /******************************************************************************/
 
 
+/* molsortslot */
+int molsortslot(simptr sim,int ll,int m) {
+	molssptr mols;
+	double pbuf[DIMMAX];
+	int ll2,*nl,*topl;
+	moleculeptr *mlist,mptr;
+	boxptr bptr;
+
+	mols=sim->mols;
+	nl=mols->nl;
+	topl=mols->topl;
+	mlist=mols->live[ll];
+	mptr=mlist[m];
+	if(mptr->list==-1) {										// move to dead list
+		if(mptr->box) boxremovemol(mptr,ll);
+		mols->dead[mols->nd++]=mols->dead[mols->topd];
+		mols->dead[mols->topd]=mptr;
+		mptr->m=mols->topd++; }
+	else {																// move to another live list
+		ll2=mptr->list;
+		bptr=mptr->box;
+		if(mptr->box) boxremovemol(mptr,ll);
+		if(nl[ll2]==mols->maxl[ll2])
+			if(molexpandlist(mols,sim->dim,ll2,-1,0)) {
+				simLog(sim,10,"out of memory in molsort\n");return 1;}
+		mols->live[ll2][nl[ll2]]=mptr;
+		mptr->m=nl[ll2]++;
+		if(mols->listtype[ll2]==MLTsystem) {
+			if(bptr) mptr->box=bptr;
+			else mptr->box=pos2box(sim,molreal2dbl(mptr->pos,pbuf,sim->dim));
+			if(boxaddmol(mptr,ll2)) {
+				simLog(sim,10,"out of memory in molsort\n");return 1;}}}
+
+	mlist[m]=mlist[--topl[ll]];										// compact original live list
+	mlist[topl[ll]]=mlist[--nl[ll]];
+	mlist[nl[ll]]=NULL;
+	if(m<nl[ll]) mlist[m]->m=m;
+	if(topl[ll]<nl[ll]) mlist[topl[ll]]->m=topl[ll];
+	return 0; }
+
+
 /* molsort */
 int molsort(simptr sim,int onlydead2live) {
 	molssptr mols;
-	int nlist,*maxl,*nl,*topl,*sortl,m,ll,ll2;
-	moleculeptr *dead,**live,*mlist,mptr;
+	int nlist,*maxl,*nl,*topl,*sortl,m,ll,ll2,k,nlog,*log;
+	moleculeptr *dead,**live,mptr;
 	enum MolListType *listtype;
-	boxptr bptr;
-	int *list_new;
-	int list_maxlen=0;
 
 	if(!sim->mols) return 0;
 	mols=sim->mols;
@@ -3274,47 +4514,26 @@ int molsort(simptr sim,int onlydead2live) {
 	sortl=mols->sortl;
 
 	if(!onlydead2live) {
-   		for(ll=0;ll<nlist;ll++)								// reset topl indicies  // onlydead2live=0
-    	 	topl[ll]=nl[ll];
-
-    	for(ll=0;ll<nlist;ll++) {							// sort live lists
-      		mlist=live[ll];
-	  		// printf("molsort, time=%f, sortl[%d]=%d, topl[%d]=%d\n", sim->time, ll, sortl[ll], ll, topl[ll]);
-      		for(m=sortl[ll];m<topl[ll];m++) {
-        		if(mlist[m]->list!=ll) {
-          			mptr=mlist[m];
-					mptr->m=m;
-          			if(mptr->list==-1) {							// move to dead list
-						// printf("molsort() line 2751 m=%d, serno=%d\n", m, mptr->serno);
-						if(mptr->box) boxremovemol(mptr,ll);
-            			dead[mols->nd++]=dead[mols->topd];
-            			dead[mols->topd++]=mptr;
-						mptr->m=mols->topd;
-            			mlist[m]=NULL;
-		 			}
-          			else {													// move to another live list
-            			ll2=mptr->list;
-            			bptr=mptr->box;
-						// printf("molsort() line 2769 m=%d, ll2=%d, serno=%d,", m, ll2, mptr->serno);
-			
-         	  	 		if(mptr->box) boxremovemol(mptr,ll);
-            			if(nl[ll2]==maxl[ll2])
-              			if(molexpandlist(mols,sim->dim,ll2,-1,0)) {
-                			simLog(sim,10,"out of memory in molsort\n");return 1;}
-            			live[ll2][nl[ll2]++]=mptr;
-						mptr->m=nl[ll2];
-            			mlist[m]=NULL;
-            			if(listtype[ll2]==MLTsystem) {
-              			if(bptr) mptr->box=bptr;
-              			else mptr->box=pos2box(sim,mptr->pos);
-              			if(boxaddmol(mptr,ll2)) {
-                			simLog(sim,10,"out of memory in molsort\n");return 1;}}}
-
-         		 mlist[m]=mlist[--topl[ll]];				// compact original live list
-          		 mlist[topl[ll]]=mlist[--nl[ll]];
-          		 mlist[nl[ll]]=NULL;
-          		 m--; }}}
-	}
+		for(ll=0;ll<nlist;ll++)								// reset topl indicies
+			topl[ll]=nl[ll];
+
+		for(ll=0;ll<nlist;ll++) {							// sort live lists
+			nlog=mols->nchglog[ll];
+			if(sortl[ll]>=topl[ll]);
+			else if(nlog>=0 && nlog<topl[ll]-sortl[ll]) {	// only visit logged slots, highest first
+				log=mols->chglog[ll];
+				std::sort(log,log+nlog);
+				for(k=nlog-1;k>=0;k--) {
+					m=log[k];
+					if(k<nlog-1 && m==log[k+1]) continue;
+					if(m<topl[ll] && live[ll][m]->list!=ll)
+						if(molsortslot(sim,ll,m)) return 1; }}
+			else {															// sweep everything above sortl
+				for(m=sortl[ll];m<topl[ll];m++)
+					if(live[ll][m]->list!=ll) {
+						if(molsortslot(sim,ll,m)) return 1;
+						m--; }}
+			mols->nchglog[ll]=0; }}
 
 	for(m=mols->topd;m<mols->nd;m++) {		// move molecules from resurrected to reborn
 		// printf("molsort, time=%f, topd=%d, nd=%d\n", sim->time, mols->topd, mols->nd);
@@ -3324,11 +4543,15 @@ int molsort(simptr sim,int onlydead2live) {
 		if(nl[ll2]==maxl[ll2])
 			if(molexpandlist(mols,sim->dim,ll2,-1,0)) {
 				simLog(sim,10,"out of memory in molsort\n");return 1;}
-		live[ll2][nl[ll2]++]=mptr;
-		mptr->m=nl[ll2];
+		live[ll2][nl[ll2]]=mptr;
+		mptr->m=nl[ll2]++;
+		moltally(mols,mptr);
+		molnbrstale(mols,0,mptr->ident);
 		dead[m]=NULL;
 		if(listtype[ll2]==MLTsystem) {
 				if(boxaddmol(mptr,ll2)) {
+				simLog(sim,10,"out of memory in molsort\n");return 1;}
+			if(mols->gfrdrmax[mptr->ident]>0 && gfrdmarkdue(mols,mptr)) {
 				simLog(sim,10,"out of memory in molsort\n");return 1;}}}
 	mols->nd=mols->topd;
 
@@ -3364,12 +4587,91 @@ int molsort(simptr sim,int onlydead2live) {
 	return 0; }
 
 
+/* molmortonkey */
+long int molmortonkey(simptr sim,molreal *pos) {
+	int d,dim,b,bits;
+	long int key,q[3];
+	double frac;
+	boxssptr boxs;
+
+	dim=sim->dim;
+	boxs=sim->boxs;
+	bits=(dim==3)?20:30;
+	for(d=0;d<dim;d++) {
+		frac=(pos[d]-boxs->min[d])/(boxs->size[d]*boxs->side[d]);
+		if(frac<0) frac=0;
+		else if(frac>=1) frac=1-DBL_EPSILON;
+		q[d]=(long int)(frac*(1L<<bits)); }
+	key=0;
+	for(b=bits-1;b>=0;b--)
+		for(d=0;d<dim;d++)
+			key=(key<<1)|((q[d]>>b)&1);
+	return key; }
+
+
+/* molspatialsort */
+int molspatialsort(simptr sim,int force) {
+	molssptr mols;
+	int ll,m,k,s,nblock,nmol,len,ok;
+	long int *key;
+	void **block;
+	moleculeptr *mlist,*copy,mptr;
+
+	mols=sim->mols;
+	if(!mols || !sim->boxs || !sim->boxs->nbox) return 0;
+	if(!force) {
+		if(!mols->resortinterval) return 0;
+		if(++mols->resortct<mols->resortinterval) return 0; }
+	mols->resortct=0;
+
+	for(ll=0;ll<mols->nlist;ll++) {
+		nmol=mols->nl[ll];
+		if(nmol<2 || mols->sortl[ll]!=nmol || mols->topl[ll]!=nmol) continue;
+		mlist=mols->live[ll];
+		key=(long int*) calloc(nmol,sizeof(long int));
+		block=(void**) calloc(nmol,sizeof(void*));
+		copy=(moleculeptr*) calloc(nmol,sizeof(moleculeptr));
+		if(!key || !block || !copy) {
+			free(key);free(block);free(copy);
+			simLog(sim,10,"out of memory in molspatialsort\n");return 1; }
+		for(m=0;m<nmol;m++) copy[m]=mlist[m];
+
+		ok=1;													// complexes are sorted as whole blocks
+		nblock=0;
+		for(m=0;m<nmol && ok;m+=len) {
+			mptr=copy[m];
+			len=(mptr->tot_sunit>1)?mptr->tot_sunit:1;
+			if(m+len>nmol) ok=0;
+			for(s=1;s<len && ok;s++)
+				if(copy[m+s]->complex_id!=mptr->complex_id) ok=0;
+			key[nblock]=molmortonkey(sim,mptr->pos);
+			block[nblock++]=(void*)(copy+m); }
+
+		if(ok) {
+			sortVliv(key,block,nblock);
+			m=0;
+			for(k=0;k<nblock;k++) {
+				mptr=*(moleculeptr*)block[k];
+				len=(mptr->tot_sunit>1)?mptr->tot_sunit:1;
+				for(s=0;s<len;s++) {
+					mlist[m]=((moleculeptr*)block[k])[s];
+					mlist[m]->m=m;
+					m++; }}}
+		else
+			simLog(sim,5,"molspatialsort: complex subunits not contiguous in list %s, not resorted\n",mols->listname[ll]);
+
+		free(key);
+		free(block);
+		free(copy); }
+	return 0; }
+
+
 /* moldosurfdrift */
 void moldosurfdrift(simptr sim,moleculeptr mptr,double dt) {
 	int i,s,axis;
 	enum MolecState ms;
 	enum PanelShape ps;
-	double *****surfdrift,vect[3],drift1,drift2,*pt1,*pt2,dist,unit0[3],unit1[3],unit2[3],top[3];
+	double *****surfdrift,vect[3],drift1,drift2,*pt1,*pt2,dist,unit0[3],unit1[3],unit2[3],top[3],pbuf[DIMMAX];
 	panelptr pnl;
 
 	i=mptr->ident;
@@ -3392,7 +4694,7 @@ void moldosurfdrift(simptr sim,moleculeptr mptr,double dt) {
 				vect[0]=-drift1*(mptr->pos[1]-pnl->point[0][1])/pnl->point[1][0];
 				vect[1]=drift1*(mptr->pos[0]-pnl->point[0][0])/pnl->point[1][0]; }
 			else if(ps==PSdisk) {
-				pt1=mptr->pos;
+				pt1=molreal2dbl(mptr->pos,pbuf,sim->dim);
 				pt2=pnl->point[0];
 				dist=sqrt((pt2[0]-pt1[0])*(pt2[0]-pt1[0])+(pt2[1]-pt1[1])*(pt2[1]-pt1[1]));
 				if(dist>VERYCLOSE) {
@@ -3422,12 +4724,12 @@ void moldosurfdrift(simptr sim,moleculeptr mptr,double dt) {
 				top[0]=pnl->point[0][0];
 				top[1]=pnl->point[0][1];
 				top[2]=pnl->point[0][2]+pnl->point[1][0];
-				Geo_SphereUnitVects(pnl->point[0],top,mptr->pos,(int)(pnl->front[0]),unit0,unit1,unit2);
+				Geo_SphereUnitVects(pnl->point[0],top,molreal2dbl(mptr->pos,pbuf,sim->dim),(int)(pnl->front[0]),unit0,unit1,unit2);
 				vect[0]=drift1*unit1[0]+drift2*unit2[0];
 				vect[1]=drift1*unit1[1]+drift2*unit2[1];
 				vect[2]=drift1*unit1[2]+drift2*unit2[2]; }
 			else if(ps==PScyl) {
-				Geo_CylUnitVects(pnl->point[0],pnl->point[1],mptr->pos,(int)(pnl->front[2]),unit0,unit1,unit2);
+				Geo_CylUnitVects(pnl->point[0],pnl->point[1],molreal2dbl(mptr->pos,pbuf,sim->dim),(int)(pnl->front[2]),unit0,unit1,unit2);
 				vect[0]=drift1*unit1[0]+drift2*unit2[0];
 				vect[1]=drift1*unit1[1]+drift2*unit2[1];
 				vect[2]=drift1*unit1[2]+drift2*unit2[2]; }
@@ -3435,12 +4737,12 @@ void moldosurfdrift(simptr sim,moleculeptr mptr,double dt) {
 				top[0]=pnl->point[0][0]-pnl->point[2][0];
 				top[1]=pnl->point[0][1]-pnl->point[2][1];
 				top[2]=pnl->point[0][2]-pnl->point[2][2];
-				Geo_SphereUnitVects(pnl->point[0],top,mptr->pos,(int)(pnl->front[0]),unit0,unit1,unit2);
+				Geo_SphereUnitVects(pnl->point[0],top,molreal2dbl(mptr->pos,pbuf,sim->dim),(int)(pnl->front[0]),unit0,unit1,unit2);
 				vect[0]=drift1*unit1[0]+drift2*unit2[0];
 				vect[1]=drift1*unit1[1]+drift2*unit2[1];
 				vect[2]=drift1*unit1[2]+drift2*unit2[2]; }
 			else if(ps==PSdisk) {
-				Geo_DiskUnitVects(pnl->point[0],pnl->front,mptr->pos,unit0,unit1,unit2);
+				Geo_DiskUnitVects(pnl->point[0],pnl->front,molreal2dbl(mptr->pos,pbuf,sim->dim),unit0,unit1,unit2);
 				vect[0]=drift1*unit1[0]+drift2*unit2[0];
 				vect[1]=drift1*unit1[1]+drift2*unit2[1];
 				vect[2]=drift1*unit1[2]+drift2*unit2[2]; }
@@ -3452,18 +4754,46 @@ void moldosurfdrift(simptr sim,moleculeptr mptr,double dt) {
 
 
 /* diffuse */
+/* molkeyedspecies.  Returns the species whose diffusion coefficient applies to
+mptr if it is a free monomer in solution with isotropic diffusion, which
+diffuse() can move in parallel with per-molecule random numbers, and -1 if it
+needs the general serial code. */
+int molkeyedspecies(simptr sim,moleculeptr mptr) {
+	molssptr mols;
+	int i;
+
+	mols=sim->mols;
+	if(mptr->domain_i>=0 || mptr->tot_sunit!=1 || mptr->complex_id!=-1) return -1;
+	if(mptr->pos!=mptr->pos_tmp || mptr->mstate!=MSsoln) return -1;
+	i=(mptr->bind_id>=0 && mptr->bind_id!=mptr->ident)?mptr->bind_id:mptr->ident;
+	if(mols->difm[i][MSsoln]) return -1;
+	if(sim->interface && sim->interface->species==i) return -1;
+	if(mptr->pnl && mols->surfdrift && mols->surfdrift[i] && mols->surfdrift[i][MSsoln]) return -1;
+	return i; }
+
+
+/* diffuse.  If sim->nthreads is non-zero, free monomers draw their displacements
+from keyrandULI() with a key made from the random seed, the step count and the
+serial number, and are moved in a parallel loop; everything else is then moved
+serially with the global generator.  Results are thus the same for any number
+of threads. */
 int diffuse(simptr sim) {
 	molssptr mols;
 	int ll,m,d,nmol,dim,i,ngtablem1;
+	unsigned long long stepkey,molkey;
 	enum MolecState ms;
-	double flt1,difc;
-	double v1[DIMMAX],v2[DIMMAX],**difstep,***difm,***drift,epsilon,margin,neighdist,*gtable,dt;
+	double flt1,difc,ldt;
+	double v1[DIMMAX],v2[DIMMAX],**difstep,***difm,***drift,epsilon,margin,neighdist,dt;
+	molreal *gtable;
 	moleculeptr *mlist;
 	moleculeptr mptr, mptr_tmp;
 	int incmpt_flag=0;	
 	int incmpt_posx_flag=0;
 	int m_next,difc_type;
 	complexptr cplx;
+#ifdef HAVE_OPENMP
+	int nthreads;
+#endif
 
 	if(!sim->mols) return 0;
 	dim=sim->dim;
@@ -3474,11 +4804,10 @@ int diffuse(simptr sim) {
 	difm=mols->difm;
 	drift=mols->drift;
 	dt=sim->dt;
-	flt1=sqrt(2.0*dt);
 	epsilon=(sim->srfss)?sim->srfss->epsilon:0;
 	margin=(sim->srfss)?sim->srfss->margin:0;
 	neighdist=(sim->srfss)?sim->srfss->neighdist:0;
-	double offset[dim];
+	double offset[dim],pbuf[DIMMAX];
 	int updated_flag;									// to check whether a bound molec has been updated or not, to prevent double update
 	char vstr[STRCHAR], *vstr1;
 	double volt,vtime;
@@ -3488,42 +4817,68 @@ int diffuse(simptr sim) {
 		nmol=mols->nl[ll];
 		for(m=0;m<nmol;m++){
 			mptr=mlist[m];
-			mptr->sites_valx=mptr->sites_val=molecsites_state(sim->mols,mptr);
+			mptr->sites_valx=mptr->sites_val;
 			if(mols->diffuselist[ll]){
 				for(d=0;d<dim;d++) mptr->posx[d]=mptr->pos[d];	
 				incmpt_posx_flag=boundarytest(sim,mptr->posx);
 				if(incmpt_posx_flag==0){
-					printf("diffuse, incmpt_flag=%d incmpt_posx_flag=%d complex_id=%d m=%d time=%f sites_val=%d ident=%d serno=%d s_index=%d posx[0]=%f posx[1]=%f posx[2]=%f pos[0]=%f pos[1]=%f pos[2]=%f prev_pos[0]=%f prev_pos[1]=%f prev_pos[2]=%f\n", incmpt_flag, incmpt_posx_flag, mptr->complex_id, m, sim->time, mptr->sites_val, mptr->ident, mptr->serno, mptr->s_index, mptr->posx[0], mptr->posx[1], mptr->posx[2],mptr->pos[0], mptr->pos[1], mptr->pos[2], mptr->prev_pos[0], mptr->prev_pos[1], mptr->prev_pos[2]);
+					SMOLTRACE(sim,TCdiffuse,TLerror,"diffuse, incmpt_flag=%d incmpt_posx_flag=%d complex_id=%d m=%d time=%f sites_val=%d ident=%d serno=%ld s_index=%d posx[0]=%f posx[1]=%f posx[2]=%f pos[0]=%f pos[1]=%f pos[2]=%f prev_pos[0]=%f prev_pos[1]=%f prev_pos[2]=%f\n", incmpt_flag, incmpt_posx_flag, mptr->complex_id, m, sim->time, mptr->sites_val, mptr->ident, mptr->serno, mptr->s_index, mptr->posx[0], mptr->posx[1], mptr->posx[2],mptr->pos[0], mptr->pos[1], mptr->pos[2], mptr->prev_pos[0], mptr->prev_pos[1], mptr->prev_pos[2]);
 					return -1;
 				}
 				if(mptr->tot_sunit>1 && mptr->s_index==0) sim->mols->complexlist[mptr->complex_id]->diffuse_updated=0;
 			}
 	
 			if(sim->mols->volt_dependent[mptr->ident]==1){
-				if(mptr->vchannel->vtime_n< sim->time){
-					if(fgets(vstr,STRCHAR,mptr->vchannel->voltage_file)){
+				if(mptr->cold->vchannel->vtime_n< sim->time){
+					if(fgets(vstr,STRCHAR,mptr->cold->vchannel->voltage_file)){
 						vstr1=strsplit(vstr,"\t");
 						sscanf(vstr1,"%lf",&volt);
 						sscanf(vstr,"%lf",&vtime);	
-						printf("volt=%f vtime=%f sim->time=%f\n",volt,vtime,sim->time);
-						mptr->vchannel->voltage=volt;
-						mptr->vchannel->vtime=sim->time;
-						mptr->vchannel->vtime_n=vtime;
+						SMOLTRACE(sim,TCdiffuse,TLdebug,"volt=%f vtime=%f sim->time=%f\n",volt,vtime,sim->time);
+						mptr->cold->vchannel->voltage=volt;
+						mptr->cold->vchannel->vtime=sim->time;
+						mptr->cold->vchannel->vtime_n=vtime;
 					}
 			}}
 			else sim->mols->volt_dependent[mptr->ident]=0;		
 		}
 	}
 	
+	for(ll=0;ll<mols->nlist;ll++)									// lists with substep>1 skip steps
+		mols->stepdue[ll]=(mols->substep[ll]<=1 || mols->substepct%mols->substep[ll]==0);
+	mols->substepct++;
+
+#ifdef HAVE_OPENMP
+	nthreads=(sim->nthreads>1)?sim->nthreads:1;
+#endif
+	stepkey=((unsigned long long)sim->randseed<<32)^(unsigned long long)mols->substepct;
+
 	for(ll=0;ll<mols->nlist;ll++)
-		if(mols->diffuselist[ll]){
+		if(mols->diffuselist[ll] && mols->stepdue[ll]){
 			mlist=mols->live[ll];
 			nmol=mols->nl[ll];		
+			ldt=dt*mols->substep[ll];
+			flt1=sqrt(2.0*ldt);
+			if(sim->nthreads) {												// keyed monomers, in parallel
+#ifdef HAVE_OPENMP
+				#pragma omp parallel for schedule(static) private(mptr,i,d,difc,molkey) num_threads(nthreads) if(nthreads>1)
+#endif
+				for(m=0;m<nmol;m++) {
+					mptr=mlist[m];
+					i=molkeyedspecies(sim,mptr);
+					if(i<0) continue;
+					difc=sqrt(2.0*mols->difc[i][MSsoln]*ldt);
+					molkey=keyrandULI(stepkey^((unsigned long long)mptr->serno*0x9E3779B97F4A7C15ULL));
+					for(d=0;d<dim;d++) {
+						mptr->prev_pos[d]=mptr->pos[d];
+						mptr->pos[d]+=difc*gtable[keyrandULI(molkey+d)&ngtablem1]; }}}
 			m=0;
 			mptr=mlist[0];
 			for(m=0;m<nmol;m+=mptr->tot_sunit){
 				updated_flag=0;
 				mptr=mlist[m];
+				if(mptr->domain_i>=0) continue;						// frozen in a protective domain
+				if(sim->nthreads && molkeyedspecies(sim,mptr)>=0) continue;		// already moved
 					
 				if(mptr->bind_id>=0 && mptr->bind_id!=mptr->ident)
 					i=mptr->bind_id;	
@@ -3542,7 +4897,7 @@ int diffuse(simptr sim) {
 				
 				if(mptr->pnl && mols->surfdrift && mols->surfdrift[i] && mols->surfdrift[i][ms]){
 					if(mptr->s_index==0){
-						moldosurfdrift(sim,mptr,dt);						// surface drift
+						moldosurfdrift(sim,mptr,ldt);						// surface drift
 						// complex_pos(sim,mptr,"posx",);
 				}}
 				
@@ -3560,7 +4915,7 @@ int diffuse(simptr sim) {
 				if(!difm[i][ms]){															// isotropic diffusion
 					if(sim->interface) {
 						if(sim->interface->species==i){	
-							if(posincompart(sim,mptr->pos,sim->interface->cmpt)){ 
+							if(posincompart(sim,molreal2dbl(mptr->pos,pbuf,dim),sim->interface->cmpt)){ 
 								for(d=0;d<dim;d++)
 									mptr->prev_pos[d]=mptr->pos[d];
 								if(SBM(sim,mptr,sim->interface)==-1.0) 
@@ -3586,7 +4941,7 @@ int diffuse(simptr sim) {
 						if(mptr->tot_sunit==1 && mptr->pos==mptr->pos_tmp) {
 							for(d=0;d<dim;d++) {
 									mptr->prev_pos[d]=mptr->pos[d];	
-									mptr->pos[d]+=sqrt(2.0*difc*sim->dt)*gtable[randULI()&ngtablem1];	
+									mptr->pos[d]+=sqrt(2.0*difc*ldt)*gtable[randULI()&ngtablem1];	
 							}
 						}
 						else if(mptr->complex_id!=-1){
@@ -3600,11 +4955,11 @@ int diffuse(simptr sim) {
 							else{	
 								for(d=0;d<dim;d++) {
 									mptr->prev_pos[d]=mptr->pos[d];			
-									mptr->pos[d]+=sqrt(2.0*difc*sim->dt)*gtable[randULI()&ngtablem1]; 
+									mptr->pos[d]+=sqrt(2.0*difc*ldt)*gtable[randULI()&ngtablem1]; 
 									offset[d]=mptr->pos[d]-mptr->posx[d];
 								}
 								if(complex_pos(sim,mptr,"posx", &offset[0],1)==-1){
-									printf("time=%f, m=%d, mptr->ident=%d, mptr->s_index=%d, mptr->serno=%d, pos0=%f, pos1=%f, pos2=%f, offset[0]=%f, offset[1]=%f, offset[2]=%f\n", sim->time, m, mptr->ident, mptr->s_index,mptr->serno, mptr->pos[0], mptr->pos[1], mptr->pos[2], offset[0], offset[1], offset[2]);
+									SMOLTRACE(sim,TCcplx,TLerror,"time=%f, m=%d, mptr->ident=%d, mptr->s_index=%d, mptr->serno=%ld, pos0=%f, pos1=%f, pos2=%f, offset[0]=%f, offset[1]=%f, offset[2]=%f\n", sim->time, m, mptr->ident, mptr->s_index,mptr->serno, mptr->pos[0], mptr->pos[1], mptr->pos[2], offset[0], offset[1], offset[2]);
 									return -1;
 					}}}}
 				}else{																	    // anisotropic diffusion
@@ -3644,8 +4999,8 @@ void complex_pos_init(simptr sim, moleculeptr mptr,compartptr cmpt){
 	/* solve for (x0,y0,z0) at the center of the ring based on one cornor point
 		(x0,y0,z0) is not the origin, but the center of ring, a variable
 	*/
-	k=tan(mptr->phi_init);
-	g=cos(mptr->theta_init);
+	k=tan(mptr->cold->phi_init);
+	g=cos(mptr->cold->theta_init);
 	x=mptr->pos[0];
 	y=mptr->pos[1];
 	z=mptr->pos[2];
@@ -3656,8 +5011,8 @@ void complex_pos_init(simptr sim, moleculeptr mptr,compartptr cmpt){
 	// layer2, with a shifted ring center, which is perpendicular to the plain phi=phi_init
 	if(layer>1){
 		h=10;
-		x1=x0+h*sin(mptr->phi_init);
-		y1=y0-h*cos(mptr->phi_init);
+		x1=x0+h*sin(mptr->cold->phi_init);
+		y1=y0-h*cos(mptr->cold->phi_init);
 		z1=z0;
 	}
 
@@ -3665,13 +5020,13 @@ void complex_pos_init(simptr sim, moleculeptr mptr,compartptr cmpt){
 	// PI is actually defined in lib/math2.h
 	mptr_tmp=mptr->to;
 	while(mptr_tmp!=NULL && mptr_tmp->s_index<total_sunit && mptr_tmp!=mptr){	
-		theta_tmp=2*PI/(total_sunit/layer)*(mptr_tmp->s_index % (total_sunit/layer))+mptr_tmp->theta_init;
+		theta_tmp=2*PI/(total_sunit/layer)*(mptr_tmp->s_index % (total_sunit/layer))+mptr_tmp->cold->theta_init;
 
 		// all subunits have the same phi
 		if(mptr_tmp->s_index<group_sunit){
 			mptr_tmp->pos[2]= z0-r*cos(theta_tmp);
-			mptr_tmp->pos[1]= y0-r*sin(theta_tmp)*sin(mptr_tmp->phi_init);
-			mptr_tmp->pos[0]= x0-r*sin(theta_tmp)*cos(mptr_tmp->phi_init);
+			mptr_tmp->pos[1]= y0-r*sin(theta_tmp)*sin(mptr_tmp->cold->phi_init);
+			mptr_tmp->pos[0]= x0-r*sin(theta_tmp)*cos(mptr_tmp->cold->phi_init);
 			//printf("theta_tmp=%f, mptr_tmp->s_index=%d\n",theta_tmp,mptr_tmp->s_index);
 		}
 		/*		
@@ -3679,15 +5034,15 @@ void complex_pos_init(simptr sim, moleculeptr mptr,compartptr cmpt){
 			mptr_tmp->pos[0]=x1-sqrt(r*r*(1-g*g)/(1+k*k));
 			mptr_tmp->pos[1]=y1-k*(x1-mptr_tmp->pos[0]);
 			mptr_tmp->pos[2]=z1-r*g;
-			printf("theta_tmp=%f, mptr_tmp->s_index=%d, s_index=%d, dist^2=%f\n",theta_tmp,mptr_tmp->s_index,mptr_tmp->from->from->from->from->from->from->s_index, molec_distance(sim,mptr_tmp->pos,mptr_tmp->from->from->from->from->from->from->pos));
+			SMOLTRACE(sim,TCcplx,TLdebug,"theta_tmp=%f, mptr_tmp->s_index=%d, s_index=%d, dist^2=%f\n",theta_tmp,mptr_tmp->s_index,mptr_tmp->from->from->from->from->from->from->s_index, molec_distance(sim,mptr_tmp->pos,mptr_tmp->from->from->from->from->from->from->pos));
 
 		}
 		*/
 		else{
 			mptr_tmp->pos[2]= z1-r*cos(theta_tmp);
-			mptr_tmp->pos[1]= y1-r*sin(theta_tmp)*sin(mptr_tmp->phi_init);
-			mptr_tmp->pos[0]= x1-r*sin(theta_tmp)*cos(mptr_tmp->phi_init);
-			printf("theta_tmp=%f, mptr_tmp->s_index=%d, s_index=%d, dist^2=%f\n",theta_tmp,mptr_tmp->s_index,mptr_tmp->from->from->from->from->from->from->s_index, molec_distance(sim,mptr_tmp->pos,mptr_tmp->from->from->from->from->from->from->pos));
+			mptr_tmp->pos[1]= y1-r*sin(theta_tmp)*sin(mptr_tmp->cold->phi_init);
+			mptr_tmp->pos[0]= x1-r*sin(theta_tmp)*cos(mptr_tmp->cold->phi_init);
+			SMOLTRACE(sim,TCcplx,TLdebug,"theta_tmp=%f, mptr_tmp->s_index=%d, s_index=%d, dist^2=%f\n",theta_tmp,mptr_tmp->s_index,mptr_tmp->from->from->from->from->from->from->s_index, molec_distance(sim,mptr_tmp->pos,mptr_tmp->from->from->from->from->from->from->pos));
 
 		}
 
@@ -3707,12 +5062,12 @@ void complex_pos_init(simptr sim, moleculeptr mptr,compartptr cmpt){
 				x0=x + sqrt(r*r*(1-g*g)/(1+k*k));	
 				y0=y + k*(x0-x);
 				z0=z + r*g;	
-				theta_tmp=mptr->theta_init;
+				theta_tmp=mptr->cold->theta_init;
 				mptr_tmp=mptr;
 				// sunit_i=0;		// then the following code makes sunit_i=1
 				if(layer>1){
-					x1=x0+h*sin(mptr->phi_init);
-					y1=y0+h*cos(mptr->phi_init);
+					x1=x0+h*sin(mptr->cold->phi_init);
+					y1=y0+h*cos(mptr->cold->phi_init);
 					z1=z0;
 				}
 			}
@@ -3773,9 +5128,9 @@ int complex_pos(simptr sim, moleculeptr mptr, char* pos_to_update, double* offse
 			else{
 				mptr_tmp->sdist_tmp=molec_distance(sim,mptr_tmp->pos,mptr_tmp->to->pos);
 				if(mptr_tmp->sdist_tmp - mptr_tmp->sdist_init>1 || mptr_tmp->sdist_tmp-mptr_tmp->sdist_init<-1){
-					printf("molec.c line3388, %s, complex_tmp->diffuse_updated=%d, mptr_tmp->serno=%d, sites_val=%d, s_index=%d, to->serno=%d, to->sites_val=%d, to->s_index=%d\n", pos_to_update, complex_tmp->diffuse_updated, mptr_tmp->serno, mptr_tmp->sites_val, mptr_tmp->s_index, mptr_tmp->to->serno, mptr_tmp->to->sites_val, mptr_tmp->to->s_index); 
-					printf("molec.c mptr_tmp pos0=%f, pos1=%f, pos2=%f, prevpos0=%f, prevpos1=%f, prevpos2=%f, posx0=%f, posx1=%f, posx2=%f\n", mptr_tmp->pos[0], mptr_tmp->pos[1], mptr_tmp->pos[2], mptr_tmp->prev_pos[0], mptr_tmp->prev_pos[1], mptr_tmp->prev_pos[2], mptr_tmp->posx[0], mptr_tmp->posx[1], mptr_tmp->posx[2]); 
-					printf("molec.c to->mptr_tmp pos0=%f, pos1=%f, pos2=%f, prevpos0=%f, prevpos1=%f, prevpos2=%f, posx0=%f, posx1=%f, posx2=%f\n", mptr_tmp->to->pos[0], mptr_tmp->to->pos[1], mptr_tmp->to->pos[2], mptr_tmp->to->prev_pos[0], mptr_tmp->to->prev_pos[1], mptr_tmp->to->prev_pos[2], mptr_tmp->to->posx[0], mptr_tmp->to->posx[1], mptr_tmp->to->posx[2]); 
+					SMOLTRACE(sim,TCcplx,TLerror,"molec.c line3388, %s, complex_tmp->diffuse_updated=%d, mptr_tmp->serno=%ld, sites_val=%d, s_index=%d, to->serno=%ld, to->sites_val=%d, to->s_index=%d\n", pos_to_update, complex_tmp->diffuse_updated, mptr_tmp->serno, mptr_tmp->sites_val, mptr_tmp->s_index, mptr_tmp->to->serno, mptr_tmp->to->sites_val, mptr_tmp->to->s_index); 
+					SMOLTRACE(sim,TCcplx,TLerror,"molec.c mptr_tmp pos0=%f, pos1=%f, pos2=%f, prevpos0=%f, prevpos1=%f, prevpos2=%f, posx0=%f, posx1=%f, posx2=%f\n", mptr_tmp->pos[0], mptr_tmp->pos[1], mptr_tmp->pos[2], mptr_tmp->prev_pos[0], mptr_tmp->prev_pos[1], mptr_tmp->prev_pos[2], mptr_tmp->posx[0], mptr_tmp->posx[1], mptr_tmp->posx[2]); 
+					SMOLTRACE(sim,TCcplx,TLerror,"molec.c to->mptr_tmp pos0=%f, pos1=%f, pos2=%f, prevpos0=%f, prevpos1=%f, prevpos2=%f, posx0=%f, posx1=%f, posx2=%f\n", mptr_tmp->to->pos[0], mptr_tmp->to->pos[1], mptr_tmp->to->pos[2], mptr_tmp->to->prev_pos[0], mptr_tmp->to->prev_pos[1], mptr_tmp->to->prev_pos[2], mptr_tmp->to->posx[0], mptr_tmp->to->posx[1], mptr_tmp->to->posx[2]); 
 					return -1;
 		}}}}
 	return 0;
@@ -3793,8 +5148,29 @@ double power(double a, int b){
 }
  
 
+#ifdef OPTION_SINGLE_PRECISION
+
+/* molreal2dbl */
+double *molreal2dbl(const molreal *x,double *buf,int dim) {
+	int d;
+
+	for(d=0;d<dim;d++) buf[d]=x[d];
+	return buf; }
+
+
+/* dbl2molreal */
+void dbl2molreal(const double *buf,molreal *x,int dim) {
+	int d;
+
+	if((const void*)buf==(const void*)x) return;
+	for(d=0;d<dim;d++) x[d]=(molreal)buf[d];
+	return; }
+
+#endif
+
+
 /* actually, distance squared, only for connected molecs */
-double molec_distance(simptr sim, double *pos1, double *pos2){
+double molec_distance(simptr sim, molreal *pos1, molreal *pos2){
 	int d;
 	int dim=sim->dim;
 	double dist=0;
@@ -3826,17 +5202,18 @@ int cplxpos_updated_test(simptr sim, moleculeptr mptr, double *offset, int *suni
 
 
 /* test if a position inside or outside */
-int boundarytest(simptr sim, double *pos){
+int boundarytest(simptr sim, molreal *pos){
 	compartptr cmptptr;
 	int poscmpt=0;		
 	int c;
+	double pbuf[DIMMAX];
 	
 	if(!sim->cmptss) return 1;
 	if(pos[0]==0 && pos[1]==0 && pos[2]==0) return 1;
 
 	// for(c=0;c<sim->cmptss->ncmpt;c++){
 		cmptptr=sim->cmptss->cmptlist[0];			// cmptlist[0] is the compelete compartment
-		poscmpt=posincompart(sim,pos,cmptptr);
+		poscmpt=posincompart(sim,molreal2dbl(pos,pbuf,sim->dim),cmptptr);
 		if(poscmpt) return poscmpt;
 	// }
 	return poscmpt;	
@@ -433,7 +433,7 @@ int portgetmols(simptr sim,portptr port,int ident,enum MolecState ms,int remove)
 	return count; }
 
 /* portgetmols2 */
-int portgetmols2(simptr sim,portptr port,int ident,enum MolecState ms,int remove, double **positions) {
+int portgetmols2(simptr sim,portptr port,int ident,enum MolecState ms,int remove, molreal **positions) {
 	int ll,nmol,count,m;
 	moleculeptr *mlist;
 
@@ -455,6 +455,7 @@ int portgetmols2(simptr sim,portptr port,int ident,enum MolecState ms,int remove
 int portputmols(simptr sim,portptr port,int nmol,int ident,int *species,double **positions) {
 	moleculeptr mptr;
 	int dim,m,d;
+	double pbuf[DIMMAX],*posx;
 	panelptr pnl;
 
 	if(!nmol) return 0;
@@ -471,14 +472,18 @@ int portputmols(simptr sim,portptr port,int nmol,int ident,int *species,double *
 		mptr->mstate=MSsoln;
 		mptr->list=sim->mols->listlookup[mptr->ident][MSsoln];
 		if(positions) {
-			closestsurfacept(port->srf,sim->dim,positions[m],mptr->posx,&pnl);
-			fixpt2panel(mptr->posx,pnl,dim,port->face,sim->srfss->epsilon);
+			posx=molreal2dbl(mptr->posx,pbuf,dim);
+			closestsurfacept(port->srf,sim->dim,positions[m],posx,&pnl);
+			fixpt2panel(posx,pnl,dim,port->face,sim->srfss->epsilon);
+			dbl2molreal(posx,mptr->posx,dim);
 			for(d=0;d<dim;d++) mptr->pos[d]=positions[m][d]; }
 		else {
-			pnl=surfrandpos(port->srf,mptr->posx,dim);
-			fixpt2panel(mptr->posx,pnl,dim,port->face,sim->srfss->epsilon);
+			posx=molreal2dbl(mptr->posx,pbuf,dim);
+			pnl=surfrandpos(port->srf,posx,dim);
+			fixpt2panel(posx,pnl,dim,port->face,sim->srfss->epsilon);
+			dbl2molreal(posx,mptr->posx,dim);
 			for(d=0;d<dim;d++) mptr->pos[d]=mptr->posx[d]; }
-		mptr->box=pos2box(sim,mptr->pos); }
+		mptr->box=pos2box(sim,molreal2dbl(mptr->pos,pbuf,dim)); }
 	sim->eventcount[ETimport]+=nmol;
 	return 0; }
 
@@ -486,6 +491,7 @@ int portputmols(simptr sim,portptr port,int nmol,int ident,int *species,double *
 int portputmols2(simptr sim,portptr port,int nmol,int ident,int *species,double **positions,double **positionsx) {
 	moleculeptr mptr;
 	int dim,m,d;
+	double pbuf[DIMMAX],*posx;
 	panelptr pnl;
 
 	if(!nmol) return 0;
@@ -506,14 +512,18 @@ int portputmols2(simptr sim,portptr port,int nmol,int ident,int *species,double
 				mptr->pos[d]=positions[m][d];
 				mptr->posx[d]=positionsx[m][d];}}
 		else if(positions) {
-			closestsurfacept(port->srf,sim->dim,positions[m],mptr->posx,&pnl);
-			fixpt2panel(mptr->posx,pnl,dim,port->face,sim->srfss->epsilon);
+			posx=molreal2dbl(mptr->posx,pbuf,dim);
+			closestsurfacept(port->srf,sim->dim,positions[m],posx,&pnl);
+			fixpt2panel(posx,pnl,dim,port->face,sim->srfss->epsilon);
+			dbl2molreal(posx,mptr->posx,dim);
 			for(d=0;d<dim;d++) mptr->pos[d]=positions[m][d]; }
 		else {
-			pnl=surfrandpos(port->srf,mptr->posx,dim);
-			fixpt2panel(mptr->posx,pnl,dim,port->face,sim->srfss->epsilon);
+			posx=molreal2dbl(mptr->posx,pbuf,dim);
+			pnl=surfrandpos(port->srf,posx,dim);
+			fixpt2panel(posx,pnl,dim,port->face,sim->srfss->epsilon);
+			dbl2molreal(posx,mptr->posx,dim);
 			for(d=0;d<dim;d++) mptr->pos[d]=mptr->posx[d]; }
-		mptr->box=pos2box(sim,mptr->pos); }
+		mptr->box=pos2box(sim,molreal2dbl(mptr->pos,pbuf,dim)); }
 	sim->eventcount[ETimport]+=nmol;
 	return 0; }
 
@@ -71,6 +71,12 @@ int rxnsupdatelists(simptr sim,int molec_num);
 
 // core simulation functions
 int morebireact(rxnssptr rxnss,gpointer rptr,moleculeptr mptr1,moleculeptr mptr2,int ll1,int m1,int ll2,enum EventType et,double *vect,int rxn_site_indx1,int rxn_site_indx2,double radius,double dc1,double dc2);
+int rxnpairstep(molssptr mols,int ll1,int ll2,int due);
+int rxnspeciesstep(molssptr mols,int i,int j);
+int rxnsetstep(rxnssptr rxnss,int k);
+int rxnnbrupdate(simptr sim);
+int rxnnbrfilter(simptr sim,moleculeptr mptr1,int ll2,boxptr *blist,int nb,moleculeptr **mlistptr);
+double intracplxscan(simptr sim,complexptr cplx,double target,moleculeptr *mptrAptr,moleculeptr *mptrBptr,GSList **rnodeptr);
 
 // rxn input process
 int rxncond_parse(molssptr mols, char *cond, int rct_ident, int **sites_state_ptr, int *sites_num, int **sites_indx);
@@ -353,7 +359,7 @@ gpointer findreverserxn(rxnssptr rxnss,gpointer rptr,moleculeptr mptr1,moleculep
 								goto next_rxn;
 						}
 						rev=r;
-						printf("rxn:%s rxnr:%s\n", rxn->rname, rxnr->rname);
+						SMOLTRACE(sim,TCreact,TLdebug,"rxn:%s rxnr:%s\n", rxn->rname, rxnr->rname);
 						break;		
 					}
 					next_rxn: continue;
@@ -443,6 +449,8 @@ rxnptr rxnalloc(int order) {
 	rxn->rparam=0;
 	rxn->prdpos=NULL;
 	rxn->disable=0;
+	rxn->logevents=1;
+	rxn->intrarate=0;
 	rxn->cmpt=NULL;
 	rxn->srf=NULL;
 	// rxn->radius=g_hash_table_new(g_direct_hash, g_direct_equal);
@@ -515,7 +523,7 @@ void rxnfree(rxnptr rxn) {
 /* rxnssalloc */
 rxnssptr rxnssalloc(rxnssptr rxnss,int molec_num,int maxspecies, int maxsitecode) {	
 	int i,i2,failfree;
-	int *newnrxn,**newtable,**newbinding;
+	int *newnrxn,**newtable,**newbinding,**newintra;
 	int j,sz, species_sz, sitecode_sz, tbl2_sz;
 
 	failfree=0;
@@ -548,7 +556,14 @@ rxnssptr rxnssalloc(rxnssptr rxnss,int molec_num,int maxspecies, int maxsitecode
 		rxnss->rxnr_ptr=g_hash_table_new(g_direct_hash,g_direct_equal);
 		rxnss->rxn_ord1st=g_hash_table_new(g_direct_hash,g_direct_equal);
 		rxnss->binding=NULL;
+		rxnss->intra=NULL;
+		rxnss->maxintra=0;
 		rxnss->radius=g_hash_table_new(g_direct_hash,g_direct_equal);
+		rxnss->rxnstep=1;
+		rxnss->nstepcache=0;
+		rxnss->stepcachek=NULL;
+		rxnss->stepradius=NULL;
+		rxnss->stepbindrad=NULL;
 	 }
 
 	if(maxspecies>rxnss->maxspecies || maxsitecode>rxnss->maxsitecode) {		// initialize or expand nrxn and table
@@ -560,7 +575,16 @@ rxnssptr rxnssalloc(rxnssptr rxnss,int molec_num,int maxspecies, int maxsitecode
 				rxnss->binding[i]=(int*)calloc(maxspecies,sizeof(int));
 				for(j=0;j<maxspecies;j++)
 					rxnss->binding[i][j]=0;
-	}}} 
+	}}
+		if(rxnss->intra && maxspecies>rxnss->maxintra) {		// expand intra-complex table
+			CHECKMEM(newintra=(int**) calloc(maxspecies,sizeof(int*)));
+			for(i=0;i<maxspecies;i++) {
+				CHECKMEM(newintra[i]=(int*) calloc(maxspecies,sizeof(int)));
+				for(j=0;i<rxnss->maxintra && j<rxnss->maxintra;j++) newintra[i][j]=rxnss->intra[i][j]; }
+			for(i=0;i<rxnss->maxintra;i++) free(rxnss->intra[i]);
+			free(rxnss->intra);
+			rxnss->intra=newintra;
+			rxnss->maxintra=maxspecies; }} 
 
 	return rxnss;
 
@@ -599,6 +623,15 @@ void rxnssfree(rxnssptr rxnss) {
 	*/
 	if(rxnss->rxnaff)
 		g_hash_table_destroy(rxnss->rxnaff);
+	if(rxnss->nstepcache) {								// radius and bindrad_eff are among the caches
+		for(i=0;i<rxnss->nstepcache;i++) {
+			g_hash_table_destroy(rxnss->stepradius[i]);
+			g_hash_table_destroy(rxnss->stepbindrad[i]); }
+		rxnss->radius=NULL;
+		rxnss->bindrad_eff=NULL; }
+	free(rxnss->stepcachek);
+	free(rxnss->stepradius);
+	free(rxnss->stepbindrad);
 	if(rxnss->bindrad_eff)
 		g_hash_table_destroy(rxnss->bindrad_eff);
 	
@@ -621,6 +654,10 @@ void rxnssfree(rxnssptr rxnss) {
 		for(i=0;i<rxnss->maxspecies;i++) free(rxnss->binding[i]);	
 		free(rxnss->binding);
 	}
+	if(rxnss->intra){
+		for(i=0;i<rxnss->maxintra;i++) free(rxnss->intra[i]);
+		free(rxnss->intra);
+	}
 	
 	free(rxnss->nrxn);
 
@@ -1205,7 +1242,8 @@ int rxnsetrate(simptr sim,int molec_num,int r_indx,char *erstr) {
 
 		if(order==1) {														
 			// for(ms=0;ms<MSMAX && !rxn->permit[ms];ms=ms+1);		// determine first state that this is permitted for (usually only state)
-			if(rxn->rate<0) {sprintf(erstr,"reaction %s rate is undefined",rxn->rname);return 1;}
+			if(rxn->intrarate>0) rxn->prob=0;						// run by intracplxreact instead
+			else if(rxn->rate<0) {sprintf(erstr,"reaction %s rate is undefined",rxn->rname);return 1;}
 			else if(rxn->rate==0) rxn->prob=0;
 			else if(ms==MSMAX) rxn->prob=0;
 			else {
@@ -1221,7 +1259,7 @@ int rxnsetrate(simptr sim,int molec_num,int r_indx,char *erstr) {
 					}
 				}
 				rxn->prob/=product;	
-				printf("%s, order=%d, prob=%g\n", rxn->rname, order, rxn->prob);
+				SMOLTRACE(sim,TCreact,TLdebug,"%s, order=%d, prob=%g\n", rxn->rname, order, rxn->prob);
 				if(!(rxn->prob>=0 && rxn->prob<=1)) {sprintf(erstr,"reaction %s probability is %g, out of range",rxn->rname,rxn->prob); return 5;}			
 				*/			
 
@@ -1479,7 +1517,7 @@ double rxncalcrate(simptr sim,int molec_num,int r,double *pgemptr) {
 			if(rxn->prob>0 && ms1!=MSMAX) {
 				ratesum=-log(1.0-sum/sim->dt);
 				ans=ratesum*probthisrxn/sum;
-				printf("%s, k=%d, sum=%f, ratesum=%g, probthisrxn=%g, ans=%g\n", rxn->rname, k, sum, ratesum, probthisrxn, ans);
+				SMOLTRACE(sim,TCreact,TLdebug,"%s, k=%d, sum=%f, ratesum=%g, probthisrxn=%g, ans=%g\n", rxn->rname, k, sum, ratesum, probthisrxn, ans);
 			}
 		}
 	}	
@@ -1636,6 +1674,34 @@ int RxnSetValue(simptr sim,const char *option,rxnptr rxn,double value) {
 	return er; }
 
 
+/* RxnSetIntraComplex.  Makes a bound-pair state change reaction, A~B->A'~B',
+fire between neighboring subunits of one complex, meaning subunits linked by
+to/from, with the given rate per ordered subunit pair.  Such pairs are then
+handled by intracplxreact() rather than by spatial search in bireact().
+Returns 0 for success, 1 for out of memory, 2 if the reaction has the wrong
+form, or 3 for a negative rate. */
+int RxnSetIntraComplex(simptr sim,rxnptr rxn,double rate) {
+	rxnssptr rxnss;
+	int i,i1,i2;
+
+	rxnss=rxn->rxnss;
+	if(rxn->molec_num!=2 || rxn->order!=1 || rxn->nprod!=1 || !rxn->rct[1]) return 2;
+	if(rate<0) return 3;
+	if(!rxnss->intra) {
+		rxnss->intra=(int**) calloc(rxnss->maxspecies,sizeof(int*));
+		if(!rxnss->intra) return 1;
+		rxnss->maxintra=rxnss->maxspecies;
+		for(i=0;i<rxnss->maxintra;i++) {
+			rxnss->intra[i]=(int*) calloc(rxnss->maxintra,sizeof(int));
+			if(!rxnss->intra[i]) return 1; }}
+	i1=rxn->rct[0]->ident;
+	i2=rxn->rct[1]->ident;
+	if(i1>=rxnss->maxintra || i2>=rxnss->maxintra) return 2;
+	rxn->intrarate=rate;
+	rxnss->intra[i1][i2]=rxnss->intra[i2][i1]=1;
+	return 0; }
+
+
 /* RxnSetRevparam */
 int RxnSetRevparam(simptr sim,rxnptr rxn,enum RevParam rparamt,double rparam,int prd,double *pos,int dim) {
 	int d,er;
@@ -1842,13 +1908,14 @@ rxnptr RxnAddReaction_cplx(simptr sim, char *rname, int molec_num, int order, in
 	maxspecies=rxnss->maxspecies;
 
 	CHECKMEM(rxn=rxnalloc(molec_num));						
+	rxn->logevents=sim->logrxnevents;
 	if(molec_num==1){															// key_num=1
 		for(i=0;i<rct1->states_num;i++){ 
 			entry=g_pairing(rct1->ident,rct1->states[i]);
 			g_hash_table_insert(rxnss->table,GINT_TO_POINTER(entry),g_slist_append((GSList*)g_hash_table_lookup(rxnss->table,GINT_TO_POINTER(entry)),GINT_TO_POINTER(rxnss->totrxn)));
 			entry_ptr=g_hash_table_lookup(rxnss->table,GINT_TO_POINTER(entry));
 			g_hash_table_insert(rxnss->entrylist,entry_ptr,GINT_TO_POINTER(g_slist_length((GSList*)entry_ptr)));
-			printf("RxnAdd, entrylist_size=%d, molec_num=%d, ident=%d, states=%d, entry=%d, entry_ptr=%d\n", g_hash_table_size(rxnss->entrylist), molec_num, rct1->ident, rct1->states[i], entry,entry_ptr);
+			SMOLTRACE(sim,TCreact,TLdebug,"RxnAdd, entrylist_size=%d, molec_num=%d, ident=%d, states=%d, entry=%d, entry_ptr=%p\n", g_hash_table_size(rxnss->entrylist), molec_num, rct1->ident, rct1->states[i], entry,entry_ptr);
 			// if(g_slist_find(rxnss->entrylist,entry_ptr)==NULL)
 		 	// 	rxnss->entrylist=g_slist_append(rxnss->entrylist,entry_ptr);	
 	}}
@@ -1856,7 +1923,7 @@ rxnptr RxnAddReaction_cplx(simptr sim, char *rname, int molec_num, int order, in
 
 	if(molec_num==2){
 		for(i=0;i<rct1->states_num;i++){
-			printf("molec_num=%d, rct1->states_num=%d, i=%d\n", molec_num, rct1->states_num, i);
+			SMOLTRACE(sim,TCreact,TLdebug,"molec_num=%d, rct1->states_num=%d, i=%d\n", molec_num, rct1->states_num, i);
 			entry1=g_pairing(rct1->ident,rct1->states[i]);
 			for(j=0;j<rct2->states_num;j++) {
 				entry2=g_pairing(rct2->ident,rct2->states[j]);		
@@ -1864,7 +1931,7 @@ rxnptr RxnAddReaction_cplx(simptr sim, char *rname, int molec_num, int order, in
 				g_hash_table_insert(rxnss->table,GINT_TO_POINTER(entry),g_slist_append((GSList*)g_hash_table_lookup(rxnss->table,GINT_TO_POINTER(entry)),GINT_TO_POINTER(rxnss->totrxn)));
 				entry_ptr=g_hash_table_lookup(rxnss->table,GINT_TO_POINTER(entry));
 				g_hash_table_insert(rxnss->entrylist,entry_ptr,GINT_TO_POINTER(g_slist_length((GSList*)entry_ptr)));
-				printf("RxnAdd, entrylist_size=%d, molec_num=%d, rct1->ident=%d, rct1->states[i]=%d, rct2->ident=%d, rct2->states[j]=%d, entry1=%d, entry2=%d, entry=%d, entry_ptr=%d\n", g_hash_table_size(rxnss->entrylist), molec_num, rct1->ident, rct1->states[i], rct2->ident, rct2->states[j], entry1, entry2, entry, entry_ptr);
+				SMOLTRACE(sim,TCreact,TLdebug,"RxnAdd, entrylist_size=%d, molec_num=%d, rct1->ident=%d, rct1->states[i]=%d, rct2->ident=%d, rct2->states[j]=%d, entry1=%d, entry2=%d, entry=%d, entry_ptr=%p\n", g_hash_table_size(rxnss->entrylist), molec_num, rct1->ident, rct1->states[i], rct2->ident, rct2->states[j], entry1, entry2, entry, entry_ptr);
 				// if(g_slist_find(rxnss->entrylist,entry_ptr)==NULL)
 				//	rxnss->entrylist=g_slist_append(rxnss->entrylist,entry_ptr);
 		}}
@@ -2276,9 +2343,11 @@ int loadrxn(simptr sim,ParseFilePtr *pfpptr,char *line2) {
 
 /* rxnsupdateparams */
 int rxnsupdateparams(simptr sim) {
-	int er,wflag,k;
+	int er,wflag,k,r,r2,j,i;
 	char errorstr[STRCHAR];
 	rxnssptr rxnss;
+	rxnptr rxn,rxn2;
+	double dsum,bindrad,rate;
 	
 	wflag=strchr(sim->flags,'w')?1:0;
 	for(k=0;k<MAXORDER;k++){
@@ -2288,6 +2357,47 @@ int rxnsupdateparams(simptr sim) {
 			if(er>=0) {
 				simLog(sim,8,"Error setting rate for reaction  %i, reaction %s\n%s\n",rxnss->molec_num,rxnss->rname[er],errorstr);
 				return 3; }}}
+
+	if(sim->mols && sim->mols->nbrcut)
+		for(k=0;k<MAXORDER;k++) {					// neighbor lists need to reach binding radii
+			rxnss=sim->rxnss[k];
+			if(!rxnss) continue;
+			for(r=0;r<rxnss->totrxn;r++) {
+				rxn=rxnss->rxn[r];
+				if(rxn->order!=2 || rxn->rate<=0) continue;
+				i=rxn->rct[0]->ident;
+				j=rxn->rct[1]->ident;
+				if(i<=0 || j<=0) continue;
+				dsum=sim->mols->difc[i][MSsoln]+sim->mols->difc[j][MSsoln];
+				bindrad=bindingradius(i==j?2*rxn->rate:rxn->rate,sim->dt*rxnspeciesstep(sim->mols,i,j),dsum,-1,0);
+				if(rxn->bindrad>bindrad) bindrad=rxn->bindrad;
+				if(sim->mols->nbrcut[j]>0 && sim->mols->nbrcut[j]<bindrad) i=j;
+				if(sim->mols->nbrcut[i]>0 && sim->mols->nbrcut[i]<bindrad) {
+					simLog(sim,8,"Error setting up reaction %s: neighbor_list cutoff for %s is %g, which is less than the binding radius %g\n",rxn->rname,sim->mols->spname[i],sim->mols->nbrcut[i],bindrad);
+					return 3; }}}
+	if(sim->mols && sim->mols->gfrdbind) {		// binding radii that protective domains keep clear
+		for(i=0;i<sim->mols->nspecies;i++) sim->mols->gfrdbind[i]=0;
+		for(k=0;k<MAXORDER;k++) {
+			rxnss=sim->rxnss[k];
+			if(!rxnss) continue;
+			for(r=0;r<rxnss->totrxn;r++) {
+				rxn=rxnss->rxn[r];
+				if(rxn->order!=2 || rxn->rate<=0) continue;
+				i=rxn->rct[0]->ident;
+				j=rxn->rct[1]->ident;
+				if(i<=0 || j<=0) continue;
+				rate=0;																			// bireact pools the rates of a pair
+				for(r2=0;r2<rxnss->totrxn;r2++) {
+					rxn2=rxnss->rxn[r2];
+					if(rxn2->order!=2 || rxn2->rate<=0) continue;
+					if((rxn2->rct[0]->ident==i && rxn2->rct[1]->ident==j) || (rxn2->rct[0]->ident==j && rxn2->rct[1]->ident==i))
+						rate+=rxn2->rate; }
+				dsum=sim->mols->difc[i][MSsoln]+sim->mols->difc[j][MSsoln];
+				bindrad=bindingradius(i==j?2*rate:rate,sim->dt*rxnspeciesstep(sim->mols,i,j),dsum,-1,0);
+				if(rxn->bindrad>bindrad) bindrad=rxn->bindrad;
+				if(bindrad>sim->mols->gfrdbind[i]) sim->mols->gfrdbind[i]=bindrad;
+				if(bindrad>sim->mols->gfrdbind[j]) sim->mols->gfrdbind[j]=bindrad; }}}
+
 	/*	
 	for(k=0;k<MAXORDER;k++){
 		rxnss=sim->rxnss[k];		
@@ -2414,7 +2524,6 @@ int doreact(rxnssptr rxnss,gpointer rptr,moleculeptr mptr1,moleculeptr mptr2,int
 	double v2[DIMMAX],v1[DIMMAX],rxnpos[DIMMAX],m3[DIMMAX*DIMMAX];
 	enum MolecState ms;
 	double delta_dist;
-	gpointer entry1_ptr,entry2_ptr;
 	rxnptr rxn;
 	simptr sim;
 	
@@ -2445,7 +2554,7 @@ int doreact(rxnssptr rxnss,gpointer rptr,moleculeptr mptr1,moleculeptr mptr2,int
 		i2=difmolec(sim, mptr2,&dif_molec2);
 		dc2=mols->difc[i2][dif_molec2->mstate];
 		//if(sim->events)
-		//	fprintf(sim->events,"\nmptr1->serno=%d mptr2->serno=%d dif_molec1->serno=%d pos[2]=%f dif_molec2->serno=%d pos[2]=%f dc1=%f dc2=%f\n", mptr1->serno, mptr2->serno, dif_molec1->serno, dif_molec1->pos[2],dif_molec2->serno, dif_molec2->pos[2],dc1,dc2);
+		//	fprintf(sim->events,"\nmptr1->serno=%ld mptr2->serno=%ld dif_molec1->serno=%ld pos[2]=%f dif_molec2->serno=%ld pos[2]=%f dc1=%f dc2=%f\n", mptr1->serno, mptr2->serno, dif_molec1->serno, dif_molec1->pos[2],dif_molec2->serno, dif_molec2->pos[2],dc1,dc2);
 		if(dc1==0 && dc2==0) x=0.5;
 		else x=dc2/(dc1+dc2);
 
@@ -2481,10 +2590,14 @@ int doreact(rxnssptr rxnss,gpointer rptr,moleculeptr mptr1,moleculeptr mptr2,int
 	
 	int new_mol=nprod-order, molec_gen;
 	siteptr site1, site2;
+	int evtype=-1;							// binary event log record, -1 for none
+	double evvalue=0;
 
+	molnbrstale(mols,mptr1->ident,rxn->prd[0]->ident);
 	mptr1->ident=rxn->prd[0]->ident;
-	if(mptr2)
-		mptr2->ident=rxn->prd[1]->ident;
+	if(mptr2) {
+		molnbrstale(mols,mptr2->ident,rxn->prd[1]->ident);
+		mptr2->ident=rxn->prd[1]->ident; }
 
 	if(new_mol>0){
 		if(!mptr2){
@@ -2517,7 +2630,7 @@ int doreact(rxnssptr rxnss,gpointer rptr,moleculeptr mptr1,moleculeptr mptr2,int
 		if(!r){
 			r=radius(sim,rptr,mptr1,mptr2,&dc1,&dc2,molec_gen);
 			if(sim->events)
-				fprintf(sim->events, "\ndif_molec1->serno=%d pos[2]=%f dif_molec2->serno=%d pos[2]=%f i1=%d dc1=%f i2=%d dc2=%f\n", dif_molec1->serno,dif_molec1->pos[2],dif_molec2->serno,dif_molec2->pos[2],i1,dc1,i2,dc2);
+				fprintf(sim->events, "\ndif_molec1->serno=%ld pos[2]=%f dif_molec2->serno=%ld pos[2]=%f i1=%d dc1=%f i2=%d dc2=%f\n", dif_molec1->serno,dif_molec1->pos[2],dif_molec2->serno,dif_molec2->pos[2],i1,dc1,i2,dc2);
 		}
 	
 		if(dc1==0 && dc2==0) x=0.5;
@@ -2532,17 +2645,17 @@ int doreact(rxnssptr rxnss,gpointer rptr,moleculeptr mptr1,moleculeptr mptr2,int
 		if(!pnl);													// soln -> soln
 		else if(ms==MSsoln){										// surf -> front soln
 			mptr2->pnl=NULL;
-			fixpt2panel(mptr2->posx,pnl,dim,PFfront,sim->srfss->epsilon); 	}
+			fixmolpt2panel(mptr2->posx,pnl,dim,PFfront,sim->srfss->epsilon); 	}
 		else if(ms==MSbsoln){										// surf -> back soln
 			mptr2->mstate=MSsoln;
 			mptr2->pnl=NULL;
-			fixpt2panel(mptr2->posx,pnl,dim,PFback,sim->srfss->epsilon); 	}
+			fixmolpt2panel(mptr2->posx,pnl,dim,PFback,sim->srfss->epsilon); 	}
 		else if(ms==MSfront){										// surf -> front surf
-			fixpt2panel(mptr2->posx,pnl,dim,PFfront,sim->srfss->epsilon); 	}
+			fixmolpt2panel(mptr2->posx,pnl,dim,PFfront,sim->srfss->epsilon); 	}
 		else if(ms==MSback){										// surf -> back surf
-			fixpt2panel(mptr2->posx,pnl,dim,PFback,sim->srfss->epsilon); 	}
+			fixmolpt2panel(mptr2->posx,pnl,dim,PFback,sim->srfss->epsilon); 	}
 		else{														// surf -> surf: up, down
-			fixpt2panel(mptr2->posx,pnl,dim,PFnone,sim->srfss->epsilon); 	}	
+			fixmolpt2panel(mptr2->posx,pnl,dim,PFnone,sim->srfss->epsilon); 	}	
 
 		for(d1=0;d1<dim && rxn->prdpos[0][d1]==0;d1++);
 		for(d2=0;d2<dim && rxn->prdpos[1][d2]==0;d2++);
@@ -2588,12 +2701,7 @@ int doreact(rxnssptr rxnss,gpointer rptr,moleculeptr mptr1,moleculeptr mptr2,int
 		if(mptr1->tot_sunit>1 && mptr2->tot_sunit>1){		
 			CHECKS(syncpos(mols,mptr1,rxn_site_indx1,NULL)!=-1, "react.c");
 			CHECKS(syncpos(mols,mptr2,rxn_site_indx2,NULL)!=-1, "react.c");
-			entry1_ptr=GINT_TO_POINTER(g_pairing(mptr1->complex_id,mptr2->complex_id));
-			entry2_ptr=GINT_TO_POINTER(g_pairing(mptr2->complex_id,mptr1->complex_id));
-			if(g_hash_table_lookup(mols->complex_connect,entry1_ptr))
-				g_hash_table_remove(mols->complex_connect,entry1_ptr);
-			if(g_hash_table_lookup(mols->complex_connect,entry2_ptr))
-				g_hash_table_remove(mols->complex_connect,entry2_ptr);
+			complexdisconnect(mols,mptr1->complex_id,mptr2->complex_id);
 
 			if(offset1[0]!=0 && offset1[1]!=0 && offset1[2]!=0)
 				CHECKS(complex_pos(sim,mptr1,"pos_line2517",&offset1[0],1)!=-1,"react.c");
@@ -2617,34 +2725,36 @@ int doreact(rxnssptr rxnss,gpointer rptr,moleculeptr mptr1,moleculeptr mptr2,int
 			CHECKS(syncpos(mols,mptr2,rxn_site_indx2,&offset2[0])!=-1, "react.c");
 		}
 
+		evtype=molec_gen==1?ERgenerate:ERunbind;
+		evvalue=molec_gen==1?0:r;
 		if(sim->events) {
 			if(molec_gen==1){
-				fprintf(sim->events, "rxn_time=%f start ident=%s serno=%d \n", sim->time, mols->spname[mptr2->ident], mptr2->serno);
-				//fprintf(sim->events, "time=%f %s prob=%f dsum=%f order=%d ident1=%s ident2=%s mptr1->serno=%d mptr1->complex_id=%d mptr2->serno=%d mptr2->complex_id=%d\n", sim->time, rxn->rname, rxn->prob, dc1+dc2, rxn->order, mols->spname[mptr1->ident], mols->spname[mptr2->ident], mptr1->serno, mptr1->complex_id, mptr2->serno, mptr2->complex_id);
+				fprintf(sim->events, "rxn_time=%f start ident=%s serno=%ld \n", sim->time, mols->spname[mptr2->ident], mptr2->serno);
+				//fprintf(sim->events, "time=%f %s prob=%f dsum=%f order=%d ident1=%s ident2=%s mptr1->serno=%ld mptr1->complex_id=%d mptr2->serno=%ld mptr2->complex_id=%d\n", sim->time, rxn->rname, rxn->prob, dc1+dc2, rxn->order, mols->spname[mptr1->ident], mols->spname[mptr2->ident], mptr1->serno, mptr1->complex_id, mptr2->serno, mptr2->complex_id);
 			}
 			else if(molec_gen==0){
-				fprintf(sim->events, "rxn_time=%f %s unbindrad=%f prob=%f dsum=%f order=%d ident1=%s ident2=%s rxn_site1=%d rxn_site2=%d mptr1->serno=%d mptr1->complex_id=%d mptr2->serno=%d mptr2->complex_id=%d\n", sim->time, rxn->rname, r, rxn->prob,dc1+dc2,order, mols->spname[mptr1->ident], mols->spname[mptr2->ident], rxn_site_indx1, rxn_site_indx2, mptr1->serno, mptr1->complex_id,mptr2->serno,mptr2->complex_id);
+				fprintf(sim->events, "rxn_time=%f %s unbindrad=%f prob=%f dsum=%f order=%d ident1=%s ident2=%s rxn_site1=%d rxn_site2=%d mptr1->serno=%ld mptr1->complex_id=%d mptr2->serno=%ld mptr2->complex_id=%d\n", sim->time, rxn->rname, r, rxn->prob,dc1+dc2,order, mols->spname[mptr1->ident], mols->spname[mptr2->ident], rxn_site_indx1, rxn_site_indx2, mptr1->serno, mptr1->complex_id,mptr2->serno,mptr2->complex_id);
 			}
 	
-			//fprintf(sim->events, ">>> %s serno=%d pos[0]=%f pos[1]=%f pos[2]=%f\n", mols->spname[mptr1->ident], mptr1->serno, mptr1->pos[0],mptr1->pos[1],mptr1->pos[2]);
-			//fprintf(sim->events, ">>> %s serno=%d pos[0]=%f pos[1]=%f pos[2]=%f\n", mols->spname[mptr2->ident], mptr2->serno, mptr2->pos[0],mptr2->pos[1],mptr2->pos[2]);
+			//fprintf(sim->events, ">>> %s serno=%ld pos[0]=%f pos[1]=%f pos[2]=%f\n", mols->spname[mptr1->ident], mptr1->serno, mptr1->pos[0],mptr1->pos[1],mptr1->pos[2]);
+			//fprintf(sim->events, ">>> %s serno=%ld pos[0]=%f pos[1]=%f pos[2]=%f\n", mols->spname[mptr2->ident], mptr2->serno, mptr2->pos[0],mptr2->pos[1],mptr2->pos[2]);
 			//for(k=0;k<sim->mols->spsites_num[mptr1->ident];k++){
 			//	if(mptr1->sites[k]->bind){ 
-			//		fprintf(sim->events,"bound: %s:%d[%d]~%s:%d ", sim->mols->spname[mptr1->ident],mptr1->serno,k,sim->mols->spname[mptr1->sites[k]->bind->ident],mptr1->sites[k]->bind->serno);
+			//		fprintf(sim->events,"bound: %s:%ld[%d]~%s:%ld ", sim->mols->spname[mptr1->ident],mptr1->serno,k,sim->mols->spname[mptr1->sites[k]->bind->ident],mptr1->sites[k]->bind->serno);
 			//}
 			//}
 			//fprintf(sim->events,"\n");
 			//for(k=0;k<sim->mols->spsites_num[mptr2->ident];k++){
-			//	if(mptr2->sites[k]->bind) fprintf(sim->events,"bound: %s:%d[%d]~%s:%d ", sim->mols->spname[mptr2->ident],mptr2->serno,k,sim->mols->spname[mptr2->sites[k]->bind->ident],mptr2->sites[k]->bind->serno);
+			//	if(mptr2->sites[k]->bind) fprintf(sim->events,"bound: %s:%ld[%d]~%s:%ld ", sim->mols->spname[mptr2->ident],mptr2->serno,k,sim->mols->spname[mptr2->sites[k]->bind->ident],mptr2->sites[k]->bind->serno);
 			//}
 			fprintf(sim->events,"\n");
 		}	
-		if(molec_gen>0 && mptr1->vchannel!=NULL){
-			if(mptr1->vchannel->molec_gen>1){
-				for(i=0;i<mptr1->vchannel->molec_gen;i++){
+		if(molec_gen>0 && mptr1->cold->vchannel!=NULL){
+			if(mptr1->cold->vchannel->molec_gen>1){
+				for(i=0;i<mptr1->cold->vchannel->molec_gen;i++){
 					mptr_tmp=getnextmol_cplx(mols,1,mptr2->ident);
 					//if(sim->events)
-					//	fprintf(sim->events,"molec_gen rxn_time=%f mptr->serno=%d\n",sim->time, mptr_tmp->serno);
+					//	fprintf(sim->events,"molec_gen rxn_time=%f mptr->serno=%ld\n",sim->time, mptr_tmp->serno);
 					mptr_tmp->list=sim->mols->listlookup[mptr2->ident][mptr2->mstate];
 					mptr_tmp->box=mptr2->box;
 					mptr_tmp->mstate=mptr2->mstate;
@@ -2656,6 +2766,7 @@ int doreact(rxnssptr rxnss,gpointer rptr,moleculeptr mptr1,moleculeptr mptr2,int
 					}
 					for(s=0;s<sim->mols->spsites_num[mptr2->ident];s++)
 						mptr_tmp->sites[s]->value[0]=mptr2->sites[s]->value[0];
+					molsitesupdate(mols,mptr_tmp);
 		}}}
 	} 
 
@@ -2667,11 +2778,12 @@ int doreact(rxnssptr rxnss,gpointer rptr,moleculeptr mptr1,moleculeptr mptr2,int
 					if(mptr1->sites[rxn->prd[0]->sites_indx[i]]->site_type==0)	// nonbinding site
 						posptr_assign(sim->mols,mptr1,NULL,rxn->prd[0]->sites_indx[i]);
 				}
+				evtype=ERmodify;
 				if(sim->events){ 
-					fprintf(sim->events, "rxn_time=%f %s order=%d ident1=%s mptr1->serno=%d %s\n", sim->time, rxn->rname, order, mols->spname[mptr1->ident], mptr1->serno, mols->spname[mptr1->ident]);
-					//fprintf(sim->events, ">>> %s serno=%d pos[0]=%f pos[1]=%f pos[2]=%f\n", rxn->rname, mptr1->serno, mptr1->pos[0], mptr1->pos[1], mptr1->pos[2]);
+					fprintf(sim->events, "rxn_time=%f %s order=%d ident1=%s mptr1->serno=%ld %s\n", sim->time, rxn->rname, order, mols->spname[mptr1->ident], mptr1->serno, mols->spname[mptr1->ident]);
+					//fprintf(sim->events, ">>> %s serno=%ld pos[0]=%f pos[1]=%f pos[2]=%f\n", rxn->rname, mptr1->serno, mptr1->pos[0], mptr1->pos[1], mptr1->pos[2]);
 					//for(k=0;k<sim->mols->spsites_num[mptr1->ident];k++)
-					//	if(mptr1->sites[k]->bind) fprintf(sim->events,"bound: %s:%d[%d]~%s:%d ", sim->mols->spname[mptr1->ident],mptr1->serno,k,sim->mols->spname[mptr1->sites[k]->bind->ident],mptr1->sites[k]->bind->serno);
+					//	if(mptr1->sites[k]->bind) fprintf(sim->events,"bound: %s:%ld[%d]~%s:%ld ", sim->mols->spname[mptr1->ident],mptr1->serno,k,sim->mols->spname[mptr1->sites[k]->bind->ident],mptr1->sites[k]->bind->serno);
 					//fprintf(sim->events, "\n");
 				}
 				if(rxn->molec_num==2){
@@ -2680,10 +2792,10 @@ int doreact(rxnssptr rxnss,gpointer rptr,moleculeptr mptr1,moleculeptr mptr2,int
 						mptr2->sites[rxn->prd[1]->sites_indx[i]]->time=sim->time;
 					}
 					if(sim->events){ 
-						fprintf(sim->events, "%s dsum=%f order=%d ident2=%s mptr2->serno=%d %s\n", rxn->rname, dc1+dc2, order, mols->spname[mptr2->ident], mptr2->serno, mols->spname[mptr2->ident]);
-						//fprintf(sim->events, ">>> %s serno=%d pos[0]=%f pos[1]=%f pos[2]=%f\n", rxn->rname, mptr2->serno, mptr2->pos[0], mptr2->pos[1], mptr2->pos[2]);
+						fprintf(sim->events, "%s dsum=%f order=%d ident2=%s mptr2->serno=%ld %s\n", rxn->rname, dc1+dc2, order, mols->spname[mptr2->ident], mptr2->serno, mols->spname[mptr2->ident]);
+						//fprintf(sim->events, ">>> %s serno=%ld pos[0]=%f pos[1]=%f pos[2]=%f\n", rxn->rname, mptr2->serno, mptr2->pos[0], mptr2->pos[1], mptr2->pos[2]);
 						//for(k=0;k<sim->mols->spsites_num[mptr2->ident];k++)
-						//	if(mptr2->sites[k]->bind) fprintf(sim->events,"bound: %s:%d[%d]~%s:%d ", sim->mols->spname[mptr2->ident],mptr2->serno,k,sim->mols->spname[mptr2->sites[k]->bind->ident],mptr2->sites[k]->bind->serno);
+						//	if(mptr2->sites[k]->bind) fprintf(sim->events,"bound: %s:%ld[%d]~%s:%ld ", sim->mols->spname[mptr2->ident],mptr2->serno,k,sim->mols->spname[mptr2->sites[k]->bind->ident],mptr2->sites[k]->bind->serno);
 						//fprintf(sim->events, "\n");
 				}}	
 		}}
@@ -2732,11 +2844,7 @@ int doreact(rxnssptr rxnss,gpointer rptr,moleculeptr mptr1,moleculeptr mptr2,int
 
 					CHECKS(syncpos(mols,mptr1,rxn_site_indx1,NULL)!=-1,"react.c");
 					CHECKS(syncpos(mols,mptr2,rxn_site_indx2,NULL)!=-1,"react.c");
-					if(mols->complex_connect==NULL) mols->complex_connect=g_hash_table_new(g_keypair_hash,g_keypair_equal);
-					entry1_ptr=GINT_TO_POINTER(g_pairing(mptr1->complex_id,mptr2->complex_id));
-					entry2_ptr=GINT_TO_POINTER(g_pairing(mptr2->complex_id,mptr1->complex_id));
-					g_hash_table_insert(mols->complex_connect,entry1_ptr,GINT_TO_POINTER(mptr1->s_index+1));		// so that the value won't be zero; if not, difficult to tell from NULL
-					g_hash_table_insert(mols->complex_connect,entry2_ptr,GINT_TO_POINTER(mptr2->s_index+1));
+					CHECKS(!complexconnect(mols,mptr1->complex_id,mptr2->complex_id,mptr1->s_index+1,mptr2->s_index+1),"out of memory in doreact");		// +1 so that the value won't be zero; if not, difficult to tell from NULL
 				}
 				else if(mptr1->tot_sunit>1 && mptr2->tot_sunit==1){
 					posptr_assign(sim->mols,mptr1,mptr2,rxn_site_indx1);
@@ -2760,10 +2868,10 @@ int doreact(rxnssptr rxnss,gpointer rptr,moleculeptr mptr1,moleculeptr mptr2,int
 					posptr_assign(sim->mols,mptr1,mptr2,rxn_site_indx1);
 					posptr_assign(sim->mols,mptr2,mptr1,rxn_site_indx2);	
 
-					if(mptr1->ident==7 && (mptr2->ident==4 || mptr2->ident==3) && mptr1->dif_molec!=NULL){
+					if(SMOLTRACEON(TCcplx,TLdebug) && mptr1->ident==7 && (mptr2->ident==4 || mptr2->ident==3) && mptr1->dif_molec!=NULL){
 						difmolec(sim,mptr1,&dif_molec1);
 						difmolec(sim,mptr2,&dif_molec2);
-						printf("sim->time=%f dif_molec1->serno=%d dif_molec2->serno=%d\n", sim->time, dif_molec1->serno, dif_molec2->serno);
+						SMOLTRACE(sim,TCcplx,TLdebug,"sim->time=%f dif_molec1->serno=%ld dif_molec2->serno=%ld\n", sim->time, dif_molec1->serno, dif_molec2->serno);
 					}
 
 					CHECKS(syncpos(mols,mptr1,rxn_site_indx1,&offset1[0])!=-1, "react.c");
@@ -2771,51 +2879,51 @@ int doreact(rxnssptr rxnss,gpointer rptr,moleculeptr mptr1,moleculeptr mptr2,int
 				}
 				mptr1->sites[rxn_site_indx1]->bind=mptr2;
 				mptr2->sites[rxn_site_indx2]->bind=mptr1;
+				evtype=ERbind;
+				evvalue=sqrt(r);
 
 				if(sim->events) {
 					difmolec(sim,mptr1,&dif_molec1);
 					difmolec(sim,mptr2,&dif_molec2);
-					//fprintf(sim->events,"after binding, dif_molec1->serno=%d, pos[2]=%f, dif_molec2->serno=%d, pos[2]=%f\n", dif_molec1->serno, dif_molec1->pos[2], dif_molec2->serno, dif_molec2->pos[2]);
-					fprintf(sim->events,"rxn_time=%f %s sqrt_bindrad2=%f dsum=%f order=%d ident1=%s ident2=%s rxn_site1=%d rxn_site2=%d mptr1->serno=%d mptr2->serno=%d mptr1->complex_id=%d mptr2->complex_id=%d mptr1->s_index=%d mptr2->s_index=%d \n", sim->time, rxn->rname, sqrt(r), dc1+dc2, order, mols->spname[mptr1->ident], mols->spname[mptr2->ident], rxn_site_indx1, rxn_site_indx2, mptr1->serno, mptr2->serno, mptr1->complex_id, mptr2->complex_id, mptr1->s_index, mptr2->s_index); 
-					//fprintf(sim->events,">>> %s mptr1->serno=%d  mptr2->serno=%d pos[0]=%f pos[1]=%f pos[2]=%f\n", rxn->rname, mptr1->serno, mptr2->serno, mptr1->pos[0], mptr1->pos[1], mptr1->pos[2]);
+					//fprintf(sim->events,"after binding, dif_molec1->serno=%ld, pos[2]=%f, dif_molec2->serno=%ld, pos[2]=%f\n", dif_molec1->serno, dif_molec1->pos[2], dif_molec2->serno, dif_molec2->pos[2]);
+					fprintf(sim->events,"rxn_time=%f %s sqrt_bindrad2=%f dsum=%f order=%d ident1=%s ident2=%s rxn_site1=%d rxn_site2=%d mptr1->serno=%ld mptr2->serno=%ld mptr1->complex_id=%d mptr2->complex_id=%d mptr1->s_index=%d mptr2->s_index=%d \n", sim->time, rxn->rname, sqrt(r), dc1+dc2, order, mols->spname[mptr1->ident], mols->spname[mptr2->ident], rxn_site_indx1, rxn_site_indx2, mptr1->serno, mptr2->serno, mptr1->complex_id, mptr2->complex_id, mptr1->s_index, mptr2->s_index); 
+					//fprintf(sim->events,">>> %s mptr1->serno=%ld  mptr2->serno=%ld pos[0]=%f pos[1]=%f pos[2]=%f\n", rxn->rname, mptr1->serno, mptr2->serno, mptr1->pos[0], mptr1->pos[1], mptr1->pos[2]);
 					//for(k=0;k<sim->mols->spsites_num[mptr1->ident];k++) {
 					//	if(mptr1->sites[k]->bind) {
-					//		fprintf(sim->events,"bound: %s:%d[%d]~%s:%d ", sim->mols->spname[mptr1->ident],mptr1->serno,k,sim->mols->spname[mptr1->sites[k]->bind->ident],mptr1->sites[k]->bind->serno);
+					//		fprintf(sim->events,"bound: %s:%ld[%d]~%s:%ld ", sim->mols->spname[mptr1->ident],mptr1->serno,k,sim->mols->spname[mptr1->sites[k]->bind->ident],mptr1->sites[k]->bind->serno);
 					//	}
 					//}	
 					//fprintf(sim->events,"\n");
 					//for(k=0;k<sim->mols->spsites_num[mptr2->ident];k++){
-					//	if(mptr2->sites[k]->bind) fprintf(sim->events,"bound: %s:%d[%d]~%s:%d ", sim->mols->spname[mptr2->ident],mptr2->serno,k,sim->mols->spname[mptr2->sites[k]->bind->ident],mptr2->sites[k]->bind->serno);}
+					//	if(mptr2->sites[k]->bind) fprintf(sim->events,"bound: %s:%ld[%d]~%s:%ld ", sim->mols->spname[mptr2->ident],mptr2->serno,k,sim->mols->spname[mptr2->sites[k]->bind->ident],mptr2->sites[k]->bind->serno);}
 					//fprintf(sim->events,"\n");
 				}
 		}}
-		mptr1->sites_val=molecsites_state(sim->mols,mptr1);
-		if(mptr1->complex_id!=-1){
-			for(mptr_tmp=mptr1->to,s=0;s<mptr1->tot_sunit-1;s++,mptr_tmp=mptr_tmp->to)
-				mptr_tmp->sites_val=molecsites_state(sim->mols,mptr_tmp);
-		}
+		molsitesupdate(sim->mols,mptr1);
 		mptr1->sim_time=sim->time;
+		moltally(mols,mptr1);
+		CHECKS(!gfrdreset(mols,mptr1),"out of memory in doreact");
 		if(mptr2){
-			mptr2->sites_val=molecsites_state(sim->mols,mptr2);
+			molsitesupdate(sim->mols,mptr2);
 			mptr2->sim_time=sim->time;
-			if(mptr2->complex_id!=-1){
-				for(mptr_tmp=mptr2->to,s=0;s<mptr2->tot_sunit-1;s++,mptr_tmp=mptr_tmp->to)
-					mptr_tmp->sites_val=molecsites_state(sim->mols,mptr_tmp);
-			}
+			moltally(mols,mptr2);
+			CHECKS(!gfrdreset(mols,mptr2),"out of memory in doreact");
 		}
+		if(evtype>=0 && sim->eventlog)
+			simeventlog(sim,(enum EventRecType)evtype,rxn,(int)(intptr_t)((GSList*)rptr)->data,mptr1,(evtype==ERmodify && rxn->molec_num!=2)?NULL:mptr2,rxn_site_indx1,rxn_site_indx2,evvalue);
 		if(sim->events) {
-			//fprintf(sim->events, ">>> mptr1->serno=%d mptr1->sites_val=%d\n", mptr1->serno, mptr1->sites_val);
+			//fprintf(sim->events, ">>> mptr1->serno=%ld mptr1->sites_val=%d\n", mptr1->serno, mptr1->sites_val);
 			//if(mptr2){
-			//	fprintf(sim->events, ">>> mptr2->serno=%d mptr2->sites_val=%d\n", mptr2->serno, mptr2->sites_val);
+			//	fprintf(sim->events, ">>> mptr2->serno=%ld mptr2->sites_val=%d\n", mptr2->serno, mptr2->sites_val);
 			//}
 			//fflush(sim->events);
 		}
 		return 0; 
 	failure: 
-	printf("rxn_time=%f, %s, mptr1->serno=%d, mptr2->serno=%d, mptr1->complex_id=%d, mptr2->complex_id=%d\n", sim->time, rxn->rname, mptr1->serno, mptr2->serno, mptr1->complex_id, mptr2->complex_id);
-	printf("mptr1: pos0=%f, pos1=%f, pos2=%f, prevpos0=%f, prevpos1=%f, prevpos2=%f\n", mptr1->pos[0], mptr1->pos[1], mptr1->pos[2], mptr1->prev_pos[0], mptr1->prev_pos[1], mptr1->prev_pos[2]);
-	printf("mptr2: pos0=%f, pos1=%f, pos2=%f, prevpos0=%f, prevpos1=%f, prevpos2=%f\n", mptr2->pos[0], mptr2->pos[1], mptr2->pos[2], mptr2->prev_pos[0], mptr2->prev_pos[1], mptr2->prev_pos[2]);
-	printf("rxnpos[0]=%f, rxnpos[1]=%f, rxnpos[2]=%f\n", rxnpos[0], rxnpos[1], rxnpos[2]);
+	SMOLTRACE(sim,TCreact,TLerror,"rxn_time=%f, %s, mptr1->serno=%ld, mptr2->serno=%ld, mptr1->complex_id=%d, mptr2->complex_id=%d\n", sim->time, rxn->rname, mptr1->serno, mptr2->serno, mptr1->complex_id, mptr2->complex_id);
+	SMOLTRACE(sim,TCreact,TLerror,"mptr1: pos0=%f, pos1=%f, pos2=%f, prevpos0=%f, prevpos1=%f, prevpos2=%f\n", mptr1->pos[0], mptr1->pos[1], mptr1->pos[2], mptr1->prev_pos[0], mptr1->prev_pos[1], mptr1->prev_pos[2]);
+	SMOLTRACE(sim,TCreact,TLerror,"mptr2: pos0=%f, pos1=%f, pos2=%f, prevpos0=%f, prevpos1=%f, prevpos2=%f\n", mptr2->pos[0], mptr2->pos[1], mptr2->pos[2], mptr2->prev_pos[0], mptr2->prev_pos[1], mptr2->prev_pos[2]);
+	SMOLTRACE(sim,TCreact,TLerror,"rxnpos[0]=%f, rxnpos[1]=%f, rxnpos[2]=%f\n", rxnpos[0], rxnpos[1], rxnpos[2]);
 	return -1;
 
 }
@@ -2856,6 +2964,7 @@ int unireact(simptr sim) {
 	int *nrxn,**table; 
 	int i,j,k,s,m,nmol,ll,entry;
 	enum MolecState ms;
+	double pbuf[DIMMAX];
 	int cond_flag1, cond_flag2;
 	GSList *r;
 	intptr_t r_indx,tmp_len;
@@ -2865,10 +2974,15 @@ int unireact(simptr sim) {
 	double v, inf_n, tau_n, rate_open, rate_close; //inf_h, tau_h, vhalf_n, slope_n, vhalf_h, slope_h;
 	double prob_OC, prob_OB, prob_OO, block_f, block_r;
 	int prd_indx, sites_val,len, list_len,molec_gen;
-	double dc1,dc2,rnd_prob,rxn_prob0,prob_acc,ica,n_t;
+	double dc1,dc2,rnd_prob,rxn_prob0,prob_acc,ica,n_t,rdt,prob;
+	int kstep;
 	
 	if(!sim->rxnss[1]) return 0;
 	for(ll=0;ll<sim->mols->nlist;ll++){
+		kstep=rxnpairstep(sim->mols,ll,ll,1);
+		if(!kstep) continue;													// subcycled list that did not diffuse
+		if(sim->rxnss[2] && rxnsetstep(sim->rxnss[2],kstep)) return 1;
+		rdt=sim->dt*kstep;
 		mlist=sim->mols->live[ll];
 		nmol=sim->mols->nl[ll];
 		for(m=0;m<nmol;m++) {
@@ -2890,10 +3004,10 @@ int unireact(simptr sim) {
 				
 				// generate varying number of Ca2+ ions
 				if(sim->mols->volt_dependent[mptr1->ident]==1){
-					if(mptr1->vchannel->vtime==sim->time){
+					if(mptr1->cold->vchannel->vtime==sim->time){
 						// if gate is open	
-						molec_gen=mptr1->vchannel->molec_gen=-1;
-						v=mptr1->vchannel->voltage;
+						molec_gen=mptr1->cold->vchannel->molec_gen=-1;
+						v=mptr1->cold->vchannel->voltage;
 						block_f=61.2 ; // 0.036 mM^-1 ms^-1= 0.036 uM^-1 s^-1= 0.036 *1700
 						block_r=0.018;
 
@@ -2908,7 +3022,7 @@ int unireact(simptr sim) {
 							// inf_h=1/(1+exp((v-1000)/10));
 							// tau_h=200*4*0.5/(exp(-(v-1000)*0.5/10) + exp((v-1000)*0.5/10)); 
 						
-							prob_OC=1.0-exp(-rate_close*sim->dt);
+							prob_OC=1.0-exp(-rate_close*rdt);
 							prob_OO=1-prob_OC;
 
 							if(rxn->prd[0]->ident==mptr1->ident) prd_indx=0;
@@ -2927,17 +3041,17 @@ int unireact(simptr sim) {
 						// to convert fA to pA by dividing 1000
 						rnd_prob=randCOD();
 						if(mptr1->sites[0]->value[0]==0){		// gate is closed
-							rxn->prob=1.0-exp(-rate_open*sim->dt);
+							rxn->prob=1.0-exp(-rate_open*rdt);
 							if(rnd_prob>rxn->prob) 
 								break;
 							else{								// calculate how many ions to generate
 								// single channel conductance 5.0 pS Keller et al. 2.5 pS
 								// ica is fitted to ghk_i in fA/um2 using eq.S3 from Tadross et al. 2013
 								// n_gate_cal0=2
-								molec_gen=(int)floor(ica*3.12*sim->dt);
+								molec_gen=(int)floor(ica*3.12*rdt);
 								if(molec_gen<=0)
 									break;
-								else { mptr1->vchannel->molec_gen=molec_gen;}
+								else { mptr1->cold->vchannel->molec_gen=molec_gen;}
 							}
 						}
 						else{  // gate is open
@@ -2947,30 +3061,32 @@ int unireact(simptr sim) {
 								rxn=rxnss->rxn[(int)r_indx];
 							}
 							if(rxn->nprod==2){
-								molec_gen=(int)floor(ica*3.12*sim->dt);
+								molec_gen=(int)floor(ica*3.12*rdt);
 								if(molec_gen<=0)
 									break;	
-								else{ mptr1->vchannel->molec_gen=molec_gen;}
+								else{ mptr1->cold->vchannel->molec_gen=molec_gen;}
 							}
 						}	
 
-						printf("unireact time=%f %s prob=%f rnd_prob=%f n_t=%f v=%f molec_gen=%d serno=%d list_len=%d pos[2]=%f\n", sim->time, rxn->rname, rxn->prob, rnd_prob, n_t,v, molec_gen,mptr1->serno, list_len, mptr1->pos[2]);
+						SMOLTRACE(sim,TCreact,TLdebug,"unireact time=%f %s prob=%f rnd_prob=%f n_t=%f v=%f molec_gen=%d serno=%ld list_len=%d pos[2]=%f\n", sim->time, rxn->rname, rxn->prob, rnd_prob, n_t,v, molec_gen,mptr1->serno, list_len, mptr1->pos[2]);
 						if(doreact(rxn->rxnss,r,mptr1,NULL,ll,m,-1,-1,NULL,NULL,NULL,NULL,NULL,dc1,dc2)){
-							printf("line 2908, unireact, doreact() failed, %s\n", rxn->rname);
+							SMOLTRACE(sim,TCreact,TLerror,"line 2908, unireact, doreact() failed, %s\n", rxn->rname);
 							return 1;
 						}	
 						else break;
 				}}
-				else if(mptr1->vchannel==NULL){
-					if(randCOD()>=rxn->prob*prob_acc){
-						prob_acc*=(1-rxn->prob);
+				else if(mptr1->cold->vchannel==NULL){
+					prob=rxn->prob;
+					if(kstep>1) prob=1.0-pow(1.0-prob,kstep);						// chance over the list's steps
+					if(randCOD()>=prob*prob_acc){
+						prob_acc*=(1-prob);
 						continue;
 					}
 					if(!rxn->permit[ms])	 continue;											// failed permit test
-					if(rxn->cmpt) { if(!posincompart(sim,mptr1->pos,rxn->cmpt))	continue;}			// failed compartment test
+					if(rxn->cmpt) { if(!posincompart(sim,molreal2dbl(mptr1->pos,pbuf,sim->dim),rxn->cmpt))	continue;}			// failed compartment test
 					if(rxn->srf) { if(!mptr1->pnl || mptr1->pnl->srf!=rxn->srf)	continue;}			// failed surface test
 					if(doreact(rxn->rxnss,r,mptr1,NULL,ll,m,-1,-1,NULL,NULL,NULL,NULL,NULL,dc1,dc2)){
-						printf("line 2922, unireact, doreact() failed, %s\n", rxn->rname);
+						SMOLTRACE(sim,TCreact,TLerror,"line 2922, unireact, doreact() failed, %s\n", rxn->rname);
 						return 1;
 					}	
 					else break;
@@ -2978,6 +3094,7 @@ int unireact(simptr sim) {
 
 	}}}
 
+	if(sim->rxnss[2]) return rxnsetstep(sim->rxnss[2],1);
 	return 0; }
 
 
@@ -2987,7 +3104,7 @@ int morebireact(rxnssptr rxnss,gpointer rptr,moleculeptr mptrA,moleculeptr mptrB
 	int d,swap;
 	enum MolecState ms,msA,msB;
 	moleculeptr mptr_tmp;
-	double offset[DIMMAX]; // pos_tmp;
+	double offset[DIMMAX],pbuf[DIMMAX]; // pos_tmp;
 	int cplx_connect,i1,i2;
 	gpointer entry_ptr, entryr_ptr;
 	simptr sim;
@@ -2997,15 +3114,15 @@ int morebireact(rxnssptr rxnss,gpointer rptr,moleculeptr mptrA,moleculeptr mptrB
 	sim=rxnss->sim;
 	rxn=rxnss->rxn[(int)(intptr_t)((GSList*)rptr)->data];
 	
-	if(rxn->cmpt && !(posincompart(sim,mptrA->pos,rxn->cmpt) && posincompart(sim,mptrB->pos,rxn->cmpt))) return 0;
+	if(rxn->cmpt && !(posincompart(sim,molreal2dbl(mptrA->pos,pbuf,sim->dim),rxn->cmpt) && posincompart(sim,molreal2dbl(mptrB->pos,pbuf,sim->dim),rxn->cmpt))) return 0;
 	if(rxn->srf && !((mptrA->pnl && mptrA->pnl->srf==rxn->srf) || (mptrB->pnl && mptrB->pnl->srf==rxn->srf))) return 0;
 
 	msA=mptrA->mstate;
 	msB=mptrB->mstate;
 	if(msA==MSsoln && msB!=MSsoln)
-		msA=(panelside(mptrA->pos,mptrB->pnl,sim->dim,NULL,0)==PFfront)?MSsoln:MSbsoln;
+		msA=(panelside(molreal2dbl(mptrA->pos,pbuf,sim->dim),mptrB->pnl,sim->dim,NULL,0)==PFfront)?MSsoln:MSbsoln;
 	else if(msB==MSsoln && msA!=MSsoln)
-		msB=(panelside(mptrB->pos,mptrA->pnl,sim->dim,NULL,0)==PFfront)?MSsoln:MSbsoln;
+		msB=(panelside(molreal2dbl(mptrB->pos,pbuf,sim->dim),mptrA->pnl,sim->dim,NULL,0)==PFfront)?MSsoln:MSbsoln;
 	ms=(MolecState)(msA*MSMAX1+msB);
 	
 	// check if the two molecules belong two complexes that are already bound
@@ -3018,7 +3135,7 @@ int morebireact(rxnssptr rxnss,gpointer rptr,moleculeptr mptrA,moleculeptr mptrB
 	}
 	else cplx_connect=0;
 	if(cplx_connect>0){
-		printf("react.c line 2786, time=%f\n", sim->time);
+		SMOLTRACE(sim,TCcplx,TLdebug,"react.c line 2786, time=%f\n", sim->time);
 		return 0;
 	}
 
@@ -3035,7 +3152,7 @@ int morebireact(rxnssptr rxnss,gpointer rptr,moleculeptr mptrA,moleculeptr mptrB
 					offset[d]=mptrB->pos[d]-mptrB->prev_pos[d];		// cplx
 				}
 				if(complex_pos(sim,mptrB,"pos_line3059",&offset[0],1)==-1){
-					printf("react.c line 3060, time=%f, %s, mptrA->serno=%d, mptrB->serno=%d\n", sim->time, rxn->rname, mptrA->serno, mptrB->serno);
+					SMOLTRACE(sim,TCcplx,TLerror,"react.c line 3060, time=%f, %s, mptrA->serno=%ld, mptrB->serno=%ld\n", sim->time, rxn->rname, mptrA->serno, mptrB->serno);
 					return -1;
 				}
 			}	
@@ -3047,7 +3164,7 @@ int morebireact(rxnssptr rxnss,gpointer rptr,moleculeptr mptrA,moleculeptr mptrB
 					offset[d]=mptrA->pos[d]-mptrA->prev_pos[d];
 				}
 				if(complex_pos(sim,mptrA,"pos_line3071",&offset[0],1)==-1){
-					printf("react.c line 3072, time=%f, %s, mptrA->serno=%d, mptrB->serno=%d\n", sim->time, rxn->rname, mptrA->serno, mptrB->serno);
+					SMOLTRACE(sim,TCcplx,TLerror,"react.c line 3072, time=%f, %s, mptrA->serno=%ld, mptrB->serno=%ld\n", sim->time, rxn->rname, mptrA->serno, mptrB->serno);
 					return -1;
 			}}}	
 
@@ -3058,17 +3175,199 @@ int morebireact(rxnssptr rxnss,gpointer rptr,moleculeptr mptrA,moleculeptr mptrB
 
 
 
+/* rxnpairstep.  Returns the number of time steps that reactions between
+molecules of lists ll1 and ll2 are evaluated over, which is the substep of the
+list that diffuses more often, since only its moves bring the pair to new
+positions.  Enter ll2 equal to ll1 for unimolecular reactions.  If due is set,
+this returns 0 when that list did not diffuse in the current time step, so the
+pair is skipped until it does. */
+int rxnpairstep(molssptr mols,int ll1,int ll2,int due) {
+	int ll;
+
+	ll=(mols->substep[ll2]<mols->substep[ll1])?ll2:ll1;
+	if(due && !mols->stepdue[ll]) return 0;
+	return mols->substep[ll]; }
+
+
+/* rxnspeciesstep.  Returns the number of time steps that reactions between
+solution-phase molecules of species i and j are evaluated over, for sizing
+binding radii during setup. */
+int rxnspeciesstep(molssptr mols,int i,int j) {
+	int ll1,ll2;
+
+	ll1=mols->listlookup[i][MSsoln];
+	ll2=mols->listlookup[j][MSsoln];
+	if(ll1<0 || ll2<0) return 1;
+	return rxnpairstep(mols,ll1,ll2,0); }
+
+
+/* rxnsetstep.  Sets the radius and bindrad_eff caches of rxnss to those for
+reactions that are evaluated over k time steps, adding new caches the first
+time k is used.  The caches for a single time step are those that rxnssalloc
+made.  radius and bireact_test compute binding and unbinding radii for
+rxnstep*dt.  Returns 0 for success or 1 for out of memory. */
+int rxnsetstep(rxnssptr rxnss,int k) {
+	int c,*newk;
+	GHashTable **newradius,**newbindrad;
+
+	if(k==rxnss->rxnstep) return 0;
+	if(rxnss->nstepcache==0) {
+		rxnss->stepcachek=(int*) calloc(1,sizeof(int));
+		rxnss->stepradius=(GHashTable**) calloc(1,sizeof(GHashTable*));
+		rxnss->stepbindrad=(GHashTable**) calloc(1,sizeof(GHashTable*));
+		if(!rxnss->stepcachek || !rxnss->stepradius || !rxnss->stepbindrad) return 1;
+		rxnss->stepcachek[0]=1;
+		rxnss->stepradius[0]=rxnss->radius;
+		rxnss->stepbindrad[0]=rxnss->bindrad_eff;
+		rxnss->nstepcache=1; }
+	for(c=0;c<rxnss->nstepcache && rxnss->stepcachek[c]!=k;c++);
+	if(c==rxnss->nstepcache) {
+		newk=(int*) realloc(rxnss->stepcachek,(c+1)*sizeof(int));
+		if(!newk) return 1;
+		rxnss->stepcachek=newk;
+		newradius=(GHashTable**) realloc(rxnss->stepradius,(c+1)*sizeof(GHashTable*));
+		if(!newradius) return 1;
+		rxnss->stepradius=newradius;
+		newbindrad=(GHashTable**) realloc(rxnss->stepbindrad,(c+1)*sizeof(GHashTable*));
+		if(!newbindrad) return 1;
+		rxnss->stepbindrad=newbindrad;
+		rxnss->stepcachek[c]=k;
+		rxnss->stepradius[c]=g_hash_table_new(g_direct_hash,g_direct_equal);
+		rxnss->stepbindrad[c]=g_hash_table_new(g_direct_hash,g_direct_equal);
+		rxnss->nstepcache++; }
+	rxnss->radius=rxnss->stepradius[c];
+	rxnss->bindrad_eff=rxnss->stepbindrad[c];
+	rxnss->rxnstep=k;
+	return 0; }
+
+
+/* rxnnbrupdate.  Maintains Verlet neighbor lists for molecules of species that
+were given a neighbor_list cutoff.  Each such molecule lists all other such
+molecules, in its own or a neighboring box, that are within the larger of the two
+cutoffs plus the smallest skin.  Lists are rebuilt, all at once, when any listed
+molecule has moved more than half the skin since the last build or when the set
+of listed molecules has changed, which molnbrstale records.  A species uses its lists in bireact only if all
+of its binding partners are listed too.  Molecules in boxes with wrap-around
+neighbors get no list and keep using the box scan, and a molecule that moves into
+such a box loses its list until the next build.  Returns 0 for success or 1 for
+out of memory. */
+int rxnnbrupdate(simptr sim) {
+	molssptr mols;
+	rxnssptr rxnss;
+	moleculeptr mptr,mptr2,*newnbr;
+	boxptr bptr,bptr2;
+	molcoldptr cold;
+	int i,j,k,ll,m,b,ll2,m2,d,dim,rebuild,maxn,newmax;
+	double skin,cut,dist2,move2;
+
+	mols=sim->mols;
+	rxnss=sim->rxnss[2];
+	if(!mols || !mols->nbrcut || !rxnss || !sim->boxs) return 0;
+	dim=sim->dim;
+
+	skin=-1;
+	for(i=1;i<mols->nspecies;i++)
+		if(mols->nbrcut[i]>0 && (skin<0 || mols->nbrskin[i]<skin)) skin=mols->nbrskin[i];
+	if(skin<0) return 0;
+
+	rebuild=!mols->nbrvalid;															// check if lists are stale
+	for(ll=0;ll<mols->nlist;ll++)
+		for(m=0;m<mols->nl[ll];m++) {
+			mptr=mols->live[ll][m];
+			if(mols->nbrcut[mptr->ident]<=0) continue;
+			if(!rebuild) {
+				move2=0;
+				for(d=0;d<dim;d++) move2+=(mptr->pos[d]-mptr->cold->nbrpos[d])*(mptr->pos[d]-mptr->cold->nbrpos[d]);
+				if(move2>0.25*skin*skin) rebuild=1; }
+			bptr=mptr->box;
+			if(bptr!=mptr->cold->nbrbox && mptr->cold->nnbr>=0 && bptr && bptr->wpneigh) {
+				for(b=0;b<bptr->nneigh && !bptr->wpneigh[b];b++);
+				if(b<bptr->nneigh) mptr->cold->nnbr=-1; }}		// list misses periodic images
+	if(!rebuild) return 0;
+
+	for(i=1;i<mols->nspecies;i++) {
+		mols->nbronly[i]=(mols->nbrcut[i]>0);
+		for(j=1;j<mols->nspecies && mols->nbronly[i];j++)
+			if((rxnss->binding[i][j] || rxnss->binding[j][i]) && mols->nbrcut[j]<=0) mols->nbronly[i]=0; }
+
+	maxn=0;
+	for(ll=0;ll<mols->nlist;ll++)
+		for(m=0;m<mols->nl[ll];m++) {
+			mptr=mols->live[ll][m];
+			i=mptr->ident;
+			if(mols->nbrcut[i]<=0) continue;
+			cold=mptr->cold;
+			for(d=0;d<dim;d++) cold->nbrpos[d]=mptr->pos[d];
+			cold->nnbr=-1;
+			bptr=mptr->box;
+			cold->nbrbox=bptr;
+			if(!mols->nbronly[i] || !bptr) continue;
+			for(b=0;b<bptr->nneigh;b++)
+				if(bptr->wpneigh && bptr->wpneigh[b]) break;
+			if(b<bptr->nneigh) continue;
+			cold->nnbr=0;
+			for(b=-1;b<bptr->nneigh;b++) {
+				bptr2=(b<0)?bptr:bptr->neigh[b];
+				for(ll2=0;ll2<mols->nlist;ll2++)
+					for(m2=0;m2<bptr2->nmol[ll2];m2++) {
+						mptr2=bptr2->mol[ll2][m2];
+						j=mptr2->ident;
+						if(mptr2==mptr || mptr2->box!=bptr2 || mptr2->list!=ll2 || mols->nbrcut[j]<=0) continue;
+						cut=(mols->nbrcut[i]>mols->nbrcut[j]?mols->nbrcut[i]:mols->nbrcut[j])+skin;
+						dist2=0;
+						for(d=0;d<dim;d++) dist2+=(mptr->pos[d]-mptr2->pos[d])*(mptr->pos[d]-mptr2->pos[d]);
+						if(dist2>cut*cut) continue;
+						if(cold->nnbr==cold->maxnbr) {
+							newmax=2*cold->maxnbr+8;
+							newnbr=(moleculeptr*) calloc(newmax,sizeof(moleculeptr));
+							if(!newnbr) return 1;
+							for(k=0;k<cold->nnbr;k++) newnbr[k]=cold->nbr[k];
+							free(cold->nbr);
+							cold->nbr=newnbr;
+							cold->maxnbr=newmax; }
+						cold->nbr[cold->nnbr++]=mptr2; }}
+			if(cold->nnbr>maxn) maxn=cold->nnbr; }
+
+	if(maxn>mols->maxnbrbuf) {
+		free(mols->nbrbuf);
+		mols->nbrbuf=(moleculeptr*) calloc(maxn,sizeof(moleculeptr));
+		if(!mols->nbrbuf) {
+			mols->maxnbrbuf=0;
+			return 1; }
+		mols->maxnbrbuf=maxn; }
+	mols->nbrvalid=1;
+	return 0; }
+
+
+/* rxnnbrfilter.  Copies the entries of the neighbor list of mptr1 that are in
+live list ll2 and in one of the nb boxes of blist to the scratch buffer, points
+*mlistptr to it, and returns the number copied. */
+int rxnnbrfilter(simptr sim,moleculeptr mptr1,int ll2,boxptr *blist,int nb,moleculeptr **mlistptr) {
+	moleculeptr mptr2,*buf;
+	int k,b,n;
+
+	buf=sim->mols->nbrbuf;
+	n=0;
+	for(k=0;k<mptr1->cold->nnbr;k++) {
+		mptr2=mptr1->cold->nbr[k];
+		if(mptr2->list!=ll2) continue;
+		for(b=0;b<nb && mptr2->box!=blist[b];b++);
+		if(b<nb) buf[n++]=mptr2; }
+	*mlistptr=buf;
+	return n; }
+
+
 /* bireact */
 int bireact(simptr sim,int neigh) {
 	int dim,maxspecies,ll,ll1,ll2,i,j,s,d,*nl,nmol2,b2,m1,m2,bmax,wpcode,maxlist;
-	int *nrxn; // ,**table;
-	double dist2,vect[DIMMAX];
+	int *nrxn,nbractive; // ,**table;
+	double dist2,vect[DIMMAX],pbuf[DIMMAX];
 	rxnssptr rxnss;
 	rxnptr rxn,*rxnlist;
 	boxptr bptr;
 	moleculeptr **live,*mlist2,mptr1,mptr2,mptrA,mptrB;
 	int bind_site_indx1, bind_site_indx2, rxn_site_indx1,rxn_site_indx2;
-	int doreact_flag, list_len,len;
+	int doreact_flag, list_len,len,kpair;
 	GSList *r, *r_tmp;
 	intptr_t r_indx;
 	siteptr site_tmp;
@@ -3087,6 +3386,7 @@ int bireact(simptr sim,int neigh) {
 	rxnlist=rxnss->rxn;
 	nl=sim->mols->nl;
 	Mlist=sim->mols->Mlist;
+	if(!neigh && rxnnbrupdate(sim)) return 1;
 
 	if(!neigh) {																		// same box
 		for(ll1=0;ll1< sim->mols->nlist;ll1++)
@@ -3096,9 +3396,14 @@ int bireact(simptr sim,int neigh) {
 				if(sim->multibinding==0){
 					if(mptr1->sim_time==sim->time) continue; }
 				bptr=mptr1->box;
+				nbractive=sim->mols->nbrvalid && sim->mols->nbronly[mptr1->ident] && mptr1->cold->nnbr>=0;
 				for(ll2=ll1;ll2<sim->mols->nlist;ll2++){
+					kpair=rxnpairstep(sim->mols,ll1,ll2,1);
+					if(!kpair) continue;												// its faster list did not move
+					if(rxnsetstep(rxnss,kpair)) return 1;
 					mlist2=bptr->mol[ll2];
 					nmol2=bptr->nmol[ll2];
+					if(nbractive) nmol2=rxnnbrfilter(sim,mptr1,ll2,&bptr,1,&mlist2);
 					for(m2=0;m2<nmol2;m2++) {
 						mptr2=mlist2[m2];
 						if(mptr2->serno<=mptr1->serno) continue;
@@ -3130,8 +3435,8 @@ int bireact(simptr sim,int neigh) {
 									if(mptrB->sites[rxn->rct[1]->sites_indx[s]]->time==sim->time) goto site_loop0;}
 
 								if(mptrA->sim_time==sim->time) 
-									printf("sim->time=%f rname:%s  mptrA->serno=%d\n",sim->time,rxn->rname,mptrA->serno);
-								if(rxn->cmpt) { if(!posincompart(sim,mptrA->pos,rxn->cmpt))	break;}			// failed compartment test
+									SMOLTRACE(sim,TCreact,TLdebug,"sim->time=%f rname:%s  mptrA->serno=%ld\n",sim->time,rxn->rname,mptrA->serno);
+								if(rxn->cmpt) { if(!posincompart(sim,molreal2dbl(mptrA->pos,pbuf,sim->dim),rxn->cmpt))	break;}			// failed compartment test
 								if(rxn->srf) { if(!mptrA->pnl || mptrA->pnl->srf!=rxn->srf)	break;}			// failed surface test
 								doreact_flag=doreact(rxn->rxnss,r_tmp,mptrA,mptrB,ll1,m1,ll2,m2,NULL,NULL,rxn->prd[0]->site_bind,rxn->prd[1]->site_bind,NULL,dc1,dc2);
 								if(doreact_flag==-1) return 1;		
@@ -3150,7 +3455,7 @@ int bireact(simptr sim,int neigh) {
 							
 							for(s=0;s<rxn->rct[0]->sites_num;s++){
 								if(mptrA->sites[rxn->rct[0]->sites_indx[s]]->time==sim->time){ 
-									//printf("%s %f mptrA->serno=%d s=%d\n",rxn->rname,sim->time,mptrA->serno,s);
+									//printf("%s %f mptrA->serno=%ld s=%d\n",rxn->rname,sim->time,mptrA->serno,s);
 									goto site_loop0;
 								}
 							}
@@ -3168,7 +3473,7 @@ int bireact(simptr sim,int neigh) {
 							rxn_site_indx2=rxn->prd[1]->site_bind;
 							
 							if(mptrA->sim_time==sim->time) 
-								printf("sim->time=%f rname:%s  mptrA->serno=%d\n",sim->time,rxn->rname,mptrA->serno);
+								SMOLTRACE(sim,TCreact,TLdebug,"sim->time=%f rname:%s  mptrA->serno=%ld\n",sim->time,rxn->rname,mptrA->serno);
 							if((rxn->prob==1 || randCOD()<rxn->prob) && (mptrA->mstate!=MSsoln || mptrB->mstate!=MSsoln || !rxnXsurface(sim,mptrA,mptrB,rxn_site_indx1,rxn_site_indx2))) {
 								if(morebireact(rxn->rxnss,r,mptrA,mptrB,ll1,m1,ll2,ETrxn2intra,NULL,rxn_site_indx1,rxn_site_indx2,bindrad2,dc1,dc2)){ 
 									if(sim->events){ 
@@ -3189,11 +3494,19 @@ int bireact(simptr sim,int neigh) {
 				if(sim->multibinding==0){
 					if(mptr1->sim_time==sim->time) continue; }
 				bptr=mptr1->box;
+				nbractive=sim->mols->nbrvalid && sim->mols->nbronly[mptr1->ident] && mptr1->cold->nnbr>=0;
 				for(ll2=ll1;ll2<sim->mols->nlist;ll2++){
+					kpair=rxnpairstep(sim->mols,ll1,ll2,1);
+					if(!kpair) continue;
+					if(rxnsetstep(rxnss,kpair)) return 1;
 					bmax=(ll1!=ll2)?bptr->nneigh:bptr->midneigh;
 					for(b2=0;b2<bmax;b2++) {
-						mlist2=bptr->neigh[b2]->mol[ll2];
-						nmol2=bptr->neigh[b2]->nmol[ll2];
+						if(nbractive) {												// one pass over listed neighbors
+							if(b2>0) break;
+							nmol2=rxnnbrfilter(sim,mptr1,ll2,bptr->neigh,bmax,&mlist2); }
+						else {
+							mlist2=bptr->neigh[b2]->mol[ll2];
+							nmol2=bptr->neigh[b2]->nmol[ll2]; }
 						if(bptr->wpneigh && bptr->wpneigh[b2]) {					  // neighbor box with wrapping
 							wpcode=bptr->wpneigh[b2];
 							for(m2=0;m2<nmol2;m2++) {
@@ -3213,7 +3526,7 @@ int bireact(simptr sim,int neigh) {
 
 								for(s=0;s<rxn->rct[0]->sites_num;s++){
 									if(mptrA->sites[rxn->rct[0]->sites_indx[s]]->time==sim->time){ 
-										//printf("%s %f mptrA->serno=%d s=%d\n",rxn->rname,sim->time,mptrA->serno,s);
+										//printf("%s %f mptrA->serno=%ld s=%d\n",rxn->rname,sim->time,mptrA->serno,s);
 										goto site_loop1;
 								}}
 								for(s=0;s<rxn->rct[1]->sites_num;s++){
@@ -3228,10 +3541,10 @@ int bireact(simptr sim,int neigh) {
 								rxn_site_indx2=rxn->prd[1]->site_bind;
 	
 								if(mptrA->sim_time==sim->time) 
-									printf("sim->time=%f rname:%s mptrA->serno=%d\n", sim->time, rxn->rname, mptrA->serno);
+									SMOLTRACE(sim,TCreact,TLdebug,"sim->time=%f rname:%s mptrA->serno=%ld\n", sim->time, rxn->rname, mptrA->serno);
 								if((rxn->prob==1 || randCOD()<rxn->prob) && mptrA->ident!=0 && mptrB->ident!=0) {
 									if(morebireact(rxn->rxnss,r,mptrA,mptrB,ll1,m1,ll2,ETrxn2wrap,vect,rxn_site_indx1,rxn_site_indx2,bindrad2,dc1,dc2)){ 
-										printf("react.c line 2946, rxn name: %s\n", rxn->rname);
+										SMOLTRACE(sim,TCreact,TLerror,"react.c line 2946, rxn name: %s\n", rxn->rname);
 										return 3;
 									}
 									//else {break; }
@@ -3255,7 +3568,7 @@ int bireact(simptr sim,int neigh) {
 									
 									for(s=0;s<rxn->rct[0]->sites_num;s++){
 										if(mptrA->sites[rxn->rct[0]->sites_indx[s]]->time==sim->time){
-											//printf("%s %f mptrA->serno=%d s=%d\n",rxn->rname,sim->time,mptrA->serno,s);
+											//printf("%s %f mptrA->serno=%ld s=%d\n",rxn->rname,sim->time,mptrA->serno,s);
 											goto site_loop2;
 									}}
 									for(s=0;s<rxn->rct[1]->sites_num;s++){
@@ -3270,10 +3583,10 @@ int bireact(simptr sim,int neigh) {
 									rxn_site_indx2=rxn->prd[1]->site_bind;
 
 									if(mptrA->sim_time==sim->time) 
-										printf("sim->time=%f rname:%s mptrA->serno=%d\n", sim->time, rxn->rname, mptrA->serno);
+										SMOLTRACE(sim,TCreact,TLdebug,"sim->time=%f rname:%s mptrA->serno=%ld\n", sim->time, rxn->rname, mptrA->serno);
 									if((rxn->prob==1||randCOD()<rxn->prob) && (mptrA->mstate!=MSsoln || mptrB->mstate!=MSsoln || !rxnXsurface(sim,mptrA,mptrB,rxn_site_indx1,rxn_site_indx2)) && mptrA->ident!=0 && mptrB->ident!=0) {
 										if(morebireact(rxn->rxnss,r,mptrA,mptrB,ll1,m1,ll2,ETrxn2inter,NULL,rxn_site_indx1,rxn_site_indx2,bindrad2,dc1,dc2)){
-											printf("react.c line 2972, rxn name: %s\n", rxn->rname);
+											SMOLTRACE(sim,TCreact,TLerror,"react.c line 2972, rxn name: %s\n", rxn->rname);
 											return 4;
 										}
 										//else { break; }
@@ -3282,8 +3595,85 @@ int bireact(simptr sim,int neigh) {
 								}
 						}}}}
 
+	return rxnsetstep(rxnss,1); }
+
+
+/* intracplxscan.  Walks the subunits of complex cplx along their to links and
+adds up the propensities of intra-complex reactions between each subunit and
+its to and from neighbors, taken as ordered pairs.  If target is negative, this
+returns the total propensity.  Otherwise, it stops at the first reaction for
+which the running sum exceeds target, returns the sum, and sets *mptrAptr,
+*mptrBptr and *rnodeptr to the reactants and the reaction's table node. */
+double intracplxscan(simptr sim,complexptr cplx,double target,moleculeptr *mptrAptr,moleculeptr *mptrBptr,GSList **rnodeptr) {
+	rxnssptr rxnss;
+	rxnptr rxn;
+	moleculeptr mptr,mptr2;
+	GSList *r;
+	int s,n,k,l,len,entry;
+	double a0;
+
+	rxnss=sim->rxnss[2];
+	a0=0;
+	mptr=cplx->zeroindx_molec;
+	n=mptr->tot_sunit;
+	for(s=0;s<n && mptr;s++,mptr=mptr->to) {
+		if(mptr->ident==0) continue;
+		for(k=0;k<2;k++) {
+			mptr2=(k==0)?mptr->to:mptr->from;
+			if(!mptr2 || mptr2==mptr || mptr2->ident==0) continue;
+			if(k==1 && mptr2==mptr->to) continue;					// two subunit ring
+			if(mptr->ident>=rxnss->maxintra || mptr2->ident>=rxnss->maxintra) continue;
+			if(!rxnss->intra[mptr->ident][mptr2->ident]) continue;
+			entry=g_pairing(g_pairing(mptr->ident,mptr->sites_val),g_pairing(mptr2->ident,mptr2->sites_val));
+			r=(GSList*)g_hash_table_lookup(rxnss->table,GINT_TO_POINTER(entry));
+			if(!r) continue;
+			len=(int)(intptr_t)g_hash_table_lookup(rxnss->entrylist,r);
+			for(l=0;l<len;l++,r=r->next) {							// table lists are circular
+				rxn=rxnss->rxn[(int)(intptr_t)r->data];
+				if(rxn->intrarate<=0 || rxn->order!=1 || rxn->disable) continue;
+				a0+=rxn->intrarate;
+				if(target>=0 && a0>target) {
+					*mptrAptr=mptr;
+					*mptrBptr=mptr2;
+					*rnodeptr=r;
+					return a0; }}}}
+	return a0; }
+
+
+/* intracplxreact.  Runs reactions between neighboring subunits of each complex
+with the direct Gillespie method over one time step.  These reactions have no
+spatial component, so each complex is an independent well-mixed system whose
+propensities are recomputed after every event.  Returns 0 for success or 1 if a
+reaction could not be performed. */
+int intracplxreact(simptr sim) {
+	rxnssptr rxnss;
+	molssptr mols;
+	complexptr cplx;
+	moleculeptr mptrA,mptrB;
+	GSList *rnode;
+	int k;
+	double t,a0;
+
+	rxnss=sim->rxnss[2];
+	mols=sim->mols;
+	if(!rxnss || !rxnss->intra || !mols) return 0;
+	for(k=0;k<mols->nlivecomplex;k++) {
+		cplx=mols->complexlist[mols->complexlive[k]];
+		if(!cplx || !cplx->zeroindx_molec) continue;
+		t=0;
+		while(1) {
+			a0=intracplxscan(sim,cplx,-1,NULL,NULL,NULL);
+			if(a0<=0) break;
+			t+=exprandCOD(1.0/a0);
+			if(t>=sim->dt) break;
+			rnode=NULL;
+			intracplxscan(sim,cplx,randCOD()*a0,&mptrA,&mptrB,&rnode);
+			if(!rnode) break;
+			if(doreact(rxnss,rnode,mptrA,mptrB,mptrA->list,mptrA->m,mptrB->list,mptrB->m,NULL,NULL,-1,-1,0,0,0)) return 1;
+			sim->eventcount[ETrxn2cplx]++; }}
 	return 0; }
 
+
 void posptr_assign(molssptr mols, moleculeptr mptr, moleculeptr mptr_bind, int site){
 	// dif_molec determines the diffusion coefficient but not necessarily determine a molecules' physical location (pos_tmp, pos)
 	int sitecode,s;
@@ -3399,7 +3789,7 @@ int syncpos(molssptr mols, moleculeptr mptr, int site, double *offset){
 		if(mptr->sites[k]->bind) {
 			for(k0=k-1;k0>=0 && mptr->sites[k0]->bind;k0--){
 				if(mptr->sites[k0]->bind==mptr->sites[k]->bind){
-					printf("binding err, serno=%d binds to the same molecule serno=%d at k=%d and k1=%d\n", mptr->serno, mptr->sites[k]->bind->serno, k, k1);	
+					SMOLTRACE(mols->sim,TCcplx,TLerror,"binding err, serno=%ld binds to the same molecule serno=%ld at k=%d and k1=%d\n", mptr->serno, mptr->sites[k]->bind->serno, k, k1);	
 					return -1;
 			}}
 			if(k!=site) {
@@ -3414,7 +3804,7 @@ int syncpos(molssptr mols, moleculeptr mptr, int site, double *offset){
 			}
 			if(k1<mols->spsites_num[mptr->sites[k]->bind->ident]){ 
 				if(mptr->sites[k]->bind->sites[k1]->bind!=mptr){ 
-					printf("binding err, mptr->serno=%d, mptr->ident=%d, mptr:bind[%d]->serno=%d, mptr:bind[%d]->ident=%d, k1=%d \n", mptr->serno, mptr->ident, k, mptr->sites[k]->bind->serno, k, mptr->sites[k]->bind->ident,k1);
+					SMOLTRACE(mols->sim,TCcplx,TLerror,"binding err, mptr->serno=%ld, mptr->ident=%d, mptr:bind[%d]->serno=%ld, mptr:bind[%d]->ident=%d, k1=%d \n", mptr->serno, mptr->ident, k, mptr->sites[k]->bind->serno, k, mptr->sites[k]->bind->ident,k1);
 					return -1;
 				}
 				else if(k!=site) { 
@@ -3460,7 +3850,7 @@ int syncpos(molssptr mols, moleculeptr mptr, int site, double *offset){
 				mptr_bind=mptr->sites[k]->bind;	
 				if(k!=site && mptr_bind->complex_id!=-1 && site!=-1){
 					if(complex_pos(mols->sim,mptr_bind,"pos_line3353",offset,1)==-1){
-						printf("line 3453 mptr->serno=%d mptr_bind->serno=%d\n",mptr->serno,mptr_bind->serno);
+						SMOLTRACE(mols->sim,TCcplx,TLerror,"line 3453 mptr->serno=%ld mptr_bind->serno=%ld\n",mptr->serno,mptr_bind->serno);
 						return -1;
 						}
 					}
@@ -3546,7 +3936,7 @@ double rxnparser(molssptr mols, char *str, int *molec_num, int *orderptr,int *np
 	else if(!strchr(lhs,'+') && !strchr(lhs,'~') && strchr(rhs,'+')) { 
 		molec2=strsplit(rhs,"+");
 		molec1=rhs;
-		printf("line 3283, molec1:%s, molec2: %s\n", molec1, molec2);
+		SMOLTRACE(mols->sim,TCreact,TLdebug,"line 3283, molec1:%s, molec2: %s\n", molec1, molec2);
 		*molec_num=1;	
 		*orderptr=1;
 		*nprodptr=2;
@@ -3627,12 +4017,12 @@ int rxnlhs(molssptr mols, char *molec, rct_mptr rct){
 
 	ms=strextract(molec,"()");
 	cond=strextract(molec,"{}");
-	printf("molec:%s, cond:%s\n",molec,cond);
+	SMOLTRACE(mols->sim,TCreact,TLdebug,"molec:%s, cond:%s\n",molec,cond);
 
 	if(ms) rct->rctstate=molstring2ms(ms);
 	else rct->rctstate=MSsoln;
 	rct->ident=stringfind(mols->spname,mols->nspecies,strtrim(molec));
-	if(rct->ident==-1) {printf("wrong rct site name\n"); return -1;}
+	if(rct->ident==-1) {SMOLTRACE(mols->sim,TCreact,TLerror,"wrong rct site name\n"); return -1;}
 	if(cond){
 		rct->states_num=rxncond_parse(mols,cond,rct->ident,&(rct->states),&(rct->sites_num),&(rct->sites_indx));	
 		if(rct->states_num<0)
@@ -3693,7 +4083,7 @@ void prdsites_parse(molssptr mols, char *sites_state_str, char *molec_name, prd_
 	char *cptr, *swap, *str_tmp, *sitename_str, *siteval_str;
 
 	prd_ident=stringfind(mols->spname,mols->nspecies,molec_name);
-	if(prd_ident==-1) {printf("wrong site name\n"); return;}
+	if(prd_ident==-1) {SMOLTRACE(mols->sim,TCreact,TLerror,"wrong site name\n"); return;}
 	prd->ident=prd_ident;
 	if(sites_state_str==NULL) {
 		prd->sites_indx=NULL;
@@ -3776,7 +4166,7 @@ int rxncond_parse(molssptr mols, char *cond, int rct_ident, int **sites_state_pt
 				bi_sitesval+=power(2,sitecode_tmp[i])*sites_state_tmp; // [i];
 			}
 			else{
-				printf("sitecode error: %s\n", condstr);
+				SMOLTRACE(mols->sim,TCreact,TLerror,"sitecode error: %s\n", condstr);
 				return -1;
 			}
 		}
@@ -3863,6 +4253,7 @@ GSList* bireact_test(simptr sim, int order, moleculeptr mptr1, moleculeptr mptr2
 		if(r_rxn==NULL){
 			for(l=0,r_tmp=r;l<len[0];r_tmp=r_tmp->next,l++){
 				rxn_tmp=rxnss->rxn[(int)(intptr_t)r_tmp->data];
+				if(rxn_tmp->intrarate>0 || rxn_tmp->rate<=0) continue;		// intracplxreact runs these, or no rate
 				if(rxn_tmp->nprod==2){
 					if(site1==rxn_tmp->prd[0]->site_bind && site2==rxn_tmp->prd[1]->site_bind){
 						g_hash_table_insert(rxnss->rxn_ord1st,GINT_TO_POINTER(entry_rxn),g_slist_append((GSList*)g_hash_table_lookup(rxnss->rxn_ord1st,GINT_TO_POINTER(entry_rxn)),(gpointer)r_tmp));		
@@ -3888,7 +4279,9 @@ GSList* bireact_test(simptr sim, int order, moleculeptr mptr1, moleculeptr mptr2
 			rnd_prob=randCOD();
 			r_tmp=(GSList*)r_rxn->data;
 			rxn_tmp=rxnss->rxn[(int)(intptr_t)r_tmp->data];
-			if(rnd_prob<rxn_tmp->prob){
+			p=rxn_tmp->prob;
+			if(rxnss->rxnstep>1) p=1.0-pow(1.0-p,rxnss->rxnstep);			// chance over the pair's steps
+			if(rnd_prob<p){
 				len[0]=1;
 				return (GSList*)r_rxn->data;
 			}
@@ -3917,7 +4310,7 @@ GSList* bireact_test(simptr sim, int order, moleculeptr mptr1, moleculeptr mptr2
 				prob_max=((double*)g_hash_table_lookup(rxnss->probrng_h,(GSList*)r_tmp->data))[0];
 			}
 
-			prob_survive=exp(-prob_max*sim->dt);
+			prob_survive=exp(-prob_max*sim->dt*rxnss->rxnstep);
 			rnd_prob=randCOD();
 			if(rnd_prob<prob_survive){
 				len[0]=0;
@@ -3957,7 +4350,7 @@ GSList* bireact_test(simptr sim, int order, moleculeptr mptr1, moleculeptr mptr2
 				dsum=MolCalcDifcSum(sim,mptr1,mptr2,dc1,dc2);
 				for(l=0,r_tmp=r;l<len[0];r_tmp=r_tmp->next,l++){
 					rxn_tmp=rxnss->rxn[(int)(intptr_t)r_tmp->data];
-					printf("%s\n",rxn_tmp->rname);
+					SMOLTRACE(sim,TCreact,TLdebug,"%s\n",rxn_tmp->rname);
 					rev=findreverserxn(rxnss,r_tmp,mptr1,mptr2);
 					if(!rev) continue;
 					if(rxn_tmp->order!=2) continue;
@@ -4009,11 +4402,11 @@ GSList* bireact_test(simptr sim, int order, moleculeptr mptr1, moleculeptr mptr2
 				}
 
 				//ka_tot*=kcr_tot;
-				bindrad_eff=bindingradius(ka_tot,sim->dt,dsum,0,0);
-				if(unbindingradius(0.2,sim->dt,dsum,bindrad_eff)>0)
-					bindrad_eff=bindingradius(ka_tot*0.8,sim->dt,dsum,-1,0);
+				bindrad_eff=bindingradius(ka_tot,sim->dt*rxnss->rxnstep,dsum,0,0);
+				if(unbindingradius(0.2,sim->dt*rxnss->rxnstep,dsum,bindrad_eff)>0)
+					bindrad_eff=bindingradius(ka_tot*0.8,sim->dt*rxnss->rxnstep,dsum,-1,0);
 				//kinetics_ratio(sim,dsum,ka_tot,&bindrad_eff,NULL);
-				printf("ka_tot=%f prob_assign=%f rc3=%f\n",ka_tot, prob_assign, bindrad_eff);
+				SMOLTRACE(sim,TCreact,TLdebug,"ka_tot=%f prob_assign=%f rc3=%f\n",ka_tot, prob_assign, bindrad_eff);
 				bindradptr=(double*)malloc(sizeof(double));
 				memcpy(bindradptr,&bindrad_eff,sizeof(double));
 				g_hash_table_insert(rxnss->bindrad_eff,(gpointer)r_tmp,bindradptr);
@@ -4087,12 +4480,26 @@ int molecsites_state(molssptr mols, moleculeptr mptr){
 				if(cplx_tmp->dif_bind_site==s)
 					state_s=cplx_tmp->dif_bind->sites[s]->value[0];				
 		}}
-		sites_state+=(int)power(2,s)*state_s;
-	
+		sites_state+=state_s<<s;
 	}
 	return sites_state;
 }
 
+
+/* molsitesupdate.  Recomputes sites_val for molecule mptr and, if it is part of
+a complex, for the other subunits of the complex, whose site values can be shared
+with mptr's.  Call whenever a site value or a complex's dif_bind changes; sites_val
+is not recomputed anywhere else. */
+void molsitesupdate(molssptr mols,moleculeptr mptr) {
+	moleculeptr mptr_tmp;
+	int s;
+
+	mptr->sites_val=molecsites_state(mols,mptr);
+	if(mptr->complex_id!=-1)
+		for(mptr_tmp=mptr->to,s=0;s<mptr->tot_sunit-1;s++,mptr_tmp=mptr_tmp->to)
+			mptr_tmp->sites_val=molecsites_state(mols,mptr_tmp);
+	return; }
+
 guint g_pairing (guint A, guint B){
 	guint h;
 	h=A>=B? A*A+A+B:A+B*B;
@@ -4131,7 +4538,7 @@ int r_pair_equal(r_pair p1, r_pair p2){
 
 
 double radius(simptr sim, gpointer rptr, moleculeptr mptr1, moleculeptr mptr2, double *dc1, double *dc2, int molec_gen){
-	double difadj1,difadj2, r, rate3, bindrad2, unbindrad, dsum;
+	double difadj1,difadj2, r, rate3, bindrad2, unbindrad, dsum, dt;
 	double *radius_ptr, *radiusrev_ptr;
 	char adj1[30], adj2[30];
 	//moleculeptr dif_molec1, dif_molec2;
@@ -4140,6 +4547,7 @@ double radius(simptr sim, gpointer rptr, moleculeptr mptr1, moleculeptr mptr2, d
 	double pg;
 	
 	dsum=MolCalcDifcSum(sim,mptr1,mptr2,dc1,dc2);
+	dt=sim->dt*sim->rxnss[2]->rxnstep;								// pairs in subcycled lists react over several steps
 	
 	if(molec_gen!=NULL){
 		if(molec_gen==1) return 0;	}
@@ -4164,7 +4572,7 @@ double radius(simptr sim, gpointer rptr, moleculeptr mptr1, moleculeptr mptr2, d
 	
 		// smoldyn-2.43/source/Smoldyn/smolreact.c line 1247
 		if(rxn->order==2 && rev==NULL){
-			bindrad2=bindingradius(rate3,sim->dt,dsum,-1,0);
+			bindrad2=bindingradius(rate3,dt,dsum,-1,0);
 			rxn->bindrad=bindrad2;
 			bindrad2*=bindrad2;
 			r=bindrad2;
@@ -4173,12 +4581,12 @@ double radius(simptr sim, gpointer rptr, moleculeptr mptr1, moleculeptr mptr2, d
 			pg=rxn->rparam;
 			// smoldyn-2.43/.../smolreact.c lin 732
 			
-			bindrad2=bindingradius(rate3,sim->dt,dsum,0,0);			
-			unbindrad=unbindingradius(pg,sim->dt,dsum,bindrad2);
+			bindrad2=bindingradius(rate3,dt,dsum,0,0);			
+			unbindrad=unbindingradius(pg,dt,dsum,bindrad2);
 			
 			if(unbindrad>0){
-				bindrad2=bindingradius(rate3*(1-pg),sim->dt,dsum,-1,0);
-				unbindrad=unbindingradius(pg,sim->dt,dsum,bindrad2);
+				bindrad2=bindingradius(rate3*(1-pg),dt,dsum,-1,0);
+				unbindrad=unbindingradius(pg,dt,dsum,bindrad2);
 			}
 			else 
 				unbindrad=0;
@@ -34,6 +34,7 @@ FILE *LogFile=NULL;
 char ErrorString[STRCHARLONG]="";
 int ErrorType=0;
 char SimFlags[STRCHAR]="";
+int TraceThreshold[TCall]={TLwarning,TLwarning,TLwarning,TLwarning};
 int VCellDefined=0;
 
 
@@ -111,6 +112,42 @@ void simLog(simptr sim,int importance,const char* format, ...) {
 	return; }
 
 
+/* simTrace.  Sends a diagnostic message to simLog, prefixed with the category
+name.  This is normally called through the SMOLTRACE macro, which does the
+compile time and run time filtering. */
+void simTrace(simptr sim,enum TraceCat cat,enum TraceLevel level,const char* format, ...) {
+	char message[STRCHARLONG];
+	const char *catname;
+	va_list arguments;
+	int importance;
+
+	va_start(arguments, format);
+	vsnprintf(message,STRCHARLONG,format,arguments);
+	va_end(arguments);
+
+	if(cat==TCreact) catname="react";
+	else if(cat==TCsurf) catname="surface";
+	else if(cat==TCcplx) catname="complex";
+	else catname="diffuse";
+	if(level==TLerror) importance=7;
+	else if(level==TLwarning) importance=5;
+	else importance=2;
+	simLog(sim,importance,"%s: %s",catname,message);
+	return; }
+
+
+/* simsettrace.  Sets the run time trace level for category cat, or for all
+categories if cat is TCall.  Returns 0 for success, or 1 if level is above the
+compiled TRACE_LEVEL, in which case the threshold is still set but messages above
+TRACE_LEVEL remain unavailable. */
+int simsettrace(enum TraceCat cat,enum TraceLevel level) {
+	int c;
+
+	for(c=0;c<TCall;c++)
+		if(cat==TCall || cat==c) TraceThreshold[c]=level;
+	return (int)level>TRACE_LEVEL?1:0; }
+
+
 /* simParseError */
 void simParseError(simptr sim,ParseFilePtr pfp) {
 	char parseerrstr[STRCHAR];
@@ -164,6 +201,32 @@ char *simss2string(enum SmolStruct ss,char *string) {
 	return string; }
 
 
+/* simstring2tc */
+enum TraceCat simstring2tc(const char *string) {
+	enum TraceCat ans;
+
+	if(!strcmp(string,"react")) ans=TCreact;
+	else if(!strcmp(string,"surface")) ans=TCsurf;
+	else if(!strcmp(string,"complex")) ans=TCcplx;
+	else if(!strcmp(string,"diffuse")) ans=TCdiffuse;
+	else if(!strcmp(string,"all")) ans=TCall;
+	else ans=(enum TraceCat) -1;
+	return ans; }
+
+
+/* simstring2tl */
+enum TraceLevel simstring2tl(const char *string) {
+	enum TraceLevel ans;
+
+	if(!strcmp(string,"none") || !strcmp(string,"off")) ans=TLnone;
+	else if(!strcmp(string,"error")) ans=TLerror;
+	else if(!strcmp(string,"warning")) ans=TLwarning;
+	else if(!strcmp(string,"info")) ans=TLinfo;
+	else if(!strcmp(string,"debug")) ans=TLdebug;
+	else ans=(enum TraceLevel) -1;
+	return ans; }
+
+
 /* simsc2string */
 char *simsc2string(enum StructCond sc,char *string) {
 	if(sc==SCinit) strcpy(string,"not initialized");
@@ -208,6 +271,10 @@ simptr simalloc(const char *fileroot) {
 	sim=NULL;
 	CHECKMEM(sim=(simptr) malloc(sizeof(struct simstruct)));
 	sim->events=NULL;
+	sim->eventlog=NULL;
+	sim->logrxnevents=1;
+	sim->endtraj=NULL;
+	sim->endtrajcodec=TCnone;
 	sim->logfile=NULL;
 	sim->condition=SCinit;
 	sim->filepath=NULL;
@@ -224,6 +291,11 @@ simptr simalloc(const char *fileroot) {
 	sim->tmax=10;
 	sim->tbreak=DBL_MAX;
 	sim->dt=1;
+	sim->dtmin=0;
+	sim->nthreads=0;
+	sim->dtmax=0;
+	sim->dtevents=0;
+	sim->dtevent0=0;
 	for(k=0;k<MAXORDER;k++) sim->rxnss[k]=NULL;
 	sim->mols=NULL;
 	sim->wlist=NULL;
@@ -269,6 +341,8 @@ void simfree(simptr sim) {
 	dim=sim->dim;
 	maxsrf=sim->srfss?sim->srfss->maxsrf:0;
 
+	simeventclose(sim);
+	if(sim->endtraj) fclose(sim->endtraj);
 	graphssfree(sim->graphss);
 	scmdssfree((cmdssptr) sim->cmds);
 	filssfree(sim->filss);
@@ -320,7 +394,9 @@ void simoutput(simptr sim) {
 	simLog(sim,2," Random number seed: %li\n",sim->randseed);
 
 	simLog(sim,2," Time from %g to %g step %g\n",sim->tmin,sim->tmax,sim->dt);
+	if(sim->dtmin>0) simLog(sim,2," Adaptive time step from %g to %g, targeting %g events per molecule\n",sim->dtmin,sim->dtmax,sim->dtevents);
 	if(sim->time!=sim->tmin) simLog(sim,2," Current time: %g\n",sim->time);
+	if(sim->nthreads) simLog(sim,2," Per-molecule random numbers, %i thread%s\n",sim->nthreads,sim->nthreads>1?"s":"");
 	simLog(sim,2,"\n");
 	return; }
 
@@ -478,7 +554,8 @@ int simreadstring(simptr sim,ParseFilePtr pfp,const char *word,char *line2) {
 	filamentptr fil;
 	long int li1;
 	listptrli lilist;
-	int num_mol, serno; //equivalent to nmol, basically the second column of "mol 2 1 a 0 0 0", just not to confuse with other parts of the program;
+	long int serno;
+	int num_mol; //equivalent to nmol, basically the second column of "mol 2 1 a 0 0 0", just not to confuse with other parts of the program;
 	rct_mptr rct1, rct2;
 	prd_mptr prd1, prd2;
 	int *ident, *sites;
@@ -557,6 +634,16 @@ int simreadstring(simptr sim,ParseFilePtr pfp,const char *word,char *line2) {
 		CHECKS(!er,"time step must be >0");
 		CHECKS(!strnword(line2,2),"unexpected text following time_step"); }
 
+	else if(!strcmp(word,"time_step_adapt")) {		// time_step_adapt
+		itct=sscanf(line2,"%lg %lg %lg",&flt1,&flt2,&v2[0]);
+		CHECKS(itct==3,"time_step_adapt format: dtmin dtmax events_per_molecule");
+		CHECKS(flt1>0 && flt2>=flt1,"time_step_adapt needs 0 < dtmin <= dtmax");
+		CHECKS(v2[0]>0,"time_step_adapt events per molecule needs to be >0");
+		sim->dtmin=flt1;
+		sim->dtmax=flt2;
+		sim->dtevents=v2[0];
+		CHECKS(!strnword(line2,4),"unexpected text following time_step_adapt"); }
+
 	else if(!strcmp(word,"time_now")) {						// time_now
 		itct=sscanf(line2,"%lg",&flt1);
 		CHECKS(itct==1,"time_now needs to be a number");
@@ -579,7 +666,7 @@ int simreadstring(simptr sim,ParseFilePtr pfp,const char *word,char *line2) {
 				itct=sscanf(line2,"%s %s",nm,fname);
 				sim->vfile=EmptyString();
 				strcpy(sim->vfile,strextract(fname,"''"));
-				printf("sim->vfile:%s\n",sim->vfile);
+				SMOLTRACE(sim,TCdiffuse,TLdebug,"sim->vfile:%s\n",sim->vfile);
 				//CHECKS(itct==1,"failed to read species name");
 			}
 			else{
@@ -663,7 +750,7 @@ int simreadstring(simptr sim,ParseFilePtr pfp,const char *word,char *line2) {
 		sim->interface->pos=interface_pos;
 		sim->interface->species=molec_ident;
 		//sim->interface->cmpt=cmpt_tmp;
-		printf("side1=%f side2=%f\n", sim->interface->side1, sim->interface->side2);
+		SMOLTRACE(sim,TCsurf,TLdebug,"side1=%f side2=%f\n", sim->interface->side1, sim->interface->side2);
 		sprintf(str1,"%lf",sim->interface->side1);
 		sprintf(str2,"%lf",sim->interface->side2);
 		Parse_AddDefine(pfp,"side1",str1,0);
@@ -677,6 +764,35 @@ int simreadstring(simptr sim,ParseFilePtr pfp,const char *word,char *line2) {
 		CHECKS(er!=5,"more molecule already exist than are requested with max_mol");
 		CHECKS(!strnword(line2,2),"unexpected text following max_mol"); }
 
+	else if(!strcmp(word,"molsort_spatial")) {				// molsort_spatial
+		itct=sscanf(line2,"%i",&i1);
+		CHECKS(itct==1,"molsort_spatial needs to be an integer");
+		er=molsetresort(sim,i1);
+		CHECKS(er!=1,"out of memory");
+		CHECKS(er!=2,"molsort_spatial interval needs to be at least 0");
+		CHECKS(!strnword(line2,2),"unexpected text following molsort_spatial"); }
+
+	else if(!strcmp(word,"neighbor_list")) {				// neighbor_list
+		CHECKS(sim->mols,"need to enter species before neighbor_list");
+		itct=sscanf(line2,"%s %lg %lg",nm,&flt1,&flt2);
+		CHECKS(itct==3,"neighbor_list format: species cutoff skin");
+		i=stringfind(sim->mols->spname,sim->mols->nspecies,nm);
+		CHECKS(i>0,"species name not recognized");
+		er=molsetnbrlist(sim,i,flt1,flt2);
+		CHECKS(er!=3,"neighbor_list cutoff and skin need to be at least 0");
+		CHECKS(!strnword(line2,4),"unexpected text following neighbor_list"); }
+
+	else if(!strcmp(word,"gfrd_species")) {				// gfrd_species
+		CHECKS(sim->mols,"need to enter species before gfrd_species");
+		itct=sscanf(line2,"%s %lg",nm,&flt1);
+		CHECKS(itct==2,"gfrd_species format: species max_radius");
+		i=stringfind(sim->mols->spname,sim->mols->nspecies,nm);
+		CHECKS(i>0,"species name not recognized");
+		er=molsetgfrd(sim,i,flt1);
+		CHECKS(er!=3,"gfrd_species is only supported in 3 dimensions");
+		CHECKS(er!=4,"gfrd_species radius needs to be at least 0");
+		CHECKS(!strnword(line2,3),"unexpected text following gfrd_species"); }
+
 	else if(!strcmp(word,"difc")) {								// difc
 		CHECKS(sim->mols,"need to enter species before difc");
 		er=molstring2index1(sim,line2,&ms,&index);
@@ -874,7 +990,7 @@ else if(!strcmp(word,"compartment_update")) {		// compartment_mol
 		CHECKS(sim->cmptss,"compartments need to be defined before compartment_update statement");
 		CHECKS(sim->cmptss->ncmpt>0,"at least one compartment needs to be defined before compartment_mol");
 		// assuming s_unit=1
-		itct=sscanf(line2,"%d %s",&serno,nm);
+		itct=sscanf(line2,"%li %s",&serno,nm);
 		c=stringfind(sim->cmptss->cnames,sim->cmptss->ncmpt,nm);
 		CHECKS(c>=0,"compartment name is not recognized");
 		line2=strnword(line2,3);
@@ -893,6 +1009,7 @@ else if(!strcmp(word,"compartment_update")) {		// compartment_mol
 		er=updatecompartmol_cplx(sim,serno,i,ident,sites,sim->cmptss->cmptlist[c]);
 		CHECKS(er!=2,"compartment volume is zero or nearly zero");
 		CHECKS(er!=3,"not enough molecules permitted by max_mol");
+		CHECKS(er!=5,"no molecule with this serial number");
 		CHECKS(!strnword(line2,2),"unexpected text following compartment_mol"); }
 
 	else if(!strcmp(word,"molecule_lists")) {			// molecule_lists
@@ -924,6 +1041,16 @@ else if(!strcmp(word,"compartment_update")) {		// compartment_mol
 		molsetlistlookup(sim,0,index,MSall,ll);
 		CHECKS(!strnword(line2,2),"unexpected text following mol_list"); }
 
+	else if(!strcmp(word,"mol_list_substep")) {				// mol_list_substep
+		CHECKS(sim->mols && sim->mols->nlist>0,"need to enter molecule_lists before mol_list_substep");
+		itct=sscanf(line2,"%s %i",nm,&i1);
+		CHECKS(itct==2,"mol_list_substep format: list_name steps");
+		ll=stringfind(sim->mols->listname,sim->mols->nlist,nm);
+		CHECKS(ll>=0,"molecule list name is not recognized");
+		er=molsetlistsubstep(sim,ll,i1);
+		CHECKS(er!=3,"mol_list_substep steps needs to be at least 1");
+		CHECKS(!strnword(line2,3),"unexpected text following mol_list_substep"); }
+
 	// graphics
 
 	else if(!strcmp(word,"graphics")) {						// graphics
@@ -1136,6 +1263,52 @@ else if(!strcmp(word,"compartment_update")) {		// compartment_mol
 	else if(!strcmp(word, "events")){			// record reaction events, cplx
 		sim->events=fopen(line2,"w");	
 	}
+	else if(!strcmp(word,"events_binary")) {			// events_binary
+		itct=sscanf(line2,"%s %i",fname,&i1);
+		CHECKS(itct>=1,"format for events_binary: filename [buffer_records]");
+		if(itct==1) i1=0;
+		er=simeventopen(sim,fname,i1);
+		CHECKS(!er,"unable to open binary event log file '%s'",fname);
+		CHECKS(!strnword(line2,itct+1),"unexpected text following events_binary"); }
+
+	else if(!strcmp(word,"end_trajectory")) {		// end_trajectory
+		itct=sscanf(line2,"%s %s",fname,nm);
+		CHECKS(itct>=1,"format for end_trajectory: filename [none|zlib]");
+		sim->endtrajcodec=TCnone;
+		if(itct==2) {
+			CHECKS(!strcmp(nm,"none") || !strcmp(nm,"zlib"),"end_trajectory compression needs to be none or zlib");
+			if(!strcmp(nm,"zlib")) sim->endtrajcodec=TCzlib;
+			CHECKS(trajcodecavailable(sim->endtrajcodec),"zlib compression is not available in this build"); }
+		if(sim->endtraj) fclose(sim->endtraj);
+		sim->endtraj=fopen(fname,"wb");
+		CHECKS(sim->endtraj,"unable to open end_trajectory file '%s'",fname);
+		CHECKS(!strnword(line2,itct+1),"unexpected text following end_trajectory"); }
+
+	else if(!strcmp(word,"events_reaction")) {		// events_reaction
+		itct=sscanf(line2,"%s %s",rname,nm);
+		CHECKS(itct==2,"format for events_reaction: rname/all on/off");
+		CHECKS(!strcmp(nm,"on") || !strcmp(nm,"off"),"events_reaction needs to be on or off");
+		i1=!strcmp(nm,"on");
+		if(!strcmp(rname,"all")) {
+			sim->logrxnevents=i1;											// also for reactions defined later
+			for(order=0;order<MAXORDER;order++)
+				if(sim->rxnss[order])
+					for(r=0;r<sim->rxnss[order]->totrxn;r++) sim->rxnss[order]->rxn[r]->logevents=i1; }
+		else {
+			r=readrxnname(sim,rname,NULL,&rxn);
+			CHECKS(r>=0,"unrecognized reaction name");
+			rxn->logevents=i1; }
+		CHECKS(!strnword(line2,3),"unexpected text following events_reaction"); }
+
+	else if(!strcmp(word,"trace")) {							// trace
+		itct=sscanf(line2,"%s %s",rname,nm);
+		CHECKS(itct==2,"format for trace: category level");
+		CHECKS((int)simstring2tc(rname)>=0,"trace category needs to be react, surface, complex, diffuse, or all");
+		CHECKS((int)simstring2tl(nm)>=0,"trace level needs to be none, error, warning, info, or debug");
+		if(simsettrace(simstring2tc(rname),simstring2tl(nm)))
+			simLog(sim,5,"WARNING: trace level %s is not compiled in; rebuild with OPTION_TRACE_LEVEL set higher\n",nm);
+		CHECKS(!strnword(line2,3),"unexpected text following trace"); }
+
 	else if(!strcmp(word,"output_root")) {				// output_root
 		er=scmdsetfroot((cmdssptr) sim->cmds,line2);
 		CHECKS(er!=-1,"SMOLDYN BUG: scmdsetfroot"); }
@@ -1151,6 +1324,17 @@ else if(!strcmp(word,"compartment_update")) {		// compartment_mol
 		CHECKS(itct==1,"format for output_precision: value");
 		scmdsetprecision((cmdssptr) sim->cmds,i1);
 		CHECKS(!strnword(line2,2),"unexpected text following output_precision"); }
+
+	else if(!strcmp(word,"output_async")) {				// output_async
+		itct=sscanf(line2,"%s %i",nm,&i1);
+		CHECKS(itct>=1,"format for output_async: on/off [buffer_size]");
+		if(itct==1) i1=0;
+		if(!strcmp(nm,"on")) {
+			er=scmdsetasync((cmdssptr) sim->cmds,1,i1);
+			CHECKS(!er,"unable to start output writer thread"); }
+		else if(!strcmp(nm,"off")) scmdsetasync((cmdssptr) sim->cmds,0,0);
+		else CHECKS(0,"output_async needs to be on or off");
+		CHECKS(!strnword(line2,itct+1),"unexpected text following output_async"); }
 	
 	else if(!strcmp(word,"append_files")) {				// append_files
 		er=scmdsetfnames((cmdssptr) sim->cmds,line2,1);
@@ -1346,9 +1530,9 @@ else if(!strcmp(word,"compartment_update")) {		// compartment_mol
 		prd1=NULL;
 		prd2=NULL;
 		rxnrate=rxnparser(sim->mols,line2,&molec_num,&order,&nprod,&rct1,&rct2,&prd1,&prd2); 
-		printf("rname:%s, rxnrate=%f\n", rname, rxnrate);
+		SMOLTRACE(sim,TCreact,TLdebug,"rname:%s, rxnrate=%f\n", rname, rxnrate);
 		if(!strstr(rname,"<v>"))
-			CHECKS(rxnrate!=NULL, "rxnparse error, %s", rname);
+			CHECKS(rxnrate!=0, "rxnparse error, %s", rname);
 		if(rxnrate) {
 			RxnAddReaction_cplx(sim,rname,molec_num,order,nprod,rct1,rct2,prd1,prd2,cmpt,srf,rxnrate);
 			line2=strnword(line2,2);
@@ -1374,6 +1558,17 @@ else if(!strcmp(word,"compartment_update")) {		// compartment_mol
 		CHECKS(er!=4,"binding radius value must be non-negative");
 		CHECKS(!strnword(line2,3),"unexpected text following binding_radius"); }
 
+	else if(!strcmp(word,"intra_complex")) {		// intra_complex
+		itct=sscanf(line2,"%s %lg",rname,&flt1);
+		CHECKS(itct==2,"intra_complex format: rname rate");
+		r=readrxnname(sim,rname,&order,&rxn);
+		CHECKS(r>=0,"unrecognized reaction name");
+		er=RxnSetIntraComplex(sim,rxn,flt1);
+		CHECKS(er!=1,"out of memory allocating intra-complex table");
+		CHECKS(er!=2,"intra_complex requires a bound pair state change reaction, A~B->A'~B'");
+		CHECKS(er!=3,"intra-complex rate must be non-negative");
+		CHECKS(!strnword(line2,3),"unexpected text following intra_complex"); }
+
 	else if(!strcmp(word,"reaction_probability")) {		// reaction_probability
 		itct=sscanf(line2,"%s %lg",rname,&flt1);
 		CHECKS(itct==2,"reaction_probability format: rname value");
@@ -1527,6 +1722,16 @@ else if(!strcmp(word,"compartment_update")) {		// compartment_mol
 		Simsetrandseed(sim,li1);
 		CHECKS(!strnword(line2,2),"unexpected text following random_seed"); }
 
+	else if(!strcmp(word,"threads")) {						// threads
+		itct=sscanf(line2,"%i",&i1);
+		CHECKS(itct==1,"threads needs to be an integer");
+		CHECKS(i1>=0,"threads needs to be at least 0");
+		sim->nthreads=i1;
+#ifndef HAVE_OPENMP
+		if(i1>1) simLog(sim,5,"WARNING: threads %i requested, but OpenMP is not compiled in; running on one thread\n",i1);
+#endif
+		CHECKS(!strnword(line2,2),"unexpected text following threads"); }
+
 	else if(!strcmp(word,"accuracy")) {						// accuracy
 		itct=sscanf(line2,"%lg",&flt1);
 		CHECKS(itct==1,"accuracy needs to be a number");
@@ -1551,6 +1756,15 @@ else if(!strcmp(word,"compartment_update")) {		// compartment_mol
 		CHECKS(er!=3,"need to enter dim before boxsize");
 		CHECKS(!strnword(line2,2),"unexpected text following boxsize"); }
 
+	else if(!strcmp(word,"box_tune")) {						// box_tune
+		itct=sscanf(line2,"%i",&i1);
+		CHECKS(itct==1,"box_tune needs to be an integer");
+		er=boxsettune(sim,i1);
+		CHECKS(er!=1,"out of memory");
+		CHECKS(er!=2,"box_tune interval needs to be at least 0");
+		CHECKS(er!=3,"need to enter dim before box_tune");
+		CHECKS(!strnword(line2,2),"unexpected text following box_tune"); }
+
 	else if(!strcmp(word,"gauss_table_size")) {		// gauss_table_size
 		itct=sscanf(line2,"%i",&i1);
 		CHECKS(itct==1,"gauss_table_size needs to be an integer");
@@ -1881,6 +2095,108 @@ int simUpdateAndDisplay(simptr sim) {
 	return 1; }
 
 
+/******************************************************************************/
+/****************************** binary event log ******************************/
+/******************************************************************************/
+
+
+/* simeventopen.  Starts a binary event log in file fname, replacing any prior one,
+with a buffer of maxbuf records, or the default if maxbuf is less than 1.  Molecules
+that already exist get start records, so the log describes them no matter where
+the events_binary statement is.  Returns 0 for success or 1 if the file could not
+be created. */
+int simeventopen(simptr sim,const char *fname,int maxbuf) {
+	molssptr mols;
+	int ll,m;
+
+	simeventclose(sim);
+	sim->eventlog=evlogwriteopen(fname,maxbuf);
+	if(!sim->eventlog) return 1;
+	mols=sim->mols;
+	if(mols) {
+		for(ll=0;ll<mols->nlist;ll++)
+			for(m=0;m<mols->nl[ll];m++)
+				if(mols->live[ll][m]->ident>0) simeventlog(sim,ERstart,NULL,-1,mols->live[ll][m],NULL,-1,-1,0);
+		for(m=mols->topd;m<mols->nd;m++)										// resurrected, not yet sorted
+			if(mols->dead[m]->ident>0) simeventlog(sim,ERstart,NULL,-1,mols->dead[m],NULL,-1,-1,0); }
+	return 0; }
+
+
+/* simeventlog.  Adds an event record to the binary event log, if there is one and
+the reaction, if any, is enabled for logging.  r is the reaction number within its
+reaction superstructure.  mptr2 may be NULL. */
+void simeventlog(simptr sim,enum EventRecType type,rxnptr rxn,int r,moleculeptr mptr1,moleculeptr mptr2,int site1,int site2,double value) {
+	eventrecptr rec;
+	moleculeptr mptr;
+	int d,k;
+
+	if(!sim->eventlog || (rxn && !rxn->logevents)) return;
+	rec=evlognext(sim->eventlog);
+	if(!rec) {
+		simLog(sim,7,"WARNING: unable to write binary event log; logging stopped\n");
+		evlogfree(sim->eventlog);
+		sim->eventlog=NULL;
+		return; }
+	rec->time=sim->time;
+	rec->type=type;
+	rec->rxnset=rxn?rxn->rxnss->molec_num:-1;
+	rec->rxn=rxn?r:-1;
+	rec->value=value;
+	for(d=0;d<3;d++) rec->pos[d]=(mptr1 && d<sim->dim)?mptr1->pos[d]:0;
+	rec->site[0]=site1;
+	rec->site[1]=site2;
+	for(k=0;k<2;k++) {
+		mptr=k==0?mptr1:mptr2;
+		rec->serno[k]=mptr?mptr->serno:0;
+		rec->ident[k]=mptr?mptr->ident:0;
+		rec->sites[k]=mptr?mptr->sites_val:0;
+		rec->complexid[k]=mptr?mptr->complex_id:-1; }
+	return; }
+
+
+/* simeventclose.  Writes the remaining records, species names, and reaction
+names to the binary event log and closes it. */
+void simeventclose(simptr sim) {
+	int k,nrxn[MAXORDER];
+	char **rxnname[MAXORDER];
+
+	if(!sim->eventlog) return;
+	for(k=0;k<MAXORDER;k++) {
+		nrxn[k]=sim->rxnss[k]?sim->rxnss[k]->totrxn:0;
+		rxnname[k]=sim->rxnss[k]?sim->rxnss[k]->rname:NULL; }
+	if(evlogwritenames(sim->eventlog,sim->mols?sim->mols->nspecies:0,sim->mols?sim->mols->spname:NULL,MAXORDER,nrxn,rxnname))
+		simLog(sim,7,"WARNING: error while writing binary event log\n");
+	evlogfree(sim->eventlog);
+	sim->eventlog=NULL;
+	return; }
+
+
+/* simendtraj.  Writes the molecules at the end of the simulation to the
+end_trajectory file, if there is one, as a binary trajectory with one frame, and
+closes the file.  Returns 0 for success, 1 if memory could not be allocated, or 2
+if the file could not be written. */
+int simendtraj(simptr sim) {
+	trajfileptr traj;
+	trajframeptr frame;
+	int er;
+
+	if(!sim->endtraj) return 0;
+	traj=NULL;
+	frame=trajframealloc(sim->dim,1);
+	er=frame?0:1;
+	if(!er && sim->mols) er=moltrajframe(sim,frame,-5,MSall,NULL,0);
+	if(!er) {
+		frame->time=sim->time;
+		traj=trajwriteopen(sim->endtraj,sim->dim,sim->mols?sim->mols->nspecies:0,sim->mols?sim->mols->spname:NULL,sim->endtrajcodec);
+		er=traj?trajwriteframe(traj,frame):2; }
+	if(!er) er=trajwriteindex(traj);
+	trajfree(traj);
+	trajframefree(frame);
+	fclose(sim->endtraj);
+	sim->endtraj=NULL;
+	return er; }
+
+
 /******************************************************************************/
 /************************** core simulation functions *************************/
 /******************************************************************************/
@@ -1891,7 +2207,9 @@ int simdocommands(simptr sim) {
 	int er;
 	enum CMDcode ccode;
 
+	cmdcensusplan(sim,0);
 	ccode=scmdexecute((cmdssptr) sim->cmds,sim->time,sim->dt,-1,0);			// scmdexecute() in SimCommand.c, iter=-1
+	if(sim->mols) sim->mols->censusok=0;
 	er=simupdate(sim);
 	if(er) return 8;
 	er=molsort(sim,0);														// sort live and dead
@@ -1900,6 +2218,28 @@ int simdocommands(simptr sim) {
 	return 0; }
 
 
+/* simadapttimestep */
+int simadapttimestep(simptr sim) {
+	int events,nmol,ll;
+	double frac,dt;
+
+	if(sim->dtmin<=0 || !sim->mols) return 0;
+	events=sim->eventcount[ETwall]+sim->eventcount[ETsurf]+sim->eventcount[ETdesorb];
+	events+=sim->eventcount[ETrxn1]+sim->eventcount[ETrxn2intra]+sim->eventcount[ETrxn2inter]+sim->eventcount[ETrxn2wrap]+sim->eventcount[ETrxn2cplx];
+	nmol=0;
+	for(ll=0;ll<sim->mols->nlist;ll++) nmol+=sim->mols->nl[ll];
+	frac=nmol>0?(double)(events-sim->dtevent0)/nmol:0;
+	sim->dtevent0=events;
+
+	dt=sim->dt;
+	if(frac>sim->dtevents) dt*=0.5;							// too busy: halve dt
+	else if(frac<0.25*sim->dtevents) dt*=1.25;				// quiescent: grow dt slowly
+	if(dt<sim->dtmin) dt=sim->dtmin;
+	if(dt>sim->dtmax) dt=sim->dtmax;
+	if(dt==sim->dt) return 0;
+	return simsettime(sim,dt,3); }
+
+
 /* simulatetimestep */
 int simulatetimestep(simptr sim) {
 	int er,ll, tot_ca;
@@ -1910,7 +2250,7 @@ int simulatetimestep(simptr sim) {
 	if(er) return 9;
 	if(sim->srfss) {														// deal with surface or wall collisions
 		for(ll=0;ll<sim->srfss->nmollist;ll++) {
-			if(sim->srfss->srfmollist[ll] & SMLdiffuse && sim->mols->nl[ll]) {
+			if(sim->srfss->srfmollist[ll] & SMLdiffuse && sim->mols->nl[ll] && sim->mols->stepdue[ll]) {
 		    	er=(*sim->surfacecollisionsfn)(sim,ll,0);		
 				if(er){
 					if(sim->events)
@@ -1922,7 +2262,7 @@ int simulatetimestep(simptr sim) {
 	else {
 		if(sim->mols)
 			for(ll=0;ll<sim->mols->nlist;ll++)
-				if(sim->mols->diffuselist[ll] && sim->mols->nl[ll])
+				if(sim->mols->diffuselist[ll] && sim->mols->nl[ll] && sim->mols->stepdue[ll])
 					(*sim->checkwallsfn)(sim,ll,0,NULL); }
 
 	if(er) 
@@ -1930,6 +2270,8 @@ int simulatetimestep(simptr sim) {
 
 	er=(*sim->assignmols2boxesfn)(sim,1,0);					// assign to boxes (diffusing molecs., not reborn)
 	if(er) return 2;
+	er=gfrdupdate(sim);												// protective domain exits, bursts, and creation
+	if(er) return 2;
 	er=molsort(sim,0);	// sort live and dead
 	if(er) return 6;
 
@@ -1937,6 +2279,8 @@ int simulatetimestep(simptr sim) {
 	if(er) return (10+er);
 	er=(*sim->bimolreactfn)(sim,1);
 	if(er) return 4;
+	er=intracplxreact(sim);
+	if(er) return 4;
 	er=(*sim->unimolreactfn)(sim);
 	if(er) return 5;
 	er=(*sim->zeroreactfn)(sim);
@@ -1944,6 +2288,10 @@ int simulatetimestep(simptr sim) {
 
 	er=molsort(sim,0);										 // sort live and dead
 	if(er) return 21;
+	er=molspatialsort(sim,0);								// periodic Morton-order resort
+	if(er) return 21;
+	er=boxestune(sim);											// periodic box size tuning
+	if(er) return 21;
 	
 	/*
 	if(sim->latticess) {
@@ -1956,7 +2304,7 @@ int simulatetimestep(simptr sim) {
 		for(ll=0;ll<sim->srfss->nmollist;ll++) {
 			if(sim->srfss->srfmollist[ll] & SMLdiffuse && sim->mols->nl[ll]) {
 		    	//er=(*sim->surfacecollisionsfn)(sim,ll,1);			
-		    	er=(*sim->surfacecollisionsfn)(sim,ll,0);			
+		    	er=(*sim->surfacecollisionsfn)(sim,ll,sim->mols->stepdue[ll]?0:1);		// lists that did not diffuse only have new products to check
 				if(er){
 					if(sim->events)
 						fprintf(sim->events,"sim timestep, ll=%d, er=%d\n", ll, er);	
@@ -1982,6 +2330,8 @@ int simulatetimestep(simptr sim) {
 	int m;
 	moleculeptr mptr;
 	sim->time+=sim->dt;										// --- end of time step ---
+	er=simadapttimestep(sim);
+	if(er) return 8;
 	er=simdocommands(sim);
 	if(er) return er;
 	if(sim->time>=sim->tmax) return 1;
@@ -2001,7 +2351,9 @@ void endsimulate(simptr sim,int er) {
 		fclose(sim->events);
 		sim->events=NULL;
 	}
+	simeventclose(sim);
 	scmdpop((cmdssptr) sim->cmds,sim->tmax);
+	cmdcensusplan(sim,1);
 	scmdexecute((cmdssptr) sim->cmds,sim->time,sim->dt,-1,1);
 
 	simLog(sim,2,"\n");
@@ -2027,6 +2379,7 @@ void endsimulate(simptr sim,int er) {
 	if(eventcount[ETrxn2intra]) simLog(sim,2,"%i intrabox bimolecular reactions\n",eventcount[ETrxn2intra]);
 	if(eventcount[ETrxn2inter]) simLog(sim,2,"%i interbox bimolecular reactions\n",eventcount[ETrxn2inter]);
 	if(eventcount[ETrxn2wrap]) simLog(sim,2,"%i wrap-around bimolecular reactions\n",eventcount[ETrxn2wrap]);
+	if(eventcount[ETrxn2cplx]) simLog(sim,2,"%i intra-complex reactions\n",eventcount[ETrxn2cplx]);
 	if(eventcount[ETimport]) simLog(sim,2,"%i imported molecules\n",eventcount[ETimport]);
 	if(eventcount[ETexport]) simLog(sim,2,"%i exported molecules\n",eventcount[ETexport]);
 
@@ -2057,14 +2410,19 @@ int smolsimulate(simptr sim) {
 		fprintf(sim->events,"smolsim.c 1949, er=%d\n",er);
 	sim->elapsedtime+=difftime(time(NULL),sim->clockstt);
 	// at the end of simulation, record all ca molecules' positions
+	if(sim->eventlog && sim->mols)
+		for(ll=0;ll<sim->mols->nlist;ll++)
+			for(m=0;m<sim->mols->nl[ll];m++)
+				simeventlog(sim,ERend,NULL,-1,sim->mols->live[ll][m],NULL,-1,-1,0);
+	if(simendtraj(sim)) simLog(sim,7,"WARNING: unable to write end_trajectory file\n");
 	if(sim->events){
 		for(ll=0;ll<sim->mols->nlist;ll++){
 			nmol=sim->mols->nl[ll];
 			mlist=sim->mols->live[ll];
 			for(m=0;m<nmol;m++){
 				mptr=mlist[m];
-				fprintf(sim->events, "rxn_time=%f end mptr->serno=%d pos[0]=%f pos[1]=%f pos[2]=%f complex_id=%d\n", sim->time, mptr->serno, mptr->pos[0], mptr->pos[1], mptr->pos[2], mptr->complex_id); 			
-				if(mptr->ident==1 && mptr->sites_val==1) fprintf(sim->events, "ca[0]:serno=%d\n", mptr->sites[0]->bind->serno); 
+				fprintf(sim->events, "rxn_time=%f end mptr->serno=%ld pos[0]=%f pos[1]=%f pos[2]=%f complex_id=%d\n", sim->time, mptr->serno, mptr->pos[0], mptr->pos[1], mptr->pos[2], mptr->complex_id); 			
+				if(mptr->ident==1 && mptr->sites_val==1) fprintf(sim->events, "ca[0]:serno=%ld\n", mptr->sites[0]->bind->serno); 
 	}}}
 
 	return er; }
@@ -1079,9 +1079,9 @@ surfacessptr surfacessalloc(surfacessptr srfss,int maxsurface,int maxspecies,int
 		srfss->maxspecies=maxspecies;
 		srfss->maxsrf=0;
 		srfss->nsrf=0;
-		srfss->epsilon=100*DBL_EPSILON;
-		srfss->margin=100*DBL_EPSILON;
-		srfss->neighdist=1000*DBL_EPSILON;
+		srfss->epsilon=100*MOLREAL_EPSILON;
+		srfss->margin=100*MOLREAL_EPSILON;
+		srfss->neighdist=1000*MOLREAL_EPSILON;
 		srfss->snames=NULL;
 		srfss->srflist=NULL;
 		srfss->maxmollist=0;
@@ -3625,7 +3625,7 @@ enum SrfAction surfaction(surfaceptr srf,enum PanelFace face,int ident,enum Mole
 /* rxnXsurface */
 int rxnXsurface(simptr sim,moleculeptr mptr1,moleculeptr mptr2,int rxn_site_indx1,int rxn_site_indx2) {
 	int dim,p,i1,i2,result;
-	double *pos1,*pos2,dc1,dc2,rxnpt,crsspt[3],cross,cross2,dsum;
+	double *pos1,*pos2,dc1,dc2,rxnpt,crsspt[3],cross,cross2,dsum,pbuf1[DIMMAX],pbuf2[DIMMAX];
 	boxptr bptr;
 	panelptr pnl;
 	enum PanelFace face1,face2,facein;
@@ -3637,8 +3637,8 @@ int rxnXsurface(simptr sim,moleculeptr mptr1,moleculeptr mptr2,int rxn_site_indx
 	i2=mptr2->ident;
 	ms1=mptr1->mstate;
 	ms2=mptr2->mstate;
-	pos1=mptr1->pos;
-	pos2=mptr2->pos;
+	pos1=molreal2dbl(mptr1->pos,pbuf1,dim);
+	pos2=molreal2dbl(mptr2->pos,pbuf2,dim);
 	// dc1=sim->mols->difc[i1][ms1];
 	// dc2=sim->mols->difc[i2][ms2];
 	dsum=MolCalcDifcSum(sim,mptr1,mptr2,&dc1,&dc2);
@@ -3647,7 +3647,7 @@ int rxnXsurface(simptr sim,moleculeptr mptr1,moleculeptr mptr2,int rxn_site_indx
 	rxnpt=dc1/dsum;
 
 	result=0;
-	for(bptr=pos2box(sim,mptr1->pos);bptr && result==0;bptr=line2nextbox(sim,pos1,pos2,bptr)) {
+	for(bptr=pos2box(sim,pos1);bptr && result==0;bptr=line2nextbox(sim,pos1,pos2,bptr)) {
 		for(p=0;p<bptr->npanel && result==0;p++) {
 			pnl=bptr->panel[p];
 			if(lineXpanel(pos1,pos2,pnl,dim,crsspt,&face1,&face2,&cross,&cross2,NULL)) {
@@ -3707,6 +3707,17 @@ void fixpt2panel(double *pt,panelptr pnl,int dim,enum PanelFace face,double epsi
 	return; }
 
 
+/* fixmolpt2panel.  fixpt2panel for a molecule position or old position, which
+is stored as molreal. */
+void fixmolpt2panel(molreal *pt,panelptr pnl,int dim,enum PanelFace face,double epsilon) {
+	double pbuf[DIMMAX],*ptd;
+
+	ptd=molreal2dbl(pt,pbuf,dim);
+	fixpt2panel(ptd,pnl,dim,face,epsilon);
+	dbl2molreal(ptd,pt,dim);
+	return; }
+
+
 /* movept2panel */
 void movept2panel(double *pt,panelptr pnl,int dim,double margin) {
 	double **point,*front,inpt0[3],inpt1[3],inpt2[3],*inpoint[3];
@@ -3909,7 +3920,7 @@ double closestsurfacept(surfaceptr srf,int dim,double *testpt,double *pnlpt,pane
 void movemol2closepanel(simptr sim,moleculeptr mptr,int dim,double epsilon,double neighdist,double margin) {
 	int nn,p,d,er,exitside,iter,edgenum,newedge;
 	double pt[DIMMAX],newedgept[DIMMAX],pnledgept[DIMMAX],oldnormal[DIMMAX],newnormal[DIMMAX],newedgenormal[DIMMAX],newpos[DIMMAX];
-	double dot,dist2,len;
+	double dot,dist2,len,pbuf[DIMMAX],pxbuf[DIMMAX],*pos,*posx;
 	int thetasign;
 	panelptr pnl,newpnl;
 	enum PanelFace face;
@@ -3920,24 +3931,28 @@ void movemol2closepanel(simptr sim,moleculeptr mptr,int dim,double epsilon,doubl
 	else if(ms==MSback) face=PFback;
 	else face=PFnone;
 	pnl=mptr->pnl;
+	pos=molreal2dbl(mptr->pos,pbuf,dim);
+	posx=molreal2dbl(mptr->posx,pxbuf,dim);
 
-	fixpt2panel(mptr->pos,pnl,dim,face,epsilon);			// move mptr->pos to panel plane
-	if(ptinpanel(mptr->pos,pnl,dim)) return;					// nothing to worry about so return
+	fixpt2panel(pos,pnl,dim,face,epsilon);			// move mptr->pos to panel plane
+	if(ptinpanel(pos,pnl,dim)) {								// nothing to worry about so return
+		dbl2molreal(pos,mptr->pos,dim);
+		return; }
 
-	if(ptinpanel(mptr->posx,pnl,dim))									// set mptr->via to starting point that was in the panel
-		for(d=0;d<dim;d++) mptr->via[d]=mptr->posx[d];
+	if(ptinpanel(posx,pnl,dim))									// set mptr->via to starting point that was in the panel
+		for(d=0;d<dim;d++) mptr->via[d]=posx[d];
 	else
-		closestpanelpt(pnl,dim,mptr->pos,mptr->via);
+		closestpanelpt(pnl,dim,pos,mptr->via);
 
 	iter=0;
-	while(iter==0 || !ptinpanel(mptr->pos,pnl,dim)) {
+	while(iter==0 || !ptinpanel(pos,pnl,dim)) {
 		iter++;
-		er=lineexitpanel(mptr->via,mptr->pos,pnl,dim,pnledgept,&exitside);
+		er=lineexitpanel(mptr->via,pos,pnl,dim,pnledgept,&exitside);
 		if(er || iter>20) {
 			//printf("time = %g.  serno = %li.  ",sim->time,mptr->serno);	// this code is here for debugging purposes but shouldn't be needed.
 			//simLog(sim,7,"BUG in movemol2closepanel %s\n",er?"mptr->via is same as mptr->pos":"iter >1");
-			movept2panel(mptr->pos,pnl,dim,margin);
-			fixpt2panel(mptr->pos,pnl,dim,face,epsilon);
+			movept2panel(pos,pnl,dim,margin);
+			fixpt2panel(pos,pnl,dim,face,epsilon);
 			break; }
 		nn=0;																						// pick a random neighbor for this edge point
 		newpnl=NULL;
@@ -3953,7 +3968,7 @@ void movemol2closepanel(simptr sim,moleculeptr mptr,int dim,double epsilon,doubl
 
 		if(nn) {
 			// if(mptr->s_index==0){															// rotate line to account for new normal vector
-				for(d=0;d<dim;d++) mptr->pos[d]+=(newedgept[d]-pnledgept[d]);				// translate position to account for any edge mismatch
+				for(d=0;d<dim;d++) pos[d]+=(newedgept[d]-pnledgept[d]);				// translate position to account for any edge mismatch
 			//	complex_pos(sim->dim,mptr);				
 			// }
 
@@ -3961,49 +3976,51 @@ void movemol2closepanel(simptr sim,moleculeptr mptr,int dim,double epsilon,doubl
 				if(newedge) thetasign=1;
 				else thetasign=coinrandD(0.5)?1:-1;
 				paneledgenormal(newpnl,newedgept,dim,newedge,newedgenormal);
-				len=sqrt((mptr->pos[0]-newedgept[0])*(mptr->pos[0]-newedgept[0])+(mptr->pos[1]-newedgept[1])*(mptr->pos[1]-newedgept[1]));
-				mptr->pos[0]=newedgept[0]-thetasign*len*newedgenormal[0];
-				mptr->pos[1]=newedgept[1]-thetasign*len*newedgenormal[1]; }
+				len=sqrt((pos[0]-newedgept[0])*(pos[0]-newedgept[0])+(pos[1]-newedgept[1])*(pos[1]-newedgept[1]));
+				pos[0]=newedgept[0]-thetasign*len*newedgenormal[0];
+				pos[1]=newedgept[1]-thetasign*len*newedgenormal[1]; }
 			else {
 				panelnormal(newpnl,newedgept,face,dim,newnormal);
 				if(newedge) {
 					panelnormal(pnl,pnledgept,face,dim,oldnormal);
 					paneledgenormal(newpnl,newedgept,dim,newedge,newedgenormal);
-					dot=(mptr->pos[0]-newedgept[0])*newedgenormal[0]+(mptr->pos[1]-newedgept[1])*newedgenormal[1]+(mptr->pos[2]-newedgept[2])*newedgenormal[2];
+					dot=(pos[0]-newedgept[0])*newedgenormal[0]+(pos[1]-newedgept[1])*newedgenormal[1]+(pos[2]-newedgept[2])*newedgenormal[2];
 					thetasign=(dot>0)?-1:1;
-					Sph_RotateVectWithNormals3D(newedgept,mptr->pos,newpos,oldnormal,newnormal,thetasign);
+					Sph_RotateVectWithNormals3D(newedgept,pos,newpos,oldnormal,newnormal,thetasign);
 					if(fabs(dot)<0.01) {												// check result if there's any doubt
 						dot=(newpos[0]-newedgept[0])*newedgenormal[0]+(newpos[1]-newedgept[1])*newedgenormal[1]+(newpos[2]-newedgept[2])*newedgenormal[2];
 						if(dot>0)																	// rotated wrong way, so do it again
-							Sph_RotateVectWithNormals3D(newedgept,mptr->pos,newpos,oldnormal,newnormal,-thetasign); }
+							Sph_RotateVectWithNormals3D(newedgept,pos,newpos,oldnormal,newnormal,-thetasign); }
 					// if(mptr->s_index==0){
-						for(d=0;d<dim;d++) mptr->pos[d]=newpos[d];
+						for(d=0;d<dim;d++) pos[d]=newpos[d];
 					//	complex_pos(sim->dim,mptr); 
 					// }
 				}
 				else
-					Sph_RotateVectWithNormals3D(newedgept,mptr->pos,mptr->pos,NULL,newnormal,0); }
+					Sph_RotateVectWithNormals3D(newedgept,pos,pos,NULL,newnormal,0); }
 			pnl=mptr->pnl=newpnl; }
 		else {																						// no new panel so bounce off of the edge of current panel
 			paneledgenormal(pnl,pnledgept,dim,exitside,newnormal);
 			dot=0;
-			for(d=0;d<dim;d++) dot+=(mptr->pos[d]-pnledgept[d])*newnormal[d];
+			for(d=0;d<dim;d++) dot+=(pos[d]-pnledgept[d])*newnormal[d];
 			// if(mptr->s_index==0){
-				for(d=0;d<dim;d++) mptr->pos[d]-=2.0*newnormal[d]*dot;
+				for(d=0;d<dim;d++) pos[d]-=2.0*newnormal[d]*dot;
 			//	complex_pos(sim->dim,mptr);
 			// }
 			for(d=0;d<dim;d++) newedgept[d]=pnledgept[d]; }
 
-		fixpt2panel(mptr->pos,pnl,dim,face,epsilon);
+		fixpt2panel(pos,pnl,dim,face,epsilon);
 		for(d=0;d<dim;d++) mptr->via[d]=newedgept[d]; }
 
+	dbl2molreal(pos,mptr->pos,dim);
 	return; }
 
 
 /* surfacereflect */
 void surfacereflect(moleculeptr mptr,panelptr pnl,double *crsspt,int dim,enum PanelFace face) {
 	int d,axis;
-	double *pos,*front,norm[3],norm2[3],dot;
+	double *front,norm[3],norm2[3],dot;
+	molreal *pos;
 
 	pos=mptr->pos;
 	front=pnl->front;
@@ -4012,7 +4029,7 @@ void surfacereflect(moleculeptr mptr,panelptr pnl,double *crsspt,int dim,enum Pa
 		if(pnl->ps==PSrect) {
 			axis=(int)front[1];
 			pos[axis]-=2.0*(pos[axis]-crsspt[axis]); 
-			// printf("pname=%s, mptr->serno=%d, axis=%d, pos=%f\n", pnl->pname, mptr->serno, axis, pos[axis]); 
+			// printf("pname=%s, mptr->serno=%ld, axis=%d, pos=%f\n", pnl->pname, mptr->serno, axis, pos[axis]); 
 		}
 		else if(pnl->ps==PStri || pnl->ps==PSdisk) {
 			dot=0;
@@ -4121,13 +4138,13 @@ int surfacejump(moleculeptr mptr,panelptr pnl,double *crsspt,enum PanelFace face
 		for(d=0;d<dim;d++) delta[d]=0;
 		dir=1; }
 
-	// printf("jump, line 4179, serno=%d, posoffset[0]=%f, posoffset[1]=%f, posoffset[2]=%f\n", mptr->serno, mptr->posoffset[0], mptr->posoffset[1], mptr->posoffset[2]);
+	// printf("jump, line 4179, serno=%ld, posoffset[0]=%f, posoffset[1]=%f, posoffset[2]=%f\n", mptr->serno, mptr->posoffset[0], mptr->posoffset[1], mptr->posoffset[2]);
 	for(d=0;d<dim;d++) {
 		crsspt[d]+=delta[d];
 		mptr->pos[d]+=delta[d];
 		mptr->posoffset[d]-=delta[d]; }
-	// printf("jump, line 4184, serno=%d, posoffset[0]=%f, posoffset[1]=%f, posoffset[2]=%f\n", mptr->serno, mptr->posoffset[0], mptr->posoffset[1], mptr->posoffset[2]);
-	// printf("jump, line 4185, serno=%d, pos[0]=%f, pos[1]=%f, pos[2]=%f\n", mptr->serno, mptr->pos[0], mptr->pos[1], mptr->pos[2]);
+	// printf("jump, line 4184, serno=%ld, posoffset[0]=%f, posoffset[1]=%f, posoffset[2]=%f\n", mptr->serno, mptr->posoffset[0], mptr->posoffset[1], mptr->posoffset[2]);
+	// printf("jump, line 4185, serno=%ld, pos[0]=%f, pos[1]=%f, pos[2]=%f\n", mptr->serno, mptr->pos[0], mptr->pos[1], mptr->pos[2]);
 	fixpt2panel(crsspt,pnl2,dim,face2,0);
 	dir*=(face!=face2)?1:-1;
 	if(dir==-1) surfacereflect(mptr,pnl2,crsspt,dim,face);
@@ -4174,7 +4191,7 @@ int rotating_jump(moleculeptr mptr, panelptr pnl, double *crsspt, enum PanelFace
 		for(d=0;d<dim;d++) pos[d]=mptr->pos[d];
 
 		if(pnlpoint1[0]==0 && pnlpoint2[0]==0 && pnlpoint1[1]!=pnlpoint2[1])  {			// rotating along x axis: x'=x, y'=y*cos(theta)-z*sin(theta), z'=y*sin(theta)+z*cos(theta)
-			printf("rotate about x\n");
+			SMOLTRACE(NULL,TCsurf,TLdebug,"rotate about x\n");
 			// if the to-panel < from-panel, then it's counter-clockwise, then r_angle>0
 			r_angle=(pnlpoint2[1]<pnlpoint1[1])?r_angle:-r_angle;
 			mptr->pos[1]= pos[1]*cos(r_angle) - pos[2]*sin(r_angle);				
@@ -4182,7 +4199,7 @@ int rotating_jump(moleculeptr mptr, panelptr pnl, double *crsspt, enum PanelFace
 			// if(mptr->tot_sunit>1) rotation_update(mptr->rotate_mtrx, 0, r_angle);						// 0: rotate about x		
 		}
 		if(pnlpoint1[1]==0 && pnlpoint2[1]==0 && pnlpoint1[0]!=pnlpoint2[0]){			// rotating along y axis: x'=x*cos(theta)+z*sin(theta), y'=y, z'=-x*sin(theta)+z*cos(theta)
-			printf("rotate about y\n");
+			SMOLTRACE(NULL,TCsurf,TLdebug,"rotate about y\n");
 			// don't know why for rotating about y, the rule is opposite
 			r_angle=(pnlpoint2[0]<pnlpoint1[0])?-r_angle:r_angle;
 			mptr->pos[0]= pos[0]*cos(r_angle) + pos[2]*sin(r_angle);
@@ -4192,7 +4209,7 @@ int rotating_jump(moleculeptr mptr, panelptr pnl, double *crsspt, enum PanelFace
 		
 		// printf("rotating_jump, pnlpoint1[0]=%f, pnlpoint1[1]=%f, pnlpoint1[2]=%f, Sc1[0]=%f, Sc1[1]=%f, Sc1[2]=%f\n", pnlpoint1[0], pnlpoint1[1], pnlpoint1[2], Sc1[0], Sc1[1], Sc1[2]);
 		// printf("rotating_jump, pnlpoint2[0]=%f, pnlpoint2[1]=%f, pnlpoint2[2]=%f, Sc2[0]=%f, Sc2[1]=%f, Sc2[2]=%f\n", pnlpoint2[0], pnlpoint2[1], pnlpoint2[2], Sc2[0], Sc2[1], Sc2[2]);
-		// printf("rotating_jump, serno=%d,r_angle=%f, pos[0]=%f, pos[1]=%f, pos[2]=%f, new_pos[0]=%f, new_pos[1]=%f, new_pos[2]=%f\n", mptr->serno, r_angle, pos[0], pos[1],pos[2],mptr->pos[0],mptr->pos[1],mptr->pos[2]);
+		// printf("rotating_jump, serno=%ld,r_angle=%f, pos[0]=%f, pos[1]=%f, pos[2]=%f, new_pos[0]=%f, new_pos[1]=%f, new_pos[2]=%f\n", mptr->serno, r_angle, pos[0], pos[1],pos[2],mptr->pos[0],mptr->pos[1],mptr->pos[2]);
 
 		for(d=0;d<dim;d++){
 			crsspt[d]+=mptr->pos[d]-pos[d];
@@ -4210,7 +4227,7 @@ int dosurfinteract(simptr sim,moleculeptr mptr,int ll,int m,panelptr pnl,enum Pa
 	enum PanelFace newface;
 	enum MolecState ms,ms2;
 	enum SrfAction act;																// smoldyn.h line 181	
-	double x,norm[DIMMAX],epsilon,neighdist,margin;
+	double x,norm[DIMMAX],epsilon,neighdist,margin,pbuf[DIMMAX],*pos;
 	moleculeptr mptr2;
 	int cmptcheck;
 	int site,s;
@@ -4247,7 +4264,7 @@ int dosurfinteract(simptr sim,moleculeptr mptr,int ll,int m,panelptr pnl,enum Pa
 		i2=i;
 		ms2=MSsoln; 
 		//if(sim->events)
-		//`	fprintf(sim->events,"dosurf time=%f act=%d mptr->serno=%d\n", sim->time,act,mptr->serno);
+		//`	fprintf(sim->events,"dosurf time=%f act=%d mptr->serno=%ld\n", sim->time,act,mptr->serno);
 	}
 	else{
 		site=0;
@@ -4272,7 +4289,7 @@ int dosurfinteract(simptr sim,moleculeptr mptr,int ll,int m,panelptr pnl,enum Pa
 		surfacereflect(mptr,pnl,crsspt,dim,face);
 		fixpt2panel(crsspt,pnl,dim,face,epsilon);
 		if(ms!=MSsoln) movemol2closepanel(sim,mptr,dim,epsilon,neighdist,margin);
-		if(panelside(mptr->pos,pnl,dim,NULL,1)!=face) fixpt2panel(mptr->pos,pnl,dim,face,0);
+		if(panelside(molreal2dbl(mptr->pos,pbuf,dim),pnl,dim,NULL,1)!=face) fixmolpt2panel(mptr->pos,pnl,dim,face,0);
 		if(i2!=i) molchangeident(sim,mptr,ll,m,i2,ms,mptr->pnl); }
 
 	else if(act==SAabsorb) {											// absorb
@@ -4296,16 +4313,18 @@ int dosurfinteract(simptr sim,moleculeptr mptr,int ll,int m,panelptr pnl,enum Pa
 		newface=(face==PFfront)?PFback:PFfront;
     fixpt2panel(crsspt,pnl,dim,newface,epsilon);
 		mptr->list=pnl->srf->port[face]->llport;
-		if(ll>=0 && m<sim->mols->sortl[ll]) sim->mols->sortl[ll]=m;
+		mollistlog(sim->mols,mptr,ll,m);
 		done=1; }
 
 	else if(act==SAadsorb) {											// adsorb
 		molchangeident(sim,mptr,ll,m,i2,ms2,pnl);
-		for(d=0;d<dim;d++) mptr->pos[d]=crsspt[d];
-		if(!ptinpanel(mptr->pos,mptr->pnl,dim))
-			movept2panel(mptr->pos,mptr->pnl,dim,margin);
-		if(ms2==MSfront) fixpt2panel(mptr->pos,mptr->pnl,dim,PFfront,epsilon);
-		else if(ms2==MSback) fixpt2panel(mptr->pos,mptr->pnl,dim,PFback,epsilon);
+		pos=molreal2dbl(mptr->pos,pbuf,dim);
+		for(d=0;d<dim;d++) pos[d]=crsspt[d];
+		if(!ptinpanel(pos,mptr->pnl,dim))
+			movept2panel(pos,mptr->pnl,dim,margin);
+		if(ms2==MSfront) fixpt2panel(pos,mptr->pnl,dim,PFfront,epsilon);
+		else if(ms2==MSback) fixpt2panel(pos,mptr->pnl,dim,PFback,epsilon);
+		dbl2molreal(pos,mptr->pos,dim);
 		done=1; }
 
 	else if(act==SArevdes || act==SAirrevdes) {		// desorb
@@ -4316,6 +4335,7 @@ int dosurfinteract(simptr sim,moleculeptr mptr,int ll,int m,panelptr pnl,enum Pa
 		if(!mptr2) return -1;
 		mptr2->ident=i2;
 		mptr2->mstate=MSsoln;
+		molsernoremove(sim->mols,mptr2);
 		mptr2->serno=mptr->serno;
 		x=desorbdist(sim->mols->difstep[i2][MSsoln],act==SArevdes?SPArevAds:SPAirrDes);
 		panelnormal(pnl,crsspt,ms2==MSsoln?PFfront:PFback,dim,norm);
@@ -4328,17 +4348,18 @@ int dosurfinteract(simptr sim,moleculeptr mptr,int ll,int m,panelptr pnl,enum Pa
 			// complex_pos(sim->dim,mptr2);
 		// }
 
-		mptr2->box=pos2box(sim,mptr2->pos);
+		mptr2->box=pos2box(sim,molreal2dbl(mptr2->pos,pbuf,dim));
 		mptr2->list=sim->mols->listlookup[i2][MSsoln];
 		sim->eventcount[ETdesorb]++;
 		molkill(sim,mptr,ll,m);
+		if(molsernoinsert(sim->mols,mptr2)) return -1;
 		checksurfaces1mol(sim,mptr2);
 		done=1; }
 
 	else if(act==SAflip) {												// on-surface flipping
 		molchangeident(sim,mptr,ll,m,i2,ms2,pnl);
-		if(ms2==MSfront) fixpt2panel(mptr->pos,mptr->pnl,dim,PFfront,epsilon);
-		else if(ms2==MSback) fixpt2panel(mptr->pos,mptr->pnl,dim,PFback,epsilon);
+		if(ms2==MSfront) fixmolpt2panel(mptr->pos,mptr->pnl,dim,PFfront,epsilon);
+		else if(ms2==MSback) fixmolpt2panel(mptr->pos,mptr->pnl,dim,PFback,epsilon);
 		done=1; }
 
 	return done; }
@@ -4348,7 +4369,8 @@ int dosurfinteract(simptr sim,moleculeptr mptr,int ll,int m,panelptr pnl,enum Pa
 int checksurfaces1mol(simptr sim,moleculeptr mptr) {
   int dim,d,done,p,lxp,it,flag;
   boxptr bptr1;
-  double crossmin,crossmin2,crssptmin[3],crsspt[3],cross,*via,*pos;
+  double crossmin,crossmin2,crssptmin[3],crsspt[3],cross,*via,*posd,pbuf[DIMMAX];
+  molreal *pos;
   enum PanelFace face,facemin; 
   panelptr pnl,pnlmin;
 
@@ -4364,16 +4386,17 @@ int checksurfaces1mol(simptr sim,moleculeptr mptr) {
       for(d=0;d<dim;d++) pos[d]=mptr->posx[d];
       simLog(sim,7,"checksurfaces1mol(), SURFACE CALCULATION ERROR: molecule could not be placed after 50 iterations\n");
       break; }
+    posd=molreal2dbl(pos,pbuf,dim);
     crossmin=crossmin2=2;
     facemin=PFfront;
     pnlmin=NULL;
-    for(bptr1=pos2box(sim,via);bptr1;bptr1=line2nextbox(sim,via,pos,bptr1)) {
+    for(bptr1=pos2box(sim,via);bptr1;bptr1=line2nextbox(sim,via,posd,bptr1)) {
 		for(p=0;p<bptr1->npanel;p++) {
         	pnl=bptr1->panel[p];
         	if(pnl!=mptr->pnl) {
 		  		// printf("checksurfaces1mol, p=%d, pnl->pname=%s\n", p, pnl->pname);
 		  		// printf("checksurfaces1mol, time=%f, tot_sunit=%d, via[0]=%f, via[1]=%f, via[2]=%f, pos[0]=%f, pos[1]=%f, pos[2]=%f\n", sim->time, mptr->tot_sunit, via[0], via[1], via[2], pos[0], pos[1], pos[2]);
-          		lxp=lineXpanel(via,pos,pnl,dim,crsspt,&face,NULL,&cross,NULL,NULL);
+          		lxp=lineXpanel(via,posd,pnl,dim,crsspt,&face,NULL,&cross,NULL,NULL);
           		if(lxp && cross<=crossmin2) {
             		if(cross<=crossmin) {			// what is cros: dist1/(dist1-dist2)
               			crossmin2=crossmin;
@@ -4383,13 +4406,13 @@ int checksurfaces1mol(simptr sim,moleculeptr mptr) {
               			facemin=face; }
             		else
               			crossmin2=cross; }}}}
-	// printf("checksurfaces1mol line 4341, serno=%d, crossmin=%f, crossmin2=%f, posx[0]=%f, posx[1]=%f, posx[2]=%f, pos[0]=%f, pos[1]=%f, pos[2]=%f\n", mptr->serno, crossmin, crossmin2, mptr->posx[0],mptr->posx[1],mptr->posx[2],mptr->pos[0],mptr->pos[1], mptr->pos[2]);
+	// printf("checksurfaces1mol line 4341, serno=%ld, crossmin=%f, crossmin2=%f, posx[0]=%f, posx[1]=%f, posx[2]=%f, pos[0]=%f, pos[1]=%f, pos[2]=%f\n", mptr->serno, crossmin, crossmin2, mptr->posx[0],mptr->posx[1],mptr->posx[2],mptr->pos[0],mptr->pos[1], mptr->pos[2]);
 
     if(crossmin<2) {											// a panel was crossed, so deal with it
       flag=(crossmin2!=crossmin && crossmin2-crossmin<VERYCLOSE)?1:0;
       if(flag) {
         for(d=0;d<dim;d++) pos[d]=via[d];
-		printf("checksurface1mol line 4349, serno=%d, via[0]=%f, via[1]=%f, via[2]=%f\n", mptr->serno, mptr->via[0], mptr->via[1], mptr->via[2]);
+		SMOLTRACE(sim,TCsurf,TLdebug,"checksurface1mol line 4349, serno=%ld, via[0]=%f, via[1]=%f, via[2]=%f\n", mptr->serno, mptr->via[0], mptr->via[1], mptr->via[2]);
         done=1; }
       else {
 #ifdef VCELL
@@ -4459,8 +4482,8 @@ int checksurfaces(simptr sim,int ll, int reborn){
 
 		for(s=s0,mptr_tmp=mptr;s<mptr->tot_sunit;s++,mptr_tmp=mptr_tmp->to){
 			result=checksurfaces_cplx(sim,mptr_tmp,m+mptr_tmp->s_index,ll,reborn);
-			if(mptr_tmp->ident!=0 && !boundarytest(sim,mptr_tmp->pos)) 
-				printf("time=%f s=%d mptr_tmp->serno=%d result=%d pos0=%f pos1=%f pos2=%f\n", sim->time,s,mptr_tmp->serno,result,mptr_tmp->pos[0],mptr_tmp->pos[1],mptr_tmp->pos[2]);
+			if(SMOLTRACEON(TCsurf,TLwarning) && mptr_tmp->ident!=0 && !boundarytest(sim,mptr_tmp->pos))
+				simTrace(sim,TCsurf,TLwarning,"time=%f s=%d mptr_tmp->serno=%ld result=%d pos0=%f pos1=%f pos2=%f\n", sim->time,s,mptr_tmp->serno,result,mptr_tmp->pos[0],mptr_tmp->pos[1],mptr_tmp->pos[2]);
 		}
 		s=0;
 		mptr_tmp=mptr;
@@ -4475,11 +4498,11 @@ int checksurfaces(simptr sim,int ll, int reborn){
 				if(!boundarytest(sim,mptr_tmp->pos)){
 					result=checksurfaces_cplx(sim,mptr_tmp,m+s,ll,reborn);
 					while(!boundarytest(sim,mptr_tmp->pos)){
-						printf("chksurf line4486, not in cmpt, time=%f ident=%d complex_id=%d serno=%d s_index=%d pos0=%f pos1=%f pos2=%f prev_pos0=%f prev_pos1=%f prev_pos2=%f\n", sim->time, mptr_tmp->ident, mptr_tmp->complex_id, mptr_tmp->serno, mptr_tmp->s_index, mptr_tmp->pos[0], mptr_tmp->pos[1], mptr_tmp->pos[2], mptr_tmp->prev_pos[0], mptr_tmp->prev_pos[1], mptr_tmp->prev_pos[2]);
+						SMOLTRACE(sim,TCsurf,TLwarning,"chksurf line4486, not in cmpt, time=%f ident=%d complex_id=%d serno=%ld s_index=%d pos0=%f pos1=%f pos2=%f prev_pos0=%f prev_pos1=%f prev_pos2=%f\n", sim->time, mptr_tmp->ident, mptr_tmp->complex_id, mptr_tmp->serno, mptr_tmp->s_index, mptr_tmp->pos[0], mptr_tmp->pos[1], mptr_tmp->pos[2], mptr_tmp->prev_pos[0], mptr_tmp->prev_pos[1], mptr_tmp->prev_pos[2]);
 						result=checksurfaces_cplx(sim,mptr_tmp,m+s,ll,reborn);
 						it++;
 						if(it>50){
-							fprintf(sim->events, "surf line4496, it over 50, time=%f, mptr_tmp->serno=%d\n", sim->time, mptr_tmp->serno); 
+							fprintf(sim->events, "surf line4496, it over 50, time=%f, mptr_tmp->serno=%ld\n", sim->time, mptr_tmp->serno); 
 							result=-2;
 							s=mptr->tot_sunit;
 							break;
@@ -4496,7 +4519,7 @@ int checksurfaces(simptr sim,int ll, int reborn){
 			}
 		}	
   		if(result!=0){
-			printf("surf.c, time=%f, m=%d, result=%d\n", sim->time, m, result);
+			SMOLTRACE(sim,TCsurf,TLerror,"surf.c, time=%f, m=%d, result=%d\n", sim->time, m, result);
 			return result;
 		}
 		m=m_next;
@@ -4509,7 +4532,8 @@ int checksurfaces(simptr sim,int ll, int reborn){
 int checksurfaces_cplx(simptr sim, moleculeptr mptr, int m, int ll,int reborn) {
 	int act,dim,d,done,p,lxp,it,flag;
 	boxptr bptr1;
-	double crossmin,crossmin2,crssptmin[3],crsspt[3],cross,*via,*pos;
+	double crossmin,crossmin2,crssptmin[3],crsspt[3],cross,*via,*posd,pbuf[DIMMAX];
+	molreal *pos;
 	double pos_offset[3];
 	enum PanelFace face,facemin;
 	panelptr pnl,pnlmin;
@@ -4534,14 +4558,15 @@ int checksurfaces_cplx(simptr sim, moleculeptr mptr, int m, int ll,int reborn) {
 			simLog(sim,7,"checksurfaces(), SURFACE CALCULATION ERROR: molecule could not be placed after 50 iterations\n");
 			break;
 		}
+		posd=molreal2dbl(pos,pbuf,dim);
 		crossmin=crossmin2=2;
 		facemin=PFfront;
 		pnlmin=NULL;
-		for(bptr1=pos2box(sim,via);bptr1;bptr1=line2nextbox(sim,via,pos,bptr1)) {
+		for(bptr1=pos2box(sim,via);bptr1;bptr1=line2nextbox(sim,via,posd,bptr1)) {
 			for(p=0;p<bptr1->npanel;p++) {
 				pnl=bptr1->panel[p];
 				if(pnl!=mptr->pnl) {
-					lxp=lineXpanel(via,pos,pnl,dim,crsspt,&face,NULL,&cross,NULL,NULL);
+					lxp=lineXpanel(via,posd,pnl,dim,crsspt,&face,NULL,&cross,NULL,NULL);
 					if(lxp && cross<=crossmin2) {
 						if(cross<=crossmin) {
 							crossmin2=crossmin;
@@ -4564,14 +4589,14 @@ int checksurfaces_cplx(simptr sim, moleculeptr mptr, int m, int ll,int reborn) {
 		}else																	// nothing was crossed
 		done=1; 
 	}
-	if(!boundarytest(sim,mptr->pos) && mptr->ident>0)
-		printf("time=%f ident=%d serno=%d act=%d prevpos[0]=%f prevpos[1]=%f prevpos[2]=%f posx[0]=%f posx[1]=%f posx[2]=%f\n",sim->time,mptr->ident,mptr->serno,act,mptr->prev_pos[0],mptr->prev_pos[1],mptr->prev_pos[2],mptr->posx[0],mptr->posx[1],mptr->posx[2]);
+	if(SMOLTRACEON(TCsurf,TLwarning) && mptr->ident>0 && !boundarytest(sim,mptr->pos))
+		simTrace(sim,TCsurf,TLwarning,"time=%f ident=%d serno=%ld act=%d prevpos[0]=%f prevpos[1]=%f prevpos[2]=%f posx[0]=%f posx[1]=%f posx[2]=%f\n",sim->time,mptr->ident,mptr->serno,act,mptr->prev_pos[0],mptr->prev_pos[1],mptr->prev_pos[2],mptr->posx[0],mptr->posx[1],mptr->posx[2]);
 	if(mptr->tot_sunit>1  && act!=-1){	
 		for(d=0;d<dim;d++) pos_offset[d]=mptr->pos[d]-mptr->prev_pos[d];
 		if(pos_offset[0]==0 && pos_offset[1]==0 && pos_offset[2]==0) return 0;
 
 		if(complex_pos(sim,mptr,"pos_surfline4570",pos_offset,1)==-1){
-			fprintf(sim->events,"chksurf, time=%f, act=%d, reborn=%d, mptr->serno=%d, pos_offset[0]=%f, pos_offset[1]=%f, pos_offset[2]=%f\n", sim->time, act, reborn, mptr->serno, pos_offset[0], pos_offset[1], pos_offset[2]); 
+			fprintf(sim->events,"chksurf, time=%f, act=%d, reborn=%d, mptr->serno=%ld, pos_offset[0]=%f, pos_offset[1]=%f, pos_offset[2]=%f\n", sim->time, act, reborn, mptr->serno, pos_offset[0], pos_offset[1], pos_offset[2]); 
 			return -3;
 		}
 	}
@@ -4583,6 +4608,7 @@ int checksurfaces_cplx(simptr sim, moleculeptr mptr, int m, int ll,int reborn) {
 int checksurfacebound(simptr sim,int ll) {
 	int nmol,m,done;
 	moleculeptr mptr,*mlist;
+	double pbuf[DIMMAX],*posx;
 
 	if(!sim->srfss) return 0;
 	if(!sim->mols) return 0;
@@ -4591,11 +4617,13 @@ int checksurfacebound(simptr sim,int ll) {
 	mlist=sim->mols->live[ll];
 	for(m=0;m<nmol;m++) {
 		mptr=mlist[m];
-		// printf("before dosurfinteract, time=%f, serno=%d, mptr->pos[0]=%f, pos[1]=%f, pos[2]=%f\n", sim->time, mptr->serno, mptr->pos[0], mptr->pos[1], mptr->pos[2]);
+		// printf("before dosurfinteract, time=%f, serno=%ld, mptr->pos[0]=%f, pos[1]=%f, pos[2]=%f\n", sim->time, mptr->serno, mptr->pos[0], mptr->pos[1], mptr->pos[2]);
 		if(mptr->mstate!=MSsoln) {
-			done=dosurfinteract(sim,mptr,ll,m,mptr->pnl,PFnone,mptr->posx, NULL);
+			posx=molreal2dbl(mptr->posx,pbuf,sim->dim);
+			done=dosurfinteract(sim,mptr,ll,m,mptr->pnl,PFnone,posx, NULL);
+			dbl2molreal(posx,mptr->posx,sim->dim);
 			if(done==-1) simLog(sim,10,"Unable to allocate memory in dosurfinteract\n"); }
-		// printf("after dosurfinteract, time=%f, serno=%d, mptr->pos[0]=%f, pos[1]=%f, pos[2]=%f\n", sim->time, mptr->serno, mptr->pos[0], mptr->pos[1], mptr->pos[2]);
+		// printf("after dosurfinteract, time=%f, serno=%ld, mptr->pos[0]=%f, pos[1]=%f, pos[2]=%f\n", sim->time, mptr->serno, mptr->pos[0], mptr->pos[1], mptr->pos[2]);
 	}
 	return 0; }
 
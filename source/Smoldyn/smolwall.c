@@ -10,6 +10,7 @@
 #include "random2.h"
 #include "smoldyn.h"
 #include "smoldynfuncs.h"
+#include "smoldynconfigure.h"
 
 /******************************************************************************/
 /************************************ Walls ***********************************/
@@ -298,12 +299,16 @@ int wallsettype(simptr sim,int d,int highside,char type) {
 /******************************************************************************/
 
 
-/* checkwalls */
+/* checkwalls.  Molecules that share a position array with other complex subunits
+are done in a second, serial pass, since any of them may move the shared position. */
 int checkwalls(simptr sim,int ll,int reborn,boxptr bptr) {
-	int nmol,w,d,m;
+	int nmol,w,d,m,nevent,nshared,pass;
 	moleculeptr *mlist;
 	double pos2,diff,difi,step,**difstep;
 	wallptr wptr;
+#ifdef HAVE_OPENMP
+	int nthreads;
+#endif
 
 	if(sim->srfss) return 0;
 	if(bptr) {
@@ -315,50 +320,87 @@ int checkwalls(simptr sim,int ll,int reborn,boxptr bptr) {
 	if(!reborn) m=0;
 	else if(reborn&&!bptr) m=sim->mols->topl[ll];
 	else {m=0;simLog(sim,10,"SMOLDYN ERROR: in checkwalls, both bptr and reborn are defined");}
+#ifdef HAVE_OPENMP
+	nthreads=(sim->nthreads>1)?sim->nthreads:1;
+#endif
 
 	for(w=0;w<2*sim->dim;w++) {
 		wptr=sim->wlist[w];
 		d=wptr->wdim;
 		if(wptr->type=='r'&&wptr->side==0) {			// reflective
 			pos2=2*wptr->pos;
-			for(m=0;m<nmol;m++)
-				if(mlist[m]->pos[d]<wptr->pos) {
-					sim->eventcount[ETwall]++;
-					if(mlist[m]->s_index==0) {
-						mlist[m]->pos[d]=pos2-mlist[m]->pos[d];
-						// complex_pos(sim->dim, mlist[m]);
-				}
-			}}
+			nevent=nshared=0;
+			for(pass=0;pass<2 && (pass==0 || nshared);pass++) {
+#ifdef HAVE_OPENMP
+				#pragma omp parallel for schedule(static) reduction(+:nevent,nshared) num_threads(nthreads) if(nthreads>1 && pass==0)
+#endif
+				for(m=0;m<nmol;m++) {
+					if((mlist[m]->pos!=mlist[m]->pos_tmp)!=pass) {
+						nshared+=!pass;
+						continue; }
+					if(mlist[m]->pos[d]<wptr->pos) {
+						nevent++;
+						if(mlist[m]->s_index==0) {
+							mlist[m]->pos[d]=pos2-mlist[m]->pos[d];
+							// complex_pos(sim->dim, mlist[m]);
+					}}}}
+			sim->eventcount[ETwall]+=nevent; }
 		else if(wptr->type=='r') {
 			pos2=2*wptr->pos;
-			for(m=0;m<nmol;m++)
-				if(mlist[m]->pos[d]>wptr->pos) {
-					sim->eventcount[ETwall]++;
-					if(mlist[m]->s_index==0){ 
-						mlist[m]->pos[d]=pos2-mlist[m]->pos[d];
-						// complex_pos(sim->dim, mlist[m]);
-				}
-			}}
+			nevent=nshared=0;
+			for(pass=0;pass<2 && (pass==0 || nshared);pass++) {
+#ifdef HAVE_OPENMP
+				#pragma omp parallel for schedule(static) reduction(+:nevent,nshared) num_threads(nthreads) if(nthreads>1 && pass==0)
+#endif
+				for(m=0;m<nmol;m++) {
+					if((mlist[m]->pos!=mlist[m]->pos_tmp)!=pass) {
+						nshared+=!pass;
+						continue; }
+					if(mlist[m]->pos[d]>wptr->pos) {
+						nevent++;
+						if(mlist[m]->s_index==0){ 
+							mlist[m]->pos[d]=pos2-mlist[m]->pos[d];
+							// complex_pos(sim->dim, mlist[m]);
+					}}}}
+			sim->eventcount[ETwall]+=nevent; }
 		else if(wptr->type=='p'&&wptr->side==0) {	// periodic
 			pos2=wptr->opp->pos-wptr->pos;
-			for(m=0;m<nmol;m++)
-				if(mlist[m]->pos[d]<wptr->pos) {
-					sim->eventcount[ETwall]++;
-					if(mlist[m]->s_index==0){	
-						mlist[m]->pos[d]+=pos2;
-						// complex_pos(sim->dim, mlist[m]);
-			}
-					mlist[m]->posoffset[d]-=pos2;}}
+			nevent=nshared=0;
+			for(pass=0;pass<2 && (pass==0 || nshared);pass++) {
+#ifdef HAVE_OPENMP
+				#pragma omp parallel for schedule(static) reduction(+:nevent,nshared) num_threads(nthreads) if(nthreads>1 && pass==0)
+#endif
+				for(m=0;m<nmol;m++) {
+					if((mlist[m]->pos!=mlist[m]->pos_tmp)!=pass) {
+						nshared+=!pass;
+						continue; }
+					if(mlist[m]->pos[d]<wptr->pos) {
+						nevent++;
+						if(mlist[m]->s_index==0){	
+							mlist[m]->pos[d]+=pos2;
+							// complex_pos(sim->dim, mlist[m]);
+				}
+						mlist[m]->posoffset[d]-=pos2; }}}
+			sim->eventcount[ETwall]+=nevent; }
 		else if(wptr->type=='p') {
 			pos2=wptr->opp->pos-wptr->pos;
-			for(m=0;m<nmol;m++)
-				if(mlist[m]->pos[d]>wptr->pos) {
-					sim->eventcount[ETwall]++;
-					if(mlist[m]->s_index==0){
-						mlist[m]->pos[d]+=pos2;
-						// complex_pos(sim->dim, mlist[m]);
-			}
-					mlist[m]->posoffset[d]-=pos2; }}
+			nevent=nshared=0;
+			for(pass=0;pass<2 && (pass==0 || nshared);pass++) {
+#ifdef HAVE_OPENMP
+				#pragma omp parallel for schedule(static) reduction(+:nevent,nshared) num_threads(nthreads) if(nthreads>1 && pass==0)
+#endif
+				for(m=0;m<nmol;m++) {
+					if((mlist[m]->pos!=mlist[m]->pos_tmp)!=pass) {
+						nshared+=!pass;
+						continue; }
+					if(mlist[m]->pos[d]>wptr->pos) {
+						nevent++;
+						if(mlist[m]->s_index==0){
+							mlist[m]->pos[d]+=pos2;
+							// complex_pos(sim->dim, mlist[m]);
+				}
+						mlist[m]->posoffset[d]-=pos2; }}}
+			sim->eventcount[ETwall]+=nevent; }
 		else if(wptr->type=='a') {								// absorbing
 			difstep=sim->mols->difstep;
 			for(m=0;m<nmol;m++) {
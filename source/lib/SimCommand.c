@@ -8,6 +8,9 @@ of the Gnu Lesser General Public License (LGPL). */
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "SimCommand.h"
 #include "Zn.h"
 
@@ -27,6 +30,45 @@ of the Gnu Lesser General Public License (LGPL). */
 
 void scmdcatfname(cmdssptr cmds,int fid,char *str);
 
+/* Output to files can be passed through a writer thread, so that the simulation
+does not wait for the disk.  Text from scmdfprintf goes into the front set of
+buffers, one buffer per file.  At the end of each scmdexecute, the front set is
+swapped with the back set if the writer has finished with the back set, and the
+writer then writes and flushes it.  If the front set grows past the limit while the
+writer is still busy, the simulation waits for the writer. */
+
+typedef struct scmdbufstruct {
+	FILE *fptr;						// file for this buffer
+	char *text;						// buffered text
+	size_t n;							// number of characters in text
+	size_t max;						// allocated size of text
+	} *scmdbufptr;
+
+typedef struct scmdbufsetstruct {
+	int nbuf;							// number of buffers in use
+	int maxbuf;						// allocated number of buffers
+	size_t total;					// total characters in all buffers
+	scmdbufptr buf;				// buffers [b]
+	} *scmdbufsetptr;
+
+typedef struct scmdwriterstruct {
+	std::thread thread;		// writer thread
+	std::mutex lock;			// guards busy, quit, and the buffer swap
+	std::condition_variable cond;	// signals changes of busy and quit
+	int busy;							// 1 while the writer owns the back set
+	int quit;							// 1 when the writer thread should end
+	int nerror;						// number of failed writes
+	size_t limit;					// front set size that forces a hand-off
+	struct scmdbufsetstruct front;	// buffers filled by the simulation
+	struct scmdbufsetstruct back;		// buffers emptied by the writer
+	} *scmdwriterptr;
+
+void scmdbufsetfree(scmdbufsetptr set);
+int scmdbufappend(scmdbufsetptr set,FILE *fptr,const char *text,size_t n);
+void scmdwriterthread(scmdwriterptr writer);
+void scmdhandoff(cmdssptr cmds,int force);
+void scmdwriterfree(cmdssptr cmds);
+
 
 /* ***** internal routine ***** */
 
@@ -82,6 +124,10 @@ cmdptr scmdalloc(void) {
 	cmd->f1=cmd->f2=cmd->f3=0;
 	cmd->v1=cmd->v2=cmd->v3=NULL;
 	cmd->freefn=NULL;
+	cmd->handler=NULL;
+	cmd->htype=CMDnone;
+	cmd->argstr=NULL;
+	cmd->argset=0;
 	return cmd; }
 
 
@@ -117,6 +163,7 @@ cmdssptr scmdssalloc(enum CMDcode (*cmdfn)(void*,cmdptr,char*),void *cmdfnarg,co
 	cmds->fptr=NULL;
 	cmds->flag=0;
 	cmds->precision=-1;
+	cmds->writer=NULL;
 	return cmds; }
 
 
@@ -128,6 +175,7 @@ void scmdssfree(cmdssptr cmds) {
 
 	if(!cmds) return;
 
+	scmdwriterfree(cmds);
 	if(cmds->cmd) {
 		while(q_pop(cmds->cmd,NULL,NULL,NULL,NULL,&voidptr)>=0) {
 			cmd=(cmdptr)voidptr;
@@ -388,9 +436,32 @@ enum CMDcode scmdexecute(cmdssptr cmds,double time,double simdt,Q_LONGLONG iter,
 			if(code1==CMDabort) return code1;
 			if(code1>code2) code2=code1; }
 
+	if(cmds->writer) scmdhandoff(cmds,0);
 	return code2; }
 
 
+/* scmddue.  Calls fn with arg for each command that the next call to
+scmdexecute, with the same time and donow values and a negative iter, would run.
+Nothing is run or taken from the queues, so callers can prepare for these commands
+first.  Commands that are run from inside other commands are not listed. */
+void scmddue(cmdssptr cmds,double time,int donow,void (*fn)(void*,cmdptr),void *arg) {
+	int i;
+	double t;
+	Q_LONGLONG it;
+	void *voidptr;
+
+	if(!cmds || !fn) return;
+	if(cmds->cmdi) {
+		i=-1;
+		while((i=q_next(i,NULL,NULL,NULL,&it,&voidptr,cmds->cmdi))>=0 && (it<=cmds->iter || donow))
+			(*fn)(arg,(cmdptr)voidptr); }
+	if(cmds->cmd) {
+		i=-1;
+		while((i=q_next(i,NULL,NULL,&t,NULL,&voidptr,cmds->cmd))>=0 && (t<=time || donow))
+			(*fn)(arg,(cmdptr)voidptr); }
+	return; }
+
+
 /* scmdcmdtype */
 enum CMDcode scmdcmdtype(cmdssptr cmds,cmdptr cmd) {
 	char string[STRCHAR];
@@ -400,6 +471,26 @@ enum CMDcode scmdcmdtype(cmdssptr cmds,cmdptr cmd) {
 	return (*cmds->cmdfn)(cmds->cmdfnarg,cmd,string); }
 
 
+/* scmdargget.  If argument k of cmd was resolved on an earlier run, copies its
+values to *iptr and *jptr, either of which may be NULL, and returns 1.  Returns 0
+otherwise, including when cmd does not keep resolved arguments. */
+int scmdargget(cmdptr cmd,int k,int *iptr,int *jptr) {
+	if(!cmd || cmd->argset<0 || k<0 || k>=CMDARGMAX || !(cmd->argset&(1<<k))) return 0;
+	if(iptr) *iptr=cmd->argi[k];
+	if(jptr) *jptr=cmd->argj[k];
+	return 1; }
+
+
+/* scmdargset.  Stores resolved values for argument k of cmd, so that later runs
+can get them with scmdargget instead of reading the command string again. */
+void scmdargset(cmdptr cmd,int k,int i,int j) {
+	if(!cmd || cmd->argset<0 || k<0 || k>=CMDARGMAX) return;
+	cmd->argi[k]=i;
+	cmd->argj[k]=j;
+	cmd->argset|=1<<k;
+	return; }
+
+
 /* scmdnextcmdtime */
 int scmdnextcmdtime(cmdssptr cmds,double time,Q_LONGLONG iter,enum CMDcode type,int equalok,double *timeptr,Q_LONGLONG *iterptr) {
 	double tbest,t,dt;
@@ -471,6 +562,7 @@ void scmdoutput(cmdssptr cmds) {
 		SCMDPRINTF(2," Output file paths and names:\n"); }
 	else
 		SCMDPRINTF(2," No output files\n");
+	if(cmds->writer) SCMDPRINTF(2," Output files are written by a background thread, waiting above %i buffered characters\n",(int)cmds->writer->limit);
 	for(fid=0;fid<cmds->nfile;fid++) {
 		if(!strcmp(cmds->fname[fid],"stdout") || !strcmp(cmds->fname[fid],"stderr"))
 			SCMDPRINTF(2,"  %s (file open): %s\n",cmds->fname[fid],cmds->fname[fid]);
@@ -514,6 +606,7 @@ void scmdwritecommands(cmdssptr cmds,FILE *fptr,char *filename) {
 
 	fprintf(fptr,"# Command parameters\n");
 	if(strlen(cmds->froot)) fprintf(fptr,"output_root %s\n",cmds->froot);
+	if(cmds->writer) fprintf(fptr,"output_async on %i\n",(int)cmds->writer->limit);
 
 	if(!(cmds->nfile==1 && !strcmp(cmds->fname[0],filename))) {
 		if(cmds->nfile) {
@@ -558,6 +651,39 @@ void scmdsetprecision(cmdssptr cmds,int precision) {
 	return; }
 
 
+/* scmdsetasync.  Turns the background writer thread on or off.  maxbuffer is the
+number of buffered characters that makes the simulation wait for the writer, or a
+value less than 1 for the default.  Returns 0 for success or 1 if the thread could
+not be started, in which case output stays synchronous. */
+int scmdsetasync(cmdssptr cmds,int async,int maxbuffer) {
+	scmdwriterptr writer;
+
+	if(!cmds) return 1;
+	if(!async) {
+		scmdwriterfree(cmds);
+		return 0; }
+	if(!cmds->writer) {
+		try {
+			writer=new struct scmdwriterstruct; }
+		catch(...) {
+			return 1; }
+		writer->busy=0;
+		writer->quit=0;
+		writer->nerror=0;
+		writer->front.nbuf=writer->back.nbuf=0;
+		writer->front.maxbuf=writer->back.maxbuf=0;
+		writer->front.total=writer->back.total=0;
+		writer->front.buf=writer->back.buf=NULL;
+		try {
+			writer->thread=std::thread(scmdwriterthread,writer); }
+		catch(...) {
+			delete writer;
+			return 1; }
+		cmds->writer=writer; }
+	cmds->writer->limit=maxbuffer>0?maxbuffer:4*1024*1024;
+	return 0; }
+
+
 /************** file functions **************/	
 	
 /* scmdsetfroot */
@@ -649,6 +775,7 @@ int scmdopenfiles(cmdssptr cmds,int overwrite) {
 	FILE *fptr;
 
 	if(!cmds) return 0;
+	scmdwait(cmds);
 	for(fid=0;fid<cmds->nfile;fid++) {
 		if(cmds->fptr[fid] && strcmp(cmds->fname[fid],"stdout") && strcmp(cmds->fname[fid],"stderr"))
 			fclose(cmds->fptr[fid]);
@@ -686,6 +813,7 @@ FILE *scmdoverwrite(cmdssptr cmds,char *line2) {
 	fid=stringfind(cmds->fname,cmds->nfile,fname);
 	if(fid<0) return NULL;
 	if(strcmp(cmds->fname[fid],"stdout") && strcmp(cmds->fname[fid],"stderr")) {
+		scmdwait(cmds);
 		fclose(cmds->fptr[fid]);
 		scmdcatfname(cmds,fid,str1);
 		cmds->fptr[fid]=fopen(str1,"w"); }
@@ -703,6 +831,7 @@ FILE *scmdincfile(cmdssptr cmds,char *line2) {
 	fid=stringfind(cmds->fname,cmds->nfile,fname);
 	if(fid<0) return NULL;
 	if(strcmp(cmds->fname[fid],"stdout") && strcmp(cmds->fname[fid],"stderr")) {
+		scmdwait(cmds);
 		fclose(cmds->fptr[fid]);
 		cmds->fsuffix[fid]++;
 		scmdcatfname(cmds,fid,str1);
@@ -715,20 +844,46 @@ FILE *scmdincfile(cmdssptr cmds,char *line2) {
 
 /* scmdgetfptr */
 FILE *scmdgetfptr(cmdssptr cmds,char *line2) {
-	int itct,fid;
+	return scmdfid2fptr(cmds,scmdgetfid(cmds,line2)); }
+
+
+/* scmdgetfid.  Returns the file index for the file name at the start of line2,
+-2 for stdout, which is also used if line2 is NULL, -3 for stderr, or -1 if the
+name is missing or not recognized. */
+int scmdgetfid(cmdssptr cmds,char *line2) {
+	int itct;
 	static char fname[STRCHAR];
 
-	if(!line2) return stdout;
+	if(!line2) return -2;
 	itct=sscanf(line2,"%s",fname);
-	if(itct!=1) return NULL;
-	if(!strcmp(fname,"stdout")) return stdout;
-	if(!strcmp(fname,"stderr")) return stderr;
-	if(!cmds) return NULL;
-	fid=stringfind(cmds->fname,cmds->nfile,fname);
-	if(fid<0) return NULL;
+	if(itct!=1) return -1;
+	if(!strcmp(fname,"stdout")) return -2;
+	if(!strcmp(fname,"stderr")) return -3;
+	if(!cmds) return -1;
+	return stringfind(cmds->fname,cmds->nfile,fname); }
+
+
+/* scmdfid2fptr.  Returns the file pointer for a file index from scmdgetfid, or NULL
+if fid is -1. */
+FILE *scmdfid2fptr(cmdssptr cmds,int fid) {
+	if(fid==-2) return stdout;
+	if(fid==-3) return stderr;
+	if(fid<0 || !cmds) return NULL;
 	return cmds->fptr[fid]; }
 
 
+/* scmdgetfptrarg.  Like scmdgetfptr, but for argument k of cmd.  The file name is
+only looked up on the first run; later runs use the saved file index, which stays
+valid when the file is incremented or reopened. */
+FILE *scmdgetfptrarg(cmdssptr cmds,cmdptr cmd,int k,char *line2) {
+	int fid;
+
+	if(!scmdargget(cmd,k,&fid,NULL)) {
+		fid=scmdgetfid(cmds,line2);
+		if(fid!=-1) scmdargset(cmd,k,fid,0); }
+	return scmdfid2fptr(cmds,fid); }
+
+
 /* scmdfprintf */
 int scmdfprintf(cmdssptr cmds,FILE *fptr,const char *format,...) {
 	char message[STRCHARLONG],newformat[STRCHAR],replacestr[STRCHAR];
@@ -740,15 +895,153 @@ int scmdfprintf(cmdssptr cmds,FILE *fptr,const char *format,...) {
 		sprintf(replacestr,"%%.%ig",cmds->precision);
 		strstrreplace(newformat,"%g",replacestr,STRCHAR); }
 	va_start(arguments,format);
-	vsprintf(message,newformat,arguments);
+	code=vsprintf(message,newformat,arguments);
 	va_end(arguments);
+	if(cmds->writer && fptr!=stdout && fptr!=stderr && code>=0) {
+		if(!scmdbufappend(&cmds->writer->front,fptr,message,code)) {
+			if(cmds->writer->front.total>=cmds->writer->limit) scmdhandoff(cmds,1);
+			return code; }
+		scmdwait(cmds); }													// out of memory, so write directly
 	code=fprintf(fptr,"%s",message);	
 	return code; 
 }
 
 
-/* scmdflush */
-void scmdflush(FILE *fptr) {
+/* scmdflush.  Buffered files are flushed by the writer thread after each
+hand-off, so this only flushes files that are written directly. */
+void scmdflush(cmdssptr cmds,FILE *fptr) {
+	if(cmds && cmds->writer && fptr!=stdout && fptr!=stderr) return;
 	fflush(fptr);
 	return; }
 
+
+/* scmdwait.  Hands off any buffered output and waits until the writer thread has
+written it.  Call this before writing to an output file directly, or closing it. */
+void scmdwait(cmdssptr cmds) {
+	scmdwriterptr writer;
+
+	if(!cmds || !cmds->writer) return;
+	writer=cmds->writer;
+	scmdhandoff(cmds,1);
+	std::unique_lock<std::mutex> guard(writer->lock);
+	while(writer->busy) writer->cond.wait(guard);
+	return; }
+
+
+/************** writer thread functions **************/
+
+
+/* scmdbufsetfree */
+void scmdbufsetfree(scmdbufsetptr set) {
+	int b;
+
+	for(b=0;b<set->maxbuf;b++) free(set->buf[b].text);
+	free(set->buf);
+	set->buf=NULL;
+	set->nbuf=set->maxbuf=0;
+	set->total=0;
+	return; }
+
+
+/* scmdbufappend.  Adds n characters of text to the buffer for fptr.  Returns 0 for
+success or 1 for out of memory. */
+int scmdbufappend(scmdbufsetptr set,FILE *fptr,const char *text,size_t n) {
+	int b,newmaxbuf;
+	scmdbufptr buf,newbuf;
+	size_t newmax;
+	char *newtext;
+
+	for(b=0;b<set->nbuf && set->buf[b].fptr!=fptr;b++);
+	if(b==set->nbuf) {
+		if(set->nbuf==set->maxbuf) {
+			newmaxbuf=2*set->maxbuf+4;
+			newbuf=(scmdbufptr) calloc(newmaxbuf,sizeof(struct scmdbufstruct));
+			if(!newbuf) return 1;
+			for(b=0;b<set->maxbuf;b++) newbuf[b]=set->buf[b];
+			free(set->buf);
+			set->buf=newbuf;
+			set->maxbuf=newmaxbuf;
+			b=set->nbuf; }
+		set->buf[b].fptr=fptr;
+		set->buf[b].n=0;
+		set->nbuf++; }
+	buf=&set->buf[b];
+
+	if(buf->n+n>buf->max) {
+		newmax=2*buf->max+n+1024;
+		newtext=(char*) malloc(newmax);
+		if(!newtext) return 1;
+		if(buf->n) memcpy(newtext,buf->text,buf->n);
+		free(buf->text);
+		buf->text=newtext;
+		buf->max=newmax; }
+	memcpy(buf->text+buf->n,text,n);
+	buf->n+=n;
+	set->total+=n;
+	return 0; }
+
+
+/* scmdwriterthread.  Main function of the writer thread, which writes the back
+set each time it is handed off and returns when quit is set. */
+void scmdwriterthread(scmdwriterptr writer) {
+	int b;
+	scmdbufptr buf;
+	std::unique_lock<std::mutex> guard(writer->lock);
+
+	while(1) {
+		while(!writer->busy && !writer->quit) writer->cond.wait(guard);
+		if(!writer->busy) break;
+		guard.unlock();
+		for(b=0;b<writer->back.nbuf;b++) {
+			buf=&writer->back.buf[b];
+			if(buf->n && fwrite(buf->text,1,buf->n,buf->fptr)!=buf->n) writer->nerror++;
+			fflush(buf->fptr);
+			buf->n=0; }
+		writer->back.nbuf=0;
+		writer->back.total=0;
+		guard.lock();
+		writer->busy=0;
+		writer->cond.notify_all(); }
+	return; }
+
+
+/* scmdhandoff.  Gives the front set to the writer thread.  If the writer is still
+busy with the previous set, this returns without doing anything, unless force is
+set or the front set is over its limit, in which case it waits for the writer. */
+void scmdhandoff(cmdssptr cmds,int force) {
+	scmdwriterptr writer;
+	struct scmdbufsetstruct swap;
+
+	writer=cmds->writer;
+	if(!writer || writer->front.total==0) return;
+	std::unique_lock<std::mutex> guard(writer->lock);
+	if(writer->busy && !force && writer->front.total<writer->limit) return;
+	while(writer->busy) writer->cond.wait(guard);
+	swap=writer->front;
+	writer->front=writer->back;
+	writer->back=swap;
+	writer->busy=1;
+	writer->cond.notify_all();
+	return; }
+
+
+/* scmdwriterfree.  Writes any remaining output, ends the writer thread, and frees
+it. */
+void scmdwriterfree(cmdssptr cmds) {
+	scmdwriterptr writer;
+
+	if(!cmds || !cmds->writer) return;
+	writer=cmds->writer;
+	scmdwait(cmds);
+	{
+		std::lock_guard<std::mutex> guard(writer->lock);
+		writer->quit=1;
+		writer->cond.notify_all(); }
+	writer->thread.join();
+	if(writer->nerror) SCMDPRINTF(7,"WARNING: %i output writes failed\n",writer->nerror);
+	scmdbufsetfree(&writer->front);
+	scmdbufsetfree(&writer->back);
+	delete writer;
+	cmds->writer=NULL;
+	return; }
+
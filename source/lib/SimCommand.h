@@ -9,10 +9,14 @@ of the Gnu Lesser General Public License (LGPL). */
 #include "queue.h"
 #include "string2.h"
 
+#define CMDARGMAX 8
+
 #define SCMDCHECK(A,...) if(!(A)) {if(cmd) sprintf(cmd->erstr,__VA_ARGS__);return CMDwarn;} else (void)0
 
 enum CMDcode {CMDok,CMDwarn,CMDpause,CMDstop,CMDabort,CMDnone,CMDcontrol,CMDobserve,CMDmanipulate,CMDctrlORobs,CMDall};
 
+struct simstruct;						// simulation structure of the calling program
+
 typedef struct cmdstruct {
 	struct cmdsuperstruct *cmds;	// owning command superstructure
 	double on;						// first command run time
@@ -29,6 +33,12 @@ typedef struct cmdstruct {
 	double f1,f2,f3;			// doubles for generic use
 	void *v1,*v2,*v3;			// pointers for generic use
 	void (*freefn)(struct cmdstruct*);	// free command memory
+	enum CMDcode (*handler)(struct simstruct*,struct cmdstruct*,char*);	// command function, resolved on first run
+	enum CMDcode htype;		// command type of handler
+	char *argstr;					// arguments following the command word in str
+	int argset;						// bit k set if argument k is resolved, -1 for none
+	int argi[CMDARGMAX];	// resolved arguments, e.g. species or file index [k]
+	int argj[CMDARGMAX];	// second part of resolved arguments, e.g. state [k]
 	} *cmdptr;
 
 typedef struct cmdsuperstruct {
@@ -47,6 +57,7 @@ typedef struct cmdsuperstruct {
 	FILE **fptr;					// file pointers [fid]
 	double flag;					// global command structure flag
 	int precision;				// precision for output commands
+	struct scmdwriterstruct *writer;	// background file writer, NULL for none
 	} *cmdssptr;
 
 // non-file functions
@@ -61,13 +72,17 @@ int scmdaddcommand(cmdssptr cmds,char ch,double tmin,double tmax,double dt,doubl
 int scmdstr2cmd(cmdssptr cmds,char *line2,double tmin,double tmax,double dt);
 void scmdpop(cmdssptr cmds,double t);
 enum CMDcode scmdexecute(cmdssptr cmds,double time,double simdt,Q_LONGLONG iter,int donow);
+void scmddue(cmdssptr cmds,double time,int donow,void (*fn)(void*,cmdptr),void *arg);
 enum CMDcode scmdcmdtype(cmdssptr cmds,cmdptr cmd);
+int scmdargget(cmdptr cmd,int k,int *iptr,int *jptr);
+void scmdargset(cmdptr cmd,int k,int i,int j);
 int scmdnextcmdtime(cmdssptr cmds,double time,Q_LONGLONG iter,enum CMDcode type,int equalok,double *timeptr,Q_LONGLONG *iterptr);
 void scmdoutput(cmdssptr cmds);
 void scmdwritecommands(cmdssptr cmds,FILE *fptr,char *filename);
 void scmdsetflag(cmdssptr cmds,double flag);
 double scmdreadflag(cmdssptr cmds);
 void scmdsetprecision(cmdssptr cmds,int precision);
+int scmdsetasync(cmdssptr cmds,int async,int maxbuffer);
 
 // file functions
 int scmdsetfroot(cmdssptr cmds,const char *root);
@@ -77,7 +92,11 @@ int scmdopenfiles(cmdssptr cmds,int overwrite);
 FILE *scmdoverwrite(cmdssptr cmds,char *line2);
 FILE *scmdincfile(cmdssptr cmds,char *line2);
 FILE *scmdgetfptr(cmdssptr cmds,char *line2);
+int scmdgetfid(cmdssptr cmds,char *line2);
+FILE *scmdfid2fptr(cmdssptr cmds,int fid);
+FILE *scmdgetfptrarg(cmdssptr cmds,cmdptr cmd,int k,char *line2);
 int scmdfprintf(cmdssptr cmds,FILE *fptr,const char *format,...);
-void scmdflush(FILE *fptr);
+void scmdflush(cmdssptr cmds,FILE *fptr);
+void scmdwait(cmdssptr cmds);
 
 # endif
@@ -0,0 +1,274 @@
+/* Binary event logs.
+Library for writing and reading fixed-size simulation event records.
+This work is distributed under the terms of the Gnu Lesser General Public License
+(LGPL). */
+
+/* File layout, all values in native byte order:
+  header:  "SMOLEVT" and a nul, version, byte order check 0x01020304, record size
+  records: fixed-size eventrecstruct records, in the order they happened
+  names:   "NAMS", nspecies and the species names, nrxnset, and then for each
+           reaction set the number of reactions and their names; each name is
+           written as its length followed by its characters
+  trailer: record count, names offset, and "SMOLEVTE"
+The names and trailer are written when the simulation ends.  Without them, the
+record count follows from the file size and names are unavailable.
+Records are collected in a buffer and written in blocks with a single fwrite, so
+logging an event costs a few stores rather than a formatted print. */
+
+#include <stdlib.h>
+#include <string.h>
+#include "SimEvent.h"
+
+#define CHECK(A) if(!(A)) {goto failure;} else (void)0
+
+#define EVENTMAGIC "SMOLEVT"
+#define EVENTENDMAGIC "SMOLEVTE"
+#define EVENTBYTEORDER 0x01020304
+
+
+/******************************************************************************/
+/***************************** internal functions *****************************/
+/******************************************************************************/
+
+
+/* evlogalloc */
+eventlogptr evlogalloc(void) {
+	eventlogptr log;
+
+	log=(eventlogptr) malloc(sizeof(struct eventlogstruct));
+	if(!log) return NULL;
+	log->fptr=NULL;
+	log->maxbuf=0;
+	log->nbuf=0;
+	log->buf=NULL;
+	log->nrec=0;
+	log->datastart=0;
+	log->nspecies=0;
+	log->spname=NULL;
+	log->nrxnset=0;
+	log->nrxn=NULL;
+	log->rxnname=NULL;
+	return log; }
+
+
+/* evlogwritestring.  Returns 0 for success or 1 for a write error. */
+int evlogwritestring(FILE *fptr,const char *string) {
+	int len;
+
+	len=string?strlen(string):0;
+	if(fwrite(&len,sizeof(int),1,fptr)!=1) return 1;
+	if(len && fwrite(string,1,len,fptr)!=(size_t)len) return 1;
+	return 0; }
+
+
+/* evlogreadstring.  Returns a newly allocated string, or NULL for failure. */
+char *evlogreadstring(FILE *fptr) {
+	int len;
+	char *string;
+
+	if(fread(&len,sizeof(int),1,fptr)!=1 || len<0) return NULL;
+	string=(char*) calloc(len+1,sizeof(char));
+	if(!string) return NULL;
+	if(len && fread(string,1,len,fptr)!=(size_t)len) {
+		free(string);
+		return NULL; }
+	return string; }
+
+
+/* evlogreadnames.  Reads the names block that starts at offset.  Returns 0 for
+success or 1 for failure. */
+int evlogreadnames(eventlogptr log,long offset) {
+	FILE *fptr;
+	char tag[4];
+	int i,s,r,n;
+
+	fptr=log->fptr;
+	if(fseek(fptr,offset,SEEK_SET)) return 1;
+	if(fread(tag,1,4,fptr)!=4 || strncmp(tag,"NAMS",4)) return 1;
+	if(fread(&n,sizeof(int),1,fptr)!=1 || n<0) return 1;
+	log->spname=(char**) calloc(n+1,sizeof(char*));
+	if(!log->spname) return 1;
+	log->nspecies=n;
+	for(i=0;i<n;i++)
+		if(!(log->spname[i]=evlogreadstring(fptr))) return 1;
+	if(fread(&n,sizeof(int),1,fptr)!=1 || n<0) return 1;
+	log->nrxn=(int*) calloc(n+1,sizeof(int));
+	log->rxnname=(char***) calloc(n+1,sizeof(char**));
+	if(!log->nrxn || !log->rxnname) return 1;
+	log->nrxnset=n;
+	for(s=0;s<log->nrxnset;s++) {
+		if(fread(&n,sizeof(int),1,fptr)!=1 || n<0) return 1;
+		log->rxnname[s]=(char**) calloc(n+1,sizeof(char*));
+		if(!log->rxnname[s]) return 1;
+		log->nrxn[s]=n;
+		for(r=0;r<n;r++)
+			if(!(log->rxnname[s][r]=evlogreadstring(fptr))) return 1; }
+	return 0; }
+
+
+/******************************************************************************/
+/********************************** writing ***********************************/
+/******************************************************************************/
+
+
+/* evlogwriteopen.  Creates the event log file fname, with a buffer for maxbuf
+records, or a default size if maxbuf is less than 1.  Returns the new structure
+or NULL if the file could not be created or memory ran out. */
+eventlogptr evlogwriteopen(const char *fname,int maxbuf) {
+	eventlogptr log;
+	char magic[8];
+	int header[3];
+
+	log=evlogalloc();
+	if(!log) return NULL;
+	if(maxbuf<1) maxbuf=4096;
+	CHECK(log->buf=(eventrecptr) calloc(maxbuf,sizeof(struct eventrecstruct)));
+	log->maxbuf=maxbuf;
+	CHECK(log->fptr=fopen(fname,"wb"));
+	memset(magic,0,8);
+	strcpy(magic,EVENTMAGIC);
+	header[0]=EVENTVERSION;
+	header[1]=EVENTBYTEORDER;
+	header[2]=sizeof(struct eventrecstruct);
+	CHECK(fwrite(magic,1,8,log->fptr)==8);
+	CHECK(fwrite(header,sizeof(int),3,log->fptr)==3);
+	log->datastart=ftell(log->fptr);
+	return log;
+ failure:
+	evlogfree(log);
+	return NULL; }
+
+
+/* evlognext.  Returns the next free record, which the caller fills in.  When the
+buffer is full, it is written to the file first.  Returns NULL for a write
+error. */
+eventrecptr evlognext(eventlogptr log) {
+	eventrecptr rec;
+
+	if(log->nbuf==log->maxbuf && evlogflush(log)) return NULL;
+	rec=&log->buf[log->nbuf++];
+	rec->unused=0;
+	return rec; }
+
+
+/* evlogflush.  Writes buffered records to the file.  Returns 0 for success or 1
+for a write error, in which case the buffered records are dropped. */
+int evlogflush(eventlogptr log) {
+	int n;
+
+	n=log->nbuf;
+	log->nbuf=0;
+	if(!n) return 0;
+	if(fwrite(log->buf,sizeof(struct eventrecstruct),n,log->fptr)!=(size_t)n) return 1;
+	log->nrec+=n;
+	return 0; }
+
+
+/* evlogwritenames.  Writes any buffered records and then the species and reaction
+names and the trailer, which end the file.  Returns 0 for success or 1 for a
+write error. */
+int evlogwritenames(eventlogptr log,int nspecies,char **spname,int nrxnset,int *nrxn,char ***rxnname) {
+	FILE *fptr;
+	long long offset;
+	int i,s,r,er;
+
+	er=evlogflush(log);
+	fptr=log->fptr;
+	offset=ftell(fptr);
+	if(fwrite("NAMS",1,4,fptr)!=4) return 1;
+	if(fwrite(&nspecies,sizeof(int),1,fptr)!=1) return 1;
+	for(i=0;i<nspecies;i++)
+		if(evlogwritestring(fptr,spname[i])) return 1;
+	if(fwrite(&nrxnset,sizeof(int),1,fptr)!=1) return 1;
+	for(s=0;s<nrxnset;s++) {
+		if(fwrite(&nrxn[s],sizeof(int),1,fptr)!=1) return 1;
+		for(r=0;r<nrxn[s];r++)
+			if(evlogwritestring(fptr,rxnname[s][r])) return 1; }
+	if(fwrite(&log->nrec,sizeof(long long),1,fptr)!=1) return 1;
+	if(fwrite(&offset,sizeof(long long),1,fptr)!=1) return 1;
+	if(fwrite(EVENTENDMAGIC,1,8,fptr)!=8) return 1;
+	fflush(fptr);
+	return er; }
+
+
+/******************************************************************************/
+/********************************** reading ***********************************/
+/******************************************************************************/
+
+
+/* evlogreadopen.  Opens the event log fname for reading, and reads the names if
+the file has them.  Returns the new structure or NULL if the file could not be
+opened or is not an event log of a supported version. */
+eventlogptr evlogreadopen(const char *fname) {
+	eventlogptr log;
+	char magic[8];
+	int header[3];
+	long long trailer[2];
+	long fsize;
+
+	log=evlogalloc();
+	if(!log) return NULL;
+	CHECK(log->fptr=fopen(fname,"rb"));
+	CHECK(fread(magic,1,8,log->fptr)==8 && !strncmp(magic,EVENTMAGIC,8));
+	CHECK(fread(header,sizeof(int),3,log->fptr)==3);
+	CHECK(header[0]==EVENTVERSION && header[1]==EVENTBYTEORDER && header[2]==sizeof(struct eventrecstruct));
+	log->datastart=ftell(log->fptr);
+	CHECK(fseek(log->fptr,0,SEEK_END)==0);
+	fsize=ftell(log->fptr);
+
+	if(fsize-log->datastart>=24 && fseek(log->fptr,-24,SEEK_END)==0 && fread(trailer,sizeof(long long),2,log->fptr)==2 && fread(magic,1,8,log->fptr)==8 && !strncmp(magic,EVENTENDMAGIC,8)) {
+		log->nrec=trailer[0];
+		CHECK(!evlogreadnames(log,(long)trailer[1])); }
+	else
+		log->nrec=(fsize-log->datastart)/sizeof(struct eventrecstruct);
+	return log;
+ failure:
+	evlogfree(log);
+	return NULL; }
+
+
+/* evlogread.  Reads up to n records, starting with record first, into recs.
+Returns the number of records read. */
+int evlogread(eventlogptr log,long long first,int n,eventrecptr recs) {
+	if(first<0 || first>=log->nrec) return 0;
+	if(first+n>log->nrec) n=(int)(log->nrec-first);
+	if(fseek(log->fptr,log->datastart+(long)(first*sizeof(struct eventrecstruct)),SEEK_SET)) return 0;
+	return (int)fread(recs,sizeof(struct eventrecstruct),n,log->fptr); }
+
+
+/* evlogtypestring */
+const char *evlogtypestring(int type) {
+	if(type==ERstart) return "start";
+	if(type==ERbind) return "bind";
+	if(type==ERunbind) return "unbind";
+	if(type==ERmodify) return "modify";
+	if(type==ERgenerate) return "generate";
+	if(type==ERend) return "end";
+	return "unknown"; }
+
+
+/******************************************************************************/
+/********************************** freeing ***********************************/
+/******************************************************************************/
+
+
+/* evlogfree.  Frees the structure and closes its file, without writing buffered
+records. */
+void evlogfree(eventlogptr log) {
+	int i,s,r;
+
+	if(!log) return;
+	if(log->fptr) fclose(log->fptr);
+	free(log->buf);
+	if(log->spname) {
+		for(i=0;i<log->nspecies;i++) free(log->spname[i]);
+		free(log->spname); }
+	if(log->rxnname) {
+		for(s=0;s<log->nrxnset;s++) {
+			if(log->rxnname[s])
+				for(r=0;r<log->nrxn[s];r++) free(log->rxnname[s][r]);
+			free(log->rxnname[s]); }
+		free(log->rxnname); }
+	free(log->nrxn);
+	free(log);
+	return; }
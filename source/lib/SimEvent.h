@@ -0,0 +1,55 @@
+/* Binary event logs.
+Library for writing and reading fixed-size simulation event records.
+This work is distributed under the terms of the Gnu Lesser General Public License
+(LGPL). */
+
+#ifndef __SimEvent_h__
+#define __SimEvent_h__
+
+#include <stdio.h>
+
+#define EVENTVERSION 1
+
+enum EventRecType {ERstart,ERbind,ERunbind,ERmodify,ERgenerate,ERend};
+
+typedef struct eventrecstruct {
+	double time;					// simulation time of event
+	double pos[3];				// position of first molecule
+	double value;					// binding or unbinding distance, or 0
+	long long serno[2];		// serial numbers of molecules, 0 for none
+	int type;							// enum EventRecType
+	int rxnset;						// reaction set, which is number of reactants, or -1
+	int rxn;							// reaction number within set, or -1
+	int ident[2];					// species of molecules
+	int site[2];					// reacting sites, or -1
+	int sites[2];					// site state bits of molecules after event
+	int complexid[2];			// complex ids of molecules
+	int unused;						// padding, always 0
+	} *eventrecptr;
+
+typedef struct eventlogstruct {
+	FILE *fptr;						// file being written or read
+	int maxbuf;						// allocated size of record buffer
+	int nbuf;							// number of records in buffer
+	eventrecptr buf;			// record buffer [n]
+	long long nrec;				// number of records in file
+	long datastart;				// file offset of first record
+	int nspecies;					// number of species names read
+	char **spname;				// species names [i]
+	int nrxnset;					// number of reaction sets read
+	int *nrxn;						// number of reaction names in each set [s]
+	char ***rxnname;			// reaction names [s][r]
+	} *eventlogptr;
+
+eventlogptr evlogwriteopen(const char *fname,int maxbuf);
+eventrecptr evlognext(eventlogptr log);
+int evlogflush(eventlogptr log);
+int evlogwritenames(eventlogptr log,int nspecies,char **spname,int nrxnset,int *nrxn,char ***rxnname);
+
+eventlogptr evlogreadopen(const char *fname);
+int evlogread(eventlogptr log,long long first,int n,eventrecptr recs);
+const char *evlogtypestring(int type);
+
+void evlogfree(eventlogptr log);
+
+#endif
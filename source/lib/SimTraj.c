@@ -0,0 +1,465 @@
+/* Binary columnar trajectory files.
+Library for writing and reading molecule trajectories in a compact binary form.
+This work is distributed under the terms of the Gnu Lesser General Public License
+(LGPL). */
+
+/* File layout, all values in native byte order:
+  header:  "SMOLTRJ" and a nul, version, byte order check 0x01020304, dim,
+           nspecies, then for each species a name length and the name
+  frame:   "FRAM", time, nmol, codec, raw block size, stored block size, block
+  block:   columns of serno (8 bytes each), species, state, sites, complex id
+           (4 bytes each), then one column of positions per dimension (doubles)
+  index:   "INDX", nframe, then time and file offset for each frame
+  trailer: index offset and "SMOLTRJE"
+The index and trailer are written when the writer is finished.  A file without
+them, for example from a run that was stopped early, is still readable because
+the reader then builds the index by stepping over the frame headers. */
+
+#include <stdlib.h>
+#include <string.h>
+#include "SimTraj.h"
+#include "smoldynconfigure.h"
+
+#ifdef HAVE_ZLIB
+	#include <zlib.h>
+#endif
+
+#define CHECK(A) if(!(A)) {goto failure;} else (void)0
+
+#define TRAJMAGIC "SMOLTRJ"
+#define TRAJENDMAGIC "SMOLTRJE"
+#define TRAJBYTEORDER 0x01020304
+
+
+/******************************************************************************/
+/********************************* frames *************************************/
+/******************************************************************************/
+
+
+/* trajframealloc */
+trajframeptr trajframealloc(int dim,int maxmol) {
+	trajframeptr frame;
+
+	if(dim<1 || dim>3) return NULL;
+	frame=(trajframeptr) malloc(sizeof(struct trajframestruct));
+	if(!frame) return NULL;
+	frame->time=0;
+	frame->dim=dim;
+	frame->nmol=0;
+	frame->maxmol=0;
+	frame->serno=NULL;
+	frame->species=NULL;
+	frame->state=NULL;
+	frame->sites=NULL;
+	frame->complexid=NULL;
+	frame->pos=NULL;
+	if(trajframeexpand(frame,maxmol)) {
+		trajframefree(frame);
+		return NULL; }
+	return frame; }
+
+
+/* trajframeexpand.  Makes room for at least maxmol molecules, discarding any
+frame contents.  Returns 0 for success or 1 for out of memory. */
+int trajframeexpand(trajframeptr frame,int maxmol) {
+	if(maxmol<=frame->maxmol) return 0;
+	free(frame->serno);
+	free(frame->species);
+	free(frame->state);
+	free(frame->sites);
+	free(frame->complexid);
+	free(frame->pos);
+	frame->serno=NULL;
+	frame->species=frame->state=frame->sites=frame->complexid=NULL;
+	frame->pos=NULL;
+	frame->maxmol=0;
+	frame->nmol=0;
+	CHECK(frame->serno=(long long*) calloc(maxmol,sizeof(long long)));
+	CHECK(frame->species=(int*) calloc(maxmol,sizeof(int)));
+	CHECK(frame->state=(int*) calloc(maxmol,sizeof(int)));
+	CHECK(frame->sites=(int*) calloc(maxmol,sizeof(int)));
+	CHECK(frame->complexid=(int*) calloc(maxmol,sizeof(int)));
+	CHECK(frame->pos=(double*) calloc(maxmol*frame->dim,sizeof(double)));
+	frame->maxmol=maxmol;
+	return 0;
+ failure:
+	return 1; }
+
+
+/* trajframefree */
+void trajframefree(trajframeptr frame) {
+	if(!frame) return;
+	free(frame->serno);
+	free(frame->species);
+	free(frame->state);
+	free(frame->sites);
+	free(frame->complexid);
+	free(frame->pos);
+	free(frame);
+	return; }
+
+
+/******************************************************************************/
+/***************************** internal functions *****************************/
+/******************************************************************************/
+
+
+/* trajalloc */
+trajfileptr trajalloc(void) {
+	trajfileptr traj;
+
+	traj=(trajfileptr) malloc(sizeof(struct trajfilestruct));
+	if(!traj) return NULL;
+	traj->fptr=NULL;
+	traj->ownfile=0;
+	traj->dim=0;
+	traj->nspecies=0;
+	traj->spname=NULL;
+	traj->codec=TCnone;
+	traj->nframe=0;
+	traj->maxframe=0;
+	traj->ftime=NULL;
+	traj->foffset=NULL;
+	traj->buf=NULL;
+	traj->zbuf=NULL;
+	traj->maxbuf=0;
+	traj->maxzbuf=0;
+	return traj; }
+
+
+/* trajaddframe.  Adds a frame to the index.  Returns 0 for success or 1 for out of
+memory. */
+int trajaddframe(trajfileptr traj,double time,long offset) {
+	int newmax,f;
+	double *newtime;
+	long *newoffset;
+
+	if(traj->nframe==traj->maxframe) {
+		newmax=2*traj->maxframe+16;
+		newtime=(double*) calloc(newmax,sizeof(double));
+		newoffset=(long*) calloc(newmax,sizeof(long));
+		if(!newtime || !newoffset) {
+			free(newtime);
+			free(newoffset);
+			return 1; }
+		for(f=0;f<traj->nframe;f++) {
+			newtime[f]=traj->ftime[f];
+			newoffset[f]=traj->foffset[f]; }
+		free(traj->ftime);
+		free(traj->foffset);
+		traj->ftime=newtime;
+		traj->foffset=newoffset;
+		traj->maxframe=newmax; }
+	traj->ftime[traj->nframe]=time;
+	traj->foffset[traj->nframe]=offset;
+	traj->nframe++;
+	return 0; }
+
+
+/* trajbufsize.  Makes sure that the raw buffer, or the compressed buffer if zip is
+set, holds at least size bytes.  Returns 0 for success or 1 for out of memory. */
+int trajbufsize(trajfileptr traj,size_t size,int zip) {
+	unsigned char *newbuf;
+
+	if(!zip && size<=traj->maxbuf) return 0;
+	if(zip && size<=traj->maxzbuf) return 0;
+	newbuf=(unsigned char*) malloc(size);
+	if(!newbuf) return 1;
+	if(zip) {
+		free(traj->zbuf);
+		traj->zbuf=newbuf;
+		traj->maxzbuf=size; }
+	else {
+		free(traj->buf);
+		traj->buf=newbuf;
+		traj->maxbuf=size; }
+	return 0; }
+
+
+/* trajrawsize.  Returns the number of bytes in the raw block of a frame. */
+size_t trajrawsize(int dim,int nmol) {
+	return (size_t)nmol*(sizeof(long long)+4*sizeof(int)+dim*sizeof(double)); }
+
+
+/******************************************************************************/
+/********************************** writing ***********************************/
+/******************************************************************************/
+
+
+/* trajcodecavailable.  Returns 1 if this build can write and read codec. */
+int trajcodecavailable(enum TrajCodec codec) {
+	if(codec==TCnone) return 1;
+#ifdef HAVE_ZLIB
+	if(codec==TCzlib) return 1;
+#endif
+	return 0; }
+
+
+/* trajwriteopen.  Starts a trajectory on fptr, which needs to be open for binary
+writing, by writing the file header.  The file is not closed by trajfree.  Returns
+the new structure, or NULL if codec is not available, memory ran out, or the
+header could not be written. */
+trajfileptr trajwriteopen(FILE *fptr,int dim,int nspecies,char **spname,enum TrajCodec codec) {
+	trajfileptr traj;
+	int header[4],i,len;
+	char magic[8];
+
+	if(!fptr || !trajcodecavailable(codec)) return NULL;
+	traj=trajalloc();
+	if(!traj) return NULL;
+	traj->fptr=fptr;
+	traj->dim=dim;
+	traj->nspecies=nspecies;
+	traj->codec=codec;
+
+	memset(magic,0,8);
+	strcpy(magic,TRAJMAGIC);
+	header[0]=TRAJVERSION;
+	header[1]=TRAJBYTEORDER;
+	header[2]=dim;
+	header[3]=nspecies;
+	CHECK(fwrite(magic,1,8,fptr)==8);
+	CHECK(fwrite(header,sizeof(int),4,fptr)==4);
+	for(i=0;i<nspecies;i++) {
+		len=(spname && spname[i])?strlen(spname[i]):0;
+		CHECK(fwrite(&len,sizeof(int),1,fptr)==1);
+		if(len) {
+			CHECK(fwrite(spname[i],1,len,fptr)==(size_t)len); }}
+	return traj;
+ failure:
+	trajfree(traj);
+	return NULL; }
+
+
+/* trajwriteframe.  Appends frame to the trajectory and records it in the index.
+Returns 0 for success, 1 for out of memory, or 2 for a write error. */
+int trajwriteframe(trajfileptr traj,trajframeptr frame) {
+	FILE *fptr;
+	size_t rawsize,size;
+	long long sizes[2];
+	int header[2],n,d;
+	unsigned char *block;
+	long offset;
+#ifdef HAVE_ZLIB
+	uLongf zsize;
+#endif
+
+	fptr=traj->fptr;
+	n=frame->nmol;
+	rawsize=trajrawsize(traj->dim,n);
+	if(trajbufsize(traj,rawsize,0)) return 1;
+	block=traj->buf;
+	memcpy(block,frame->serno,n*sizeof(long long));
+	block+=n*sizeof(long long);
+	memcpy(block,frame->species,n*sizeof(int));
+	block+=n*sizeof(int);
+	memcpy(block,frame->state,n*sizeof(int));
+	block+=n*sizeof(int);
+	memcpy(block,frame->sites,n*sizeof(int));
+	block+=n*sizeof(int);
+	memcpy(block,frame->complexid,n*sizeof(int));
+	block+=n*sizeof(int);
+	for(d=0;d<traj->dim;d++) {
+		memcpy(block,frame->pos+d*frame->maxmol,n*sizeof(double));
+		block+=n*sizeof(double); }
+
+	block=traj->buf;
+	size=rawsize;
+	header[1]=TCnone;
+#ifdef HAVE_ZLIB
+	if(traj->codec==TCzlib && rawsize>0) {
+		zsize=rawsize+rawsize/1000+64;				// compress2 bound, also for old zlib without compressBound
+		if(trajbufsize(traj,zsize,1)) return 1;
+		if(compress2(traj->zbuf,&zsize,traj->buf,rawsize,Z_BEST_SPEED)==Z_OK && zsize<rawsize) {
+			block=traj->zbuf;
+			size=zsize;
+			header[1]=TCzlib; }}
+#endif
+
+	offset=ftell(fptr);
+	header[0]=n;
+	sizes[0]=rawsize;
+	sizes[1]=size;
+	if(fwrite("FRAM",1,4,fptr)!=4) return 2;
+	if(fwrite(&frame->time,sizeof(double),1,fptr)!=1) return 2;
+	if(fwrite(header,sizeof(int),2,fptr)!=2) return 2;
+	if(fwrite(sizes,sizeof(long long),2,fptr)!=2) return 2;
+	if(size && fwrite(block,1,size,fptr)!=size) return 2;
+	if(trajaddframe(traj,frame->time,offset)) return 1;
+	return 0; }
+
+
+/* trajwriteindex.  Writes the frame index and trailer, which end the file.
+Returns 0 for success or 2 for a write error. */
+int trajwriteindex(trajfileptr traj) {
+	FILE *fptr;
+	long long offset,foffset;
+	int f;
+
+	fptr=traj->fptr;
+	offset=ftell(fptr);
+	if(fwrite("INDX",1,4,fptr)!=4) return 2;
+	if(fwrite(&traj->nframe,sizeof(int),1,fptr)!=1) return 2;
+	for(f=0;f<traj->nframe;f++) {
+		foffset=traj->foffset[f];
+		if(fwrite(&traj->ftime[f],sizeof(double),1,fptr)!=1) return 2;
+		if(fwrite(&foffset,sizeof(long long),1,fptr)!=1) return 2; }
+	if(fwrite(&offset,sizeof(long long),1,fptr)!=1) return 2;
+	if(fwrite(TRAJENDMAGIC,1,8,fptr)!=8) return 2;
+	fflush(fptr);
+	return 0; }
+
+
+/******************************************************************************/
+/********************************** reading ***********************************/
+/******************************************************************************/
+
+
+/* trajreadindex.  Reads the index from the end of the file, or if there is none,
+builds it by stepping over frame headers starting at offset start, ignoring a final
+frame that is incomplete.  Returns 0 for success, 1 for out of memory, or 3 for a
+damaged file. */
+int trajreadindex(trajfileptr traj,long start) {
+	FILE *fptr;
+	char tag[8];
+	long long offset,sizes[2];
+	double time;
+	int nframe,f,header[2];
+	long fsize;
+
+	fptr=traj->fptr;
+	traj->nframe=0;
+	if(fseek(fptr,0,SEEK_END)) return 3;
+	fsize=ftell(fptr);
+	if(fseek(fptr,-16,SEEK_END)==0 && fread(&offset,sizeof(long long),1,fptr)==1 && fread(tag,1,8,fptr)==8 && !strncmp(tag,TRAJENDMAGIC,8)) {
+		if(fseek(fptr,(long)offset,SEEK_SET)) return 3;
+		if(fread(tag,1,4,fptr)!=4 || strncmp(tag,"INDX",4)) return 3;
+		if(fread(&nframe,sizeof(int),1,fptr)!=1 || nframe<0) return 3;
+		for(f=0;f<nframe;f++) {
+			if(fread(&time,sizeof(double),1,fptr)!=1) return 3;
+			if(fread(&offset,sizeof(long long),1,fptr)!=1) return 3;
+			if(trajaddframe(traj,time,(long)offset)) return 1; }
+		return 0; }
+
+	if(fseek(fptr,start,SEEK_SET)) return 3;
+	while(fread(tag,1,4,fptr)==4 && !strncmp(tag,"FRAM",4)) {
+		offset=ftell(fptr)-4;
+		if(fread(&time,sizeof(double),1,fptr)!=1) break;
+		if(fread(header,sizeof(int),2,fptr)!=2) break;
+		if(fread(sizes,sizeof(long long),2,fptr)!=2) break;
+		if(sizes[1]<0 || ftell(fptr)+sizes[1]>fsize) break;		// last frame was cut short
+		if(fseek(fptr,(long)sizes[1],SEEK_CUR)) break;
+		if(trajaddframe(traj,time,(long)offset)) return 1; }
+	return 0; }
+
+
+/* trajreadopen.  Opens the trajectory file fname for reading and loads its header
+and frame index.  Returns the new structure or NULL if the file could not be
+opened or is not a trajectory file of a supported version. */
+trajfileptr trajreadopen(const char *fname) {
+	trajfileptr traj;
+	char magic[8];
+	int header[4],i,len;
+
+	traj=trajalloc();
+	if(!traj) return NULL;
+	CHECK(traj->fptr=fopen(fname,"rb"));
+	traj->ownfile=1;
+	CHECK(fread(magic,1,8,traj->fptr)==8 && !strncmp(magic,TRAJMAGIC,8));
+	CHECK(fread(header,sizeof(int),4,traj->fptr)==4);
+	CHECK(header[0]==TRAJVERSION && header[1]==TRAJBYTEORDER);
+	traj->dim=header[2];
+	CHECK(traj->dim>=1 && traj->dim<=3);
+	CHECK(header[3]>=0);
+	CHECK(traj->spname=(char**) calloc(header[3]+1,sizeof(char*)));
+	traj->nspecies=header[3];
+	for(i=0;i<traj->nspecies;i++) {
+		CHECK(fread(&len,sizeof(int),1,traj->fptr)==1 && len>=0);
+		CHECK(traj->spname[i]=(char*) calloc(len+1,sizeof(char)));
+		if(len) {
+			CHECK(fread(traj->spname[i],1,len,traj->fptr)==(size_t)len); }}
+	CHECK(trajreadindex(traj,ftell(traj->fptr))==0);
+	return traj;
+ failure:
+	trajfree(traj);
+	return NULL; }
+
+
+/* trajreadframe.  Reads frame number f into frame, which is expanded as needed.
+Returns 0 for success, 1 for out of memory, 2 for a bad frame number or a
+dimension mismatch, 3 for a damaged file, or 4 for a compressed frame that this
+build cannot read. */
+int trajreadframe(trajfileptr traj,int f,trajframeptr frame) {
+	FILE *fptr;
+	char tag[4];
+	long long sizes[2];
+	int header[2],n,d;
+	unsigned char *block;
+#ifdef HAVE_ZLIB
+	uLongf rawsize;
+#endif
+
+	if(f<0 || f>=traj->nframe || frame->dim!=traj->dim) return 2;
+	fptr=traj->fptr;
+	if(fseek(fptr,traj->foffset[f],SEEK_SET)) return 3;
+	if(fread(tag,1,4,fptr)!=4 || strncmp(tag,"FRAM",4)) return 3;
+	if(fread(&frame->time,sizeof(double),1,fptr)!=1) return 3;
+	if(fread(header,sizeof(int),2,fptr)!=2) return 3;
+	if(fread(sizes,sizeof(long long),2,fptr)!=2) return 3;
+	n=header[0];
+	if(n<0 || (size_t)sizes[0]!=trajrawsize(traj->dim,n)) return 3;
+	if(!trajcodecavailable((enum TrajCodec)header[1])) return 4;
+	if(trajframeexpand(frame,n)) return 1;
+	if(trajbufsize(traj,(size_t)sizes[0],0)) return 1;
+
+	if(header[1]==TCnone) {
+		if(sizes[1]!=sizes[0]) return 3;
+		if(sizes[0] && fread(traj->buf,1,(size_t)sizes[0],fptr)!=(size_t)sizes[0]) return 3; }
+#ifdef HAVE_ZLIB
+	else if(header[1]==TCzlib) {
+		if(trajbufsize(traj,(size_t)sizes[1],1)) return 1;
+		if(fread(traj->zbuf,1,(size_t)sizes[1],fptr)!=(size_t)sizes[1]) return 3;
+		rawsize=(uLongf)sizes[0];
+		if(uncompress(traj->buf,&rawsize,traj->zbuf,(uLong)sizes[1])!=Z_OK || rawsize!=(uLongf)sizes[0]) return 3; }
+#endif
+	else return 4;
+
+	block=traj->buf;
+	memcpy(frame->serno,block,n*sizeof(long long));
+	block+=n*sizeof(long long);
+	memcpy(frame->species,block,n*sizeof(int));
+	block+=n*sizeof(int);
+	memcpy(frame->state,block,n*sizeof(int));
+	block+=n*sizeof(int);
+	memcpy(frame->sites,block,n*sizeof(int));
+	block+=n*sizeof(int);
+	memcpy(frame->complexid,block,n*sizeof(int));
+	block+=n*sizeof(int);
+	for(d=0;d<traj->dim;d++) {
+		memcpy(frame->pos+d*frame->maxmol,block,n*sizeof(double));
+		block+=n*sizeof(double); }
+	frame->nmol=n;
+	return 0; }
+
+
+/******************************************************************************/
+/********************************** freeing ***********************************/
+/******************************************************************************/
+
+
+/* trajfree.  Frees the structure, and closes the file if it was opened by
+trajreadopen. */
+void trajfree(trajfileptr traj) {
+	int i;
+
+	if(!traj) return;
+	if(traj->ownfile && traj->fptr) fclose(traj->fptr);
+	if(traj->spname) {
+		for(i=0;i<traj->nspecies;i++) free(traj->spname[i]);
+		free(traj->spname); }
+	free(traj->ftime);
+	free(traj->foffset);
+	free(traj->buf);
+	free(traj->zbuf);
+	free(traj);
+	return; }
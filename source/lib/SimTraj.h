@@ -0,0 +1,59 @@
+/* Binary columnar trajectory files.
+Library for writing and reading molecule trajectories in a compact binary form.
+This work is distributed under the terms of the Gnu Lesser General Public License
+(LGPL). */
+
+#ifndef __SimTraj_h__
+#define __SimTraj_h__
+
+#include <stdio.h>
+
+#define TRAJVERSION 1
+
+enum TrajCodec {TCnone,TCzlib};
+
+typedef struct trajframestruct {
+	double time;					// simulation time of frame
+	int dim;							// system dimensionality
+	int nmol;							// number of molecules in frame
+	int maxmol;						// allocated size of columns
+	long long *serno;			// molecule serial numbers [m]
+	int *species;					// species numbers [m]
+	int *state;						// molecule states [m]
+	int *sites;						// site state bits [m]
+	int *complexid;				// complex ids, -1 for none [m]
+	double *pos;					// positions, one column per dimension [d*maxmol+m]
+	} *trajframeptr;
+
+typedef struct trajfilestruct {
+	FILE *fptr;						// file being written or read
+	int ownfile;					// 1 if fptr is closed with the structure
+	int dim;							// system dimensionality
+	int nspecies;					// number of species, including empty
+	char **spname;				// species names [i]
+	enum TrajCodec codec;	// block compression for written frames
+	int nframe;						// number of frames
+	int maxframe;					// allocated size of frame index
+	double *ftime;				// frame times [f]
+	long *foffset;				// frame file offsets [f]
+	unsigned char *buf;		// raw block buffer
+	unsigned char *zbuf;	// compressed block buffer
+	size_t maxbuf;				// allocated size of buf
+	size_t maxzbuf;				// allocated size of zbuf
+	} *trajfileptr;
+
+trajframeptr trajframealloc(int dim,int maxmol);
+int trajframeexpand(trajframeptr frame,int maxmol);
+void trajframefree(trajframeptr frame);
+
+int trajcodecavailable(enum TrajCodec codec);
+trajfileptr trajwriteopen(FILE *fptr,int dim,int nspecies,char **spname,enum TrajCodec codec);
+int trajwriteframe(trajfileptr traj,trajframeptr frame);
+int trajwriteindex(trajfileptr traj);
+
+trajfileptr trajreadopen(const char *fname);
+int trajreadframe(trajfileptr traj,int f,trajframeptr frame);
+
+void trajfree(trajfileptr traj);
+
+#endif
@@ -141,6 +141,16 @@ inline static int intrand(int n) {
 	return (int)(randULI()%n); }
 
 
+/* keyrandULI.  Counter-based generator for parallel code; the result depends only
+on key, so it does not matter which thread asks or in which order.  This is the
+splitmix64 finalizer. */
+inline static unsigned long int keyrandULI(unsigned long long key) {
+	key+=0x9E3779B97F4A7C15ULL;
+	key=(key^(key>>30))*0xBF58476D1CE4E5B9ULL;
+	key=(key^(key>>27))*0x94D049BB133111EBULL;
+	return (unsigned long int)(key^(key>>31)); }
+
+
 inline static double exprandCOD(double a) {
 	return -log(randOCD())*a; }
 
@@ -0,0 +1,141 @@
+/* Decodes binary event logs that were written by Smoldyn's events_binary statement. */
+/* Prints the events as text, one per line, or a summary of event counts. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SimEvent.h"
+
+#define VERSION 1.0
+#define READBLOCK 4096
+
+void printusage(void);
+const char *speciesname(eventlogptr log,int i);
+const char *reactionname(eventlogptr log,eventrecptr rec);
+void printevent(eventlogptr log,eventrecptr rec);
+int printsummary(eventlogptr log,eventrecptr recs);
+
+
+/* printusage */
+void printusage(void) {
+	printf("smolevents version %g\n",VERSION);
+	printf("Usage: smolevents file              all events as text\n");
+	printf("       smolevents file summary      number of events of each type and reaction\n");
+	printf("Event lines list time, event type, reaction, then serial number, species,\n");
+	printf("site, site bits, and complex id for each molecule, then position and value.\n");
+	return; }
+
+
+/* speciesname */
+const char *speciesname(eventlogptr log,int i) {
+	static char string[32];
+
+	if(i>=0 && i<log->nspecies) return log->spname[i];
+	sprintf(string,"%i",i);
+	return string; }
+
+
+/* reactionname */
+const char *reactionname(eventlogptr log,eventrecptr rec) {
+	static char string[32];
+
+	if(rec->rxnset<0) return "-";
+	if(rec->rxnset<log->nrxnset && rec->rxn>=0 && rec->rxn<log->nrxn[rec->rxnset])
+		return log->rxnname[rec->rxnset][rec->rxn];
+	sprintf(string,"%i:%i",rec->rxnset,rec->rxn);
+	return string; }
+
+
+/* printevent */
+void printevent(eventlogptr log,eventrecptr rec) {
+	int k,nmol;
+
+	printf("%g %s %s",rec->time,evlogtypestring(rec->type),reactionname(log,rec));
+	nmol=rec->serno[1]?2:1;
+	for(k=0;k<nmol;k++)
+		printf(" %lli %s %i %i %i",rec->serno[k],speciesname(log,rec->ident[k]),rec->site[k],rec->sites[k],rec->complexid[k]);
+	printf(" %g %g %g %g\n",rec->pos[0],rec->pos[1],rec->pos[2],rec->value);
+	return; }
+
+
+/* printsummary.  Returns 0 for success or 1 for out of memory. */
+int printsummary(eventlogptr log,eventrecptr recs) {
+	int n,i,j,nkey,maxkey,*count,*newcount;
+	long long first;
+	eventrecptr key,newkey;
+
+	nkey=maxkey=0;
+	key=NULL;
+	count=NULL;
+	for(first=0;(n=evlogread(log,first,READBLOCK,recs))>0;first+=n)
+		for(i=0;i<n;i++) {
+			for(j=0;j<nkey && !(key[j].type==recs[i].type && key[j].rxnset==recs[i].rxnset && key[j].rxn==recs[i].rxn);j++);
+			if(j==nkey) {
+				if(nkey==maxkey) {
+					maxkey=2*maxkey+16;
+					newkey=(eventrecptr) calloc(maxkey,sizeof(struct eventrecstruct));
+					newcount=(int*) calloc(maxkey,sizeof(int));
+					if(!newkey || !newcount) {
+						free(newkey);
+						free(newcount);
+						free(key);
+						free(count);
+						return 1; }
+					for(j=0;j<nkey;j++) {
+						newkey[j]=key[j];
+						newcount[j]=count[j]; }
+					free(key);
+					free(count);
+					key=newkey;
+					count=newcount; }
+				key[nkey]=recs[i];
+				count[nkey]=0;
+				j=nkey++; }
+			count[j]++; }
+
+	printf("species:");
+	for(i=1;i<log->nspecies;i++) printf(" %s",log->spname[i]);
+	printf("\n");
+	printf("events: %lli\n",log->nrec);
+	for(j=0;j<nkey;j++)
+		printf(" %s %s: %i\n",evlogtypestring(key[j].type),reactionname(log,&key[j]),count[j]);
+	free(key);
+	free(count);
+	return 0; }
+
+
+/* main */
+int main(int argc,char **argv) {
+	eventlogptr log;
+	eventrecptr recs;
+	long long first;
+	int n,i,er;
+
+	if(argc<2) {
+		printusage();
+		return 0; }
+	log=evlogreadopen(argv[1]);
+	if(!log) {
+		fprintf(stderr,"Unable to read event log '%s'\n",argv[1]);
+		return 1; }
+	if(!log->nspecies) fprintf(stderr,"Event log has no names, probably because the simulation did not finish\n");
+	recs=(eventrecptr) calloc(READBLOCK,sizeof(struct eventrecstruct));
+	if(!recs) {
+		fprintf(stderr,"Out of memory\n");
+		evlogfree(log);
+		return 1; }
+
+	er=0;
+	if(argc==2) {
+		for(first=0;(n=evlogread(log,first,READBLOCK,recs))>0;first+=n)
+			for(i=0;i<n;i++) printevent(log,&recs[i]); }
+	else if(!strcmp(argv[2],"summary")) {
+		er=printsummary(log,recs);
+		if(er) fprintf(stderr,"Out of memory\n"); }
+	else {
+		printusage();
+		er=1; }
+
+	free(recs);
+	evlogfree(log);
+	return er; }
@@ -0,0 +1,110 @@
+/* Reads binary trajectory files that were written by Smoldyn, using writetraj, the
+traj option of the molecule listing commands, or the end_trajectory statement. */
+/* Prints a summary, the frame list, or frame contents as text. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SimTraj.h"
+
+#define VERSION 1.0
+
+void printusage(void);
+void printsummary(trajfileptr traj);
+void printframelist(trajfileptr traj);
+int printframe(trajfileptr traj,trajframeptr frame,int f);
+
+
+/* printusage */
+void printusage(void) {
+	printf("smoltraj version %g\n",VERSION);
+	printf("Usage: smoltraj file                summary of the trajectory\n");
+	printf("       smoltraj file frames         time and molecule count of each frame\n");
+	printf("       smoltraj file dump f         molecules of frame f, one per line\n");
+	printf("       smoltraj file text           molecules of all frames\n");
+	printf("Molecule lines list time, serial number, species, state, site bits,\n");
+	printf("complex id, and position.\n");
+	return; }
+
+
+/* printsummary */
+void printsummary(trajfileptr traj) {
+	int i;
+
+	printf("dimensions: %i\n",traj->dim);
+	printf("species:");
+	for(i=1;i<traj->nspecies;i++) printf(" %s",traj->spname[i]);
+	printf("\n");
+	printf("frames: %i\n",traj->nframe);
+	if(traj->nframe)
+		printf("times: %g to %g\n",traj->ftime[0],traj->ftime[traj->nframe-1]);
+	return; }
+
+
+/* printframelist */
+void printframelist(trajfileptr traj) {
+	trajframeptr frame;
+	int f,er;
+
+	frame=trajframealloc(traj->dim,1);
+	if(!frame) {
+		fprintf(stderr,"Out of memory\n");
+		return; }
+	for(f=0;f<traj->nframe;f++) {
+		er=trajreadframe(traj,f,frame);
+		if(er) printf("%i %g unreadable (error %i)\n",f,traj->ftime[f],er);
+		else printf("%i %g %i\n",f,frame->time,frame->nmol); }
+	trajframefree(frame);
+	return; }
+
+
+/* printframe.  Returns 0 for success or the trajreadframe error code. */
+int printframe(trajfileptr traj,trajframeptr frame,int f) {
+	int m,d,er,i;
+
+	er=trajreadframe(traj,f,frame);
+	if(er) return er;
+	for(m=0;m<frame->nmol;m++) {
+		i=frame->species[m];
+		printf("%g %lli %s %i %i %i",frame->time,frame->serno[m],(i>0 && i<traj->nspecies)?traj->spname[i]:"?",frame->state[m],frame->sites[m],frame->complexid[m]);
+		for(d=0;d<traj->dim;d++) printf(" %g",frame->pos[d*frame->maxmol+m]);
+		printf("\n"); }
+	return 0; }
+
+
+/* main */
+int main(int argc,char **argv) {
+	trajfileptr traj;
+	trajframeptr frame;
+	int f,er;
+
+	if(argc<2) {
+		printusage();
+		return 0; }
+	traj=trajreadopen(argv[1]);
+	if(!traj) {
+		fprintf(stderr,"Unable to read trajectory file '%s'\n",argv[1]);
+		return 1; }
+
+	er=0;
+	if(argc==2) printsummary(traj);
+	else if(!strcmp(argv[2],"frames")) printframelist(traj);
+	else if(!strcmp(argv[2],"dump") || !strcmp(argv[2],"text")) {
+		frame=trajframealloc(traj->dim,1);
+		if(!frame) er=1;
+		else if(!strcmp(argv[2],"dump")) {
+			if(argc<4 || sscanf(argv[3],"%i",&f)!=1) er=2;
+			else er=printframe(traj,frame,f); }
+		else
+			for(f=0;f<traj->nframe && !er;f++) er=printframe(traj,frame,f);
+		trajframefree(frame);
+		if(er==1) fprintf(stderr,"Out of memory\n");
+		else if(er==2) fprintf(stderr,"Frame number is missing or out of range\n");
+		else if(er==3) fprintf(stderr,"Trajectory file is damaged\n");
+		else if(er==4) fprintf(stderr,"Frame is compressed with a codec that this build cannot read\n"); }
+	else {
+		printusage();
+		er=2; }
+
+	trajfree(traj);
+	return er?1:0; }
@@ -0,0 +1,30 @@
+# Runs one Smoldyn regression test and compares its output files with the expected ones.
+# Invoked by ctest as:
+#   cmake -DSMOLDYN=<program> -DCONFIG=<config file> -DEXPECTED=<directory> -DWORKDIR=<directory> -P RunSmoldynTest.cmake
+# The configuration file is copied into WORKDIR before it is run, because Smoldyn writes its
+# output files next to the configuration file.  Every file in EXPECTED must then be reproduced
+# exactly.
+
+file(REMOVE_RECURSE ${WORKDIR})
+file(MAKE_DIRECTORY ${WORKDIR})
+get_filename_component(CONFIGNAME ${CONFIG} NAME)
+configure_file(${CONFIG} ${WORKDIR}/${CONFIGNAME} COPYONLY)
+
+execute_process(COMMAND ${SMOLDYN} ${CONFIGNAME} -qw
+	WORKING_DIRECTORY ${WORKDIR}
+	RESULT_VARIABLE RESULT)
+if(NOT RESULT EQUAL 0)
+	message(FATAL_ERROR "${CONFIGNAME} failed with status ${RESULT}")
+endif()
+
+file(GLOB EXPECTEDFILES RELATIVE ${EXPECTED} ${EXPECTED}/*)
+foreach(NAME ${EXPECTEDFILES})
+	if(NOT EXISTS ${WORKDIR}/${NAME})
+		message(FATAL_ERROR "${NAME} was not written")
+	endif()
+	execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${EXPECTED}/${NAME} ${WORKDIR}/${NAME}
+		RESULT_VARIABLE RESULT)
+	if(NOT RESULT EQUAL 0)
+		message(FATAL_ERROR "${NAME} differs from ${EXPECTED}/${NAME}")
+	endif()
+endforeach()